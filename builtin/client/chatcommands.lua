@@ -69,6 +69,29 @@ core.register_chatcommand("clear_chat_queue", {
 	end,
 })
 
+local profiler_report, profiler_save, profiler_reset =
+	core.profiler_report, core.profiler_save, core.profiler_reset
+core.profiler_report, core.profiler_save, core.profiler_reset = nil, nil, nil
+
+core.register_chatcommand("csm_profiler", {
+	params = core.gettext("[save | reset]"),
+	description = core.gettext("Show the time spent in client-side mods, " ..
+		"save it for a flame graph or reset it"),
+	func = function(param)
+		if param == "save" then
+			local path = profiler_save()
+			if not path then
+				return false, core.gettext("Failed to save the profile.")
+			end
+			return true, core.gettext("Saved the profile to ") .. path
+		elseif param == "reset" then
+			profiler_reset()
+			return true, core.gettext("The profile is now empty.")
+		end
+		return true, profiler_report()
+	end,
+})
+
 function core.run_server_chatcommand(cmd, param)
 	core.send_chat_message("/" .. cmd .. " " .. param)
 end
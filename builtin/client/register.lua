@@ -3,6 +3,10 @@ core.callback_origins = {}
 local getinfo = debug.getinfo
 debug.getinfo = nil
 
+-- Only present when the callback profiler is enabled
+local profiler_enter, profiler_leave = core.profiler_enter, core.profiler_leave
+core.profiler_enter, core.profiler_leave = nil, nil
+
 --- Runs given callbacks.
 --
 -- Note: this function is also called from C++
@@ -22,7 +26,14 @@ function core.run_callbacks(callbacks, mode, ...)
 	end
 	local ret
 	for i = 1, cb_len do
-		local cb_ret = callbacks[i](...)
+		local cb_ret
+		if profiler_enter then
+			profiler_enter(callbacks[i])
+			cb_ret = callbacks[i](...)
+			profiler_leave(callbacks[i])
+		else
+			cb_ret = callbacks[i](...)
+		end
 
 		if mode == 0 and i == 1 or mode == 1 and i == cb_len then
 			ret = cb_ret
@@ -0,0 +1,265 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "benchmark_client.h"
+#include "debug.h"
+#include "defaultsettings.h"
+#include "log.h"
+#include "porting.h"
+#include "settings.h"
+#include "version.h"
+#include "network/socket.h"
+#include "util/numeric.h"
+#include "util/string.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+volatile u64 g_benchmark_sink = 0;
+
+// Target duration of one sample
+#define SAMPLE_TIME_NS 20000000ULL
+// Minimum time spent warming up each case
+#define WARMUP_TIME_NS 100000000ULL
+
+struct RegisteredBenchmark
+{
+	std::string name;
+	BenchmarkFunc func;
+};
+
+static std::vector<RegisteredBenchmark> &get_benchmarks()
+{
+	// Function-local to be independent of static initialization order
+	static std::vector<RegisteredBenchmark> benchmarks;
+	return benchmarks;
+}
+
+BenchmarkRegistrar::BenchmarkRegistrar(const char *name, BenchmarkFunc func)
+{
+	get_benchmarks().push_back({name, func});
+}
+
+static std::string json_escape(const std::string &str)
+{
+	std::string ret;
+	ret.reserve(str.size());
+	for (char c : str) {
+		if (c == '"' || c == '\\')
+			ret += '\\';
+		if ((unsigned char)c < 0x20)
+			ret += ' ';
+		else
+			ret += c;
+	}
+	return ret;
+}
+
+BenchmarkRunner::BenchmarkRunner(const BenchmarkOptions &options) :
+	m_options(options)
+{
+}
+
+BenchmarkRunner::~BenchmarkRunner() = default;
+
+void BenchmarkRunner::list()
+{
+	std::vector<std::string> names;
+	for (const RegisteredBenchmark &benchmark : get_benchmarks())
+		names.push_back(benchmark.name);
+	std::sort(names.begin(), names.end());
+	for (const std::string &name : names)
+		std::cout << name << std::endl;
+}
+
+bool BenchmarkRunner::run()
+{
+	std::vector<RegisteredBenchmark> benchmarks = get_benchmarks();
+	std::sort(benchmarks.begin(), benchmarks.end(),
+		[] (const RegisteredBenchmark &a, const RegisteredBenchmark &b) {
+			return a.name < b.name;
+		});
+
+	std::cout << "{\"version\":\"" << json_escape(g_version_hash)
+		<< "\",\"samples\":" << m_options.samples << "}" << std::endl;
+
+	// Every benchmark runs, measure() and report() skip the cases that do
+	// not match the filter and the benchmarks use wanted() to skip their
+	// preparation
+	for (const RegisteredBenchmark &benchmark : benchmarks) {
+		infostream << "Running benchmark " << benchmark.name << std::endl;
+		try {
+			benchmark.func(*this);
+		} catch (const std::exception &e) {
+			fail(benchmark.name, e.what());
+		}
+	}
+
+	if (m_matched == 0) {
+		errorstream << "No benchmark case matches \"" << m_options.filter
+			<< "\"" << std::endl;
+		return false;
+	}
+
+	return !m_failed;
+}
+
+bool BenchmarkRunner::wanted(const std::string &name) const
+{
+	return name.find(m_options.filter) != std::string::npos;
+}
+
+void BenchmarkRunner::measure(const std::string &name, u32 items,
+		const char *unit, const std::function<void()> &fn)
+{
+	if (!wanted(name))
+		return;
+	m_matched++;
+
+	// Warm up caches and find how many calls make up a sample
+	u64 warmup_calls = 0;
+	const u64 warmup_start = porting::getTimeNs();
+	u64 warmup_time;
+	do {
+		fn();
+		warmup_calls++;
+		warmup_time = porting::getTimeNs() - warmup_start;
+	} while (warmup_time < WARMUP_TIME_NS || warmup_calls < 2);
+
+	const u64 call_time = MYMAX(warmup_time / warmup_calls, 1);
+	const u32 iterations = rangelim(SAMPLE_TIME_NS / call_time, 1, 1000000);
+
+	std::vector<double> samples;
+	samples.reserve(m_options.samples);
+	for (u32 i = 0; i < m_options.samples; i++) {
+		const u64 start = porting::getTimeNs();
+		for (u32 j = 0; j < iterations; j++)
+			fn();
+		const u64 elapsed = porting::getTimeNs() - start;
+		samples.push_back((double)elapsed / ((double)iterations * items));
+	}
+
+	std::sort(samples.begin(), samples.end());
+	const double median = samples[samples.size() / 2];
+
+	std::vector<double> deviations;
+	deviations.reserve(samples.size());
+	for (double sample : samples)
+		deviations.push_back(std::fabs(sample - median));
+	std::sort(deviations.begin(), deviations.end());
+	const double mad = deviations[deviations.size() / 2];
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< "{\"name\":\"" << json_escape(name)
+		<< "\",\"unit\":\"" << unit
+		<< "\",\"items\":" << items
+		<< ",\"samples\":" << samples.size()
+		<< ",\"iterations\":" << iterations
+		<< ",\"median_ns\":" << median
+		<< ",\"min_ns\":" << samples.front()
+		<< ",\"max_ns\":" << samples.back()
+		<< ",\"mad_ns\":" << mad << "}" << std::endl;
+}
+
+void BenchmarkRunner::report(const std::string &name, double value,
+		const char *unit)
+{
+	if (!wanted(name))
+		return;
+	m_matched++;
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< "{\"name\":\"" << json_escape(name)
+		<< "\",\"unit\":\"" << unit
+		<< "\",\"value\":" << value << "}" << std::endl;
+}
+
+void BenchmarkRunner::fail(const std::string &name, const std::string &message)
+{
+	m_failed = true;
+	errorstream << "Benchmark " << name << " failed: " << message << std::endl;
+	std::cout << "{\"name\":\"" << json_escape(name)
+		<< "\",\"error\":\"" << json_escape(message) << "\"}" << std::endl;
+}
+
+BenchmarkClient *BenchmarkRunner::getClient()
+{
+	if (!m_client)
+		m_client = std::make_unique<BenchmarkClient>();
+	return m_client.get();
+}
+
+static void print_usage(const char *argv0)
+{
+	std::cerr << "Usage: " << argv0 << " [options]" << std::endl
+		<< "  --filter <text>     only run cases whose name contains <text>" << std::endl
+		<< "  --samples <n>       samples per case (default 20)" << std::endl
+		<< "  --capture <file>    also decode the map blocks of a packet capture" << std::endl
+		<< "  --list              list the benchmarks and exit" << std::endl
+		<< "Results are written to stdout as one JSON object per line." << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+	BenchmarkOptions options;
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		const bool has_value = i + 1 < argc;
+		if (arg == "--filter" && has_value) {
+			options.filter = argv[++i];
+		} else if (arg == "--samples" && has_value) {
+			options.samples = rangelim(stoi(argv[++i]), 1, 1000);
+		} else if (arg == "--capture" && has_value) {
+			options.capture_file = argv[++i];
+		} else if (arg == "--list") {
+			BenchmarkRunner::list();
+			return 0;
+		} else {
+			print_usage(argv[0]);
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	debug_set_exception_handler();
+	g_logger.registerThread("Main");
+	// Keep stdout for the results
+	g_logger.addOutputMaxLevel(&stderr_output, LL_WARNING);
+
+	porting::signal_handler_init();
+	porting::initializePaths();
+	sockets_init();
+
+	set_default_settings();
+	Settings::createLayer(SL_GLOBAL);
+
+	int retval;
+	{
+		BenchmarkRunner runner(options);
+		retval = runner.run() ? 0 : 1;
+	}
+
+	sockets_cleanup();
+	for (int i = 0; i < (int)SL_TOTAL_COUNT; i++)
+		delete Settings::getLayer((SettingsLayer)i);
+
+	return retval;
+}
@@ -0,0 +1,118 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+#include <functional>
+#include <memory>
+#include <string>
+
+class BenchmarkClient;
+class BenchmarkRunner;
+
+typedef void (*BenchmarkFunc)(BenchmarkRunner &runner);
+
+/*
+	Microbenchmarks of the benchmark_client target.
+
+	A benchmark is a function that prepares its data and then calls
+	BenchmarkRunner::measure() once per case. Each case is written to stdout
+	as one line of JSON, for example
+
+	{"name":"mapblock.deserialize.terrain","unit":"block","items":64,
+	 "samples":20,"iterations":16,"median_ns":12345.6,"min_ns":12001.2,
+	 "max_ns":13010.9,"mad_ns":101.7}
+
+	where the times are per item. The median and its median absolute
+	deviation are the values meant for tracking; all inputs are generated
+	from fixed seeds so runs are comparable.
+
+	Results that are not times, such as a number of frames, are written as
+	{"name":"framescheduler.join_gpu_bound","unit":"frame","value":6}
+*/
+#define BENCHMARK(name) \
+	static void benchmark_##name(BenchmarkRunner &runner); \
+	static BenchmarkRegistrar benchmark_registrar_##name(#name, benchmark_##name); \
+	static void benchmark_##name(BenchmarkRunner &runner)
+
+struct BenchmarkRegistrar
+{
+	BenchmarkRegistrar(const char *name, BenchmarkFunc func);
+};
+
+struct BenchmarkOptions
+{
+	// Only cases whose name contains this are run
+	std::string filter;
+	u32 samples = 20;
+	// Packet capture (see client/packetcapture.h) to take map blocks from
+	std::string capture_file;
+};
+
+class BenchmarkRunner
+{
+public:
+	BenchmarkRunner(const BenchmarkOptions &options);
+	~BenchmarkRunner();
+	DISABLE_CLASS_COPY(BenchmarkRunner)
+
+	// Runs all registered benchmarks and the cases that match the filter.
+	// Returns false if a check failed or no case matched.
+	bool run();
+
+	// Prints the names of all registered benchmarks
+	static void list();
+
+	// Times fn, which processes `items` items (of the given unit) per call,
+	// and reports the time per item as `name`.
+	void measure(const std::string &name, u32 items, const char *unit,
+			const std::function<void()> &fn);
+
+	// Reports a result that is not a time
+	void report(const std::string &name, double value, const char *unit);
+
+	// Whether measure() would run the given case. Lets benchmarks skip
+	// expensive preparation.
+	bool wanted(const std::string &name) const;
+
+	// Reports a failed correctness check
+	void fail(const std::string &name, const std::string &message);
+
+	const BenchmarkOptions &getOptions() const { return m_options; }
+
+	// Headless client shared by all benchmarks, created on first use
+	BenchmarkClient *getClient();
+
+private:
+	BenchmarkOptions m_options;
+	std::unique_ptr<BenchmarkClient> m_client;
+	bool m_failed = false;
+	// Cases that were measured or reported
+	u32 m_matched = 0;
+};
+
+// Keeps the compiler from optimizing away results that are otherwise unused
+extern volatile u64 g_benchmark_sink;
+
+inline void benchmark_consume(u64 value)
+{
+	g_benchmark_sink = g_benchmark_sink + value;
+}
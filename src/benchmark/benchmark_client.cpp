@@ -0,0 +1,335 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark_client.h"
+#include "client/camera.h"
+#include "client/client.h"
+#include "client/clientmap.h"
+#include "client/event_manager.h"
+#include "client/mapblock_mesh.h"
+#include "client/renderingengine.h"
+#include "client/shader.h"
+#include "client/sound.h"
+#include "client/tile.h"
+#include "gameparams.h"
+#include "itemdef.h"
+#include "mapblock.h"
+#include "mapsector.h"
+#include "nodedef.h"
+#include "noise.h"
+#include "settings.h"
+#include "network/networkprotocol.h"
+#include <sstream>
+#include <vector>
+
+const char *const benchmark_nodemix_names[NODEMIX_COUNT] = {
+	"terrain",
+	"cave",
+	"foliage",
+	"water",
+	"nodebox",
+};
+
+#define BENCHMARK_SEED 1337
+
+// Deterministic value in [-1, 1] for a node position
+static float node_hash(v3s16 p, s32 seed)
+{
+	return noise2d(p.X + p.Z * 1619, p.Y, seed);
+}
+
+static void insert_test_image(IWritableTextureSource *tsrc, const std::string &name,
+		u32 seed, bool with_alpha)
+{
+	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
+	video::IImage *img = driver->createImage(video::ECF_A8R8G8B8,
+			core::dimension2d<u32>(16, 16));
+	PcgRandom pr(seed);
+	for (u32 y = 0; y < 16; y++)
+	for (u32 x = 0; x < 16; x++) {
+		u32 alpha = with_alpha && pr.range(0, 3) == 0 ? 0 : 255;
+		img->setPixel(x, y, video::SColor(alpha, pr.range(0, 255),
+				pr.range(0, 255), pr.range(0, 255)));
+	}
+	tsrc->insertSourceImage(name, img);
+	img->drop();
+}
+
+BenchmarkClient::BenchmarkClient()
+{
+	// Everything that needs a GPU or a window is turned off
+	g_settings->set("video_driver", "null");
+	g_settings->setBool("enable_shaders", false);
+	g_settings->setBool("enable_minimap", false);
+	g_settings->setBool("enable_sound", false);
+
+	m_rendering_engine = std::make_unique<RenderingEngine>(nullptr);
+	m_tsrc = createTextureSource();
+	m_shsrc = createShaderSource();
+	m_itemdef = createItemDefManager();
+	m_nodedef = createNodeDefManager();
+	m_eventmgr = new EventManager();
+	m_sound = std::make_unique<DummySoundManager>();
+	m_draw_control = std::make_unique<MapDrawControl>();
+
+	m_client = new Client("benchmark", "", "", *m_draw_control, m_tsrc, m_shsrc,
+			m_itemdef, m_nodedef, m_sound.get(), m_eventmgr,
+			m_rendering_engine.get(), false, nullptr, ELoginRegister::Any);
+
+	m_camera = new Camera(*m_draw_control, m_client, m_rendering_engine.get());
+	m_client->setCamera(m_camera);
+
+	registerNodes();
+}
+
+BenchmarkClient::~BenchmarkClient()
+{
+	// Same order as in Game
+	delete m_client;
+	delete m_camera;
+	delete m_eventmgr;
+	delete m_tsrc;
+	delete m_shsrc;
+	delete m_nodedef;
+	delete m_itemdef;
+}
+
+ClientMap &BenchmarkClient::getMap()
+{
+	return m_client->getEnv().getClientMap();
+}
+
+gui::IGUIEnvironment *BenchmarkClient::getGUIEnvironment()
+{
+	return m_rendering_engine->get_gui_env();
+}
+
+void BenchmarkClient::registerNodes()
+{
+	insert_test_image(m_tsrc, "benchmark_stone.png", 1, false);
+	insert_test_image(m_tsrc, "benchmark_grass.png", 2, false);
+	insert_test_image(m_tsrc, "benchmark_dirt.png", 3, false);
+	insert_test_image(m_tsrc, "benchmark_grass_side.png", 4, true);
+	insert_test_image(m_tsrc, "benchmark_glass.png", 5, true);
+	insert_test_image(m_tsrc, "benchmark_leaves.png", 6, true);
+	insert_test_image(m_tsrc, "benchmark_water.png", 7, false);
+	insert_test_image(m_tsrc, "benchmark_plant.png", 8, true);
+
+	// The definitions take the same way as ones sent by a server
+	std::unique_ptr<NodeDefManager> defs(createNodeDefManager());
+	auto make = [] (const std::string &name, NodeDrawType drawtype,
+			const std::string &texture, bool light) {
+		ContentFeatures f;
+		f.name = "benchmark:" + name;
+		f.drawtype = drawtype;
+		for (TileDef &tiledef : f.tiledef)
+			tiledef.name = texture;
+		if (light) {
+			f.param_type = CPT_LIGHT;
+			f.light_propagates = true;
+			f.sunlight_propagates = true;
+		}
+		f.setDefaultAlphaMode();
+		return f;
+	};
+
+	ContentFeatures f = make("stone", NDT_NORMAL, "benchmark_stone.png", false);
+	defs->set(f.name, f);
+
+	f = make("grass", NDT_NORMAL, "benchmark_dirt.png^benchmark_grass_side.png", false);
+	f.tiledef[0].name = "benchmark_grass.png";
+	f.tiledef[1].name = "benchmark_dirt.png";
+	defs->set(f.name, f);
+
+	f = make("glass", NDT_GLASSLIKE, "benchmark_glass.png", true);
+	defs->set(f.name, f);
+
+	f = make("leaves", NDT_ALLFACES_OPTIONAL, "benchmark_leaves.png", true);
+	defs->set(f.name, f);
+
+	f = make("plant", NDT_PLANTLIKE, "benchmark_plant.png", true);
+	f.walkable = false;
+	defs->set(f.name, f);
+
+	f = make("slab", NDT_NODEBOX, "benchmark_stone.png", true);
+	f.node_box.type = NODEBOX_FIXED;
+	f.node_box.fixed.emplace_back(-BS / 2, -BS / 2, -BS / 2, BS / 2, 0, BS / 2);
+	defs->set(f.name, f);
+
+	for (int i = 0; i < 2; i++) {
+		const bool source = i == 0;
+		f = make(source ? "water_source" : "water_flowing",
+				source ? NDT_LIQUID : NDT_FLOWINGLIQUID, "benchmark_water.png", true);
+		f.walkable = false;
+		f.liquid_type = source ? LIQUID_SOURCE : LIQUID_FLOWING;
+		f.liquid_alternative_source = "benchmark:water_source";
+		f.liquid_alternative_flowing = "benchmark:water_flowing";
+		f.alpha = ALPHAMODE_BLEND;
+		if (!source)
+			f.param_type_2 = CPT2_FLOWINGLIQUID;
+		f.tiledef_special[0].name = "benchmark_water.png";
+		f.tiledef_special[0].backface_culling = false;
+		f.tiledef_special[1].name = "benchmark_water.png";
+		defs->set(f.name, f);
+	}
+
+	std::ostringstream os(std::ios::binary);
+	defs->serialize(os, LATEST_PROTOCOL_VERSION);
+	std::istringstream is(os.str(), std::ios::binary);
+	m_nodedef->deSerialize(is, LATEST_PROTOCOL_VERSION);
+
+	// See Client::afterContentReceived()
+	m_nodedef->updateAliases(m_itemdef);
+	m_nodedef->setNodeRegistrationStatus(true);
+	m_nodedef->runNodeResolveCallbacks();
+	m_nodedef->updateTextures(m_client, nullptr);
+
+	m_c_stone = m_nodedef->getId("benchmark:stone");
+	m_c_grass = m_nodedef->getId("benchmark:grass");
+	m_c_glass = m_nodedef->getId("benchmark:glass");
+	m_c_leaves = m_nodedef->getId("benchmark:leaves");
+	m_c_plant = m_nodedef->getId("benchmark:plant");
+	m_c_slab = m_nodedef->getId("benchmark:slab");
+	m_c_water_source = m_nodedef->getId("benchmark:water_source");
+	m_c_water_flowing = m_nodedef->getId("benchmark:water_flowing");
+}
+
+s16 BenchmarkClient::getGroundLevel(s16 x, s16 z) const
+{
+	return 8 + noise2d_perlin(x / 64.0f, z / 64.0f, BENCHMARK_SEED, 3, 0.5f) * 12;
+}
+
+void BenchmarkClient::generateBlock(BenchmarkNodeMix mix, v3s16 blockpos,
+		MapNode *nodes) const
+{
+	const v3s16 origin = blockpos * MAP_BLOCKSIZE;
+	const MapNode air(CONTENT_AIR, LIGHT_SUN, 0);
+	const s16 water_level = 10;
+
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+		const s16 ground = getGroundLevel(origin.X + x, origin.Z + z);
+
+		for (s16 y = 0; y < MAP_BLOCKSIZE; y++) {
+			const v3s16 p = origin + v3s16(x, y, z);
+			const float hash = node_hash(p, BENCHMARK_SEED);
+			MapNode &n = nodes[z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+				y * MAP_BLOCKSIZE + x];
+
+			switch (mix) {
+			case NODEMIX_TERRAIN:
+				if (p.Y < ground)
+					n = MapNode(m_c_stone);
+				else if (p.Y == ground)
+					n = MapNode(m_c_grass);
+				else if (p.Y == ground + 1 && hash > 0.6f)
+					n = MapNode(m_c_plant, LIGHT_SUN, 0);
+				else
+					n = air;
+				break;
+			case NODEMIX_CAVE:
+				n = hash > 0.3f ? MapNode(CONTENT_AIR) : MapNode(m_c_stone);
+				break;
+			case NODEMIX_FOLIAGE:
+				if (hash < 0.0f)
+					n = MapNode(m_c_leaves, LIGHT_SUN, 0);
+				else if (hash < 0.8f)
+					n = air;
+				else
+					n = MapNode(m_c_glass, LIGHT_SUN, 0);
+				break;
+			case NODEMIX_WATER:
+				if (p.Y <= MYMIN(ground, water_level - 4))
+					n = MapNode(m_c_stone);
+				else if (p.Y < water_level)
+					n = MapNode(m_c_water_source, LIGHT_SUN, 0);
+				else if (p.Y == water_level && hash > 0.0f)
+					n = MapNode(m_c_water_flowing, LIGHT_SUN,
+						(u8)((hash * 8.0f)) & LIQUID_LEVEL_MASK);
+				else
+					n = air;
+				break;
+			case NODEMIX_NODEBOX:
+				if (p.Y < 0)
+					n = MapNode(m_c_stone);
+				else if (hash > 0.4f)
+					n = MapNode(m_c_slab, LIGHT_SUN, 0);
+				else
+					n = air;
+				break;
+			default:
+				n = air;
+			}
+		}
+	}
+}
+
+void BenchmarkClient::placeArea(BenchmarkNodeMix mix, v3s16 blockpos_min,
+		v3s16 blockpos_max, bool with_meshes)
+{
+	ClientMap &map = getMap();
+	v3s16 p;
+	for (p.Z = blockpos_min.Z; p.Z <= blockpos_max.Z; p.Z++)
+	for (p.X = blockpos_min.X; p.X <= blockpos_max.X; p.X++) {
+		MapSector *sector = map.emergeSector(v2s16(p.X, p.Z));
+		for (p.Y = blockpos_min.Y; p.Y <= blockpos_max.Y; p.Y++) {
+			MapBlock *block = sector->getBlockNoCreateNoEx(p.Y);
+			if (!block)
+				block = sector->createBlankBlock(p.Y);
+			generateBlock(mix, p, block->getData());
+			if (g_settings->getBool("client_mapblock_compact"))
+				block->compact();
+			block->raiseModified(MOD_STATE_WRITE_NEEDED);
+			delete block->mesh;
+			block->mesh = nullptr;
+		}
+	}
+
+	if (!with_meshes)
+		return;
+
+	// Meshes depend on the neighbors, so they are built in a second pass
+	for (p.Z = blockpos_min.Z; p.Z <= blockpos_max.Z; p.Z++)
+	for (p.X = blockpos_min.X; p.X <= blockpos_max.X; p.X++)
+	for (p.Y = blockpos_min.Y; p.Y <= blockpos_max.Y; p.Y++) {
+		MeshMakeData data(m_client, false);
+		fillMeshMakeData(&data, p);
+		map.getBlockNoCreateNoEx(p)->mesh = new MapBlockMesh(&data, v3s16(0, 0, 0));
+	}
+}
+
+void BenchmarkClient::fillMeshMakeData(MeshMakeData *data, v3s16 blockpos)
+{
+	static std::vector<MapNode> ignore_nodes(
+			MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE, MapNode(CONTENT_IGNORE));
+	ClientMap &map = getMap();
+
+	data->fillBlockDataBegin(blockpos);
+	v3s16 p;
+	for (p.X = blockpos.X - 1; p.X <= blockpos.X + data->m_mesh_grid.cell_size; p.X++)
+	for (p.Z = blockpos.Z - 1; p.Z <= blockpos.Z + data->m_mesh_grid.cell_size; p.Z++)
+	for (p.Y = blockpos.Y - 1; p.Y <= blockpos.Y + data->m_mesh_grid.cell_size; p.Y++) {
+		MapBlock *block = map.getBlockNoCreateNoEx(p);
+		if (block)
+			block->copyTo(data->m_vmanip);
+		else
+			data->fillBlockData(p, ignore_nodes.data());
+	}
+	data->setSmoothLighting(g_settings->getBool("smooth_lighting"));
+}
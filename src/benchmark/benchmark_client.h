@@ -0,0 +1,109 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes_bloated.h"
+#include "mapnode.h"
+#include "util/basic_macros.h"
+#include <memory>
+
+class Camera;
+class Client;
+class ClientMap;
+class ISoundManager;
+class IWritableItemDefManager;
+class IWritableShaderSource;
+class IWritableTextureSource;
+class MapBlock;
+class MtEventManager;
+class NodeDefManager;
+class RenderingEngine;
+struct MapDrawControl;
+struct MeshMakeData;
+
+namespace irr::gui {
+	class IGUIEnvironment;
+}
+
+// Representative mixes of nodes to fill map blocks with
+enum BenchmarkNodeMix
+{
+	NODEMIX_TERRAIN, // Solid ground with a grass surface and plants
+	NODEMIX_CAVE,    // Stone with many small holes, lots of hidden faces
+	NODEMIX_FOLIAGE, // Scattered leaves and glass, transparent faces
+	NODEMIX_WATER,   // Ground under a lake of source and flowing water
+	NODEMIX_NODEBOX, // Scattered slabs on a stone floor
+	NODEMIX_COUNT,
+};
+
+extern const char *const benchmark_nodemix_names[NODEMIX_COUNT];
+
+/*
+	A Client that is set up far enough to build meshes and run map and
+	collision code, without a window, GPU or server: the null video driver
+	is used and the definitions of a fixed set of nodes are loaded as if
+	they had been received from a server.
+*/
+class BenchmarkClient
+{
+public:
+	BenchmarkClient();
+	~BenchmarkClient();
+	DISABLE_CLASS_COPY(BenchmarkClient)
+
+	Client *getClient() { return m_client; }
+	ClientMap &getMap();
+	Camera *getCamera() { return m_camera; }
+	MapDrawControl &getDrawControl() { return *m_draw_control; }
+	gui::IGUIEnvironment *getGUIEnvironment();
+
+	// Fills the nodes of the block at blockpos. The result only depends
+	// on the position, so neighboring blocks fit together.
+	void generateBlock(BenchmarkNodeMix mix, v3s16 blockpos, MapNode *nodes) const;
+
+	// Generates all blocks in the area into the client map, replacing
+	// existing ones, and optionally builds their meshes
+	void placeArea(BenchmarkNodeMix mix, v3s16 blockpos_min, v3s16 blockpos_max,
+			bool with_meshes = false);
+
+	// Copies the block and its neighbors from the client map, like the
+	// mesh update queue does
+	void fillMeshMakeData(MeshMakeData *data, v3s16 blockpos);
+
+	// Height of the ground surface in the terrain and water mixes
+	s16 getGroundLevel(s16 x, s16 z) const;
+
+private:
+	void registerNodes();
+
+	std::unique_ptr<RenderingEngine> m_rendering_engine;
+	IWritableTextureSource *m_tsrc = nullptr;
+	IWritableShaderSource *m_shsrc = nullptr;
+	IWritableItemDefManager *m_itemdef = nullptr;
+	NodeDefManager *m_nodedef = nullptr;
+	MtEventManager *m_eventmgr = nullptr;
+	std::unique_ptr<ISoundManager> m_sound;
+	std::unique_ptr<MapDrawControl> m_draw_control;
+	Client *m_client = nullptr;
+	Camera *m_camera = nullptr;
+
+	content_t m_c_stone, m_c_grass, m_c_glass, m_c_leaves, m_c_water_source,
+		m_c_water_flowing, m_c_plant, m_c_slab;
+};
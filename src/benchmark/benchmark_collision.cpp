@@ -0,0 +1,86 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "benchmark_client.h"
+#include "client/client.h"
+#include "collision.h"
+#include "noise.h"
+#include <vector>
+
+struct CollisionCase
+{
+	const char *name;
+	BenchmarkNodeMix mix;
+	// Speed of the moving box, in nodes per second
+	v3f speed;
+	f32 dtime;
+};
+
+static const CollisionCase collision_cases[] = {
+	// A player walking over uneven ground
+	{"walk.terrain", NODEMIX_TERRAIN, v3f(4.0f, 0.0f, 2.0f), 0.016f},
+	// A player flying fast at a server step length
+	{"fly.terrain", NODEMIX_TERRAIN, v3f(20.0f, -5.0f, 12.0f), 0.09f},
+	// Falling objects among many small boxes
+	{"fall.nodebox", NODEMIX_NODEBOX, v3f(1.0f, -10.0f, 0.5f), 0.05f},
+	// Tight spaces, where boxes are collected on every axis
+	{"walk.cave", NODEMIX_CAVE, v3f(4.0f, 0.0f, 3.0f), 0.05f},
+};
+
+BENCHMARK(collision)
+{
+	// Player-sized box
+	const aabb3f box(-0.3f * BS, 0.0f, -0.3f * BS, 0.3f * BS, 1.77f * BS, 0.3f * BS);
+	const v3f gravity(0, -9.81f * BS, 0);
+	// Moves per measured call, from different places
+	const u32 moves = 32;
+
+	for (const CollisionCase &c : collision_cases) {
+		const std::string name = std::string("collision.") + c.name;
+		if (!runner.wanted(name))
+			continue;
+
+		BenchmarkClient *bclient = runner.getClient();
+		Client *client = bclient->getClient();
+		bclient->placeArea(c.mix, v3s16(-2, -2, -2), v3s16(2, 2, 2));
+
+		std::vector<v3f> start_positions;
+		PcgRandom pr(1);
+		for (u32 i = 0; i < moves; i++) {
+			s16 x = pr.range(-24, 24);
+			s16 z = pr.range(-24, 24);
+			s16 y = c.mix == NODEMIX_TERRAIN ? bclient->getGroundLevel(x, z) + 1 :
+					pr.range(0, 8);
+			start_positions.push_back(v3f(x, y, z) * BS);
+		}
+
+		runner.measure(name, moves, "move", [&] () {
+			for (const v3f &start : start_positions) {
+				v3f position = start;
+				v3f speed = c.speed * BS;
+				const f32 pos_max_d = MYMAX(BS * 0.25f, speed.getLength() * c.dtime);
+				collisionMoveResult result = collisionMoveSimple(&client->getEnv(),
+						client, pos_max_d, box, 0.6f * BS, c.dtime,
+						&position, &speed, gravity, nullptr, false);
+				benchmark_consume(result.collisions.size());
+			}
+		});
+	}
+}
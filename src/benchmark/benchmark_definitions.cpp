@@ -0,0 +1,150 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "client/defsnapshot.h"
+#include "itemdef.h"
+#include "nodedef.h"
+#include "serialization.h"
+#include "network/networkprotocol.h"
+#include <memory>
+#include <sstream>
+#include <string>
+
+// About the size of a large game
+#define DEFINITION_COUNT 4000
+
+static std::string node_name(u32 i)
+{
+	return "mod" + std::to_string(i % 50) + ":node_" + std::to_string(i);
+}
+
+static void fill_definitions(NodeDefManager *ndef, IWritableItemDefManager *idef)
+{
+	for (u32 i = 0; i < DEFINITION_COUNT; i++) {
+		ContentFeatures f;
+		f.name = node_name(i);
+		f.drawtype = (NodeDrawType)(i % 5);
+		for (u32 t = 0; t < 6; t++)
+			f.tiledef[t].name = "node_" + std::to_string(i) + "_side" +
+					std::to_string(t) + ".png";
+		f.groups["cracky"] = 1 + i % 3;
+		f.groups["stone"] = 1;
+		f.sound_footstep.name = "default_hard_footstep";
+		f.sound_dig.name = "default_dig_cracky";
+		f.sound_dug.name = "default_dug_node";
+		ndef->set(f.name, f);
+
+		ItemDefinition def;
+		def.type = ITEM_NODE;
+		def.name = f.name;
+		def.description = "Node number " + std::to_string(i);
+		def.inventory_image = f.tiledef[0].name;
+		def.groups = f.groups;
+		def.node_placement_prediction = f.name;
+		idef->registerItem(def);
+	}
+}
+
+// As Server::sendNodeDef and Server::sendItemDef
+template <typename T>
+static std::string compress_definitions(T *def, size_t *data_size)
+{
+	std::ostringstream tmp_os(std::ios::binary);
+	def->serialize(tmp_os, LATEST_PROTOCOL_VERSION);
+	*data_size = tmp_os.str().size();
+	std::ostringstream tmp_os2(std::ios::binary);
+	compressZlib(tmp_os.str(), tmp_os2);
+	return tmp_os2.str();
+}
+
+static void inflate(const std::string &compressed, std::stringstream &os)
+{
+	os.str("");
+	std::istringstream is(compressed, std::ios::binary);
+	decompressZlib(is, os);
+}
+
+/*
+	The steps of Client::handleCommand_NodeDef and handleCommand_ItemDef:
+	inflating the payload, parsing it, and restoring the definitions from
+	DefinitionSnapshot when the server resends the same data.
+*/
+BENCHMARK(definitions)
+{
+	std::unique_ptr<NodeDefManager> server_ndef(createNodeDefManager());
+	std::unique_ptr<IWritableItemDefManager> server_idef(createItemDefManager());
+	fill_definitions(server_ndef.get(), server_idef.get());
+
+	size_t nodedef_size, itemdef_size;
+	const std::string nodedef_data =
+			compress_definitions(server_ndef.get(), &nodedef_size);
+	const std::string itemdef_data =
+			compress_definitions(server_idef.get(), &itemdef_size);
+	const std::string last_name = node_name(DEFINITION_COUNT - 1);
+
+	std::unique_ptr<NodeDefManager> ndef(createNodeDefManager());
+	std::unique_ptr<IWritableItemDefManager> idef(createItemDefManager());
+	std::stringstream tmp_os(std::ios::binary | std::ios::in | std::ios::out);
+
+	runner.measure("definitions.nodedef.inflate", DEFINITION_COUNT, "node", [&] () {
+		inflate(nodedef_data, tmp_os);
+	});
+	inflate(nodedef_data, tmp_os);
+	runner.measure("definitions.nodedef.deserialize", DEFINITION_COUNT, "node", [&] () {
+		tmp_os.clear();
+		tmp_os.seekg(0);
+		ndef->deSerialize(tmp_os, LATEST_PROTOCOL_VERSION);
+	});
+
+	runner.measure("definitions.itemdef.inflate", DEFINITION_COUNT, "item", [&] () {
+		inflate(itemdef_data, tmp_os);
+	});
+	inflate(itemdef_data, tmp_os);
+	runner.measure("definitions.itemdef.deserialize", DEFINITION_COUNT, "item", [&] () {
+		tmp_os.clear();
+		tmp_os.seekg(0);
+		idef->deSerialize(tmp_os, LATEST_PROTOCOL_VERSION);
+	});
+
+	DefinitionSnapshot::storeNodeDefs(nodedef_data, LATEST_PROTOCOL_VERSION,
+			server_ndef.get(), nodedef_size);
+	DefinitionSnapshot::storeItemDefs(itemdef_data, LATEST_PROTOCOL_VERSION,
+			server_idef.get(), itemdef_size);
+
+	runner.measure("definitions.nodedef.restore", DEFINITION_COUNT, "node", [&] () {
+		if (!DefinitionSnapshot::restoreNodeDefs(nodedef_data,
+				LATEST_PROTOCOL_VERSION, ndef.get()))
+			runner.fail("definitions.nodedef.restore", "Snapshot not used");
+	});
+	content_t id;
+	if (runner.wanted("definitions.nodedef.restore") &&
+			!ndef->getId(last_name, id))
+		runner.fail("definitions.nodedef.restore", "Missing node " + last_name);
+
+	runner.measure("definitions.itemdef.restore", DEFINITION_COUNT, "item", [&] () {
+		if (!DefinitionSnapshot::restoreItemDefs(itemdef_data,
+				LATEST_PROTOCOL_VERSION, idef.get()))
+			runner.fail("definitions.itemdef.restore", "Snapshot not used");
+	});
+	if (runner.wanted("definitions.itemdef.restore") && !idef->isKnown(last_name))
+		runner.fail("definitions.itemdef.restore", "Missing item " + last_name);
+
+	DefinitionSnapshot::clear();
+}
@@ -0,0 +1,213 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "benchmark_client.h"
+#include "client/client.h"
+#include "client/renderingengine.h"
+#include "gui/guiAnimatedImage.h"
+#include "gui/guiFormSpecMenu.h"
+#include "gui/guiItemImage.h"
+#include "util/string.h"
+#include <set>
+#include <sstream>
+
+// An inventory form with a crafting grid and a page of item buttons
+static std::string make_formspec(u32 page = 1, const char *color = "#ff000080",
+		const char *next = "Next")
+{
+	std::string fs = "formspec_version[6]size[10.75,11]"
+		"bgcolor[#08080880;true]"
+		"list[current_player;main;0.5,6;8,4;]"
+		"list[current_player;craft;1.75,0.5;3,3;]"
+		"list[current_player;craftpreview;6.25,1.75;1,1;]"
+		"listring[current_player;main]listring[current_player;craft]";
+	for (int i = 0; i < 48; i++) {
+		const std::string pos = ftos(0.5f + (i % 8) * 1.25f) + "," +
+				ftos(0.5f + (i / 8) * 0.9f);
+		fs += "item_image_button[" + pos + ";1,1;benchmark:node_" + itos(i) +
+				";give_" + itos(i) + ";]";
+		fs += "tooltip[give_" + itos(i) + ";Item " + itos(i) +
+				"\\; with \\[escaped\\] text]";
+	}
+	fs += "label[0.5,5.5;Page " + itos(page) + " of 4]"
+		"image[9.5,0.5;1,1;benchmark_a.png^[colorize:" + color + "]"
+		"button[8.5,5;2,0.8;next;" + next + " \\]]";
+	return fs;
+}
+
+// A shop with a featured offer, its stock and a row of other offers
+static std::string make_shop_formspec(u32 offer, u32 stock)
+{
+	std::string fs = "formspec_version[6]size[10.75,9.5]"
+		"bgcolor[#08080880;true]"
+		"label[0.5,0.5;Shop]"
+		"item_image[0.5,1;2,2;benchmark:node_" + itos(offer) + "]"
+		"label[3,1.5;Price: " + itos(5 + offer) + " gold]"
+		"label[3,2.2;In stock: " + itos(stock) + "]"
+		"list[current_player;main;0.5,4.5;8,4;]"
+		"list[current_name;pay;8.5,1;1,1;]"
+		"button[8.5,2.5;1.75,0.8;buy;Buy]"
+		"listring[current_player;main]listring[current_name;pay]";
+	for (u32 i = 0; i < 8; i++) {
+		fs += "item_image_button[" + ftos(0.5f + i * 1.25f) +
+				",3.25;1,1;benchmark:node_" + itos(i) + ";offer_" + itos(i) + ";]";
+	}
+	return fs;
+}
+
+class BenchmarkMenuManager : public IMenuManager
+{
+public:
+	void createdMenu(gui::IGUIElement *menu) override {}
+	void deletingMenu(gui::IGUIElement *menu) override {}
+};
+
+class BenchmarkTextDest : public TextDest
+{
+public:
+	BenchmarkTextDest() { m_formname = "benchmark"; }
+	void gotText(const StringMap &fields) override {}
+};
+
+// A formspec menu of the window size, as Game shows it
+static GUIFormSpecMenu *create_menu(BenchmarkClient *bclient,
+		IMenuManager *menumgr, const std::string &formspec)
+{
+	Client *client = bclient->getClient();
+	gui::IGUIEnvironment *env = bclient->getGUIEnvironment();
+	GUIFormSpecMenu *menu = new GUIFormSpecMenu(nullptr, env->getRootGUIElement(),
+			-1, menumgr, client, env, client->getTextureSource(),
+			client->getSoundManager(), nullptr, new BenchmarkTextDest(), "");
+	menu->setFormSpec(formspec, InventoryLocation());
+	menu->regenerateGui(RenderingEngine::getWindowSize());
+	return menu;
+}
+
+static void delete_menu(GUIFormSpecMenu *menu)
+{
+	menu->remove();
+	menu->drop();
+}
+
+// Describes the element tree with everything a patch can change
+static void describe_elements(gui::IGUIElement *e, std::ostream &os, int depth = 0)
+{
+	const core::rect<s32> &rect = e->getAbsolutePosition();
+	os << std::string(depth, ' ') << e->getTypeName() << " " << e->getID()
+		<< " " << rect.UpperLeftCorner.X << "," << rect.UpperLeftCorner.Y
+		<< " " << rect.LowerRightCorner.X << "," << rect.LowerRightCorner.Y
+		<< " " << e->isVisible() << " \"" << wide_to_utf8(e->getText()) << "\"";
+	if (e->getType() == gui::EGUIET_IMAGE)
+		os << " " << static_cast<gui::IGUIImage *>(e)->getImage();
+	if (auto *image = dynamic_cast<GUIAnimatedImage *>(e))
+		os << " " << image->getTexture();
+	if (auto *item_image = dynamic_cast<GUIItemImage *>(e))
+		os << " " << item_image->getItemName();
+	os << "\n";
+	for (gui::IGUIElement *child : e->getChildren())
+		describe_elements(child, os, depth + 1);
+}
+
+static void collect_elements(gui::IGUIElement *e, std::set<gui::IGUIElement *> &out)
+{
+	out.insert(e);
+	for (gui::IGUIElement *child : e->getChildren())
+		collect_elements(child, out);
+}
+
+/*
+	Resending a form with small changes, as mods do to refresh it. Checks
+	that the patched GUI is the same as one built from scratch, and that
+	the changes were patched rather than rebuilt when they should be.
+*/
+static void benchmark_update(BenchmarkRunner &runner, const std::string &name,
+		const std::string &formspec_a, const std::string &formspec_b,
+		bool patchable)
+{
+	if (!runner.wanted(name))
+		return;
+
+	BenchmarkClient *bclient = runner.getClient();
+	BenchmarkMenuManager menumgr;
+
+	GUIFormSpecMenu *menu = create_menu(bclient, &menumgr, formspec_a);
+	std::set<gui::IGUIElement *> elements_before, elements_after;
+	collect_elements(menu, elements_before);
+	// Keeps new elements from getting the addresses of removed ones
+	for (gui::IGUIElement *e : elements_before)
+		e->grab();
+	menu->setFormSpec(formspec_b, InventoryLocation());
+	collect_elements(menu, elements_after);
+	if ((elements_before == elements_after) != patchable)
+		runner.fail(name, patchable ? "Rebuilt instead of patched" :
+				"Patched a change that needs a rebuild");
+	for (gui::IGUIElement *e : elements_before)
+		e->drop();
+
+	GUIFormSpecMenu *reference = create_menu(bclient, &menumgr, formspec_b);
+	std::ostringstream patched_os, reference_os;
+	describe_elements(menu, patched_os);
+	describe_elements(reference, reference_os);
+	if (patched_os.str() != reference_os.str())
+		runner.fail(name, "Updated GUI differs from a full rebuild:\n" +
+				patched_os.str() + "instead of\n" + reference_os.str());
+	delete_menu(reference);
+
+	bool flip = false;
+	runner.measure(name, 1, "update", [&] () {
+		flip = !flip;
+		menu->setFormSpec(flip ? formspec_a : formspec_b, InventoryLocation());
+	});
+	delete_menu(menu);
+}
+
+BENCHMARK(formspec)
+{
+	const std::string formspec = make_formspec();
+
+	std::vector<std::string> reference = split(formspec, ']');
+	if (split_formspec_elements(formspec) != reference)
+		runner.fail("formspec.split", "split_formspec_elements() mismatch");
+
+	// Corner cases of escaping at the end of the string
+	for (const std::string &fs : {"", "]", "a\\", "a\\]", "a]\\\\", "label[0,0;\\]"}) {
+		if (split_formspec_elements(fs) != split(fs, ']'))
+			runner.fail("formspec.split", "split_formspec_elements() mismatch for \"" +
+					fs + "\"");
+	}
+
+	const u32 elements = reference.size();
+	runner.measure("formspec.split", elements, "element", [&] () {
+		benchmark_consume(split_formspec_elements(formspec).size());
+	});
+	runner.measure("formspec.split.reference", elements, "element", [&] () {
+		benchmark_consume(split(formspec, ']').size());
+	});
+
+	// A new page number and a recolored progress image
+	benchmark_update(runner, "formspec.update.inventory", formspec,
+			make_formspec(2, "#00ff0080"), true);
+	// A button text can't be patched
+	benchmark_update(runner, "formspec.update.inventory.rebuild", formspec,
+			make_formspec(1, "#ff000080", "Forward"), false);
+	// Another featured offer, and one item less in stock
+	benchmark_update(runner, "formspec.update.shop", make_shop_formspec(3, 12),
+			make_shop_formspec(4, 11), true);
+}
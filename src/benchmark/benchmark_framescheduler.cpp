@@ -0,0 +1,99 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "porting.h"
+#include "client/framescheduler.h"
+
+/*
+	Joining a server while drawing takes the whole frame (GPU bound): the
+	packet backlog must not take more frames to process than with the fixed
+	10 ms budget that Client::ReceiveAll() had before FrameScheduler.
+*/
+
+// 60 FPS limit, drawing takes longer than that
+#define JOIN_FRAME_US 16667
+#define JOIN_RENDER_US 25000
+// 50 ms of packet processing
+#define JOIN_PACKETS 2500
+#define JOIN_PACKET_US 20
+#define JOIN_FIXED_BUDGET_US 10000
+
+static void busy_wait_us(u64 us)
+{
+	const u64 end = porting::getTimeUs() + us;
+	while (porting::getTimeUs() < end)
+		;
+}
+
+// Returns the number of frames it took
+static u32 join_scheduled()
+{
+	FrameScheduler scheduler;
+	// The packet task as Client registers it
+	const u32 task = scheduler.addTask("packets", 4, 1000, 10000);
+	// Let the average draw time settle
+	for (u32 i = 0; i < 100; i++)
+		scheduler.beginFrame(JOIN_FRAME_US, JOIN_RENDER_US);
+
+	u32 packets = JOIN_PACKETS;
+	u32 frames = 0;
+	while (packets > 0) {
+		scheduler.beginFrame(JOIN_FRAME_US, JOIN_RENDER_US);
+		FrameScheduler::Slice slice(scheduler, task);
+		while (packets > 0 && !slice.expired()) {
+			busy_wait_us(JOIN_PACKET_US);
+			packets--;
+		}
+		frames++;
+	}
+	return frames;
+}
+
+static u32 join_fixed_budget()
+{
+	u32 packets = JOIN_PACKETS;
+	u32 frames = 0;
+	while (packets > 0) {
+		const u64 start = porting::getTimeUs();
+		while (packets > 0 && porting::getTimeUs() - start < JOIN_FIXED_BUDGET_US) {
+			busy_wait_us(JOIN_PACKET_US);
+			packets--;
+		}
+		frames++;
+	}
+	return frames;
+}
+
+BENCHMARK(framescheduler)
+{
+	if (!runner.wanted("framescheduler.join_gpu_bound") &&
+			!runner.wanted("framescheduler.join_fixed_budget"))
+		return;
+
+	const u32 scheduled = join_scheduled();
+	const u32 fixed = join_fixed_budget();
+	runner.report("framescheduler.join_gpu_bound", scheduled, "frame");
+	runner.report("framescheduler.join_fixed_budget", fixed, "frame");
+	// The first frame only gets the minimum, before the task is starving
+	if (scheduled > fixed + 1)
+		runner.fail("framescheduler.join_gpu_bound", "Took " +
+				std::to_string(scheduled) + " frames instead of " +
+				std::to_string(fixed));
+}
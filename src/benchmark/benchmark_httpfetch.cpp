@@ -0,0 +1,357 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "httpfetch.h"
+#include "porting.h"
+#include "threading/thread.h"
+#include "util/string.h"
+#include <atomic>
+#include <vector>
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+	typedef SOCKET server_socket_t;
+	#define SERVER_INVALID_SOCKET INVALID_SOCKET
+	#define close_socket(fd) closesocket(fd)
+#else
+	typedef int server_socket_t;
+	#define SERVER_INVALID_SOCKET (-1)
+	#define close_socket(fd) ::close(fd)
+#endif
+
+#define HTTPFETCH_PARALLEL_LIMIT 4
+#define HTTPFETCH_FILES 60
+
+/*
+	HTTP/1.1 server on the loopback interface for the built-in fetcher.
+	It answers by path:
+
+	/file/<n>  "file <n>", the connection is kept alive
+	/chunked   a chunked body with extensions and a trailer
+	/close     a response with "Connection: close"
+	/drop      a kept-alive response, then the connection is closed anyway,
+	           as if it had been idle for too long
+	/broken    the connection is closed without a response
+	otherwise  404
+*/
+class LoopbackHTTPServer : public Thread
+{
+public:
+	LoopbackHTTPServer() : Thread("LoopbackHTTP") {}
+	~LoopbackHTTPServer();
+
+	// Returns false if there is no loopback interface
+	bool listen();
+
+	std::string getURL(const std::string &path) const
+	{
+		return "http://127.0.0.1:" + itos(m_port) + path;
+	}
+
+	u32 getConnections() const { return m_connections; }
+	// Requests that arrived before the previous one was answered
+	u32 getPipelined() const { return m_pipelined; }
+
+protected:
+	void *run();
+
+private:
+	struct Connection
+	{
+		server_socket_t fd;
+		std::string buf;
+	};
+
+	// Returns false if the connection is to be closed
+	bool respond(Connection &conn, const std::string &path);
+	// Answers the complete requests in conn.buf
+	bool process(Connection &conn);
+
+	server_socket_t m_listen = SERVER_INVALID_SOCKET;
+	u16 m_port = 0;
+	std::vector<Connection> m_conns;
+	std::atomic<u32> m_connections {0};
+	std::atomic<u32> m_pipelined {0};
+};
+
+LoopbackHTTPServer::~LoopbackHTTPServer()
+{
+	for (const Connection &conn : m_conns)
+		close_socket(conn.fd);
+	if (m_listen != SERVER_INVALID_SOCKET)
+		close_socket(m_listen);
+}
+
+bool LoopbackHTTPServer::listen()
+{
+	m_listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (m_listen == SERVER_INVALID_SOCKET)
+		return false;
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t len = sizeof(addr);
+	if (bind(m_listen, (struct sockaddr *)&addr, len) != 0 ||
+			::listen(m_listen, 16) != 0 ||
+			getsockname(m_listen, (struct sockaddr *)&addr, &len) != 0)
+		return false;
+
+	m_port = ntohs(addr.sin_port);
+	return true;
+}
+
+static bool send_all(server_socket_t fd, const std::string &data)
+{
+	size_t pos = 0;
+	while (pos < data.size()) {
+		int n = send(fd, data.data() + pos, data.size() - pos, 0);
+		if (n <= 0)
+			return false;
+		pos += n;
+	}
+	return true;
+}
+
+bool LoopbackHTTPServer::respond(Connection &conn, const std::string &path)
+{
+	if (str_starts_with(path, "/file/")) {
+		const std::string body = "file " + path.substr(6);
+		return send_all(conn.fd, "HTTP/1.1 200 OK\r\nContent-Length: " +
+				itos(body.size()) + "\r\n\r\n" + body);
+	} else if (path == "/chunked") {
+		send_all(conn.fd, "HTTP/1.1 200 OK\r\n"
+				"Transfer-Encoding: chunked\r\n\r\n"
+				"5;name=value\r\nHello\r\n"
+				"1\r\n,\r\n"
+				"6\r\n world\r\n"
+				"0\r\nX-Trailer: 1\r\n\r\n");
+		return true;
+	} else if (path == "/close") {
+		send_all(conn.fd, "HTTP/1.1 200 OK\r\nConnection: close\r\n"
+				"Content-Length: 6\r\n\r\nclosed");
+		return false;
+	} else if (path == "/drop") {
+		send_all(conn.fd, "HTTP/1.1 200 OK\r\nContent-Length: 7\r\n\r\ndropped");
+		return false;
+	} else if (path == "/broken") {
+		return false;
+	}
+	return send_all(conn.fd, "HTTP/1.1 404 Not Found\r\n"
+			"Content-Length: 9\r\n\r\nnot found");
+}
+
+bool LoopbackHTTPServer::process(Connection &conn)
+{
+	for (;;) {
+		size_t end = conn.buf.find("\r\n\r\n");
+		if (end == std::string::npos)
+			return true;
+
+		const std::string head = conn.buf.substr(0, end);
+		size_t body_size = 0;
+		size_t pos = lowercase(head).find("\r\ncontent-length:");
+		if (pos != std::string::npos)
+			body_size = mystoi(head.substr(pos + 17));
+		if (conn.buf.size() < end + 4 + body_size)
+			return true;
+		conn.buf.erase(0, end + 4 + body_size);
+		if (!conn.buf.empty())
+			m_pipelined++;
+
+		// "GET /path HTTP/1.1"
+		const std::vector<std::string> words = str_split(
+				head.substr(0, head.find("\r\n")), ' ');
+		if (words.size() != 3 || !respond(conn, words[1]))
+			return false;
+	}
+}
+
+void *LoopbackHTTPServer::run()
+{
+	while (!stopRequested()) {
+		fd_set rd;
+		FD_ZERO(&rd);
+		FD_SET(m_listen, &rd);
+		int maxfd = (int)m_listen;
+		for (const Connection &conn : m_conns) {
+			FD_SET(conn.fd, &rd);
+			maxfd = MYMAX(maxfd, (int)conn.fd);
+		}
+
+		struct timeval tv;
+		tv.tv_sec = 0;
+		tv.tv_usec = 10000;
+		if (select(maxfd + 1, &rd, nullptr, nullptr, &tv) <= 0)
+			continue;
+
+		for (auto it = m_conns.begin(); it != m_conns.end();) {
+			bool keep = true;
+			if (FD_ISSET(it->fd, &rd)) {
+				char buf[4096];
+				int n = recv(it->fd, buf, sizeof(buf), 0);
+				if (n > 0) {
+					it->buf.append(buf, n);
+					keep = process(*it);
+				} else {
+					keep = false;
+				}
+			}
+			if (keep) {
+				++it;
+			} else {
+				close_socket(it->fd);
+				it = m_conns.erase(it);
+			}
+		}
+
+		if (FD_ISSET(m_listen, &rd)) {
+			server_socket_t fd = accept(m_listen, nullptr, nullptr);
+			if (fd != SERVER_INVALID_SOCKET) {
+				m_conns.push_back({fd, ""});
+				m_connections++;
+			}
+		}
+	}
+	return nullptr;
+}
+
+// Fetches the URLs at the same time, the results are in the same order
+static std::vector<HTTPFetchResult> fetch_all(const std::vector<std::string> &urls)
+{
+	const u64 caller = httpfetch_caller_alloc();
+	for (size_t i = 0; i < urls.size(); i++) {
+		HTTPFetchRequest request;
+		request.url = urls[i];
+		request.caller = caller;
+		request.request_id = i;
+		httpfetch_async(request);
+	}
+
+	std::vector<HTTPFetchResult> results(urls.size());
+	size_t received = 0;
+	const u64 deadline = porting::getTimeMs() + 20000;
+	while (received < urls.size() && porting::getTimeMs() < deadline) {
+		HTTPFetchResult result;
+		if (httpfetch_async_get(caller, result)) {
+			results[result.request_id] = result;
+			received++;
+		} else {
+			sleep_ms(1);
+		}
+	}
+	httpfetch_caller_free(caller);
+	return results;
+}
+
+static HTTPFetchResult fetch(const std::string &url)
+{
+	return fetch_all({url})[0];
+}
+
+static void check_result(BenchmarkRunner &runner, const std::string &name,
+		const HTTPFetchResult &result, long response_code, const std::string &data)
+{
+	if (!result.succeeded)
+		runner.fail(name, "Request failed");
+	else if (result.response_code != response_code)
+		runner.fail(name, "Response code " + itos(result.response_code));
+	else if (result.data != data)
+		runner.fail(name, "Wrong body \"" + result.data + "\"");
+}
+
+/*
+	The built-in HTTP client (see httpfetch.cpp) against a server on the
+	loopback interface. Remote media are many small files fetched at once.
+*/
+BENCHMARK(httpfetch)
+{
+	// The checks run along with the only measured case
+	if (!runner.wanted("httpfetch.pipelined_get"))
+		return;
+
+	LoopbackHTTPServer server;
+	if (!server.listen()) {
+		runner.fail("httpfetch", "Can't listen on the loopback interface");
+		return;
+	}
+	server.start();
+	httpfetch_init(HTTPFETCH_PARALLEL_LIMIT);
+
+	std::vector<std::string> urls;
+	for (u32 i = 0; i < HTTPFETCH_FILES; i++)
+		urls.push_back(server.getURL("/file/" + itos(i)));
+
+	// More requests than connections are pipelined on the open ones
+	std::vector<HTTPFetchResult> results = fetch_all(urls);
+	for (u32 i = 0; i < HTTPFETCH_FILES; i++)
+		check_result(runner, "httpfetch.pipelined", results[i], 200, "file " + itos(i));
+	if (server.getPipelined() == 0)
+		runner.fail("httpfetch.pipelined", "No request was pipelined");
+	if (server.getConnections() > HTTPFETCH_PARALLEL_LIMIT)
+		runner.fail("httpfetch.pipelined", "Opened " +
+				itos(server.getConnections()) + " connections");
+
+	// Requests after the server closed a connection, with or without
+	// telling, go to a new one
+	check_result(runner, "httpfetch.close", fetch(server.getURL("/close")),
+			200, "closed");
+	check_result(runner, "httpfetch.close", fetch(server.getURL("/file/1")),
+			200, "file 1");
+	check_result(runner, "httpfetch.drop", fetch(server.getURL("/drop")),
+			200, "dropped");
+	check_result(runner, "httpfetch.drop", fetch(server.getURL("/file/2")),
+			200, "file 2");
+
+	check_result(runner, "httpfetch.chunked", fetch(server.getURL("/chunked")),
+			200, "Hello, world");
+
+	check_result(runner, "httpfetch.not_found", fetch(server.getURL("/missing")),
+			404, "not found");
+	if (fetch(server.getURL("/broken")).succeeded)
+		runner.fail("httpfetch.broken", "Succeeded without a response");
+	if (fetch("https://127.0.0.1/").succeeded)
+		runner.fail("httpfetch.https", "Succeeded without TLS support");
+
+	HTTPFetchRequest request;
+	request.url = server.getURL("/file/3");
+	HTTPFetchResult result;
+	httpfetch_sync(request, result);
+	check_result(runner, "httpfetch.sync", result, 200, "file 3");
+
+	runner.measure("httpfetch.pipelined_get", HTTPFETCH_FILES, "request", [&] () {
+		benchmark_consume(fetch_all(urls).size());
+	});
+
+	httpfetch_cleanup();
+	server.stop();
+	server.wait();
+}
@@ -0,0 +1,248 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "benchmark_client.h"
+#include "client/client.h"
+#include "client/clientmap.h"
+#include "client/packetcapture.h"
+#include "mapblock.h"
+#include "mapnode.h"
+#include "noise.h"
+#include "serialization.h"
+#include "settings.h"
+#include "network/networkpacket.h"
+#include "network/networkprotocol.h"
+#include "util/serialize.h"
+#include <sstream>
+#include <vector>
+
+// Like the server's default map_compression_level_net
+#define NETWORK_COMPRESSION_LEVEL -1
+
+struct EncodedBlocks
+{
+	u8 ser_ver = SER_FMT_VER_HIGHEST_WRITE;
+	// Block data as in TOCLIENT_BLOCKDATA, without the position
+	std::vector<std::string> blocks;
+	u64 total_size = 0;
+};
+
+static void decode_blocks(BenchmarkRunner &runner, const std::string &name,
+		const EncodedBlocks &encoded)
+{
+	Client *client = runner.getClient()->getClient();
+	MapBlock block(&client->getEnv().getMap(), v3s16(0, 0, 0), client);
+	std::vector<u8> decode_buffer;
+	// As Client::handleCommand_BlockData
+	const bool compact = g_settings->getBool("client_mapblock_compact");
+
+	runner.measure(name, encoded.blocks.size(), "block", [&] () {
+		for (const std::string &data : encoded.blocks) {
+			size_t consumed = block.deSerialize(
+					reinterpret_cast<const u8 *>(data.data()), data.size(),
+					encoded.ser_ver, decode_buffer);
+			if (compact)
+				block.compact();
+			benchmark_consume(consumed);
+		}
+	});
+}
+
+static EncodedBlocks encode_generated_blocks(BenchmarkRunner &runner,
+		BenchmarkNodeMix mix)
+{
+	BenchmarkClient *bclient = runner.getClient();
+	Client *client = bclient->getClient();
+	EncodedBlocks encoded;
+
+	v3s16 p;
+	for (p.Z = -2; p.Z < 2; p.Z++)
+	for (p.Y = -1; p.Y < 3; p.Y++)
+	for (p.X = -2; p.X < 2; p.X++) {
+		MapBlock block(&client->getEnv().getMap(), p, client);
+		bclient->generateBlock(mix, p, block.getData());
+
+		// Check the compact storage against the generated nodes
+		const std::vector<MapNode> nodes(block.getData(),
+				block.getData() + MapBlock::nodecount);
+		if (block.compact()) {
+			for (u32 i = 0; i < MapBlock::nodecount; i++) {
+				if (!(block.getNodeNoCheck(i % MAP_BLOCKSIZE,
+						i / MAP_BLOCKSIZE % MAP_BLOCKSIZE,
+						i / MapBlock::zstride) == nodes[i])) {
+					runner.fail(std::string("mapblock.deserialize.") +
+							benchmark_nodemix_names[mix], "Compact block mismatch");
+					break;
+				}
+			}
+		}
+
+		std::ostringstream os(std::ios::binary);
+		block.serialize(os, encoded.ser_ver, false, NETWORK_COMPRESSION_LEVEL);
+		encoded.blocks.push_back(os.str());
+		encoded.total_size += encoded.blocks.back().size();
+	}
+	return encoded;
+}
+
+static bool read_captured_blocks(BenchmarkRunner &runner, const std::string &path,
+		EncodedBlocks *encoded)
+{
+	try {
+		PacketCaptureReader reader(path, true);
+		NetworkPacket pkt;
+		while (reader.read(&pkt)) {
+			if (pkt.getCommand() == TOCLIENT_HELLO && pkt.getSize() >= 1) {
+				pkt >> encoded->ser_ver;
+			} else if (pkt.getCommand() == TOCLIENT_BLOCKDATA && pkt.getSize() > 6) {
+				// Skip the block position
+				encoded->blocks.emplace_back(pkt.getString(6), pkt.getSize() - 6);
+				encoded->total_size += encoded->blocks.back().size();
+			}
+		}
+	} catch (const BaseException &e) {
+		runner.fail("mapblock.deserialize.captured",
+				"Cannot read capture \"" + path + "\": " + e.what());
+		return false;
+	}
+
+	if (encoded->blocks.empty()) {
+		runner.fail("mapblock.deserialize.captured",
+				"No map blocks in capture \"" + path + "\"");
+		return false;
+	}
+	return true;
+}
+
+BENCHMARK(mapblock)
+{
+	for (int mix = 0; mix < NODEMIX_COUNT; mix++) {
+		const std::string name = std::string("mapblock.deserialize.") +
+				benchmark_nodemix_names[mix];
+		if (!runner.wanted(name))
+			continue;
+
+		EncodedBlocks encoded = encode_generated_blocks(runner, (BenchmarkNodeMix)mix);
+		decode_blocks(runner, name, encoded);
+	}
+
+	const std::string &capture = runner.getOptions().capture_file;
+	if (!capture.empty() && runner.wanted("mapblock.deserialize.captured")) {
+		EncodedBlocks encoded;
+		if (read_captured_blocks(runner, capture, &encoded))
+			decode_blocks(runner, "mapblock.deserialize.captured", encoded);
+	}
+}
+
+/*
+	MapNode bulk (de)serialization uses SIMD kernels where available. These
+	straightforward versions are what they must match.
+*/
+
+static void reference_serialize_bulk(const MapNode *nodes, u32 nodecount, u8 *dst)
+{
+	for (u32 i = 0; i < nodecount; i++)
+		writeU16(&dst[i * 2], nodes[i].param0);
+	for (u32 i = 0; i < nodecount; i++)
+		writeU8(&dst[2 * nodecount + i], nodes[i].param1);
+	for (u32 i = 0; i < nodecount; i++)
+		writeU8(&dst[3 * nodecount + i], nodes[i].param2);
+}
+
+static void reference_deserialize_bulk(const u8 *src, MapNode *nodes, u32 nodecount)
+{
+	for (u32 i = 0; i < nodecount; i++)
+		nodes[i].param0 = readU16(&src[i * 2]);
+	for (u32 i = 0; i < nodecount; i++)
+		nodes[i].param1 = readU8(&src[2 * nodecount + i]);
+	for (u32 i = 0; i < nodecount; i++)
+		nodes[i].param2 = readU8(&src[3 * nodecount + i]);
+}
+
+static std::vector<MapNode> random_nodes(u32 nodecount, u64 seed)
+{
+	PcgRandom pr(seed);
+	std::vector<MapNode> nodes(nodecount);
+	for (MapNode &n : nodes) {
+		n.param0 = pr.next();
+		n.param1 = pr.next();
+		n.param2 = pr.next();
+	}
+	return nodes;
+}
+
+static bool nodes_equal(const std::vector<MapNode> &a, const std::vector<MapNode> &b)
+{
+	for (size_t i = 0; i < a.size(); i++) {
+		if (a[i].param0 != b[i].param0 || a[i].param1 != b[i].param1 ||
+				a[i].param2 != b[i].param2)
+			return false;
+	}
+	return a.size() == b.size();
+}
+
+BENCHMARK(mapnode)
+{
+	const int version = SER_FMT_VER_HIGHEST_WRITE;
+
+	// Node counts that do and don't fill the SIMD kernels exactly
+	for (u32 nodecount : {1U, 15U, 16U, 17U, 4095U, 4096U, 4099U}) {
+		std::vector<MapNode> nodes = random_nodes(nodecount, nodecount);
+		const std::string what = "MapNode bulk with " + itos(nodecount) + " nodes: ";
+
+		std::vector<u8> expected(nodecount * 4);
+		reference_serialize_bulk(nodes.data(), nodecount, expected.data());
+		SharedBuffer<u8> actual = MapNode::serializeBulk(version, nodes.data(),
+				nodecount, 2, 2);
+		if (memcmp(*actual, expected.data(), expected.size()) != 0)
+			runner.fail("mapnode.bulk", what + "serializeBulk() mismatch");
+
+		std::vector<MapNode> decoded(nodecount);
+		MapNode::deSerializeBulk(expected.data(), version, decoded.data(),
+				nodecount, 2, 2);
+		if (!nodes_equal(decoded, nodes))
+			runner.fail("mapnode.bulk", what + "deSerializeBulk() mismatch");
+	}
+
+	const u32 nodecount = MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE;
+	std::vector<MapNode> nodes = random_nodes(nodecount, 1);
+	std::vector<u8> data(nodecount * 4);
+	reference_serialize_bulk(nodes.data(), nodecount, data.data());
+
+	runner.measure("mapnode.serialize_bulk", nodecount, "node", [&] () {
+		SharedBuffer<u8> buf = MapNode::serializeBulk(version, nodes.data(),
+				nodecount, 2, 2);
+		benchmark_consume(buf[0]);
+	});
+	runner.measure("mapnode.serialize_bulk.reference", nodecount, "node", [&] () {
+		SharedBuffer<u8> buf(nodecount * 4);
+		reference_serialize_bulk(nodes.data(), nodecount, &buf[0]);
+		benchmark_consume(buf[0]);
+	});
+	runner.measure("mapnode.deserialize_bulk", nodecount, "node", [&] () {
+		MapNode::deSerializeBulk(data.data(), version, nodes.data(),
+				nodecount, 2, 2);
+		benchmark_consume(nodes[0].param0);
+	});
+	runner.measure("mapnode.deserialize_bulk.reference", nodecount, "node", [&] () {
+		reference_deserialize_bulk(data.data(), nodes.data(), nodecount);
+		benchmark_consume(nodes[0].param0);
+	});
+}
@@ -0,0 +1,94 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "benchmark_client.h"
+#include "client/camera.h"
+#include "client/client.h"
+#include "client/clientmap.h"
+#include "client/mapblock_mesh.h"
+#include "settings.h"
+
+BENCHMARK(mesh)
+{
+	BenchmarkClient *bclient = nullptr;
+
+	for (int mix = 0; mix < NODEMIX_COUNT; mix++) {
+		const std::string name = std::string("mesh.") + benchmark_nodemix_names[mix];
+		if (!runner.wanted(name))
+			continue;
+
+		if (!bclient)
+			bclient = runner.getClient();
+		Client *client = bclient->getClient();
+
+		// The block and all of its neighbors
+		bclient->placeArea((BenchmarkNodeMix)mix, v3s16(-1, -1, -1), v3s16(1, 1, 1));
+		MeshMakeData data(client, false);
+		bclient->fillMeshMakeData(&data, v3s16(0, 0, 0));
+
+		// Includes freeing the mesh, which the client does as often
+		runner.measure(name, 1, "block", [&] () {
+			MapBlockMesh mesh(&data, v3s16(0, 0, 0));
+			benchmark_consume(mesh.getMesh()->getMeshBufferCount());
+		});
+	}
+}
+
+BENCHMARK(drawlist)
+{
+	const char *cullers[] = {"bfs", "loops"};
+	bool wanted = false;
+	for (const char *culler : cullers)
+		wanted |= runner.wanted(std::string("drawlist.") + culler);
+	if (!wanted)
+		return;
+
+	BenchmarkClient *bclient = runner.getClient();
+	ClientMap &map = bclient->getMap();
+
+	// Terrain around the camera, as far as a default viewing range
+	const s16 range = 6;
+	bclient->placeArea(NODEMIX_TERRAIN, v3s16(-range, -2, -range),
+			v3s16(range, 2, range), true);
+
+	const v3f position = v3f(0, bclient->getGroundLevel(0, 0) + 2, 0) * BS;
+	const v3f direction = v3f(1, -0.2f, 0.3f).normalize();
+	const f32 fov = 72.0f * core::DEGTORAD;
+
+	scene::ICameraSceneNode *camera_node = bclient->getCamera()->getCameraNode();
+	camera_node->setPosition(position);
+	camera_node->setTarget(position + direction);
+	camera_node->setFOV(fov);
+	camera_node->updateAbsolutePosition();
+	camera_node->updateMatrices();
+
+	MapDrawControl &draw_control = bclient->getDrawControl();
+	draw_control.wanted_range = range * MAP_BLOCKSIZE;
+	map.updateCamera(position, direction, fov, v3s16(0, 0, 0));
+
+	const std::string old_culler = g_settings->get("occlusion_culler");
+	for (const char *culler : cullers) {
+		g_settings->set("occlusion_culler", culler);
+		runner.measure(std::string("drawlist.") + culler, 1, "update", [&] () {
+			map.updateDrawList();
+		});
+	}
+	g_settings->set("occlusion_culler", old_culler);
+}
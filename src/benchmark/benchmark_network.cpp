@@ -0,0 +1,72 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "noise.h"
+#include "constants.h"
+#include "network/connection.h"
+#include "network/networkprotocol.h"
+#include <algorithm>
+#include <vector>
+
+// Packets in flight, about what a busy connection has buffered
+#define RELIABLE_WINDOW 512
+
+/*
+	Reliable packets that arrive out of order wait in a ReliablePacketBuffer,
+	which is kept sorted by sequence number.
+*/
+BENCHMARK(network)
+{
+	Address address(127, 0, 0, 1, 30000);
+	// Sequence numbers wrap around in the middle of the window
+	const u16 next_expected = 65535 - RELIABLE_WINDOW / 2;
+
+	std::vector<con::BufferedPacketPtr> in_order;
+	SharedBuffer<u8> payload(64);
+	memset(*payload, 0, payload.getSize());
+	for (u16 i = 1; i <= RELIABLE_WINDOW; i++) {
+		const u16 seqnum = next_expected + i;
+		in_order.push_back(con::makePacket(address, con::makeReliablePacket(payload, seqnum),
+				PROTOCOL_ID, PEER_ID_SERVER, 0));
+	}
+
+	std::vector<con::BufferedPacketPtr> shuffled = in_order;
+	PcgRandom pr(1);
+	for (size_t i = shuffled.size() - 1; i > 0; i--)
+		std::swap(shuffled[i], shuffled[pr.range(0, (s32)i)]);
+
+	std::vector<con::BufferedPacketPtr> reversed(in_order.rbegin(), in_order.rend());
+
+	auto insert_all = [&] (std::vector<con::BufferedPacketPtr> &packets) {
+		con::ReliablePacketBuffer buffer;
+		for (con::BufferedPacketPtr &packet : packets)
+			buffer.insert(packet, next_expected);
+		// Drain it as the receive thread does
+		while (!buffer.empty())
+			benchmark_consume(buffer.popFirst()->size());
+	};
+
+	runner.measure("network.reliable_insert.in_order", RELIABLE_WINDOW, "packet",
+			[&] () { insert_all(in_order); });
+	runner.measure("network.reliable_insert.shuffled", RELIABLE_WINDOW, "packet",
+			[&] () { insert_all(shuffled); });
+	runner.measure("network.reliable_insert.reversed", RELIABLE_WINDOW, "packet",
+			[&] () { insert_all(reversed); });
+}
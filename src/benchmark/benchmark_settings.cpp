@@ -0,0 +1,50 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "settings.h"
+
+/*
+	Settings read in per-frame code: a value only present in the defaults
+	layer, one set in the global layer, and the cached SettingHandle.
+*/
+BENCHMARK(settings)
+{
+	g_settings->setFloat("benchmark_value", 1.5f);
+
+	runner.measure("settings.get_default", 1, "lookup", [&] () {
+		benchmark_consume(g_settings->getFloat("fov"));
+	});
+	runner.measure("settings.get_global", 1, "lookup", [&] () {
+		benchmark_consume(g_settings->getFloat("benchmark_value"));
+	});
+	runner.measure("settings.get_bool", 1, "lookup", [&] () {
+		benchmark_consume(g_settings->getBool("enable_fog"));
+	});
+	runner.measure("settings.get_string", 1, "lookup", [&] () {
+		benchmark_consume(g_settings->get("occlusion_culler").size());
+	});
+
+	SettingHandle<float> fov("fov");
+	runner.measure("settings.handle", 1, "lookup", [&] () {
+		benchmark_consume(fov.get());
+	});
+
+	g_settings->remove("benchmark_value");
+}
@@ -0,0 +1,88 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "noise.h"
+#include "util/hex.h"
+#include "util/sha1.h"
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static std::string sha1_hex(const std::string &data, bool shani)
+{
+	SHA1 sha1;
+	if (!shani)
+		sha1.disableSHANI();
+	sha1.addBytes(data.c_str(), data.size());
+	unsigned char *digest = sha1.getDigest();
+	std::string ret = hex_encode((char *)digest, 20);
+	free(digest);
+	return ret;
+}
+
+/*
+	Media files are hashed when they are loaded and received, see
+	MediaLoadPool. The portable code is tested and measured as well as the
+	SHA extensions, if the CPU has them.
+*/
+BENCHMARK(sha1)
+{
+	static const struct {
+		std::string data;
+		const char *digest;
+	} vectors[] = {
+		{"", "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+		{"abc", "a9993e364706816aba3e25717850c26c9cd0d89d"},
+		{"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+			"84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+		{std::string(1000000, 'a'), "34aa973cd4c4daa4f61eeb2bdbad27316534016f"},
+	};
+
+	std::vector<bool> implementations = {false};
+	if (SHA1::hasSHANI())
+		implementations.push_back(true);
+
+	for (bool shani : implementations) {
+		const std::string name = shani ? "sha1.shani" : "sha1.scalar";
+
+		for (const auto &vector : vectors) {
+			if (sha1_hex(vector.data, shani) != vector.digest)
+				runner.fail(name, "Wrong digest for input of " +
+						std::to_string(vector.data.size()) + " bytes");
+		}
+
+		// A small texture and a large model
+		for (u32 size : {4096U, 1U << 20}) {
+			std::string data(size, '\0');
+			PcgRandom pr(size);
+			pr.bytes(&data[0], data.size());
+
+			runner.measure(name + "." + std::to_string(size), size, "byte", [&] () {
+				SHA1 sha1;
+				if (!shani)
+					sha1.disableSHANI();
+				sha1.addBytes(data.c_str(), data.size());
+				unsigned char *digest = sha1.getDigest();
+				benchmark_consume(digest[0]);
+				free(digest);
+			});
+		}
+	}
+}
@@ -0,0 +1,89 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "benchmark.h"
+#include "benchmark_client.h"
+#include "client/renderingengine.h"
+#include "client/tile.h"
+#include "noise.h"
+#include <memory>
+
+// Modifier chains as commonly found in games
+static const struct {
+	const char *name;
+	const char *texture;
+} texture_chains[] = {
+	{"plain", "benchmark_a.png"},
+	{"overlay", "benchmark_a.png^benchmark_b.png"},
+	{"colorize", "benchmark_a.png^[colorize:#40a0ff:128"},
+	{"multiply", "benchmark_a.png^[multiply:#ff8040"},
+	{"transform", "benchmark_a.png^[transformFXR90"},
+	{"resize_opacity", "benchmark_a.png^[resize:64x64^[opacity:160"},
+	{"mask_invert", "benchmark_a.png^[mask:benchmark_b.png^[invert:rgb"},
+	{"combine", "[combine:32x32:0,0=benchmark_a.png:16,0=benchmark_b.png"
+		":0,16=benchmark_b.png:16,16=benchmark_a.png"},
+	{"inventorycube", "[inventorycube{benchmark_a.png{benchmark_b.png"
+		"{benchmark_a.png^[colorize:#ff0000:64"},
+};
+
+static void insert_image(IWritableTextureSource *tsrc, const std::string &name,
+		u32 size, u64 seed)
+{
+	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
+	video::IImage *img = driver->createImage(video::ECF_A8R8G8B8,
+			core::dimension2d<u32>(size, size));
+	PcgRandom pr(seed);
+	for (u32 y = 0; y < size; y++)
+	for (u32 x = 0; x < size; x++)
+		img->setPixel(x, y, video::SColor(pr.next()));
+	tsrc->insertSourceImage(name, img);
+	img->drop();
+}
+
+BENCHMARK(texture)
+{
+	std::unique_ptr<IWritableTextureSource> tsrc;
+
+	for (const auto &chain : texture_chains) {
+		const std::string name = std::string("texture.") + chain.name;
+		if (!runner.wanted(name))
+			continue;
+
+		if (!tsrc) {
+			// The rendering engine is needed for the video driver
+			runner.getClient();
+			tsrc.reset(createTextureSource());
+			insert_image(tsrc.get(), "benchmark_a.png", 16, 1);
+			insert_image(tsrc.get(), "benchmark_b.png", 16, 2);
+		}
+
+		video::IImage *img = tsrc->generateImage(chain.texture);
+		if (!img) {
+			runner.fail(name, std::string("Cannot generate ") + chain.texture);
+			continue;
+		}
+		img->drop();
+
+		runner.measure(name, 1, "image", [&] () {
+			video::IImage *img = tsrc->generateImage(chain.texture);
+			benchmark_consume(img->getDimension().Width);
+			img->drop();
+		});
+	}
+}
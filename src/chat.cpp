@@ -62,6 +62,7 @@ void ChatBuffer::clear()
 {
 	m_unformatted.clear();
 	m_formatted.clear();
+	m_pending = 0;
 	m_scroll = 0;
 	m_lines_modified = true;
 }
@@ -91,6 +92,12 @@ void ChatBuffer::deleteOldest(u32 count)
 	u32 del_unformatted = 0;
 	u32 del_formatted = 0;
 
+	// Pending lines are the oldest ones and have no formatted rows
+	u32 del_pending = std::min(count, m_pending);
+	m_pending -= del_pending;
+	del_unformatted += del_pending;
+	count -= del_pending;
+
 	while (count > 0 && del_unformatted < m_unformatted.size()) {
 		++del_unformatted;
 
@@ -140,15 +147,12 @@ void ChatBuffer::reformat(u32 cols, u32 rows)
 		m_rows = 0;
 		m_scroll = 0;
 		m_formatted.clear();
+		m_pending = 0;
 	}
 	else if (cols != m_cols || rows != m_rows)
 	{
-		// TODO: Avoid reformatting ALL lines (even invisible ones)
-		// each time the console size changes.
-
 		// Find out the scroll position in *unformatted* lines
-		u32 restore_scroll_unformatted = 0;
-		u32 restore_scroll_formatted = 0;
+		u32 restore_scroll_unformatted = m_pending;
 		bool at_bottom = (m_scroll == getBottomScrollPos());
 		if (!at_bottom)
 		{
@@ -159,21 +163,26 @@ void ChatBuffer::reformat(u32 cols, u32 rows)
 			}
 		}
 
-		// If number of columns change, reformat everything
-		if (cols != m_cols)
+		// Update the console size
+		bool cols_changed = cols != m_cols;
+		m_cols = cols;
+		m_rows = rows;
+
+		// If number of columns change, throw away all formatted lines.
+		// They are formatted again from the bottom up, as far as needed.
+		if (cols_changed)
 		{
 			m_formatted.clear();
-			for (u32 i = 0; i < m_unformatted.size(); ++i)
-			{
-				if (i == restore_scroll_unformatted)
-					restore_scroll_formatted = m_formatted.size();
-				formatChatLine(m_unformatted[i], cols, m_formatted);
-			}
+			m_pending = m_unformatted.size();
+			if (!at_bottom)
+				formatPending(U32_MAX, restore_scroll_unformatted);
+			// Top row of the previous top line
+			m_scroll = 0;
 		}
 
-		// Update the console size
-		m_cols = cols;
-		m_rows = rows;
+		// Make sure there are enough rows to fill the console
+		if (m_formatted.size() < m_rows)
+			formatPending(m_rows - m_formatted.size());
 
 		// Restore the scroll position
 		if (at_bottom)
@@ -182,7 +191,7 @@ void ChatBuffer::reformat(u32 cols, u32 rows)
 		}
 		else
 		{
-			scrollAbsolute(restore_scroll_formatted);
+			scrollAbsolute(m_scroll);
 		}
 	}
 }
@@ -203,6 +212,12 @@ void ChatBuffer::scroll(s32 rows)
 
 void ChatBuffer::scrollAbsolute(s32 scroll)
 {
+	// Scrolling above the formatted rows: format older lines first
+	if (scroll < 0 && m_pending > 0) {
+		u32 added = formatPending(-scroll);
+		scroll += added;
+	}
+
 	s32 top = getTopScrollPos();
 	s32 bottom = getBottomScrollPos();
 
@@ -218,8 +233,26 @@ void ChatBuffer::scrollBottom()
 	m_scroll = getBottomScrollPos();
 }
 
+u32 ChatBuffer::formatPending(u32 min_rows, u32 keep_pending)
+{
+	if (m_cols == 0)
+		return 0;
+
+	u32 added = 0;
+	std::deque<ChatFormattedLine> rows;
+	while (m_pending > keep_pending && added < min_rows) {
+		--m_pending;
+		rows.clear();
+		u32 num = formatChatLine(m_unformatted[m_pending], m_cols, rows);
+		m_formatted.insert(m_formatted.begin(), rows.begin(), rows.end());
+		added += num;
+	}
+	m_scroll += added;
+	return added;
+}
+
 u32 ChatBuffer::formatChatLine(const ChatLine &line, u32 cols,
-		std::vector<ChatFormattedLine> &destination) const
+		std::deque<ChatFormattedLine> &destination) const
 {
 	u32 num_added = 0;
 	std::vector<ChatFormattedFragment> next_frags;
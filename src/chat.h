@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <string>
 #include <vector>
+#include <deque>
 #include <list>
 #include <optional>
 
@@ -99,7 +100,9 @@ class ChatBuffer
 
 	// Get number of rows, 0 if reformat has not been called yet.
 	u32 getRows() const;
-	// Update console size and reformat all formatted lines.
+	// Update console size and reformat formatted lines.
+	// Only the lines needed to fill the console are formatted right away,
+	// older ones are formatted when scrolled into view.
 	void reformat(u32 cols, u32 rows);
 	// Get formatted line for a given row (0 is top of screen).
 	// Only valid after reformat has been called at least once
@@ -123,7 +126,7 @@ class ChatBuffer
 	// Appends the formatted lines to the destination array and
 	// returns the number of formatted lines.
 	u32 formatChatLine(const ChatLine& line, u32 cols,
-			std::vector<ChatFormattedLine>& destination) const;
+			std::deque<ChatFormattedLine>& destination) const;
 
 	void resize(u32 scrollback);
 
@@ -131,11 +134,19 @@ class ChatBuffer
 	s32 getTopScrollPos() const;
 	s32 getBottomScrollPos() const;
 
+	// Format pending lines (newest first) until at least min_rows rows
+	// were added to the top of m_formatted or only keep_pending lines are
+	// left. Adjusts m_scroll and returns the number of rows added.
+	u32 formatPending(u32 min_rows, u32 keep_pending = 0);
+
 private:
 	// Scrollback size
 	u32 m_scrollback;
 	// Array of unformatted chat lines
-	std::vector<ChatLine> m_unformatted;
+	std::deque<ChatLine> m_unformatted;
+	// Number of oldest lines in m_unformatted that have no rows in
+	// m_formatted yet. Always 0 unless m_formatted holds at least m_rows rows.
+	u32 m_pending = 0;
 
 	// Number of character columns in console
 	u32 m_cols = 0;
@@ -144,7 +155,7 @@ class ChatBuffer
 	// Scroll position (console's top line index into m_formatted)
 	s32 m_scroll = 0;
 	// Array of formatted lines
-	std::vector<ChatFormattedLine> m_formatted;
+	std::deque<ChatFormattedLine> m_formatted;
 	// Empty formatted line, for error returns
 	ChatFormattedLine m_empty_formatted_line;
 
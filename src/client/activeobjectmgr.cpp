@@ -17,10 +17,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <algorithm>
 #include <cmath>
 #include <log.h>
 #include "profiler.h"
 #include "activeobjectmgr.h"
+#include "util/numeric.h"
 
 namespace client
 {
@@ -34,6 +36,9 @@ void ActiveObjectMgr::clear()
 		active_object.second = nullptr;
 	}
 	m_active_objects.clear();
+	m_grid.clear();
+	m_grid_entries.clear();
+	m_large_objects.clear();
 }
 
 void ActiveObjectMgr::step(
@@ -42,6 +47,7 @@ void ActiveObjectMgr::step(
 	g_profiler->avg("ActiveObjectMgr: CAO count [#]", m_active_objects.size());
 	for (auto &ao_it : m_active_objects) {
 		f(ao_it.second);
+		updateGridEntry(ao_it.second);
 	}
 }
 
@@ -70,6 +76,7 @@ bool ActiveObjectMgr::registerObject(ClientActiveObject *obj)
 	infostream << "Client::ActiveObjectMgr::registerObject(): "
 			<< "added (id=" << obj->getId() << ")" << std::endl;
 	m_active_objects[obj->getId()] = obj;
+	updateGridEntry(obj);
 	return true;
 }
 
@@ -85,19 +92,117 @@ void ActiveObjectMgr::removeObject(u16 id)
 	}
 
 	m_active_objects.erase(id);
+	removeGridEntry(obj);
 
 	obj->removeFromScene(true);
 	delete obj;
 }
 
 // clang-format on
+v3s16 ActiveObjectMgr::getGridCell(const v3f &pos) const
+{
+	// Clamped, positions of misbehaving objects may be huge or NaN
+	auto coord = [] (f32 f) -> s16 {
+		f32 c = std::floor(f / GRID_CELL_SIZE);
+		return c > -S16_MAX ? (c < S16_MAX ? (s16)c : S16_MAX) : -S16_MAX;
+	};
+	return v3s16(coord(pos.X), coord(pos.Y), coord(pos.Z));
+}
+
+void ActiveObjectMgr::updateGridEntry(ClientActiveObject *obj)
+{
+	GridEntry entry;
+	entry.cell = getGridCell(obj->getPosition());
+	entry.large = false;
+
+	aabb3f selection_box;
+	if (obj->getSelectionBox(&selection_box)) {
+		// Distance of the farthest corner, also covers rotated boxes
+		v3f reach(
+			std::fmax(std::fabs(selection_box.MinEdge.X), std::fabs(selection_box.MaxEdge.X)),
+			std::fmax(std::fabs(selection_box.MinEdge.Y), std::fabs(selection_box.MaxEdge.Y)),
+			std::fmax(std::fabs(selection_box.MinEdge.Z), std::fabs(selection_box.MaxEdge.Z)));
+		entry.large = !(reach.getLengthSQ() <= GRID_MARGIN * GRID_MARGIN);
+	}
+
+	auto it = m_grid_entries.find(obj->getId());
+	if (it != m_grid_entries.end()) {
+		if (it->second.large == entry.large &&
+				(entry.large || it->second.cell == entry.cell))
+			return;
+		removeGridEntry(obj);
+	}
+
+	if (entry.large)
+		m_large_objects.push_back(obj);
+	else
+		m_grid[entry.cell].push_back(obj);
+	m_grid_entries[obj->getId()] = entry;
+}
+
+void ActiveObjectMgr::removeGridEntry(ClientActiveObject *obj)
+{
+	auto it = m_grid_entries.find(obj->getId());
+	if (it == m_grid_entries.end())
+		return;
+
+	auto erase_from = [obj] (std::vector<ClientActiveObject *> &objects) {
+		auto found = std::find(objects.begin(), objects.end(), obj);
+		if (found != objects.end()) {
+			*found = objects.back();
+			objects.pop_back();
+		}
+	};
+
+	if (it->second.large) {
+		erase_from(m_large_objects);
+	} else {
+		auto cell = m_grid.find(it->second.cell);
+		if (cell != m_grid.end()) {
+			erase_from(cell->second);
+			if (cell->second.empty())
+				m_grid.erase(cell);
+		}
+	}
+	m_grid_entries.erase(it);
+}
+
+void ActiveObjectMgr::getGridCandidates(v3f minp, v3f maxp,
+		std::vector<ClientActiveObject *> &dest) const
+{
+	minp -= v3f(GRID_MARGIN);
+	maxp += v3f(GRID_MARGIN);
+	const v3s16 cmin = getGridCell(minp);
+	const v3s16 cmax = getGridCell(maxp);
+
+	// Looking up more cells than are occupied is slower than visiting them all
+	const u64 cell_count = (u64)(cmax.X - cmin.X + 1) *
+			(cmax.Y - cmin.Y + 1) * (cmax.Z - cmin.Z + 1);
+	if (cell_count > m_grid.size()) {
+		for (const auto &cell : m_grid)
+			dest.insert(dest.end(), cell.second.begin(), cell.second.end());
+	} else {
+		v3s16 c;
+		for (c.Z = cmin.Z; c.Z <= cmax.Z; c.Z++)
+		for (c.Y = cmin.Y; c.Y <= cmax.Y; c.Y++)
+		for (c.X = cmin.X; c.X <= cmax.X; c.X++) {
+			auto cell = m_grid.find(c);
+			if (cell != m_grid.end())
+				dest.insert(dest.end(), cell->second.begin(), cell->second.end());
+		}
+	}
+
+	dest.insert(dest.end(), m_large_objects.begin(), m_large_objects.end());
+}
+
 void ActiveObjectMgr::getActiveObjects(const v3f &origin, f32 max_d,
 		std::vector<DistanceSortedActiveObject> &dest)
 {
-	f32 max_d2 = max_d * max_d;
-	for (auto &ao_it : m_active_objects) {
-		ClientActiveObject *obj = ao_it.second;
+	std::vector<ClientActiveObject *> candidates;
+	getGridCandidates(origin - v3f(max_d), origin + v3f(max_d), candidates);
 
+	f32 max_d2 = max_d * max_d;
+	for (ClientActiveObject *obj : candidates) {
 		f32 d2 = (obj->getPosition() - origin).getLengthSQ();
 
 		if (d2 > max_d2)
@@ -113,9 +218,14 @@ std::vector<DistanceSortedActiveObject> ActiveObjectMgr::getActiveSelectableObje
 	f32 max_d = shootline.getLength();
 	v3f dir = shootline.getVector().normalize();
 
-	for (auto &ao_it : m_active_objects) {
-		ClientActiveObject *obj = ao_it.second;
+	std::vector<ClientActiveObject *> candidates;
+	{
+		aabb3f line_box(shootline.start);
+		line_box.addInternalPoint(shootline.end);
+		getGridCandidates(line_box.MinEdge, line_box.MaxEdge, candidates);
+	}
 
+	for (ClientActiveObject *obj : candidates) {
 		aabb3f selection_box;
 		if (!obj->getSelectionBox(&selection_box))
 			continue;
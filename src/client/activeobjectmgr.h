@@ -20,9 +20,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <functional>
+#include <unordered_map>
 #include <vector>
 #include "../activeobjectmgr.h"
 #include "clientobject.h"
+#include "constants.h"
 
 namespace client
 {
@@ -42,5 +44,32 @@ class ActiveObjectMgr : public ::ActiveObjectMgr<ClientActiveObject>
 	/// @note CAOs without a selection box are not returned.
 	/// @note Distances are along the @p shootline.
 	std::vector<DistanceSortedActiveObject> getActiveSelectableObjects(const core::line3d<f32> &shootline);
+
+private:
+	/*
+		Uniform grid over object positions, so that the queries above only
+		look at objects near the queried area. Objects are moved between
+		cells after each step. Objects whose selection box reaches further
+		than GRID_MARGIN from their position are kept in a separate list
+		that every query scans.
+	*/
+	static constexpr f32 GRID_CELL_SIZE = 8 * BS;
+	static constexpr f32 GRID_MARGIN = 4 * BS;
+
+	struct GridEntry {
+		v3s16 cell;
+		bool large;
+	};
+
+	v3s16 getGridCell(const v3f &pos) const;
+	void updateGridEntry(ClientActiveObject *obj);
+	void removeGridEntry(ClientActiveObject *obj);
+	// Collects all objects that may be within the given box
+	void getGridCandidates(v3f minp, v3f maxp,
+			std::vector<ClientActiveObject *> &dest) const;
+
+	std::unordered_map<v3s16, std::vector<ClientActiveObject *>> m_grid;
+	std::unordered_map<u16, GridEntry> m_grid_entries;
+	std::vector<ClientActiveObject *> m_large_objects;
 };
 } // namespace client
@@ -584,7 +584,8 @@ void Camera::update(LocalPlayer* player, f32 frametime, f32 tool_reload_ratio)
 	const bool walking = movement_XZ && player->touching_ground;
 	const bool swimming = (movement_XZ || player->swimming_vertical) && player->in_liquid;
 	const bool climbing = movement_Y && player->is_climbing;
-	const bool flying = g_settings->getBool("free_move")
+	static const SettingHandle<bool> free_move("free_move");
+	const bool flying = free_move
 		&& m_client->checkLocalPrivilege("fly");
 	if ((walking || swimming || climbing) && !flying) {
 		// Start animation
@@ -599,7 +600,8 @@ void Camera::update(LocalPlayer* player, f32 frametime, f32 tool_reload_ratio)
 
 void Camera::updateViewingRange()
 {
-	f32 viewing_range = g_settings->getFloat("viewing_range");
+	static const SettingHandle<float> viewing_range_setting("viewing_range");
+	f32 viewing_range = viewing_range_setting;
 
 	m_cameranode->setNearValue(0.1f * BS);
 
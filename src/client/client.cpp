@@ -22,6 +22,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <sstream>
 #include <cmath>
 #include <IFileSystem.h>
+#include <IMeshCache.h>
+#include <IMeshManipulator.h>
 #include <json/json.h>
 #include "client.h"
 #include "network/clientopcodes.h"
@@ -29,13 +31,17 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "network/networkpacket.h"
 #include "threading/mutex_auto_lock.h"
 #include "client/clientevent.h"
+#include "client/defsnapshot.h"
 #include "client/gameui.h"
 #include "client/renderingengine.h"
 #include "client/sound.h"
 #include "client/tile.h"
 #include "client/mesh_generator_thread.h"
+#include "client/packetcapture.h"
 #include "client/particles.h"
 #include "client/localplayer.h"
+#include "client/medialoader.h"
+#include "client/mesh.h"
 #include "util/auth.h"
 #include "util/directiontables.h"
 #include "util/pointedthing.h"
@@ -134,6 +140,17 @@ Client::Client(
 	m_game_ui(game_ui),
 	m_modchannel_mgr(new ModChannelMgr())
 {
+	// Before anything that needs the destructor to clean up
+	const std::string replay_path = g_settings->get("network_replay_file");
+	if (!replay_path.empty()) {
+		m_packet_replay = std::make_unique<PacketCaptureReader>(replay_path,
+				g_settings->getBool("network_replay_fast"));
+	} else {
+		const std::string capture_path = g_settings->get("network_capture_file");
+		if (!capture_path.empty())
+			m_packet_capture = std::make_unique<PacketCaptureWriter>(capture_path);
+	}
+
 	// Add local player
 	m_env.setLocalPlayer(new LocalPlayer(this, playername));
 
@@ -147,6 +164,16 @@ Client::Client(
 	}
 
 	m_mesh_grid = { g_settings->getU16("client_mesh_chunk") };
+	m_compact_mapblocks = g_settings->getBool("client_mapblock_compact");
+
+	// In the order step() runs them. The maximums are the limits that
+	// apply outside of frames, such as on the loading screen.
+	m_task_packets = m_frame_scheduler.addTask("packets", 4, 1000, 10000);
+	m_task_map = m_frame_scheduler.addTask("map unload", 1, 100, 500);
+	// Can't be cut short, only measured
+	m_task_env = m_frame_scheduler.addTask("environment", 0, 0, 0);
+	m_task_meshes = m_frame_scheduler.addTask("meshes", 4, 1000, 0);
+	m_task_media = m_frame_scheduler.addTask("media", 2, 1000, 0);
 }
 
 void Client::loadMods()
@@ -348,6 +375,12 @@ Client::~Client()
 
 void Client::connect(Address address, bool is_local_server)
 {
+	if (m_packet_replay) {
+		// The server is played back from the capture file
+		m_replay_address = address;
+		return;
+	}
+
 	// Since we use TryReceive() a timeout here would be ineffective anyway
 	m_con->SetTimeoutMs(0);
 	m_con->Connect(address);
@@ -407,15 +440,27 @@ void Client::step(float dtime)
 	*/
 
 	/*
-		Run Map's timers and unload unused data
+		Run Map's timers and unload unused data, a little every frame
 	*/
-	const float map_timer_and_unload_dtime = 5.25;
-	if(m_map_timer_and_unload_interval.step(dtime, map_timer_and_unload_dtime)) {
+	{
+		static const SettingHandle<float> unload_timeout(
+				"client_unload_unused_data_timeout");
+		static const SettingHandle<s32> mapblock_limit("client_mapblock_limit");
+		static const SettingHandle<u32> mapblock_memory_limit(
+				"client_mapblock_memory_limit");
+
 		std::vector<v3s16> deleted_blocks;
-		m_env.getMap().timerUpdate(map_timer_and_unload_dtime,
-			std::max(g_settings->getFloat("client_unload_unused_data_timeout"), 0.0f),
-			g_settings->getS32("client_mapblock_limit"),
-			&deleted_blocks);
+		{
+			FrameScheduler::Slice slice(m_frame_scheduler, m_task_map);
+			m_env.getMap().timerUpdate(dtime,
+				std::max(unload_timeout.get(), 0.0f),
+				mapblock_limit,
+				&deleted_blocks,
+				(u64)mapblock_memory_limit.get() * 1024 * 1024,
+				slice.getBudgetUs());
+			// Stopped by the budget, most likely
+			slice.expired();
+		}
 
 		/*
 			Send info to server
@@ -449,6 +494,8 @@ void Client::step(float dtime)
 		}
 	}
 
+	updateMemoryUsage(dtime);
+
 	/*
 		Send pending messages on out chat queue
 	*/
@@ -463,7 +510,10 @@ void Client::step(float dtime)
 	LocalPlayer *player = m_env.getLocalPlayer();
 
 	// Step environment (also handles player controls)
-	m_env.step(dtime);
+	{
+		FrameScheduler::Slice slice(m_frame_scheduler, m_task_env);
+		m_env.step(dtime);
+	}
 	m_sound->step(dtime);
 
 	/*
@@ -520,7 +570,9 @@ void Client::step(float dtime)
 		std::vector<v3s16> blocks_to_ack;
 		bool force_update_shadows = false;
 		MeshUpdateResult r;
-		while (m_mesh_update_manager->getNextResult(r))
+		// The rest stays queued for the next frame
+		FrameScheduler::Slice slice(m_frame_scheduler, m_task_meshes);
+		while (!slice.expired() && m_mesh_update_manager->getNextResult(r))
 		{
 			num_processed_meshes++;
 
@@ -541,6 +593,7 @@ void Client::step(float dtime)
 				// Delete the old mesh
 				delete block->mesh;
 				block->mesh = nullptr;
+				block->mesh_evicted = false;
 				block->solid_sides = r.solid_sides;
 
 				if (r.mesh) {
@@ -599,6 +652,7 @@ void Client::step(float dtime)
 
 		if (num_processed_meshes > 0)
 			g_profiler->graphAdd("num_processed_meshes", num_processed_meshes);
+		m_mesh_update_count += num_processed_meshes;
 
 		auto shadow_renderer = RenderingEngine::get_shadow_renderer();
 		if (shadow_renderer && force_update_shadows)
@@ -608,14 +662,16 @@ void Client::step(float dtime)
 	/*
 		Load fetched media
 	*/
-	if (m_media_downloader && m_media_downloader->isStarted()) {
-		m_media_downloader->step(this);
-		if (m_media_downloader->isDone()) {
-			delete m_media_downloader;
-			m_media_downloader = NULL;
-		}
-	}
 	{
+		FrameScheduler::Slice slice(m_frame_scheduler, m_task_media);
+		if (m_media_downloader && m_media_downloader->isStarted()) {
+			m_media_downloader->step(this);
+			if (m_media_downloader->isDone()) {
+				delete m_media_downloader;
+				m_media_downloader = NULL;
+			}
+		}
+
 		// Acknowledge dynamic media downloads to server
 		std::vector<u32> done;
 		for (auto it = m_pending_media_downloads.begin();
@@ -775,10 +831,14 @@ bool Client::loadMedia(const std::string &data, const std::string &filename,
 	if (!name.empty()) {
 		verbosestream<<"Client: Storing model into memory: "
 				<<"\""<<filename<<"\""<<std::endl;
-		if(m_mesh_data.count(filename))
+		auto it = m_mesh_data.find(filename);
+		if (it != m_mesh_data.end()) {
 			errorstream<<"Multiple models with name \""<<filename.c_str()
 					<<"\" found; replacing previous model"<<std::endl;
+			m_mesh_data_bytes -= it->second.size();
+		}
 		m_mesh_data[filename] = data;
+		m_mesh_data_bytes += data.size();
 		return true;
 	}
 
@@ -800,6 +860,20 @@ bool Client::loadMedia(const std::string &data, const std::string &filename,
 	return false;
 }
 
+bool Client::loadMedia(PreparedMedia &media)
+{
+	// Translations were already parsed by the load pool. Images are
+	// decoded here, the image loaders must not run on the pool threads.
+	if (media.translations) {
+		TRACESTREAM(<< "Client: Merging prepared translation: "
+				<< "\"" << media.name << "\"" << std::endl);
+		g_client_translations->merge(*media.translations);
+		return true;
+	}
+
+	return loadMedia(media.data, media.name);
+}
+
 // Virtual methods from con::PeerHandler
 void Client::peerAdded(con::Peer *peer)
 {
@@ -852,15 +926,77 @@ void Client::request_media(const std::vector<std::string> &file_requests)
 			<< pkt.getSize() << ")" << std::endl;
 }
 
+void Client::updateMemoryUsage(float dtime)
+{
+	if (!m_memory_usage_interval.step(dtime, 1.0f))
+		return;
+
+	ScopeProfiler sp(g_profiler, "Client::updateMemoryUsage()", SPT_AVG);
+
+	ClientMemoryUsage &usage = m_memory_usage;
+	usage.mapblocks = m_env.getMap().getLoadedBlockBytes();
+	usage.meshes = MapBlockMesh::getTotalMemoryUsage();
+	usage.textures = m_tsrc->getTextureMemoryUsage();
+	usage.images = m_tsrc->getSourceImageMemoryUsage();
+	usage.sounds = m_sound->getMemoryUsage();
+	usage.models = m_mesh_data_bytes;
+	usage.definitions = DefinitionSnapshot::getMemoryUsage();
+
+	const u64 budget = (u64)g_settings->getU32("client_memory_budget") * 1024 * 1024;
+	if (budget > 0 && usage.total() > budget) {
+		/*
+			Free what is cheapest to get back first: the definition snapshot
+			only speeds up reconnecting, meshes of distant blocks are made
+			again when they come into range, source images and sounds are
+			loaded again from disk when needed.
+			Map blocks are limited by client_mapblock_memory_limit instead.
+		*/
+		u64 over = usage.total() - budget;
+		u64 freed = usage.definitions;
+		if (freed > 0) {
+			DefinitionSnapshot::clear();
+			usage.definitions = 0;
+			over -= std::min(freed, over);
+		}
+		if (over > 0) {
+			freed = m_env.getClientMap().evictMeshes(over);
+			usage.meshes -= std::min(freed, usage.meshes);
+			over -= std::min(freed, over);
+		}
+		if (over > 0) {
+			freed = m_tsrc->evictSourceImages(over);
+			usage.images -= std::min(freed, usage.images);
+			over -= std::min(freed, over);
+		}
+		if (over > 0) {
+			freed = m_sound->freeMemory(over);
+			usage.sounds -= std::min(freed, usage.sounds);
+			over -= std::min(freed, over);
+		}
+		if (over > 0) {
+			verbosestream << "Client: " << (over >> 20)
+					<< " MiB over client_memory_budget" << std::endl;
+		}
+	}
+
+	const float mib = 1.0f / (1024 * 1024);
+	g_profiler->avg("Client: memory mapblocks [MiB]", usage.mapblocks * mib);
+	g_profiler->avg("Client: memory meshes [MiB]", usage.meshes * mib);
+	g_profiler->avg("Client: memory textures [MiB]", usage.textures * mib);
+	g_profiler->avg("Client: memory images [MiB]", usage.images * mib);
+	g_profiler->avg("Client: memory sounds [MiB]", usage.sounds * mib);
+	g_profiler->avg("Client: memory models [MiB]", usage.models * mib);
+	g_profiler->avg("Client: memory definitions [MiB]", usage.definitions * mib);
+}
+
 void Client::ReceiveAll()
 {
 	NetworkPacket pkt;
-	u64 start_ms = porting::getTimeMs();
-	const u64 budget = 10;
+	FrameScheduler::Slice slice(m_frame_scheduler, m_task_packets);
 	for(;;) {
 		// Limit time even if there would be huge amounts of data to
 		// process
-		if (porting::getTimeMs() > start_ms + budget) {
+		if (slice.expired()) {
 			infostream << "Client::ReceiveAll(): "
 					"Packet processing budget exceeded." << std::endl;
 			break;
@@ -868,8 +1004,14 @@ void Client::ReceiveAll()
 
 		pkt.clear();
 		try {
-			if (!m_con->TryReceive(&pkt))
+			if (m_packet_replay) {
+				if (!m_packet_replay->read(&pkt))
+					break;
+			} else if (!m_con->TryReceive(&pkt)) {
 				break;
+			}
+			if (m_packet_capture)
+				m_packet_capture->write(&pkt);
 			ProcessData(&pkt);
 		} catch (const con::InvalidIncomingDataException &e) {
 			infostream << "Client::ReceiveAll(): "
@@ -941,6 +1083,10 @@ void Client::ProcessData(NetworkPacket *pkt)
 
 void Client::Send(NetworkPacket* pkt)
 {
+	// Nobody is listening during a replay
+	if (m_packet_replay)
+		return;
+
 	m_con->Send(PEER_ID_SERVER,
 		serverCommandFactoryTable[pkt->getCommand()].channel,
 		pkt,
@@ -1686,6 +1832,8 @@ ClientEvent *Client::getClientEvent()
 
 const Address Client::getServerAddress()
 {
+	if (m_packet_replay)
+		return m_replay_address;
 	return m_con->GetPeerAddress(PEER_ID_SERVER);
 }
 
@@ -1697,6 +1845,14 @@ float Client::mediaReceiveProgress()
 	return 1.0; // downloader only exists when not yet done
 }
 
+float Client::mediaLoadRate()
+{
+	if (m_media_downloader)
+		return m_media_downloader->getLoadRate();
+
+	return 0.0f;
+}
+
 struct TextureUpdateArgs {
 	gui::IGUIEnvironment *guienv;
 	u64 last_time_ms;
@@ -1707,6 +1863,10 @@ struct TextureUpdateArgs {
 
 void Client::showUpdateProgressTexture(void *args, u32 progress, u32 max_progress)
 {
+		// No progress is shown without a loading screen
+		if (!args)
+			return;
+
 		TextureUpdateArgs* targs = (TextureUpdateArgs*) args;
 		u16 cur_percent = ceil(progress / (double) max_progress * 100.);
 
@@ -1929,20 +2089,42 @@ scene::IAnimatedMesh* Client::getMesh(const std::string &filename, bool cache)
 		return NULL;
 	}
 	const std::string &data    = it->second;
+	scene::ISceneManager *smgr = m_rendering_engine->get_scene_manager();
+
+	// Cached models are parsed once and shared by all instances
+	if (cache) {
+		scene::IAnimatedMesh *mesh =
+				smgr->getMeshCache()->getMeshByName(filename.c_str());
+		if (mesh) {
+			mesh->grab();
+			return mesh;
+		}
+	}
 
-	// Create the mesh, remove it from cache and return it
-	// This allows unique vertex colors and other properties for each instance
 	io::IReadFile *rfile = m_rendering_engine->get_filesystem()->createMemoryReadFile(
 			data.c_str(), data.size(), filename.c_str());
 	FATAL_ERROR_IF(!rfile, "Could not create/open RAM file");
 
-	scene::IAnimatedMesh *mesh = m_rendering_engine->get_scene_manager()->getMesh(rfile);
+	scene::IAnimatedMesh *mesh = smgr->getMesh(rfile);
 	rfile->drop();
 	if (!mesh)
 		return nullptr;
 	mesh->grab();
-	if (!cache)
+	if (!cache) {
+		// Remove the mesh from the cache and return it
+		// This allows unique vertex colors and other properties for each instance
 		m_rendering_engine->removeMesh(mesh);
+		return mesh;
+	}
+
+	// Prepare the shared mesh once, its users must not modify it
+	if (!checkMeshNormals(mesh)) {
+		infostream << "Client: recalculating normals for mesh "
+			<< filename << std::endl;
+		smgr->getMeshManipulator()->recalculateNormals(mesh, true, false);
+	}
+	// set vertex colors to ensure alpha is set
+	setMeshColor(mesh, video::SColor(0xFFFFFFFF));
 	return mesh;
 }
 
@@ -36,6 +36,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "network/peerhandler.h"
 #include "gameparams.h"
 #include "clientdynamicinfo.h"
+#include "client/framescheduler.h"
 #include <fstream>
 #include "util/numeric.h"
 
@@ -55,6 +56,7 @@ class ClientMediaDownloader;
 class SingleMediaDownloader;
 struct MapDrawControl;
 class ModChannelMgr;
+struct PreparedMedia;
 class MtEventManager;
 struct PointedThing;
 struct MapNode;
@@ -65,6 +67,8 @@ class ParticleManager;
 class Camera;
 struct PlayerControl;
 class NetworkPacket;
+class PacketCaptureWriter;
+class PacketCaptureReader;
 namespace con {
 class Connection;
 }
@@ -107,6 +111,26 @@ class PacketCounter
 	std::map<u16, u32> m_packets;
 };
 
+/*
+	Memory used by the client, by subsystem, in bytes
+*/
+struct ClientMemoryUsage
+{
+	u64 mapblocks = 0;
+	u64 meshes = 0;
+	u64 textures = 0;
+	u64 images = 0;
+	u64 sounds = 0;
+	u64 models = 0;
+	u64 definitions = 0;
+
+	u64 total() const
+	{
+		return mapblocks + meshes + textures + images + sounds + models +
+				definitions;
+	}
+};
+
 class ClientScripting;
 class GameUI;
 
@@ -353,6 +377,7 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	bool m_simple_singleplayer_mode;
 
 	float mediaReceiveProgress();
+	float mediaLoadRate();
 
 	void afterContentReceived();
 	void showUpdateProgressTexture(void *args, u32 progress, u32 max_progress);
@@ -387,6 +412,8 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	// Insert a media file appropriately into the appropriate manager
 	bool loadMedia(const std::string &data, const std::string &filename,
 		bool from_media_push = false);
+	// Same for a file that went through MediaLoadPool
+	bool loadMedia(PreparedMedia &media);
 
 	// Send a request for conventional media transfer
 	void request_media(const std::vector<std::string> &file_requests);
@@ -438,6 +465,15 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 		return m_mesh_grid;
 	}
 
+	// Number of meshes received from the mesh generator so far
+	u64 getMeshUpdateCount() const { return m_mesh_update_count; }
+
+	// Updated about once per second
+	const ClientMemoryUsage &getMemoryUsage() const { return m_memory_usage; }
+
+	// Shares the frame time among the work done in step()
+	FrameScheduler &getFrameScheduler() { return m_frame_scheduler; }
+
 	bool inhibit_inventory_revert = false;
 
 private:
@@ -449,6 +485,9 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 
 	void ReceiveAll();
 
+	// Accounts memory by subsystem and frees some if over client_memory_budget
+	void updateMemoryUsage(float dtime);
+
 	void sendPlayerPos();
 
 	void deleteAuthData();
@@ -467,7 +506,6 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	float m_connection_reinit_timer = 0.1f;
 	float m_avg_rtt_timer = 0.0f;
 	float m_playerpos_send_timer = 0.0f;
-	IntervalLimiter m_map_timer_and_unload_interval;
 
 	IWritableTextureSource *m_tsrc;
 	IWritableShaderSource *m_shsrc;
@@ -482,6 +520,11 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 	ClientEnvironment m_env;
 	std::unique_ptr<ParticleManager> m_particle_manager;
 	std::unique_ptr<con::Connection> m_con;
+	// Set by the network_capture_file and network_replay_file settings.
+	// When replaying, packets come from the file and m_con is never connected.
+	std::unique_ptr<PacketCaptureWriter> m_packet_capture;
+	std::unique_ptr<PacketCaptureReader> m_packet_replay;
+	Address m_replay_address;
 	std::string m_address_name;
 	ELoginRegister m_allow_login_or_register = ELoginRegister::Any;
 	Camera *m_camera = nullptr;
@@ -490,6 +533,19 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 
 	// Server serialization version
 	u8 m_server_ser_ver;
+	// Reused for decompressing received map blocks
+	std::vector<u8> m_block_decode_buffer;
+	// Store received map blocks with a palette, see MapBlock::compact()
+	bool m_compact_mapblocks;
+
+	FrameScheduler m_frame_scheduler;
+	// Tasks of m_frame_scheduler
+	u32 m_task_packets, m_task_map, m_task_env, m_task_meshes, m_task_media;
+
+	ClientMemoryUsage m_memory_usage;
+	IntervalLimiter m_memory_usage_interval;
+	// Size of the models in m_mesh_data
+	u64 m_mesh_data_bytes = 0;
 
 	// Used version of the protocol with server
 	// Values smaller than 25 only mean they are smaller than 25,
@@ -596,4 +652,6 @@ class Client : public con::PeerHandler, public InventoryManager, public IGameDef
 
 	// The number of blocks the client will combine for mesh generation.
 	MeshGrid m_mesh_grid;
+
+	u64 m_mesh_update_count = 0;
 };
@@ -146,7 +146,8 @@ void ClientEnvironment::step(float dtime)
 
 	// Get some settings
 	bool fly_allowed = m_client->checkLocalPrivilege("fly");
-	bool free_move = fly_allowed && g_settings->getBool("free_move");
+	static const SettingHandle<bool> free_move_setting("free_move");
+	bool free_move = fly_allowed && free_move_setting;
 
 	// Get local player
 	LocalPlayer *lplayer = getLocalPlayer();
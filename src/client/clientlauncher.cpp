@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "gui/mainmenumanager.h"
 #include "clouds.h"
+#include "defsnapshot.h"
 #include "server.h"
 #include "filesys.h"
 #include "gui/guiMainMenu.h"
@@ -263,6 +264,10 @@ bool ClientLauncher::run(GameStartData &start_data, const Settings &cmd_args)
 
 		m_rendering_engine->get_scene_manager()->clear();
 
+		// The definitions are only reused when reconnecting to the same server
+		if (!reconnect_requested)
+			DefinitionSnapshot::clear();
+
 #ifdef HAVE_TOUCHSCREENGUI
 		delete g_touchscreengui;
 		g_touchscreengui = NULL;
@@ -283,6 +288,8 @@ bool ClientLauncher::run(GameStartData &start_data, const Settings &cmd_args)
 	g_menuclouds->drop();
 	g_menucloudsmgr->drop();
 
+	DefinitionSnapshot::clear();
+
 	return retval;
 }
 
@@ -304,6 +311,11 @@ void ClientLauncher::init_args(GameStartData &start_data, const Settings &cmd_ar
 
 	if (cmd_args.exists("name"))
 		start_data.name = cmd_args.get("name");
+
+	if (cmd_args.exists("benchmark")) {
+		skip_main_menu = true;
+		start_data.benchmark_script = cmd_args.get("benchmark");
+	}
 }
 
 bool ClientLauncher::init_engine()
@@ -425,10 +437,15 @@ bool ClientLauncher::launch_game(std::string &error_message,
 	}
 
 	if (start_data.address.empty()) {
-		error_message = "This ";
-		errorstream << error_message << std::endl;
-		return false;
+		if (!g_settings->getBool("synthetic_server")) {
+			error_message = "This ";
+			errorstream << error_message << std::endl;
+			return false;
+		}
 
+		// Load testing against the built-in synthetic server
+		if (start_data.name.empty())
+			start_data.name = "singleplayer";
 	}
 
 	start_data.world_path = start_data.world_spec.path;
@@ -358,6 +358,11 @@ void ClientMap::updateDrawList()
 				block->resetUsageTimer();
 				blocks_in_range_with_mesh++;
 
+				if (block->mesh_evicted) {
+					block->mesh_evicted = false;
+					m_client->addUpdateMeshTask(block->getPos());
+				}
+
 				// Frustum culling
 				// Only do coarse culling here, to account for fast camera movement.
 				// This is needed because this function is not called every frame.
@@ -680,6 +685,11 @@ void ClientMap::touchMapBlocks()
 			// Keep the block alive as long as it is in range.
 			block->resetUsageTimer();
 			blocks_in_range_with_mesh++;
+
+			if (block->mesh_evicted) {
+				block->mesh_evicted = false;
+				m_client->addUpdateMeshTask(block->getPos());
+			}
 		}
 	}
 
@@ -687,6 +697,51 @@ void ClientMap::touchMapBlocks()
 	g_profiler->avg("MapBlocks loaded [#]", blocks_loaded);
 }
 
+u64 ClientMap::evictMeshes(u64 bytes)
+{
+	ScopeProfiler sp(g_profiler, "CM::evictMeshes()", SPT_AVG);
+
+	const f32 range = m_control.wanted_range * BS;
+
+	// Meshes of blocks that are out of view range and not drawn
+	std::vector<std::pair<f32, MapBlock *>> candidates;
+	MapBlockVect sectorblocks;
+	for (auto &sector_it : m_sectors) {
+		sectorblocks.clear();
+		sector_it.second->getBlocks(sectorblocks);
+		for (MapBlock *block : sectorblocks) {
+			if (!block->mesh || block->refGet() > 0)
+				continue;
+			const v3f center = intToFloat(block->getPos() * MAP_BLOCKSIZE, BS) +
+					block->mesh->getBoundingSphereCenter();
+			const f32 d = center.getDistanceFrom(m_camera_position) -
+					block->mesh->getBoundingRadius();
+			if (m_control.range_all || d <= range)
+				continue;
+			candidates.emplace_back(d, block);
+		}
+	}
+
+	// Farthest first
+	std::sort(candidates.begin(), candidates.end(),
+		[] (const std::pair<f32, MapBlock *> &a, const std::pair<f32, MapBlock *> &b) {
+			return a.first > b.first;
+		});
+
+	u64 freed = 0;
+	for (auto &it : candidates) {
+		if (freed >= bytes)
+			break;
+		MapBlock *block = it.second;
+		freed += block->mesh->getMemoryUsage();
+		delete block->mesh;
+		block->mesh = nullptr;
+		block->mesh_evicted = true;
+	}
+	g_profiler->avg("CM::evictMeshes() freed [MiB]", freed / (1024.0f * 1024.0f));
+	return freed;
+}
+
 void ClientMap::renderMap(video::IVideoDriver* driver, s32 pass)
 {
 	bool is_transparent_pass = pass == scene::ESNRP_TRANSPARENT;
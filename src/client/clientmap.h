@@ -118,6 +118,13 @@ class ClientMap : public Map, public scene::ISceneNode
 	void updateDrawList();
 	// @brief Calculate statistics about the map and keep the blocks alive
 	void touchMapBlocks();
+	/*
+		Deletes meshes of blocks outside the view range, farthest first,
+		until at least the given amount of bytes is freed.
+		The meshes are made again once the blocks come into range.
+		Returns the amount of bytes freed.
+	*/
+	u64 evictMeshes(u64 bytes);
 	void updateDrawListShadow(v3f shadow_light_pos, v3f shadow_light_dir, float radius, float length);
 	// Returns true if draw list needs updating before drawing the next frame.
 	bool needsUpdateDrawList() { return m_needs_update_drawlist; }
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "httpfetch.h"
 #include "client.h"
 #include "filecache.h"
+#include "medialoader.h"
 #include "filesys.h"
 #include "log.h"
 #include "porting.h"
@@ -58,6 +59,8 @@ ClientMediaDownloader::~ClientMediaDownloader()
 	if (m_httpfetch_caller != HTTPFETCH_DISCARD)
 		httpfetch_caller_free(m_httpfetch_caller);
 
+	delete m_load_pool;
+
 	for (auto &file_it : m_files)
 		delete file_it.second;
 
@@ -71,6 +74,15 @@ bool ClientMediaDownloader::loadMedia(Client *client, const std::string &data,
 	return client->loadMedia(data, name);
 }
 
+float ClientMediaDownloader::getLoadRate() const
+{
+	if (m_loaded_count == 0)
+		return 0.0f;
+
+	u64 elapsed_ms = porting::getTimeMs() - m_load_start_ms;
+	return m_loaded_count * 1000.0f / MYMAX(elapsed_ms, 1);
+}
+
 void ClientMediaDownloader::addFile(const std::string &name, const std::string &sha1)
 {
 	assert(!m_initial_step_done); // pre-condition
@@ -101,6 +113,7 @@ void ClientMediaDownloader::addFile(const std::string &name, const std::string &
 
 	FileStatus *filestatus = new FileStatus();
 	filestatus->received = false;
+	filestatus->loading = false;
 	filestatus->sha1 = sha1;
 	filestatus->current_remote = -1;
 	m_files.insert(std::make_pair(name, filestatus));
@@ -110,9 +123,16 @@ void ClientMediaDownloader::addRemoteServer(const std::string &baseurl)
 {
 	assert(!m_initial_step_done);	// pre-condition
 
-	infostream << "Client: Ignoring remote server \""
-		<< baseurl << "\" because cURL support is not compiled in"
-		<< std::endl;
+	if (!g_settings->getBool("enable_remote_media_server"))
+		return;
+
+	infostream << "Client: Adding remote server \""
+		<< baseurl << "\" for media download" << std::endl;
+
+	RemoteServerStatus *remote = new RemoteServerStatus();
+	remote->baseurl = baseurl;
+	remote->active_count = 0;
+	m_remotes.push_back(remote);
 }
 
 void ClientMediaDownloader::step(Client *client)
@@ -122,6 +142,9 @@ void ClientMediaDownloader::step(Client *client)
 		m_initial_step_done = true;
 	}
 
+	if (m_load_pool)
+		processLoadResults(client);
+
 	// Remote media: check for completion of fetches
 	if (m_httpfetch_active) {
 		bool fetched_something = false;
@@ -135,54 +158,174 @@ void ClientMediaDownloader::step(Client *client)
 			if (fetch_result.request_id < m_remotes.size())
 				remoteHashSetReceived(fetch_result);
 			else
-				remoteMediaReceived(fetch_result, client);
+				remoteMediaReceived(fetch_result);
 		}
 
 		if (fetched_something)
 			startRemoteMediaTransfers();
+	}
 
-		// Did all remote transfers end and no new ones can be started?
-		// If so, request still missing files from the minetest server
-		// (Or report that we have all files.)
-		if (m_httpfetch_active == 0) {
-			if (m_uncached_received_count < m_uncached_count) {
-				infostream << "Client: Failed to remote-fetch "
-					<< (m_uncached_count-m_uncached_received_count)
-					<< " files. Requesting them"
-					<< " the usual way." << std::endl;
-			}
-			startConventionalTransfers(client);
+	// Did all remote transfers end and no new ones can be started?
+	// If so, request still missing files from the minetest server
+	// (Or report that we have all files.)
+	if (m_remote_fetching && m_httpfetch_active == 0 && m_remote_loading == 0) {
+		m_remote_fetching = false;
+		if (m_uncached_received_count < m_uncached_count) {
+			infostream << "Client: Failed to remote-fetch "
+				<< (m_uncached_count-m_uncached_received_count)
+				<< " files. Requesting them"
+				<< " the usual way." << std::endl;
 		}
+		startConventionalTransfers(client);
 	}
 }
 
 void ClientMediaDownloader::initialStep(Client *client)
 {
-	// Check media cache
 	m_uncached_count = m_files.size();
-	for (auto &file_it : m_files) {
-		const std::string &name = file_it.first;
-		FileStatus *filestatus = file_it.second;
-		const std::string &sha1 = filestatus->sha1;
+	m_load_start_ms = porting::getTimeMs();
 
-		if (tryLoadFromCache(name, sha1, client)) {
-			filestatus->received = true;
-			m_uncached_count--;
-		}
+	if (m_files.empty()) {
+		cacheCheckDone(client);
+		return;
 	}
 
+	// Check media cache. The files are read and verified by the load pool,
+	// see processLoadResults() for the rest.
+	m_load_pool = new MediaLoadPool(getMediaCacheDir());
+	for (auto &file_it : m_files) {
+		PreparedMedia *media = new PreparedMedia();
+		media->name = file_it.first;
+		media->sha1 = file_it.second->sha1;
+		media->from_cache = true;
+		m_load_pool->enqueue(media);
+		m_cache_pending++;
+	}
+}
+
+void ClientMediaDownloader::cacheCheckDone(Client *client)
+{
 	assert(m_uncached_received_count == 0);
 
+	infostream << "Client: Found " << (m_files.size() - m_uncached_count)
+		<< " of " << m_files.size() << " media files in the cache"
+		<< std::endl;
+
 	// Create the media cache dir if we are likely to write to it
 	if (m_uncached_count != 0)
 		createCacheDirs();
 
 	// If we found all files in the cache, report this fact to the server.
 	// If the server reported no remote servers, immediately start
-	// conventional transfers. Note: if cURL support is not compiled in,
-	// m_remotes is always empty, so "!USE_CURL" is redundant but may
-	// reduce the size of the compiled code
-	startConventionalTransfers(client);
+	// conventional transfers.
+	if (m_uncached_count == 0 || m_remotes.empty()) {
+		startConventionalTransfers(client);
+		return;
+	}
+
+	// Otherwise start off by requesting each server's sha1 set
+
+	// This is the first time we use httpfetch, so alloc a caller ID
+	m_httpfetch_caller = httpfetch_caller_alloc();
+	m_remote_fetching = true;
+
+	// Keep more requests queued than httpfetch has connections, so that
+	// the gaps between two calls of step() don't starve it. httpfetch
+	// still enforces curl_parallel_limit on its own.
+	m_httpfetch_active_limit = g_settings->getS32("curl_parallel_limit");
+	m_httpfetch_active_limit = MYMAX(m_httpfetch_active_limit, 84);
+
+	// Write a list of hashes that we need. This will be POSTed
+	// to the server using Content-Type: application/octet-stream
+	std::string required_hash_set = serializeRequiredHashSet();
+
+	for (u32 i = 0; i < m_remotes.size(); ++i) {
+		assert(m_httpfetch_next_id == i);
+
+		RemoteServerStatus *remote = m_remotes[i];
+		actionstream << "Client: Contacting remote server \""
+			<< remote->baseurl << "\"" << std::endl;
+
+		HTTPFetchRequest fetch_request;
+		fetch_request.url = remote->baseurl + MTHASHSET_FILE_NAME;
+		fetch_request.caller = m_httpfetch_caller;
+		fetch_request.request_id = m_httpfetch_next_id; // == i
+		fetch_request.method = HTTP_POST;
+		fetch_request.raw_data = required_hash_set;
+		fetch_request.extra_headers.emplace_back(
+			"Content-Type: application/octet-stream");
+
+		// Encapsulate possible IPv6 plain address in []
+		std::string addr = client->getAddressName();
+		if (addr.find(':', 0) != std::string::npos)
+			addr = '[' + addr + ']';
+		fetch_request.extra_headers.emplace_back(
+			std::string("Referer: minetest://") + addr + ":" +
+			std::to_string(client->getServerAddress().getPort()));
+
+		httpfetch_async(fetch_request);
+
+		m_httpfetch_active++;
+		m_httpfetch_next_id++;
+		m_outstanding_hash_sets++;
+	}
+}
+
+void ClientMediaDownloader::processLoadResults(Client *client)
+{
+	// What is left is loaded in the next frames
+	while (!client->getFrameScheduler().expired()) {
+		PreparedMedia *media = m_load_pool->getResult();
+		if (!media)
+			break;
+		const char *cached_or_received = media->from_cache ? "cached" : "received";
+		std::string sha1_hex = hex_encode(media->sha1);
+
+		bool success = media->ok && client->loadMedia(*media);
+		if (success) {
+			m_loaded_count++;
+			verbosestream << "Client: "
+				<< "Loaded " << cached_or_received << " media: "
+				<< sha1_hex << " \"" << media->name << "\""
+				<< std::endl;
+		} else if (!media->from_cache || media->ok) {
+			// Cache misses are expected and not worth logging
+			infostream << "Client: "
+				<< "Failed to load " << cached_or_received << " media: "
+				<< sha1_hex << " \"" << media->name << "\""
+				<< std::endl;
+		}
+
+		if (media->from_cache) {
+			if (success) {
+				m_files[media->name]->received = true;
+				m_uncached_count--;
+			}
+			if (--m_cache_pending == 0)
+				cacheCheckDone(client);
+		} else {
+			FileStatus *filestatus = m_files[media->name];
+			if (success && m_write_to_cache)
+				m_media_cache.update(sha1_hex, media->data);
+			if (filestatus->loading) {
+				// Fetched from a remote server
+				filestatus->loading = false;
+				m_remote_loading--;
+				if (success) {
+					filestatus->received = true;
+					assert(m_uncached_received_count < m_uncached_count);
+					m_uncached_received_count++;
+				} else {
+					// Try another server
+					startRemoteMediaTransfers();
+				}
+			} else {
+				m_load_pending--;
+			}
+		}
+
+		delete media;
+	}
 }
 
 void ClientMediaDownloader::remoteHashSetReceived(
@@ -222,13 +365,12 @@ void ClientMediaDownloader::remoteHashSetReceived(
 }
 
 void ClientMediaDownloader::remoteMediaReceived(
-		const HTTPFetchResult &fetch_result,
-		Client *client)
+		HTTPFetchResult &fetch_result)
 {
 	// Some remote server sent us a file.
 	// -> decrement number of active fetches
-	// -> mark file as received if fetch succeeded
-	// -> try to load media
+	// -> hand the file to the load pool if fetch succeeded; it is
+	//    marked as received once it has been verified and loaded
 
 	std::string name;
 	{
@@ -251,14 +393,14 @@ void ClientMediaDownloader::remoteMediaReceived(
 
 	// If fetch succeeded, try to load media file
 
-	if (fetch_result.succeeded) {
-		bool success = checkAndLoad(name, filestatus->sha1,
-				fetch_result.data, false, client);
-		if (success) {
-			filestatus->received = true;
-			assert(m_uncached_received_count < m_uncached_count);
-			m_uncached_received_count++;
-		}
+	if (fetch_result.succeeded && fetch_result.response_code == 200) {
+		PreparedMedia *media = new PreparedMedia();
+		media->name = name;
+		media->sha1 = filestatus->sha1;
+		media->data = std::move(fetch_result.data);
+		m_load_pool->enqueue(media);
+		filestatus->loading = true;
+		m_remote_loading++;
 	}
 }
 
@@ -311,7 +453,8 @@ void ClientMediaDownloader::startRemoteMediaTransfers()
 		const std::string &name = files_iter->first;
 		FileStatus *filestatus = files_iter->second;
 
-		if (!filestatus->received && filestatus->current_remote < 0) {
+		if (!filestatus->received && !filestatus->loading &&
+				filestatus->current_remote < 0) {
 			// File has not been received yet and is not currently
 			// being transferred. Choose a server for it.
 			s32 remote_id = selectRemoteServer(filestatus);
@@ -347,7 +490,7 @@ void ClientMediaDownloader::startRemoteMediaTransfers()
 		}
 
 		if (filestatus->received ||
-				(filestatus->current_remote < 0 &&
+				(filestatus->current_remote < 0 && !filestatus->loading &&
 				 !m_outstanding_hash_sets)) {
 			// If we arrive here, we conclusively know that we
 			// won't fetch this file from a remote server in the
@@ -410,9 +553,14 @@ bool ClientMediaDownloader::conventionalTransferDone(
 	assert(m_uncached_received_count < m_uncached_count);
 	m_uncached_received_count++;
 
-	// Check that received file matches announced checksum
-	// If so, load it
-	checkAndLoad(name, filestatus->sha1, data, false, client);
+	// Let the load pool check that the received file matches the
+	// announced checksum
+	PreparedMedia *media = new PreparedMedia();
+	media->name = name;
+	media->sha1 = filestatus->sha1;
+	media->data = data;
+	m_load_pool->enqueue(media);
+	m_load_pending++;
 
 	return true;
 }
@@ -441,12 +589,12 @@ void IClientMediaDownloader::createCacheDirs()
 bool IClientMediaDownloader::tryLoadFromCache(const std::string &name,
 	const std::string &sha1, Client *client)
 {
-	std::ostringstream tmp_os(std::ios_base::binary);
-	bool found_in_cache = m_media_cache.load(hex_encode(sha1), tmp_os);
+	std::string data;
+	bool found_in_cache = m_media_cache.load(hex_encode(sha1), data);
 
 	// If found in cache, try to load it from there
 	if (found_in_cache)
-		return checkAndLoad(name, sha1, tmp_os.str(), true, client);
+		return checkAndLoad(name, sha1, data, true, client);
 
 	return false;
 }
@@ -456,21 +604,21 @@ bool IClientMediaDownloader::checkAndLoad(
 		const std::string &data, bool is_from_cache, Client *client)
 {
 	const char *cached_or_received = is_from_cache ? "cached" : "received";
-	//const char *cached_or_received_uc = is_from_cache ? "Cached" : "Received";
+	const char *cached_or_received_uc = is_from_cache ? "Cached" : "Received";
 	std::string sha1_hex = hex_encode(sha1);
 
 	// Compute actual checksum of data
-	/*std::string data_sha1;
+	std::string data_sha1;
 	{
 		SHA1 data_sha1_calculator;
 		data_sha1_calculator.addBytes(data.c_str(), data.size());
 		unsigned char *data_tmpdigest = data_sha1_calculator.getDigest();
 		data_sha1.assign((char*) data_tmpdigest, 20);
 		free(data_tmpdigest);
-	}*/
+	}
 
 	// Check that received file matches announced checksum
-	/*if (data_sha1 != sha1) {
+	if (data_sha1 != sha1) {
 		std::string data_sha1_hex = hex_encode(data_sha1);
 		infostream << "Client: "
 			<< cached_or_received_uc << " media file "
@@ -478,7 +626,7 @@ bool IClientMediaDownloader::checkAndLoad(
 			<< "mismatches actual checksum " << data_sha1_hex
 			<< std::endl;
 		return false;
-	}*/
+	}
 
 	// Checksum is ok, try loading the file
 	bool success = loadMedia(client, data, name);
@@ -601,6 +749,9 @@ void SingleMediaDownloader::addFile(const std::string &name, const std::string &
 void SingleMediaDownloader::addRemoteServer(const std::string &baseurl)
 {
 	assert(m_stage == STAGE_INIT); // pre-condition
+
+	if (g_settings->getBool("enable_remote_media_server"))
+		m_remotes.emplace_back(baseurl);
 }
 
 void SingleMediaDownloader::step(Client *client)
@@ -642,7 +793,14 @@ void SingleMediaDownloader::initialStep(Client *client)
 
 	// If the server reported no remote servers, immediately fall back to
 	// conventional transfer.
-	startConventionalTransfer(client);
+	if (m_remotes.empty()) {
+		startConventionalTransfer(client);
+	} else {
+		// Otherwise start by requesting the file from the first remote media server
+		m_httpfetch_caller = httpfetch_caller_alloc();
+		m_current_remote = 0;
+		startRemoteMediaTransfer();
+	}
 }
 
 void SingleMediaDownloader::remoteMediaReceived(
@@ -29,6 +29,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <unordered_map>
 
 class Client;
+class MediaLoadPool;
 struct HTTPFetchResult;
 
 #define MTHASHSET_FILE_SIGNATURE 0x4d544853 // 'MTHS'
@@ -53,7 +54,7 @@ class IClientMediaDownloader
 	// Add a file to the list of required file (but don't fetch it yet)
 	virtual void addFile(const std::string &name, const std::string &sha1) = 0;
 
-	// Add a remote server to the list; ignored if not built with cURL
+	// Add a remote server to the list; ignored if remote media is disabled
 	virtual void addRemoteServer(const std::string &baseurl) = 0;
 
 	// Steps the media downloader:
@@ -113,10 +114,14 @@ class ClientMediaDownloader : public IClientMediaDownloader
 	}
 
 	bool isDone() const override {
-		return m_initial_step_done &&
-			m_uncached_received_count == m_uncached_count;
+		return m_initial_step_done && m_cache_pending == 0 &&
+			m_uncached_received_count == m_uncached_count &&
+			m_load_pending == 0;
 	}
 
+	// Number of media files loaded per second so far
+	float getLoadRate() const;
+
 	void addFile(const std::string &name, const std::string &sha1) override;
 
 	void addRemoteServer(const std::string &baseurl) override;
@@ -135,6 +140,8 @@ class ClientMediaDownloader : public IClientMediaDownloader
 private:
 	struct FileStatus {
 		bool received;
+		// Fetched from a remote server and waiting in m_load_pool
+		bool loading;
 		std::string sha1;
 		s32 current_remote;
 		std::vector<s32> available_remotes;
@@ -146,9 +153,10 @@ class ClientMediaDownloader : public IClientMediaDownloader
 	};
 
 	void initialStep(Client *client);
+	void cacheCheckDone(Client *client);
+	void processLoadResults(Client *client);
 	void remoteHashSetReceived(const HTTPFetchResult &fetch_result);
-	void remoteMediaReceived(const HTTPFetchResult &fetch_result,
-			Client *client);
+	void remoteMediaReceived(HTTPFetchResult &fetch_result);
 	s32 selectRemoteServer(FileStatus *filestatus);
 	void startRemoteMediaTransfers();
 	void startConventionalTransfers(Client *client);
@@ -173,12 +181,29 @@ class ClientMediaDownloader : public IClientMediaDownloader
 	// Number of media files that have been received
 	s32 m_uncached_received_count = 0;
 
+	// Reads and verifies cached and received files off the main thread
+	MediaLoadPool *m_load_pool = nullptr;
+
+	// Number of files still being looked up in the media cache
+	s32 m_cache_pending = 0;
+
+	// Number of received files handed to m_load_pool but not loaded yet
+	s32 m_load_pending = 0;
+
+	// Number of files loaded into the client, and when loading started
+	u32 m_loaded_count = 0;
+	u64 m_load_start_ms = 0;
+
 	// Status of remote transfers
 	u64 m_httpfetch_caller;
 	u64 m_httpfetch_next_id = 0;
 	s32 m_httpfetch_active = 0;
 	s32 m_httpfetch_active_limit = 0;
 	s32 m_outstanding_hash_sets = 0;
+	// Remote servers are in use and conventional transfers haven't started
+	bool m_remote_fetching = false;
+	// Number of remote files waiting in m_load_pool
+	s32 m_remote_loading = 0;
 	std::unordered_map<u64, std::string> m_remote_file_transfers;
 
 	// All files up to this name have either been received from a
@@ -629,22 +629,14 @@ void GenericCAO::addToScene(ITextureSource *tsrc, scene::ISceneManager *smgr)
 		grabMatrixNode();
 		scene::IAnimatedMesh *mesh = m_client->getMesh(m_prop.mesh, true);
 		if (mesh) {
-			if (!checkMeshNormals(mesh)) {
-				infostream << "GenericCAO: recalculating normals for mesh "
-					<< m_prop.mesh << std::endl;
-				m_smgr->getMeshManipulator()->
-						recalculateNormals(mesh, true, false);
-			}
-
+			// Normals and vertex colors of the shared mesh were already
+			// prepared by Client::getMesh()
 			m_animated_meshnode = m_smgr->addAnimatedMeshSceneNode(mesh, m_matrixnode);
 			m_animated_meshnode->grab();
 			mesh->drop(); // The scene node took hold of it
 			m_animated_meshnode->animateJoints(); // Needed for some animations
 			m_animated_meshnode->setScale(m_prop.visual_size);
 
-			// set vertex colors to ensure alpha is set
-			setMeshColor(m_animated_meshnode->getMesh(), video::SColor(0xFFFFFFFF));
-
 			setAnimatedMeshColor(m_animated_meshnode, video::SColor(0xFFFFFFFF));
 
 			setSceneNodeMaterials(m_animated_meshnode);
@@ -918,11 +910,13 @@ void GenericCAO::step(float dtime, ClientEnvironment *env)
 			bool allow_update = false;
 
 			// increase speed if using fast or flying fast
-			if((g_settings->getBool("fast_move") &&
+			static const SettingHandle<bool> fast_move("fast_move");
+			static const SettingHandle<bool> free_move("free_move");
+			if((fast_move &&
 					m_client->checkLocalPrivilege("fast")) &&
 					(controls.aux1 ||
 					(!player->touching_ground &&
-					g_settings->getBool("free_move") &&
+					free_move &&
 					m_client->checkLocalPrivilege("fly"))))
 					new_speed *= 1.5;
 			// slowdown speed if sneaking
@@ -1114,11 +1108,44 @@ void GenericCAO::step(float dtime, ClientEnvironment *env)
 		if (m_matrixnode)
 			updatePositionRecursive(m_matrixnode);
 		m_animated_meshnode->updateAbsolutePosition();
-		m_animated_meshnode->animateJoints();
-		updateBonePosition();
+
+		if (usesSharedPose()) {
+			// All instances of a mesh share one skinned mesh, which is only
+			// re-skinned when the frame changes. Deriving the frame from the
+			// frame time puts every distant instance playing the same loop
+			// on the same frame, so the mesh is skinned once for all of them.
+			// Nothing is attached to the joints, so they need no update.
+			const f32 length = m_animation_range.Y - m_animation_range.X;
+			f32 phase = std::fmod(m_env->getFrameTime() / 1000.0 *
+					m_animation_speed, length);
+			if (phase < 0)
+				phase += length;
+			m_animated_meshnode->setCurrentFrame(m_animation_range.X + phase);
+		} else {
+			m_animated_meshnode->animateJoints();
+			updateBonePosition();
+		}
 	}
 }
 
+bool GenericCAO::usesSharedPose() const
+{
+	static const SettingHandle<float> sharing_distance(
+			"entity_animation_sharing_distance");
+
+	if (sharing_distance <= 0 || m_is_local_player)
+		return false;
+
+	// Anything that needs the per-instance joint state
+	if (!m_animation_loop || m_animation_blend > 0 ||
+			m_animation_range.Y <= m_animation_range.X ||
+			!m_bone_position.empty() || !m_attachment_child_ids.empty())
+		return false;
+
+	v3f camera_pos = m_client->getCamera()->getPosition();
+	return camera_pos.getDistanceFrom(m_position) > sharing_distance * BS;
+}
+
 void GenericCAO::updateTexturePos()
 {
 	if(m_spritenode)
@@ -1193,7 +1220,8 @@ void GenericCAO::updateTextures(std::string mod)
 {
 	ITextureSource *tsrc = m_client->tsrc();
 
-	bool use_anisotropic_filter = g_settings->getBool("anisotropic_filter");
+	static const SettingHandle<bool> anisotropic_filter("anisotropic_filter");
+	bool use_anisotropic_filter = anisotropic_filter;
 
 	m_previous_texture_modifier = m_current_texture_modifier;
 	m_current_texture_modifier = mod;
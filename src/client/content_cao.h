@@ -266,6 +266,10 @@ class GenericCAO : public ClientActiveObject
 
 	void updateAnimationSpeed();
 
+	// Whether this entity plays its animation in step with all other
+	// distant instances of its mesh, see step()
+	bool usesSharedPose() const;
+
 	void updateBonePosition();
 
 	void processMessage(const std::string &data);
@@ -0,0 +1,124 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "defsnapshot.h"
+#include "itemdef.h"
+#include "nodedef.h"
+#include <memory>
+#include <set>
+
+namespace DefinitionSnapshot
+{
+
+struct Snapshot
+{
+	// The data is compared as a whole, which is cheaper than hashing it
+	std::string compressed;
+	u16 protocol_version = 0;
+	size_t data_size = 0;
+
+	bool matches(const std::string &other, u16 other_protocol_version) const
+	{
+		return protocol_version == other_protocol_version &&
+				compressed == other;
+	}
+};
+
+static Snapshot s_nodedef_snapshot;
+static std::unique_ptr<NodeDefManager> s_nodedef;
+
+static Snapshot s_itemdef_snapshot;
+static std::unique_ptr<IWritableItemDefManager> s_itemdef;
+
+static void copy_item_defs(const IItemDefManager *from, IWritableItemDefManager *to)
+{
+	to->clear();
+
+	std::set<std::string> names;
+	from->getAll(names);
+	for (const std::string &name : names) {
+		const std::string &convert_to = from->getAlias(name);
+		if (convert_to != name)
+			to->registerAlias(name, convert_to);
+		else
+			to->registerItem(from->get(name));
+	}
+}
+
+bool restoreNodeDefs(const std::string &compressed, u16 protocol_version,
+		NodeDefManager *ndef)
+{
+	if (!s_nodedef || !s_nodedef_snapshot.matches(compressed, protocol_version))
+		return false;
+
+	ndef->copyDefinitionsFrom(*s_nodedef);
+	return true;
+}
+
+void storeNodeDefs(const std::string &compressed, u16 protocol_version,
+		const NodeDefManager *ndef, size_t data_size)
+{
+	if (!s_nodedef)
+		s_nodedef.reset(createNodeDefManager());
+	s_nodedef->copyDefinitionsFrom(*ndef);
+	s_nodedef_snapshot.compressed = compressed;
+	s_nodedef_snapshot.protocol_version = protocol_version;
+	s_nodedef_snapshot.data_size = data_size;
+}
+
+bool restoreItemDefs(const std::string &compressed, u16 protocol_version,
+		IWritableItemDefManager *idef)
+{
+	if (!s_itemdef || !s_itemdef_snapshot.matches(compressed, protocol_version))
+		return false;
+
+	copy_item_defs(s_itemdef.get(), idef);
+	return true;
+}
+
+void storeItemDefs(const std::string &compressed, u16 protocol_version,
+		const IItemDefManager *idef, size_t data_size)
+{
+	if (!s_itemdef)
+		s_itemdef.reset(createItemDefManager());
+	copy_item_defs(idef, s_itemdef.get());
+	s_itemdef_snapshot.compressed = compressed;
+	s_itemdef_snapshot.protocol_version = protocol_version;
+	s_itemdef_snapshot.data_size = data_size;
+}
+
+u64 getMemoryUsage()
+{
+	u64 bytes = 0;
+	if (s_nodedef)
+		bytes += s_nodedef_snapshot.compressed.size() + s_nodedef_snapshot.data_size;
+	if (s_itemdef)
+		bytes += s_itemdef_snapshot.compressed.size() + s_itemdef_snapshot.data_size;
+	return bytes;
+}
+
+void clear()
+{
+	s_nodedef.reset();
+	s_nodedef_snapshot = Snapshot();
+	s_itemdef.reset();
+	s_itemdef_snapshot = Snapshot();
+}
+
+}
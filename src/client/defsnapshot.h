@@ -0,0 +1,63 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include <string>
+
+class NodeDefManager;
+class IItemDefManager;
+class IWritableItemDefManager;
+
+/*
+	Keeps the node and item definitions of the last server joined by this
+	process. When a server sends exactly the same definitions again, e.g.
+	on reconnect, they are copied from here instead of being decompressed
+	and deserialized again.
+
+	Nothing is kept on disk across launches: a cached copy could only stand
+	in for the decompressed data, and inflating it is a small part of the
+	cost next to parsing it (see the "definitions" benchmark).
+
+	Must only be used from the main thread.
+*/
+namespace DefinitionSnapshot
+{
+	// Fills ndef and returns true if `compressed` matches the stored data
+	bool restoreNodeDefs(const std::string &compressed, u16 protocol_version,
+			NodeDefManager *ndef);
+	// Stores a copy of ndef, which must not have textures loaded yet.
+	// data_size is the size of the decompressed data.
+	void storeNodeDefs(const std::string &compressed, u16 protocol_version,
+			const NodeDefManager *ndef, size_t data_size);
+
+	// Fills idef and returns true if `compressed` matches the stored data
+	bool restoreItemDefs(const std::string &compressed, u16 protocol_version,
+			IWritableItemDefManager *idef);
+	// Stores a copy of idef, data_size as above
+	void storeItemDefs(const std::string &compressed, u16 protocol_version,
+			const IItemDefManager *idef, size_t data_size);
+
+	// Approximate, the decompressed data size stands in for the copies
+	u64 getMemoryUsage();
+
+	// Frees the stored definitions
+	void clear();
+}
@@ -28,9 +28,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <fstream>
 #include <cstdlib>
 
-bool FileCache::loadByPath(const std::string &path, std::ostream &os)
+bool FileCache::loadByPath(const std::string &path, std::string &data)
 {
-	std::ifstream fis(path.c_str(), std::ios_base::binary);
+	std::ifstream fis(path.c_str(), std::ios_base::binary | std::ios_base::ate);
 
 	if(!fis.good()){
 		verbosestream<<"FileCache: File not found in cache: "
@@ -38,25 +38,29 @@ bool FileCache::loadByPath(const std::string &path, std::ostream &os)
 		return false;
 	}
 
-	bool bad = false;
-	for(;;){
-		char buf[1024];
-		fis.read(buf, 1024);
-		std::streamsize len = fis.gcount();
-		os.write(buf, len);
-		if(fis.eof())
-			break;
-		if(!fis.good()){
-			bad = true;
-			break;
-		}
-	}
-	if(bad){
+	std::streamoff size = fis.tellg();
+	data.resize(size);
+	fis.seekg(0);
+	if (size > 0)
+		fis.read(&data[0], size);
+
+	if(fis.fail()){
 		errorstream<<"FileCache: Failed to read file from cache: \""
 				<<path<<"\""<<std::endl;
+		return false;
 	}
 
-	return !bad;
+	return true;
+}
+
+bool FileCache::loadByPath(const std::string &path, std::ostream &os)
+{
+	std::string data;
+	if (!loadByPath(path, data))
+		return false;
+
+	os.write(data.c_str(), data.size());
+	return true;
 }
 
 bool FileCache::updateByPath(const std::string &path, const std::string &data)
@@ -89,6 +93,12 @@ bool FileCache::load(const std::string &name, std::ostream &os)
 	return loadByPath(path, os);
 }
 
+bool FileCache::load(const std::string &name, std::string &data) const
+{
+	std::string path = m_dir + DIR_DELIM + name;
+	return loadByPath(path, data);
+}
+
 bool FileCache::exists(const std::string &name)
 {
 	std::string path = m_dir + DIR_DELIM + name;
@@ -33,11 +33,14 @@ class FileCache
 
 	bool update(const std::string &name, const std::string &data);
 	bool load(const std::string &name, std::ostream &os);
+	// Reads the whole file with a single read, safe to call from any thread
+	bool load(const std::string &name, std::string &data) const;
 	bool exists(const std::string &name);
 
 private:
 	std::string m_dir;
 
+	static bool loadByPath(const std::string &path, std::string &data);
 	bool loadByPath(const std::string &path, std::ostream &os);
 	bool updateByPath(const std::string &path, const std::string &data);
 };
@@ -0,0 +1,239 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "flythrough.h"
+#include "constants.h"
+#include "convert_json.h"
+#include "filesys.h"
+#include "log.h"
+#include "profiler.h"
+#include "util/string.h"
+#include <json/json.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+std::unique_ptr<FlyThroughBenchmark> FlyThroughBenchmark::load(
+		const std::string &path, std::string &error)
+{
+	std::ifstream is(path);
+	if (!is.good()) {
+		error = "Cannot open benchmark script \"" + path + "\"";
+		return nullptr;
+	}
+
+	std::unique_ptr<FlyThroughBenchmark> benchmark(new FlyThroughBenchmark());
+	benchmark->m_output_path = path + ".json";
+
+	std::string line;
+	for (u32 line_num = 1; std::getline(is, line); line_num++) {
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty())
+			continue;
+
+		std::istringstream ls(line);
+		std::string command;
+		ls >> command;
+
+		Step step = {};
+		bool ok;
+		if (command == "output") {
+			std::getline(ls, benchmark->m_output_path);
+			benchmark->m_output_path = trim(benchmark->m_output_path);
+			ok = !benchmark->m_output_path.empty();
+		} else if (command == "goto" || command == "fly") {
+			step.command = command == "goto" ? Command::Goto : Command::Fly;
+			ls >> step.position.X >> step.position.Y >> step.position.Z
+				>> step.yaw >> step.pitch;
+			if (step.command == Command::Fly)
+				ls >> step.duration;
+			step.position *= BS;
+			ok = !ls.fail() && step.duration >= 0.0f;
+		} else if (command == "wait" || command == "warmup") {
+			step.command = command == "wait" ? Command::Wait : Command::Warmup;
+			ls >> step.duration;
+			ok = !ls.fail() && step.duration >= 0.0f;
+		} else {
+			ok = false;
+		}
+
+		if (!ok) {
+			error = "Invalid benchmark script line " + std::to_string(line_num) +
+					": " + line;
+			return nullptr;
+		}
+		if (command != "output")
+			benchmark->m_steps.push_back(step);
+	}
+
+	if (benchmark->m_steps.empty()) {
+		error = "Benchmark script \"" + path + "\" has no steps";
+		return nullptr;
+	}
+
+	// Start at the first position given
+	for (const Step &step : benchmark->m_steps) {
+		if (step.command == Command::Goto || step.command == Command::Fly) {
+			benchmark->m_position = benchmark->m_from_position = step.position;
+			benchmark->m_yaw = benchmark->m_from_yaw = step.yaw;
+			benchmark->m_pitch = benchmark->m_from_pitch = step.pitch;
+			break;
+		}
+	}
+	return benchmark;
+}
+
+bool FlyThroughBenchmark::measuring() const
+{
+	return !finished() && m_steps[m_current].command != Command::Warmup;
+}
+
+void FlyThroughBenchmark::nextStep()
+{
+	const Step &step = m_steps[m_current];
+	if (step.command == Command::Goto || step.command == Command::Fly) {
+		m_position = step.position;
+		m_yaw = step.yaw;
+		m_pitch = step.pitch;
+	}
+	m_from_position = m_position;
+	m_from_yaw = m_yaw;
+	m_from_pitch = m_pitch;
+	m_step_time = 0.0f;
+	m_current++;
+}
+
+void FlyThroughBenchmark::step(f32 dtime)
+{
+	m_step_time += dtime;
+
+	while (!finished()) {
+		const Step &step = m_steps[m_current];
+		if (step.command != Command::Goto && m_step_time < step.duration) {
+			if (step.command == Command::Fly) {
+				const f32 t = m_step_time / step.duration;
+				m_position = m_from_position + (step.position - m_from_position) * t;
+				m_yaw = m_from_yaw + (step.yaw - m_from_yaw) * t;
+				m_pitch = m_from_pitch + (step.pitch - m_from_pitch) * t;
+			}
+			return;
+		}
+		nextStep();
+	}
+}
+
+void FlyThroughBenchmark::recordFrame(f32 dtime, u64 busy_us,
+		u64 mesh_update_count)
+{
+	if (m_first_frame) {
+		m_first_frame = false;
+		m_last_mesh_update_count = mesh_update_count;
+	}
+	const u64 mesh_updates = mesh_update_count - m_last_mesh_update_count;
+	m_last_mesh_update_count = mesh_update_count;
+
+	if (!measuring())
+		return;
+
+	m_measured_since_sample = true;
+	m_frame_ms.push_back(dtime * 1000.0f);
+	m_busy_ms.push_back(busy_us / 1000.0f);
+	m_measured_time += dtime;
+	m_mesh_updates += mesh_updates;
+}
+
+void FlyThroughBenchmark::sampleProfiler()
+{
+	if (!m_measured_since_sample)
+		return;
+	m_measured_since_sample = false;
+
+	Profiler::GraphValues values;
+	g_profiler->getPage(values, 1, 1);
+	for (const auto &it : values) {
+		// Entries not updated since the last clear are zero, skip them
+		if (it.second == 0.0f)
+			continue;
+		auto &value = m_profiler_values[it.first];
+		value.first += it.second;
+		value.second++;
+	}
+}
+
+// Nearest-rank percentiles of the given frame times
+static Json::Value frame_time_stats(std::vector<f32> times)
+{
+	Json::Value result(Json::objectValue);
+	if (times.empty())
+		return result;
+
+	std::sort(times.begin(), times.end());
+	auto percentile = [&] (f32 p) {
+		size_t rank = (size_t)std::ceil(p * times.size());
+		return times[std::max<size_t>(rank, 1) - 1];
+	};
+	f64 sum = 0;
+	for (f32 t : times)
+		sum += t;
+
+	result["p50"] = percentile(0.50f);
+	result["p95"] = percentile(0.95f);
+	result["p99"] = percentile(0.99f);
+	result["max"] = times.back();
+	result["mean"] = sum / times.size();
+	return result;
+}
+
+bool FlyThroughBenchmark::writeResults()
+{
+	// The values since the last clear are not sampled yet
+	sampleProfiler();
+
+	Json::Value root(Json::objectValue);
+	root["frames"] = (Json::UInt64)m_frame_ms.size();
+	root["duration_s"] = m_measured_time;
+	root["frame_time_ms"] = frame_time_stats(m_frame_ms);
+	root["busy_time_ms"] = frame_time_stats(m_busy_ms);
+	root["mesh_updates_per_s"] = m_measured_time > 0.0f ?
+			m_mesh_updates / m_measured_time : 0.0;
+
+	// Mean over the profiler intervals of each value
+	Json::Value profiler(Json::objectValue);
+	f64 drawcalls = 0;
+	for (const auto &it : m_profiler_values) {
+		const f64 mean = it.second.first / it.second.second;
+		profiler[it.first] = mean;
+		if (str_ends_with(it.first, "drawcalls [#]"))
+			drawcalls += mean;
+	}
+	root["drawcalls_per_frame"] = drawcalls;
+	root["profiler"] = profiler;
+
+	if (!fs::safeWriteToFile(m_output_path, fastWriteJson(root))) {
+		errorstream << "FlyThroughBenchmark: Cannot write \"" << m_output_path
+				<< "\"" << std::endl;
+		return false;
+	}
+
+	actionstream << "FlyThroughBenchmark: " << m_frame_ms.size()
+			<< " frames, results written to \"" << m_output_path << "\""
+			<< std::endl;
+	return true;
+}
@@ -0,0 +1,106 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes_bloated.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+	Scripted camera path for the --benchmark mode.
+
+	The script is a text file with one command per line, '#' starts a
+	comment. Positions are in nodes, angles in degrees.
+
+		output <file>                            Where to write the results
+		goto <x> <y> <z> <yaw> <pitch>           Jump to a position
+		fly <x> <y> <z> <yaw> <pitch> <seconds>  Move there in a straight line
+		wait <seconds>                           Stay at the current position
+		warmup <seconds>                         Like wait, but not measured
+
+	Frame times, mesh updates and the g_profiler values are collected while
+	the script runs and written to a JSON file when it ends. Without an
+	output command, the file is the script path with ".json" appended.
+*/
+class FlyThroughBenchmark
+{
+public:
+	// Returns nullptr and sets error if the script cannot be read
+	static std::unique_ptr<FlyThroughBenchmark> load(const std::string &path,
+			std::string &error);
+
+	// Moves along the path
+	void step(f32 dtime);
+	bool finished() const { return m_current >= m_steps.size(); }
+
+	// Camera position (in BS units) and orientation for this frame
+	const v3f &getPosition() const { return m_position; }
+	f32 getYaw() const { return m_yaw; }
+	f32 getPitch() const { return m_pitch; }
+
+	// Records one frame. busy_us excludes the time slept by the FPS limit,
+	// mesh_update_count is the total number of meshes received so far.
+	void recordFrame(f32 dtime, u64 busy_us, u64 mesh_update_count);
+
+	// Must be called before g_profiler is cleared. Only intervals with
+	// measured frames are taken into account.
+	void sampleProfiler();
+
+	bool writeResults();
+
+private:
+	enum class Command { Goto, Fly, Wait, Warmup };
+
+	struct Step {
+		Command command;
+		v3f position;
+		f32 yaw, pitch;
+		f32 duration;
+	};
+
+	FlyThroughBenchmark() = default;
+
+	bool measuring() const;
+	void nextStep();
+
+	std::vector<Step> m_steps;
+	size_t m_current = 0;
+	f32 m_step_time = 0.0f;
+	std::string m_output_path;
+
+	// Pose at the start of the current step, and the current one
+	v3f m_from_position;
+	f32 m_from_yaw = 0.0f, m_from_pitch = 0.0f;
+	v3f m_position;
+	f32 m_yaw = 0.0f, m_pitch = 0.0f;
+
+	std::vector<f32> m_frame_ms;
+	std::vector<f32> m_busy_ms;
+	f32 m_measured_time = 0.0f;
+	bool m_measured_since_sample = false;
+	bool m_first_frame = true;
+	u64 m_last_mesh_update_count = 0;
+	u64 m_mesh_updates = 0;
+
+	// Sum and count of the per-interval profiler values
+	std::map<std::string, std::pair<f64, u32>> m_profiler_values;
+};
@@ -0,0 +1,130 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include "framescheduler.h"
+#include "porting.h"
+#include "profiler.h"
+#include "debug.h"
+#include <algorithm>
+
+// Limit of the share multiplier of a starving task
+#define FRAME_SCHEDULER_MAX_BOOST 4
+// Budget a starving task without a maximum gets even when the frame is late
+#define FRAME_SCHEDULER_STARVED_MIN_US 10000
+
+u32 FrameScheduler::addTask(const std::string &name, u32 priority,
+		u64 min_us, u64 max_us)
+{
+	Task task;
+	task.name = name;
+	task.priority = priority;
+	task.min_us = min_us;
+	task.max_us = max_us;
+	m_tasks.push_back(task);
+	return m_tasks.size() - 1;
+}
+
+void FrameScheduler::beginFrame(u64 frame_us, u64 render_us)
+{
+	m_render_us_avg = m_render_us_avg * 0.9f + render_us * 0.1f;
+	const u64 reserved_us = std::min<u64>(m_render_us_avg, frame_us);
+	m_deadline_us = porting::getTimeUs() + frame_us - reserved_us;
+
+	for (Task &task : m_tasks)
+		task.ran = false;
+}
+
+u32 FrameScheduler::getWeight(const Task &task) const
+{
+	return task.priority *
+			(1 + std::min<u32>(task.starved_frames, FRAME_SCHEDULER_MAX_BOOST - 1));
+}
+
+u64 FrameScheduler::getMinimum(const Task &task) const
+{
+	if (task.starved_frames == 0)
+		return task.min_us;
+	/*
+		When rendering takes the whole frame (GPU bound), there is no time
+		left to share and every task would only get its minimum. A task
+		that keeps running out of time, such as the packet backlog while
+		joining, gets its maximum instead until it has caught up.
+	*/
+	return task.max_us > 0 ? task.max_us :
+			std::max<u64>(task.min_us, FRAME_SCHEDULER_STARVED_MIN_US);
+}
+
+void FrameScheduler::startTask(u32 id)
+{
+	sanity_check(!m_current && id < m_tasks.size());
+	m_current = &m_tasks[id];
+	m_start_us = porting::getTimeUs();
+	m_starved = false;
+
+	Task &task = *m_current;
+	if (task.priority == 0) {
+		m_budget_us = 0;
+	} else if (m_deadline_us == 0) {
+		m_budget_us = task.max_us;
+	} else {
+		// Share the time left with the tasks that did not run yet
+		u32 weight_left = getWeight(task);
+		for (const Task &other : m_tasks) {
+			if (!other.ran && &other != &task)
+				weight_left += getWeight(other);
+		}
+		const u64 time_left = m_deadline_us > m_start_us ?
+				m_deadline_us - m_start_us : 0;
+		m_budget_us = std::max(time_left * getWeight(task) / weight_left,
+				getMinimum(task));
+		if (task.max_us > 0)
+			m_budget_us = std::min(m_budget_us, task.max_us);
+	}
+	task.ran = true;
+}
+
+bool FrameScheduler::expired()
+{
+	if (!m_current || m_budget_us == 0 ||
+			porting::getTimeUs() - m_start_us < m_budget_us)
+		return false;
+	m_starved = true;
+	return true;
+}
+
+void FrameScheduler::endTask()
+{
+	Task &task = *m_current;
+	m_current = nullptr;
+
+	const u64 used_us = porting::getTimeUs() - m_start_us;
+	if (m_starved)
+		task.starved_frames++;
+	else
+		task.starved_frames = 0;
+
+	g_profiler->avg("FrameScheduler: " + task.name + " [ms]", used_us / 1000.0f);
+	if (task.priority > 0) {
+		g_profiler->avg("FrameScheduler: " + task.name + " budget [ms]",
+				m_budget_us / 1000.0f);
+		g_profiler->avg("FrameScheduler: " + task.name + " starved [%]",
+				m_starved ? 100.0f : 0.0f);
+	}
+}
@@ -0,0 +1,114 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+#include <string>
+#include <vector>
+
+/*
+	Shares the time left in a frame among the main thread work of the
+	client, see Client::step().
+
+	Each task gets a part of the time left until the frame deadline,
+	weighted by its priority among the tasks that have not run yet in this
+	frame. Time a task leaves unused goes to the ones after it. A task that
+	runs out of time keeps the rest of its work for the next frame, and its
+	share grows for as long as it keeps running out ("starving"). A
+	starving task also gets its maximum when the frame is already late.
+
+	Outside of frames (e.g. on the loading screen) tasks get their maximum.
+*/
+class FrameScheduler
+{
+public:
+	FrameScheduler() = default;
+	DISABLE_CLASS_COPY(FrameScheduler)
+
+	/*
+		priority: weight of the task's share, 0 only measures the task
+		min_us: budget the task gets even when the frame is late
+		max_us: budget limit, 0 for none. Also the budget of a task that
+		ran out of time in the last frame, even when the frame is late.
+		Returns the task id.
+	*/
+	u32 addTask(const std::string &name, u32 priority, u64 min_us, u64 max_us);
+
+	/*
+		Called by the game loop at the start of each frame.
+		frame_us: time a frame should take, from the FPS limit
+		render_us: time the last frame took to draw, reserved at the end
+	*/
+	void beginFrame(u64 frame_us, u64 render_us);
+
+	// True once the running task used up its budget, then it should stop.
+	// For code deep inside a task, false when no task is running.
+	bool expired();
+
+	// Runs a task for as long as it exists
+	class Slice
+	{
+	public:
+		Slice(FrameScheduler &scheduler, u32 task) :
+			m_scheduler(scheduler)
+		{
+			m_scheduler.startTask(task);
+		}
+		~Slice() { m_scheduler.endTask(); }
+		DISABLE_CLASS_COPY(Slice)
+
+		bool expired() { return m_scheduler.expired(); }
+		// 0 means unlimited
+		u64 getBudgetUs() const { return m_scheduler.m_budget_us; }
+
+	private:
+		FrameScheduler &m_scheduler;
+	};
+
+private:
+	struct Task {
+		std::string name;
+		u32 priority;
+		u64 min_us, max_us;
+		// Frames in a row in which the task ran out of time
+		u32 starved_frames = 0;
+		bool ran = false;
+	};
+
+	u32 getWeight(const Task &task) const;
+	u64 getMinimum(const Task &task) const;
+
+	void startTask(u32 id);
+	void endTask();
+
+	std::vector<Task> m_tasks;
+
+	// 0 when not in a frame
+	u64 m_deadline_us = 0;
+	f32 m_render_us_avg = 0.0f;
+
+	// The running task
+	Task *m_current = nullptr;
+	u64 m_start_us = 0;
+	u64 m_budget_us = 0;
+	bool m_starved = false;
+};
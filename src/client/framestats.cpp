@@ -0,0 +1,136 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#include "framestats.h"
+#include "log.h"
+#include "porting.h"
+#include "settings.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+// Seconds of frames the percentiles are taken from
+#define FRAME_STATS_WINDOW 10.0f
+// Longest frame time in ms that gets its own bucket
+#define FRAME_STATS_BUCKETS 1000
+// Hitches kept for the debug info
+#define FRAME_STATS_HITCHES 8
+// Sections listed per hitch
+#define FRAME_STATS_HITCH_SECTIONS 5
+
+std::string FrameStats::Hitch::toString() const
+{
+	std::ostringstream os(std::ios_base::binary);
+	os.precision(1);
+	os << std::fixed << busy_ms << " ms at " << time << " s ("
+		<< packets << " packets, " << meshes << " meshes, "
+		<< textures << " textures, " << lua_ms << " ms CSM)";
+	for (const auto &section : sections)
+		os << ", " << section.first << " " << section.second;
+	return os.str();
+}
+
+FrameStats::FrameStats() :
+	m_histogram(FRAME_STATS_BUCKETS + 1, 0)
+{
+}
+
+void FrameStats::beginFrame(f32 dtime)
+{
+	m_frame_start_us = porting::getTimeUs();
+	m_time += dtime;
+
+	const f32 frame_ms = dtime * 1000.0f;
+	m_histogram[std::min<u32>(frame_ms, FRAME_STATS_BUCKETS)]++;
+	m_window_frames++;
+	m_window_max = std::max(m_window_max, frame_ms);
+
+	m_window_time += dtime;
+	if (m_window_time >= FRAME_STATS_WINDOW)
+		finishWindow();
+}
+
+void FrameStats::endFrame(const Profiler::GraphValues &graph_values)
+{
+	static const SettingHandle<u32> hitch_threshold("hitch_threshold");
+
+	// Always take the section times, so they don't pile up
+	Profiler::GraphValues frametimes;
+	g_profiler->frameGet(frametimes);
+
+	const f32 busy_ms = (porting::getTimeUs() - m_frame_start_us) / 1000.0f;
+	if (hitch_threshold == 0 || m_frame_start_us == 0 || busy_ms < hitch_threshold)
+		return;
+
+	auto graph_value = [&] (const char *name) -> f32 {
+		auto it = graph_values.find(name);
+		return it != graph_values.end() ? it->second : 0.0f;
+	};
+
+	Hitch hitch;
+	hitch.time = m_time;
+	hitch.busy_ms = busy_ms;
+	hitch.packets = graph_value("client_received_packets");
+	hitch.meshes = graph_value("num_processed_meshes");
+	hitch.textures = graph_value("num_generated_textures");
+	auto lua = frametimes.find("Client: CSM callbacks [ms]");
+	hitch.lua_ms = lua != frametimes.end() ? lua->second : 0.0f;
+
+	hitch.sections.assign(frametimes.begin(), frametimes.end());
+	std::sort(hitch.sections.begin(), hitch.sections.end(),
+		[] (const std::pair<std::string, f32> &a, const std::pair<std::string, f32> &b) {
+			return a.second > b.second;
+		});
+	if (hitch.sections.size() > FRAME_STATS_HITCH_SECTIONS)
+		hitch.sections.resize(FRAME_STATS_HITCH_SECTIONS);
+
+	actionstream << "FrameStats: Hitch of " << hitch.toString() << std::endl;
+
+	m_hitch_count++;
+	m_hitches.push_back(std::move(hitch));
+	if (m_hitches.size() > FRAME_STATS_HITCHES)
+		m_hitches.pop_front();
+}
+
+f32 FrameStats::getPercentile(u32 count, f32 fraction) const
+{
+	const u32 wanted = std::max<u32>(std::ceil(count * fraction), 1);
+	u32 seen = 0;
+	for (u32 i = 0; i < FRAME_STATS_BUCKETS; i++) {
+		seen += m_histogram[i];
+		// Upper bound of the bucket
+		if (seen >= wanted)
+			return std::min<f32>(i + 1, m_window_max);
+	}
+	return m_window_max;
+}
+
+void FrameStats::finishWindow()
+{
+	m_p50 = getPercentile(m_window_frames, 0.50f);
+	m_p95 = getPercentile(m_window_frames, 0.95f);
+	m_p99 = getPercentile(m_window_frames, 0.99f);
+	m_max = m_window_max;
+
+	std::fill(m_histogram.begin(), m_histogram.end(), 0);
+	m_window_frames = 0;
+	m_window_time = 0.0f;
+	m_window_max = 0.0f;
+}
@@ -0,0 +1,91 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "profiler.h"
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+	Frame time statistics of the game loop.
+
+	Frame times go into a histogram of fixed 1 ms buckets, from which the
+	percentiles of the last window of FRAME_STATS_WINDOW seconds are taken.
+
+	A frame whose busy time (the FPS limit sleep excluded) exceeds the
+	hitch_threshold setting is recorded as a hitch, along with the main
+	thread ScopeProfiler sections that ran during it and what was
+	processed. Hitches are written to the log.
+*/
+class FrameStats
+{
+public:
+	struct Hitch {
+		// Time since the game started
+		f32 time;
+		f32 busy_ms;
+		u32 packets;
+		u32 meshes;
+		u32 textures;
+		f32 lua_ms;
+		// Longest sections first, these may be nested
+		std::vector<std::pair<std::string, f32>> sections;
+
+		std::string toString() const;
+	};
+
+	FrameStats();
+
+	// Call right after the FPS limit, dtime is the duration of the last frame
+	void beginFrame(f32 dtime);
+	// Call at the end of the frame with the profiler graph values of the frame
+	void endFrame(const Profiler::GraphValues &graph_values);
+
+	// Percentiles of the last finished window, in ms
+	f32 getP50() const { return m_p50; }
+	f32 getP95() const { return m_p95; }
+	f32 getP99() const { return m_p99; }
+	f32 getMax() const { return m_max; }
+
+	u32 getHitchCount() const { return m_hitch_count; }
+	// The most recent hitches, oldest first
+	const std::deque<Hitch> &getHitches() const { return m_hitches; }
+
+private:
+	f32 getPercentile(u32 count, f32 fraction) const;
+	void finishWindow();
+
+	// Buckets of 1 ms, the last one takes all longer frames
+	std::vector<u32> m_histogram;
+	u32 m_window_frames = 0;
+	f32 m_window_time = 0.0f;
+	f32 m_window_max = 0.0f;
+
+	f32 m_p50 = 0.0f, m_p95 = 0.0f, m_p99 = 0.0f, m_max = 0.0f;
+
+	f32 m_time = 0.0f;
+	u64 m_frame_start_us = 0;
+	u32 m_hitch_count = 0;
+	std::deque<Hitch> m_hitches;
+};
@@ -37,6 +37,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "content_cao.h"
 #include "content/subgames.h"
 #include "client/event_manager.h"
+#include "client/flythrough.h"
 #include "fontengine.h"
 #include "itemdef.h"
 #include "log.h"
@@ -57,6 +58,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "profiler.h"
 #include "raycast.h"
 #include "server.h"
+#include "server/syntheticserver.h"
 #include "settings.h"
 #include "shader.h"
 #include "sky.h"
@@ -603,6 +605,8 @@ struct FpsControl {
 
 	// all values in microseconds (us)
 	u64 last_time, busy_time, sleep_time;
+	// Frame time wanted by the FPS limit
+	u64 frametime_min = 0;
 };
 
 
@@ -703,7 +707,7 @@ class Game {
 	void updateProfilers(const RunStats &stats, const FpsControl &draw_times, f32 dtime);
 	void updateDebugState();
 	void updateStats(RunStats *stats, const FpsControl &draw_times, f32 dtime);
-	void updateProfilerGraphs(ProfilerGraph *graph);
+	void updateProfilerGraphs(ProfilerGraph *graph, RunStats *stats);
 
 	// Input related
 	void processUserInput(f32 dtime);
@@ -854,6 +858,10 @@ class Game {
 	EventManager *eventmgr = nullptr;
 
 	std::unique_ptr<GameUI> m_game_ui;
+	// Drives the camera in the --benchmark mode
+	std::unique_ptr<FlyThroughBenchmark> m_benchmark;
+	// Serves generated content when load testing, see synthetic_server
+	std::unique_ptr<SyntheticServer> m_synthetic_server;
 	GUIChatConsole *gui_chat_console = nullptr; // Free using ->Drop()
 	MapDrawControl *draw_control = nullptr;
 	Camera *camera = nullptr;
@@ -1087,6 +1095,17 @@ bool Game::startup(bool *kill,
 
 	g_client_translations->clear();
 
+	if (!start_data.benchmark_script.empty()) {
+		m_benchmark = FlyThroughBenchmark::load(
+				start_data.benchmark_script, error_message);
+		if (!m_benchmark) {
+			errorstream << error_message << std::endl;
+			return false;
+		}
+		// The pause menu would stop the benchmark
+		m_does_lost_focus_pause_game = false;
+	}
+
 	// address can change if simple_singleplayer_mode
 	if (!init(start_data.world_spec.path, start_data.address,
 			start_data.socket_port, start_data.game_spec))
@@ -1155,6 +1174,10 @@ void Game::run()
 		updateStats(&stats, draw_times, dtime);
 		updateInteractTimers(dtime);
 
+		// Leave time to draw the frame before the FPS limit deadline
+		client->getFrameScheduler().beginFrame(draw_times.frametime_min,
+				stats.drawtime);
+
 		if (!checkConnection())
 			break;
 		if (!handleCallbacks())
@@ -1166,12 +1189,19 @@ void Game::run()
 
 		updateProfilers(stats, draw_times, dtime);
 		processUserInput(dtime);
-		// Update camera before player movement to avoid camera lag of one frame
-		updateCameraDirection(&cam_view_target, dtime);
-		cam_view.camera_yaw += (cam_view_target.camera_yaw -
-				cam_view.camera_yaw) * m_cache_cam_smoothing;
-		cam_view.camera_pitch += (cam_view_target.camera_pitch -
-				cam_view.camera_pitch) * m_cache_cam_smoothing;
+		if (m_benchmark) {
+			// The script has the camera, not the mouse
+			m_benchmark->step(dtime);
+			cam_view_target.camera_yaw = cam_view.camera_yaw = m_benchmark->getYaw();
+			cam_view_target.camera_pitch = cam_view.camera_pitch = m_benchmark->getPitch();
+		} else {
+			// Update camera before player movement to avoid camera lag of one frame
+			updateCameraDirection(&cam_view_target, dtime);
+			cam_view.camera_yaw += (cam_view_target.camera_yaw -
+					cam_view.camera_yaw) * m_cache_cam_smoothing;
+			cam_view.camera_pitch += (cam_view_target.camera_pitch -
+					cam_view.camera_pitch) * m_cache_cam_smoothing;
+		}
 		updatePlayerControl(cam_view);
 
 		{
@@ -1191,17 +1221,33 @@ void Game::run()
 
 		if (!m_is_paused)
 			step(dtime);
+		if (m_benchmark) {
+			LocalPlayer *player = client->getEnv().getLocalPlayer();
+			player->setPosition(m_benchmark->getPosition());
+			player->setSpeed(v3f());
+		}
 		processClientEvents(&cam_view_target);
 		updateDebugState();
 		updateCamera(dtime);
 		updateSound(dtime);
 		processPlayerInteraction(dtime, m_game_ui->m_flags.show_hud);
 		updateFrame(&graph, &stats, dtime, cam_view);
-		updateProfilerGraphs(&graph);
+		updateProfilerGraphs(&graph, &stats);
 
 		// Update if minimap has been disabled by the server
 		m_game_ui->m_flags.show_minimap &= client->shouldShowMinimap();
 
+		if (m_benchmark) {
+			m_benchmark->recordFrame(dtime, draw_times.busy_time,
+					client->getMeshUpdateCount());
+			if (m_benchmark->finished()) {
+				// Makes the process exit with an error
+				if (!m_benchmark->writeResults())
+					*error_message = "Cannot write the benchmark results";
+				g_gamecallback->exitToOS();
+			}
+		}
+
 		if (m_does_lost_focus_pause_game && !device->isWindowFocused() && !isMenuActive()) {
 			showPauseMenu();
 		}
@@ -1288,7 +1334,19 @@ bool Game::init(
 
 	// Create a server if not connecting to an existing one
 	if (address.empty()) {
-		return false;
+		if (!g_settings->getBool("synthetic_server"))
+			return false;
+
+		showOverlayMessage(N_("Creating server..."), 0, 5);
+		try {
+			m_synthetic_server = std::make_unique<SyntheticServer>(
+					Address(127, 0, 0, 1, port));
+			m_synthetic_server->start();
+		} catch (const BaseException &e) {
+			*error_message = fmtgettext("Error creating server: %s", e.what());
+			errorstream << *error_message << std::endl;
+			return false;
+		}
 	}
 
 	return true;
@@ -1548,6 +1606,12 @@ bool Game::connectToServer(const GameStartData &start_data,
 				break;
 			}
 
+			if (m_synthetic_server && !m_synthetic_server->getError().empty()) {
+				*error_message = m_synthetic_server->getError();
+				errorstream << *error_message << std::endl;
+				break;
+			}
+
 			wait_time += dtime;
 			// Only time out if we aren't waiting for the server we started
 			if (!start_data.address.empty() && wait_time > 10) {
@@ -1625,7 +1689,9 @@ bool Game::getServerContent(bool *aborted)
 			message << gettext("Media...");
 			if (receive > 0)
 				message << " " << receive << "%";
-			message.precision(2);
+			float rate = client->mediaLoadRate();
+			if (rate > 0)
+				message << " (" << rate << " " << gettext("files/s") << ")";
 
 			progress = 30 + client->mediaReceiveProgress() * 35 + 0.5;
 			m_rendering_engine->draw_load_screen(utf8_to_wide(message.str()), guienv,
@@ -1743,6 +1809,8 @@ void Game::updateProfilers(const RunStats &stats, const FpsControl &draw_times,
 		}
 
 		m_game_ui->updateProfiler();
+		if (m_benchmark)
+			m_benchmark->sampleProfiler();
 		g_profiler->clear();
 	}
 
@@ -1761,6 +1829,8 @@ void Game::updateStats(RunStats *stats, const FpsControl &draw_times,
 	f32 jitter;
 	Jitter *jp;
 
+	stats->frame_stats.beginFrame(dtime);
+
 	/* Time average and jitter calculation
 	 */
 	jp = &stats->dtime_jitter;
@@ -3875,10 +3945,11 @@ void Game::updateFrame(ProfilerGraph *graph, RunStats *stats, f32 dtime,
 }
 
 /* Log times and stuff for visualization */
-inline void Game::updateProfilerGraphs(ProfilerGraph *graph)
+inline void Game::updateProfilerGraphs(ProfilerGraph *graph, RunStats *stats)
 {
 	Profiler::GraphValues values;
 	g_profiler->graphGet(values);
+	stats->frame_stats.endFrame(values);
 	graph->put(values);
 }
 
@@ -3924,10 +3995,11 @@ void FpsControl::reset()
  */
 void FpsControl::limit(IrrlichtDevice *device, f32 *dtime)
 {
+	static const SettingHandle<float> fps_max("fps_max");
+	static const SettingHandle<float> fps_max_unfocused("fps_max_unfocused");
 	const float fps_limit = (device->isWindowFocused() && !g_menumgr.pausesGame())
-			? g_settings->getFloat("fps_max")
-			: g_settings->getFloat("fps_max_unfocused");
-	const u64 frametime_min = 1000000.0f / std::max(fps_limit, 1.0f);
+			? fps_max : fps_max_unfocused;
+	frametime_min = 1000000.0f / std::max(fps_limit, 1.0f);
 
 	u64 time = porting::getTimeUs();
 
@@ -3994,7 +4066,9 @@ void Game::readSettings()
 	m_enable_hotbar_mouse_wheel = g_settings->getBool("enable_hotbar_mouse_wheel");
 	m_invert_hotbar_mouse_wheel = g_settings->getBool("invert_hotbar_mouse_wheel");
 
-	m_does_lost_focus_pause_game = g_settings->getBool("pause_on_lost_focus");
+	// Stays off while benchmarking, see startup()
+	m_does_lost_focus_pause_game = g_settings->getBool("pause_on_lost_focus") &&
+			!m_benchmark;
 }
 
 /****************************************************************************/
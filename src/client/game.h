@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include "irrlichttypes.h"
+#include "client/framestats.h"
 #include <string>
 
 class InputHandler;
@@ -36,6 +37,8 @@ struct RunStats {
 	u64 drawtime; // (us)
 
 	Jitter dtime_jitter, busy_time_jitter;
+
+	FrameStats frame_stats;
 };
 
 struct CameraOrientation {
@@ -127,6 +127,16 @@ void GameUI::update(const RunStats &stats, Client *client, MapDrawControl *draw_
 			<< std::setprecision(2)
 			<< " | RTT: " << (client->getRTT() * 1000.0f) << "ms";
 
+		const FrameStats &frame_stats = stats.frame_stats;
+		os << std::setprecision(1)
+			<< "\nframe time p50/p95/p99/max: " << frame_stats.getP50()
+			<< "/" << frame_stats.getP95()
+			<< "/" << frame_stats.getP99()
+			<< "/" << frame_stats.getMax() << "ms"
+			<< " | hitches: " << frame_stats.getHitchCount();
+		if (!frame_stats.getHitches().empty())
+			os << " | last: " << frame_stats.getHitches().back().toString();
+
 		m_guitext->setRelativePosition(core::rect<s32>(5, 5, screensize.X, screensize.Y));
 
 		setStaticText(m_guitext, utf8_to_wide(os.str()).c_str());
@@ -166,6 +176,16 @@ void GameUI::update(const RunStats &stats, Client *client, MapDrawControl *draw_
 			}
 		}
 
+		const ClientMemoryUsage &mem = client->getMemoryUsage();
+		os << "\nmemory: " << (mem.total() >> 20) << " MiB"
+			<< " | mapblocks: " << (mem.mapblocks >> 20)
+			<< " | meshes: " << (mem.meshes >> 20)
+			<< " | textures: " << (mem.textures >> 20)
+			<< " | images: " << (mem.images >> 20)
+			<< " | sounds: " << (mem.sounds >> 20)
+			<< " | models: " << (mem.models >> 20)
+			<< " | definitions: " << (mem.definitions >> 20);
+
 		m_guitext2->setRelativePosition(core::rect<s32>(5, 5 + minimal_debug_height,
 				screensize.X, screensize.Y));
 
@@ -39,6 +39,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "wieldmesh.h"
 #include "client/renderingengine.h"
 #include "client/minimap.h"
+#include "profiler.h"
 
 #ifdef HAVE_TOUCHSCREENGUI
 #include "gui/touchscreengui.h"
@@ -48,7 +49,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define CROSSHAIR_LINE_SIZE 10
 
 Hud::Hud(Client *client, LocalPlayer *player,
-		Inventory *inventory)
+		Inventory *inventory) :
+	m_batch(RenderingEngine::get_video_driver())
 {
 	driver            = RenderingEngine::get_video_driver();
 	this->client      = client;
@@ -121,8 +123,7 @@ Hud::~Hud()
 		m_selection_mesh->drop();
 }
 
-void Hud::drawItem(const ItemStack &item, const core::rect<s32>& rect,
-		bool selected)
+void Hud::drawItemBackground(const core::rect<s32> &rect, bool selected)
 {
 	if (selected) {
 		/* draw highlighting around selected item */
@@ -134,7 +135,7 @@ void Hud::drawItem(const ItemStack &item, const core::rect<s32>& rect,
 			imgrect2.LowerRightCorner.Y += (m_padding*2);
 				video::ITexture *texture = tsrc->getTexture(hotbar_selected_image);
 				core::dimension2di imgsize(texture->getOriginalSize());
-			draw2DImageFilterScaled(driver, texture, imgrect2,
+			m_batch.drawImage(SPRITE_LAYER_BACKGROUND, texture, imgrect2,
 					core::rect<s32>(core::position2d<s32>(0,0), imgsize),
 					NULL, hbar_colors, true);
 		} else {
@@ -146,22 +147,22 @@ void Hud::drawItem(const ItemStack &item, const core::rect<s32>& rect,
 			s32 x2 = rect.LowerRightCorner.X;
 			s32 y2 = rect.LowerRightCorner.Y;
 			// Black base borders
-			driver->draw2DRectangle(c_outside,
+			m_batch.drawRectangle(SPRITE_LAYER_BACKGROUND, c_outside,
 				core::rect<s32>(
 				v2s32(x1 - m_padding, y1 - m_padding),
 				v2s32(x2 + m_padding, y1)
 				), NULL);
-			driver->draw2DRectangle(c_outside,
+			m_batch.drawRectangle(SPRITE_LAYER_BACKGROUND, c_outside,
 				core::rect<s32>(
 				v2s32(x1 - m_padding, y2),
 				v2s32(x2 + m_padding, y2 + m_padding)
 				), NULL);
-			driver->draw2DRectangle(c_outside,
+			m_batch.drawRectangle(SPRITE_LAYER_BACKGROUND, c_outside,
 				core::rect<s32>(
 				v2s32(x1 - m_padding, y1),
 					v2s32(x1, y2)
 				), NULL);
-			driver->draw2DRectangle(c_outside,
+			m_batch.drawRectangle(SPRITE_LAYER_BACKGROUND, c_outside,
 				core::rect<s32>(
 					v2s32(x2, y1),
 				v2s32(x2 + m_padding, y2)
@@ -193,9 +194,14 @@ void Hud::drawItem(const ItemStack &item, const core::rect<s32>& rect,
 
 	video::SColor bgcolor2(128, 0, 0, 0);
 	if (!use_hotbar_image)
-		driver->draw2DRectangle(bgcolor2, rect, NULL);
+		m_batch.drawRectangle(SPRITE_LAYER_SLOT, bgcolor2, rect, NULL);
+}
+
+void Hud::drawItem(const ItemStack &item, const core::rect<s32>& rect,
+		bool selected)
+{
 	drawItemStack(driver, g_fontengine->getFont(), item, rect, NULL,
-		client, selected ? IT_ROT_SELECTED : IT_ROT_NONE);
+		client, selected ? IT_ROT_SELECTED : IT_ROT_NONE, &m_batch);
 }
 
 //NOTE: selectitem = 0 -> no selected; selectitem 1-based
@@ -221,13 +227,13 @@ void Hud::drawItems(v2s32 upperleftpos, v2s32 screen_offset, s32 itemcount,
 	v2s32 pos = screen_offset * m_scale_factor;
 	pos += upperleftpos;
 
-	// Store hotbar_image in member variable, used by drawItem()
+	// Store hotbar_image in member variable, used by drawItemBackground()
 	if (hotbar_image != player->hotbar_image) {
 		hotbar_image = player->hotbar_image;
 		use_hotbar_image = !hotbar_image.empty();
 	}
 
-	// Store hotbar_selected_image in member variable, used by drawItem()
+	// Store hotbar_selected_image in member variable, used by drawItemBackground()
 	if (hotbar_selected_image != player->hotbar_selected_image) {
 		hotbar_selected_image = player->hotbar_selected_image;
 		use_hotbar_selected_image = !hotbar_selected_image.empty();
@@ -240,7 +246,7 @@ void Hud::drawItems(v2s32 upperleftpos, v2s32 screen_offset, s32 itemcount,
 		core::rect<s32> rect2 = imgrect2 + pos;
 		video::ITexture *texture = tsrc->getTexture(hotbar_image);
 		core::dimension2di imgsize(texture->getOriginalSize());
-		draw2DImageFilterScaled(driver, texture, rect2,
+		m_batch.drawImage(SPRITE_LAYER_BACKGROUND, texture, rect2,
 			core::rect<s32>(core::position2d<s32>(0,0), imgsize),
 			NULL, hbar_colors, true);
 	}
@@ -248,9 +254,8 @@ void Hud::drawItems(v2s32 upperleftpos, v2s32 screen_offset, s32 itemcount,
 	// Draw items
 	core::rect<s32> imgrect(0, 0, m_hotbar_imagesize, m_hotbar_imagesize);
 	const s32 list_size = mainlist ? mainlist->getSize() : 0;
-	for (s32 i = inv_offset; i < itemcount && i < list_size; i++) {
-		s32 fullimglen = m_hotbar_imagesize + m_padding * 2;
-
+	const s32 fullimglen = m_hotbar_imagesize + m_padding * 2;
+	auto item_rect = [&] (s32 i) {
 		v2s32 steppos;
 		switch (direction) {
 		case HUD_DIR_RIGHT_LEFT:
@@ -266,14 +271,25 @@ void Hud::drawItems(v2s32 upperleftpos, v2s32 screen_offset, s32 itemcount,
 			steppos = v2s32(m_padding + (i - inv_offset) * fullimglen, m_padding);
 			break;
 		}
+		return imgrect + pos + steppos;
+	};
+
+	// Backgrounds of all slots first, so that they are drawn with one draw
+	// call per texture even if some of the items are meshes
+	for (s32 i = inv_offset; i < itemcount && i < list_size; i++)
+		drawItemBackground(item_rect(i), (i + 1) == selectitem);
+	m_batch.flush(SPRITE_LAYER_SLOT);
 
-		drawItem(mainlist->getItem(i), (imgrect + pos + steppos), (i + 1) == selectitem);
+	for (s32 i = inv_offset; i < itemcount && i < list_size; i++) {
+		drawItem(mainlist->getItem(i), item_rect(i), (i + 1) == selectitem);
 
 #ifdef HAVE_TOUCHSCREENGUI
 		if (g_touchscreengui)
-			g_touchscreengui->registerHudItem(i, (imgrect + pos + steppos));
+			g_touchscreengui->registerHudItem(i, item_rect(i));
 #endif
 	}
+
+	m_batch.flush();
 }
 
 bool Hud::hasElementOfType(HudElementType type)
@@ -508,6 +524,11 @@ void Hud::drawLuaElements(const v3s16 &camera_offset)
 					<< " due to unrecognized type" << std::endl;
 		}
 	}
+
+	// Covers the hotbar as well, which is drawn right before
+	g_profiler->avg("Hud: sprites [#]", m_batch.getSpriteCount());
+	g_profiler->avg("Hud: drawcalls [#]", m_batch.getDrawCallCount());
+	m_batch.resetStats();
 }
 
 void Hud::drawCompassTranslate(HudElement *e, video::ITexture *texture,
@@ -670,18 +691,18 @@ void Hud::drawStatbar(v2s32 pos, u16 corner, u16 drawdir,
 		core::rect<s32> dstrect(0, 0, dstd.Width, dstd.Height);
 
 		dstrect += p;
-		draw2DImageFilterScaled(driver, stat_texture,
+		m_batch.drawImage(SPRITE_LAYER_IMAGE, stat_texture,
 			dstrect, srcrect, NULL, colors, true);
 		p += steppos;
 	}
 
 	if (count % 2 == 1) {
 		// Draw half a texture
-		draw2DImageFilterScaled(driver, stat_texture,
+		m_batch.drawImage(SPRITE_LAYER_IMAGE, stat_texture,
 			dsthalfrect + p, srchalfrect, NULL, colors, true);
 
 		if (stat_texture_bg && maxcount > count) {
-			draw2DImageFilterScaled(driver, stat_texture_bg,
+			m_batch.drawImage(SPRITE_LAYER_IMAGE, stat_texture_bg,
 					dsthalfrect2 + p, srchalfrect2,
 					NULL, colors, true);
 			p += steppos;
@@ -700,17 +721,19 @@ void Hud::drawStatbar(v2s32 pos, u16 corner, u16 drawdir,
 			core::rect<s32> dstrect(0, 0, dstd.Width, dstd.Height);
 
 			dstrect += p;
-			draw2DImageFilterScaled(driver, stat_texture_bg,
+			m_batch.drawImage(SPRITE_LAYER_IMAGE, stat_texture_bg,
 					dstrect, srcrect,
 					NULL, colors, true);
 			p += steppos;
 		}
 
 		if (maxcount % 2 == 1) {
-			draw2DImageFilterScaled(driver, stat_texture_bg,
+			m_batch.drawImage(SPRITE_LAYER_IMAGE, stat_texture_bg,
 				dsthalfrect + p, srchalfrect, NULL, colors, true);
 		}
 	}
+
+	m_batch.flush();
 }
 
 
@@ -728,9 +751,9 @@ void Hud::drawHotbar(u16 playeritem) {
 	s32 width = hotbar_itemcount * (m_hotbar_imagesize + m_padding * 2);
 	v2s32 pos = centerlowerpos - v2s32(width / 2, m_hotbar_imagesize + m_padding * 3);
 
+	static const SettingHandle<float> hotbar_max_width("hud_hotbar_max_width");
 	const v2u32 &window_size = RenderingEngine::getWindowSize();
-	if ((float) width / (float) window_size.X <=
-			g_settings->getFloat("hud_hotbar_max_width")) {
+	if ((float) width / (float) window_size.X <= hotbar_max_width) {
 		if (player->hud_flags & HUD_FLAG_HOTBAR_VISIBLE) {
 			drawItems(pos, v2s32(0, 0), hotbar_itemcount, 0, mainlist, playeritem + 1, 0);
 		}
@@ -970,7 +993,8 @@ void drawItemStack(
 		Client *client,
 		ItemRotationKind rotation_kind,
 		const v3s16 &angle,
-		const v3s16 &rotation_speed)
+		const v3s16 &rotation_speed,
+		SpriteBatch2D *batch)
 {
 	static MeshTimeInfo rotation_time_infos[IT_ROT_NONE];
 
@@ -1005,6 +1029,12 @@ void drawItemStack(
 		has_mesh = imesh && imesh->mesh;
 	}
 	if (has_mesh) {
+		// Meshes are drawn right away, so the slot backgrounds have to be
+		// on screen first. Item images and overlays stay queued, they do
+		// not overlap other slots.
+		if (batch)
+			batch->flush(SPRITE_LAYER_SLOT);
+
 		scene::IMesh *mesh = imesh->mesh;
 		driver->clearBuffers(video::ECBF_DEPTH);
 		s32 delta = 0;
@@ -1106,9 +1136,14 @@ void drawItemStack(
 
 		const video::SColor colors[] = { color, color, color, color };
 
-		draw2DImageFilterScaled(driver, texture, rect,
-			core::rect<s32>({0, 0}, core::dimension2di(texture->getOriginalSize())),
-			clip, colors, true);
+		const core::rect<s32> srcrect({0, 0},
+			core::dimension2di(texture->getOriginalSize()));
+		if (batch)
+			batch->drawImage(SPRITE_LAYER_IMAGE, texture, rect, srcrect,
+				clip, colors, true);
+		else
+			draw2DImageFilterScaled(driver, texture, rect, srcrect,
+				clip, colors, true);
 
 		draw_overlay = true;
 	}
@@ -1119,7 +1154,12 @@ void drawItemStack(
 		video::ITexture *overlay_texture = tsrc->getTexture(inventory_overlay);
 		core::dimension2d<u32> dimens = overlay_texture->getOriginalSize();
 		core::rect<s32> srcrect(0, 0, dimens.Width, dimens.Height);
-		draw2DImageFilterScaled(driver, overlay_texture, rect, srcrect, clip, 0, true);
+		if (batch)
+			batch->drawImage(SPRITE_LAYER_OVERLAY, overlay_texture, rect,
+				srcrect, clip, 0, true);
+		else
+			draw2DImageFilterScaled(driver, overlay_texture, rect, srcrect,
+				clip, 0, true);
 	}
 
 	if (def.type == ITEM_TOOL && item.wear != 0) {
@@ -1155,12 +1195,18 @@ void drawItemStack(
 
 		core::rect<s32> progressrect2 = progressrect;
 		progressrect2.LowerRightCorner.X = progressmid;
-		driver->draw2DRectangle(color, progressrect2, clip);
+		if (batch)
+			batch->drawRectangle(SPRITE_LAYER_FOREGROUND, color, progressrect2, clip);
+		else
+			driver->draw2DRectangle(color, progressrect2, clip);
 
 		color = video::SColor(255, 0, 0, 0);
 		progressrect2 = progressrect;
 		progressrect2.UpperLeftCorner.X = progressmid;
-		driver->draw2DRectangle(color, progressrect2, clip);
+		if (batch)
+			batch->drawRectangle(SPRITE_LAYER_FOREGROUND, color, progressrect2, clip);
+		else
+			driver->draw2DRectangle(color, progressrect2, clip);
 	}
 
 	const std::string &count_text = item.metadata.getString("count_meta");
@@ -1224,7 +1270,10 @@ void drawItemStack(
 		}
 
 		video::SColor color(255, 255, 255, 255);
-		font->draw(utf8_to_wide(text).c_str(), rect2, color, false, false, &viewrect);
+		if (batch)
+			batch->drawText(font, utf8_to_wide(text), rect2, color, &viewrect);
+		else
+			font->draw(utf8_to_wide(text).c_str(), rect2, color, false, false, &viewrect);
 	}
 }
 
@@ -1235,8 +1284,9 @@ void drawItemStack(
 		const core::rect<s32> &rect,
 		const core::rect<s32> *clip,
 		Client *client,
-		ItemRotationKind rotation_kind)
+		ItemRotationKind rotation_kind,
+		SpriteBatch2D *batch)
 {
 	drawItemStack(driver, font, item, rect, clip, client, rotation_kind,
-		v3s16(0, 0, 0), v3s16(0, 100, 0));
+		v3s16(0, 0, 0), v3s16(0, 100, 0), batch);
 }
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <IGUIFont.h>
 #include "irr_aabb3d.h"
 #include "../hud.h"
+#include "client/spritebatch.h"
 
 class Client;
 class ITextureSource;
@@ -103,6 +104,7 @@ class Hud
 			s32 inv_offset, InventoryList *mainlist, u16 selectitem,
 			u16 direction);
 
+	void drawItemBackground(const core::rect<s32> &rect, bool selected);
 	void drawItem(const ItemStack &item, const core::rect<s32> &rect, bool selected);
 
 	void drawCompassTranslate(HudElement *e, video::ITexture *texture,
@@ -113,6 +115,7 @@ class Hud
 
 	Client *client = nullptr;
 	video::IVideoDriver *driver = nullptr;
+	SpriteBatch2D m_batch;
 	LocalPlayer *player = nullptr;
 	Inventory *inventory = nullptr;
 	ITextureSource *tsrc = nullptr;
@@ -163,7 +166,8 @@ void drawItemStack(video::IVideoDriver *driver,
 		const core::rect<s32> &rect,
 		const core::rect<s32> *clip,
 		Client *client,
-		ItemRotationKind rotation_kind);
+		ItemRotationKind rotation_kind,
+		SpriteBatch2D *batch = nullptr);
 
 void drawItemStack(
 		video::IVideoDriver *driver,
@@ -174,5 +178,6 @@ void drawItemStack(
 		Client *client,
 		ItemRotationKind rotation_kind,
 		const v3s16 &angle,
-		const v3s16 &rotation_speed);
+		const v3s16 &rotation_speed,
+		SpriteBatch2D *batch = nullptr);
 
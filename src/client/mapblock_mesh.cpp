@@ -635,6 +635,8 @@ void PartialMeshBuffer::afterDraw() const
 	MapBlockMesh
 */
 
+std::atomic<u64> MapBlockMesh::s_total_memory_usage(0);
+
 MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 	m_tsrc(data->m_client->getTextureSource()),
 	m_shdrsrc(data->m_client->getShaderSource()),
@@ -812,10 +814,21 @@ MapBlockMesh::MapBlockMesh(MeshMakeData *data, v3s16 camera_offset):
 		!m_crack_materials.empty() ||
 		!m_daynight_diffs.empty() ||
 		!m_animation_info.empty();
+
+	for (scene::IMesh *mesh : m_mesh) {
+		for (u32 i = 0; i < mesh->getMeshBufferCount(); i++) {
+			scene::IMeshBuffer *buf = mesh->getMeshBuffer(i);
+			m_memory_usage += buf->getVertexCount() * sizeof(video::S3DVertex) +
+					buf->getIndexCount() * sizeof(u16);
+		}
+	}
+	m_memory_usage += m_transparent_triangles.capacity() * sizeof(MeshTriangle);
+	s_total_memory_usage += m_memory_usage;
 }
 
 MapBlockMesh::~MapBlockMesh()
 {
+	s_total_memory_usage -= m_memory_usage;
 	for (scene::IMesh *m : m_mesh) {
 		m->drop();
 	}
@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "client/tile.h"
 #include "voxel.h"
 #include <array>
+#include <atomic>
 #include <map>
 #include <unordered_map>
 
@@ -234,6 +235,12 @@ class MapBlockMesh
 		return this->m_transparent_buffers;
 	}
 
+	/// Approximate size of the vertices, indices and transparent triangles
+	size_t getMemoryUsage() const { return m_memory_usage; }
+
+	/// Sum of getMemoryUsage() of all meshes, can be called from any thread
+	static u64 getTotalMemoryUsage() { return s_total_memory_usage; }
+
 private:
 	struct AnimationInfo {
 		int frame; // last animation frame
@@ -280,6 +287,10 @@ class MapBlockMesh
 	MapBlockBspTree m_bsp_tree;
 	// Ordered list of references to parts of transparent buffers to draw
 	std::vector<PartialMeshBuffer> m_transparent_buffers;
+
+	size_t m_memory_usage = 0;
+	// Meshes are built on the mesh threads and deleted on the main thread
+	static std::atomic<u64> s_total_memory_usage;
 };
 
 /*!
@@ -0,0 +1,151 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "medialoader.h"
+#include "threading/thread.h"
+#include "translation.h"
+#include "log.h"
+#include "util/hex.h"
+#include "util/numeric.h"
+#include "util/sha1.h"
+#include "util/string.h"
+#include <algorithm>
+#include <cstdlib>
+
+// Translations is only forward declared in the header
+PreparedMedia::~PreparedMedia() = default;
+
+class MediaLoadThread : public Thread
+{
+public:
+	MediaLoadThread(MediaLoadPool *pool) :
+		Thread("MediaLoad"),
+		m_pool(pool)
+	{}
+
+	void *run()
+	{
+		while (!stopRequested()) {
+			PreparedMedia *media = m_pool->m_jobs.pop_frontNoEx(100);
+			if (!media)
+				continue;
+
+			m_pool->prepare(media);
+			m_pool->m_results.push_back(media);
+		}
+		return nullptr;
+	}
+
+private:
+	MediaLoadPool *m_pool;
+};
+
+MediaLoadPool::MediaLoadPool(const std::string &cache_dir) :
+	m_cache(cache_dir)
+{
+	// Leave one core for the main thread
+	unsigned int num_threads = Thread::getNumberOfProcessors();
+	num_threads = rangelim(num_threads, 2U, 9U) - 1;
+
+	for (unsigned int i = 0; i < num_threads; i++) {
+		MediaLoadThread *thread = new MediaLoadThread(this);
+		thread->start();
+		m_threads.push_back(thread);
+	}
+	infostream << "MediaLoadPool: using " << num_threads
+		<< " threads" << std::endl;
+}
+
+MediaLoadPool::~MediaLoadPool()
+{
+	for (MediaLoadThread *thread : m_threads)
+		thread->stop();
+	for (MediaLoadThread *thread : m_threads) {
+		thread->wait();
+		delete thread;
+	}
+
+	while (PreparedMedia *media = m_jobs.pop_frontNoEx(0))
+		delete media;
+	while (PreparedMedia *media = m_results.pop_frontNoEx(0))
+		delete media;
+	for (auto &it : m_finished)
+		delete it.second;
+}
+
+void MediaLoadPool::enqueue(PreparedMedia *media)
+{
+	media->seq = m_next_seq++;
+	m_pending++;
+	m_jobs.push_back(media);
+}
+
+PreparedMedia *MediaLoadPool::getResult()
+{
+	// The workers finish in any order, put it back together
+	while (PreparedMedia *media = m_results.pop_frontNoEx(0))
+		m_finished.emplace(media->seq, media);
+
+	auto it = m_finished.find(m_next_result);
+	if (it == m_finished.end())
+		return nullptr;
+
+	PreparedMedia *media = it->second;
+	m_finished.erase(it);
+	m_next_result++;
+	m_pending--;
+	return media;
+}
+
+void MediaLoadPool::prepare(PreparedMedia *media)
+{
+	media->ok = false;
+
+	if (media->from_cache && !m_cache.load(hex_encode(media->sha1), media->data))
+		return;
+
+	// Check that the data matches the announced checksum. A corrupted
+	// cache entry counts as a cache miss and is fetched again.
+	std::string data_sha1;
+	{
+		SHA1 ctx;
+		ctx.addBytes(media->data.c_str(), media->data.size());
+		unsigned char *digest = ctx.getDigest();
+		data_sha1.assign((char *)digest, 20);
+		free(digest);
+	}
+	if (data_sha1 != media->sha1) {
+		infostream << "Client: "
+			<< (media->from_cache ? "Cached" : "Received") << " media file "
+			<< hex_encode(media->sha1) << " \"" << media->name << "\" "
+			<< "mismatches actual checksum " << hex_encode(data_sha1)
+			<< std::endl;
+		return;
+	}
+
+	const char *translate_ext[] = {
+		".tr", NULL
+	};
+	if (!removeStringEnd(media->name, translate_ext).empty()) {
+		media->translations = std::make_unique<Translations>();
+		media->translations->loadTranslation(media->data);
+	}
+
+	media->ok = true;
+}
@@ -0,0 +1,103 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "filecache.h"
+#include "util/basic_macros.h"
+#include "util/container.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Translations;
+class MediaLoadThread;
+
+/*
+	A media file on its way through MediaLoadPool.
+
+	The worker threads read it from the cache (if from_cache is set),
+	verify its checksum and parse translations. Images are decoded by the
+	main thread when it registers the file: Irrlicht's image loaders are
+	shared through the video driver and are not thread-safe.
+*/
+struct PreparedMedia
+{
+	PreparedMedia() = default;
+	~PreparedMedia();
+	DISABLE_CLASS_COPY(PreparedMedia)
+
+	std::string name;
+	// Position in the enqueue order, set by MediaLoadPool::enqueue()
+	u64 seq = 0;
+	// Raw SHA1 digest announced by the server
+	std::string sha1;
+	// File contents, read by the worker if from_cache is set
+	std::string data;
+	bool from_cache = false;
+
+	// Set by the worker: whether the file could be read and verified
+	bool ok = false;
+	// Parsed translations, if this is a .tr file
+	std::unique_ptr<Translations> translations;
+};
+
+/*
+	Reads and verifies media files on a set of worker threads.
+*/
+class MediaLoadPool
+{
+public:
+	MediaLoadPool(const std::string &cache_dir);
+	~MediaLoadPool();
+	DISABLE_CLASS_COPY(MediaLoadPool)
+
+	// Takes ownership of media
+	void enqueue(PreparedMedia *media);
+
+	// Returns a finished file or nullptr. The caller takes ownership.
+	// Files are returned in the order they were enqueued, so that e.g. a
+	// translation announced later still overrides an earlier one.
+	PreparedMedia *getResult();
+
+	// Number of files enqueued but not yet returned by getResult()
+	u32 getPendingCount() const { return m_pending; }
+
+private:
+	friend class MediaLoadThread;
+
+	void prepare(PreparedMedia *media);
+
+	FileCache m_cache;
+
+	MutexedQueue<PreparedMedia *> m_jobs;
+	MutexedQueue<PreparedMedia *> m_results;
+	std::atomic<u32> m_pending {0};
+
+	// Only used by the thread calling enqueue() and getResult()
+	u64 m_next_seq = 0;
+	u64 m_next_result = 0;
+	// Finished files that are waiting for an earlier one
+	std::map<u64, PreparedMedia *> m_finished;
+
+	std::vector<MediaLoadThread *> m_threads;
+};
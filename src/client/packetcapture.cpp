@@ -0,0 +1,125 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "packetcapture.h"
+#include "exceptions.h"
+#include "log.h"
+#include "porting.h"
+#include "network/networkpacket.h"
+#include "constants.h"
+#include "util/serialize.h"
+#include <cstring>
+
+static const char CAPTURE_MAGIC[8] = {'M', 'T', 'P', 'K', 'T', 'C', 'A', 'P'};
+static const u8 CAPTURE_VERSION = 1;
+
+PacketCaptureWriter::PacketCaptureWriter(const std::string &path) :
+	m_os(path, std::ios::binary | std::ios::trunc),
+	m_start_ms(porting::getTimeMs())
+{
+	if (!m_os.good()) {
+		errorstream << "PacketCaptureWriter: Cannot open \"" << path
+				<< "\" for writing" << std::endl;
+		return;
+	}
+
+	m_os.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+	writeU8(m_os, CAPTURE_VERSION);
+	infostream << "PacketCaptureWriter: Recording received packets to \""
+			<< path << "\"" << std::endl;
+}
+
+void PacketCaptureWriter::write(NetworkPacket *pkt)
+{
+	if (!m_os.good())
+		return;
+
+	const u32 size = pkt->getSize();
+	writeU32(m_os, porting::getTimeMs() - m_start_ms);
+	writeU32(m_os, size + 2);
+	writeU16(m_os, pkt->getCommand());
+	if (size > 0)
+		m_os.write(pkt->getString(0), size);
+}
+
+PacketCaptureReader::PacketCaptureReader(const std::string &path, bool fast) :
+	m_is(path, std::ios::binary),
+	m_fast(fast)
+{
+	if (!m_is.good())
+		throw FileNotGoodException("Cannot open packet capture \"" + path + "\"");
+
+	char magic[sizeof(CAPTURE_MAGIC)];
+	m_is.read(magic, sizeof(magic));
+	if (!m_is.good() || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0)
+		throw SerializationError("\"" + path + "\" is not a packet capture");
+	if (readU8(m_is) != CAPTURE_VERSION)
+		throw SerializationError("Unsupported packet capture version");
+
+	infostream << "PacketCaptureReader: Replaying \"" << path << "\""
+			<< (fast ? " as fast as possible" : "") << std::endl;
+}
+
+bool PacketCaptureReader::readHeader()
+{
+	char header[8];
+	m_is.read(header, sizeof(header));
+	if (m_is.gcount() != (std::streamsize)sizeof(header))
+		return false;
+
+	m_next_time_ms = readU32((u8 *)&header[0]);
+	m_next_size = readU32((u8 *)&header[4]);
+	// Every packet has at least a command
+	return m_next_size >= 2;
+}
+
+bool PacketCaptureReader::read(NetworkPacket *pkt)
+{
+	if (m_finished)
+		return false;
+
+	if (m_start_ms == 0)
+		m_start_ms = porting::getTimeMs();
+
+	if (!m_have_next) {
+		if (!readHeader()) {
+			actionstream << "PacketCaptureReader: Replay finished after "
+					<< porting::getTimeMs() - m_start_ms << " ms" << std::endl;
+			m_finished = true;
+			return false;
+		}
+		m_have_next = true;
+	}
+
+	if (!m_fast && porting::getTimeMs() - m_start_ms < m_next_time_ms)
+		return false;
+
+	m_buffer.resize(m_next_size);
+	m_is.read(&m_buffer[0], m_next_size);
+	m_have_next = false;
+	if (m_is.gcount() != (std::streamsize)m_next_size) {
+		warningstream << "PacketCaptureReader: Truncated packet capture"
+				<< std::endl;
+		m_finished = true;
+		return false;
+	}
+
+	pkt->putRawPacket((const u8 *)m_buffer.data(), m_next_size, PEER_ID_SERVER);
+	return true;
+}
@@ -0,0 +1,81 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes.h"
+#include "util/basic_macros.h"
+#include <fstream>
+#include <string>
+
+class NetworkPacket;
+
+/*
+	Packet capture files hold the packets a client received from the server,
+	each with the time it arrived. They can be played back into a Client
+	without any network connection to reproduce a session.
+
+	Format: the magic "MTPKTCAP", a u8 format version, then one record per
+	packet: u32 arrival time in ms since the capture started, u32 size,
+	then the raw packet (u16 command followed by the payload).
+*/
+
+class PacketCaptureWriter
+{
+public:
+	// Errors are logged and turn the writer into a no-op
+	PacketCaptureWriter(const std::string &path);
+	DISABLE_CLASS_COPY(PacketCaptureWriter)
+
+	void write(NetworkPacket *pkt);
+
+private:
+	std::ofstream m_os;
+	u64 m_start_ms;
+};
+
+class PacketCaptureReader
+{
+public:
+	// Throws FileNotGoodException or SerializationError
+	PacketCaptureReader(const std::string &path, bool fast);
+	DISABLE_CLASS_COPY(PacketCaptureReader)
+
+	// Fills pkt with the next packet that is due, returns false if there is
+	// none. Packets are due at their recorded time after the first call,
+	// or right away in fast mode.
+	bool read(NetworkPacket *pkt);
+
+	bool finished() const { return m_finished; }
+
+private:
+	bool readHeader();
+
+	std::ifstream m_is;
+	bool m_fast;
+	bool m_finished = false;
+	// Start of the replay, set on the first call to read()
+	u64 m_start_ms = 0;
+
+	// Header of the next record, valid if m_have_next is set
+	bool m_have_next = false;
+	u32 m_next_time_ms = 0;
+	u32 m_next_size = 0;
+	std::string m_buffer;
+};
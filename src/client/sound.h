@@ -137,6 +137,18 @@ class ISoundManager
 	virtual void updateSoundPosVel(sound_handle_t sound, const v3f &pos,
 			const v3f &vel) = 0;
 
+	/**
+	 * @return Approximate size in bytes of the loaded and decoded sound data.
+	 */
+	virtual size_t getMemoryUsage() = 0;
+
+	/**
+	 * Frees decoded sounds that are not playing, least recently used first,
+	 * until `bytes` are freed. They are decoded again when played.
+	 * @return The number of bytes freed.
+	 */
+	virtual size_t freeMemory(size_t bytes) = 0;
+
 	/**
 	 * Get and reset the list of sounds that were stopped.
 	 */
@@ -183,4 +195,7 @@ class DummySoundManager final : public ISoundManager
 	void stopSound(sound_handle_t sound) override {}
 	void fadeSound(sound_handle_t sound, f32 step, f32 target_gain) override {}
 	void updateSoundPosVel(sound_handle_t sound, const v3f &pos, const v3f &vel) override {}
+
+	size_t getMemoryUsage() override { return 0; }
+	size_t freeMemory(size_t bytes) override { return 0; }
 };
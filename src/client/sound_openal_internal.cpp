@@ -27,6 +27,7 @@ with this program; ifnot, write to the Free Software Foundation, Inc.,
 #include "util/numeric.h" // myrand()
 #include "../sound.h"
 #include "filesys.h"
+#include "profiler.h"
 #include "settings.h"
 #include <algorithm>
 #include <cmath>
@@ -202,8 +203,8 @@ std::optional<OggFileDecodeInfo> RAIIOggFile::getDecodeInfo(const std::string &f
 	return ret;
 }
 
-RAIIALSoundBuffer RAIIOggFile::loadBuffer(const OggFileDecodeInfo &decode_info,
-		ALuint pcm_start, ALuint pcm_end)
+bool RAIIOggFile::decodePCM(const OggFileDecodeInfo &decode_info,
+		ALuint pcm_start, ALuint pcm_end, std::string &pcm)
 {
 	constexpr int endian = 0; // 0 for Little-Endian, 1 for Big-Endian
 	constexpr int word_size = 2; // we use s16 samples
@@ -214,35 +215,41 @@ RAIIALSoundBuffer RAIIOggFile::loadBuffer(const OggFileDecodeInfo &decode_info,
 		if (ov_pcm_seek(&m_file, pcm_start) != 0) {
 			warningstream << "Audio: Error decoding (could not seek) "
 					<< decode_info.name_for_logging << std::endl;
-			return RAIIALSoundBuffer();
+			return false;
 		}
 	}
 
 	const size_t size = static_cast<size_t>(pcm_end - pcm_start)
 			* decode_info.bytes_per_sample;
 
-	std::unique_ptr<char[]> snd_buffer(new char[size]);
+	pcm.resize(size);
 
 	// read size bytes
 	size_t read_count = 0;
 	int bitStream;
 	while (read_count < size) {
 		// Read up to a buffer's worth of decoded sound data
-		long num_bytes = ov_read(&m_file, &snd_buffer[read_count], size - read_count,
+		long num_bytes = ov_read(&m_file, &pcm[read_count], size - read_count,
 				endian, word_size, word_signed, &bitStream);
 
 		if (num_bytes <= 0) {
 			warningstream << "Audio: Error decoding "
 					<< decode_info.name_for_logging << std::endl;
-			return RAIIALSoundBuffer();
+			return false;
 		}
 
 		read_count += num_bytes;
 	}
 
+	return true;
+}
+
+static RAIIALSoundBuffer upload_pcm(const OggFileDecodeInfo &decode_info,
+		const std::string &pcm)
+{
 	// load buffer to openal
 	RAIIALSoundBuffer snd_buffer_id = RAIIALSoundBuffer::generate();
-	alBufferData(snd_buffer_id.get(), decode_info.format, &(snd_buffer[0]), size,
+	alBufferData(snd_buffer_id.get(), decode_info.format, pcm.data(), pcm.size(),
 			decode_info.freq);
 
 	ALenum error = alGetError();
@@ -255,6 +262,16 @@ RAIIALSoundBuffer RAIIOggFile::loadBuffer(const OggFileDecodeInfo &decode_info,
 	return snd_buffer_id;
 }
 
+RAIIALSoundBuffer RAIIOggFile::loadBuffer(const OggFileDecodeInfo &decode_info,
+		ALuint pcm_start, ALuint pcm_end)
+{
+	std::string pcm;
+	if (!decodePCM(decode_info, pcm_start, pcm_end, pcm))
+		return RAIIALSoundBuffer();
+
+	return upload_pcm(decode_info, pcm);
+}
+
 /*
  * SoundManagerSingleton class
  */
@@ -303,41 +320,19 @@ SoundManagerSingleton::~SoundManagerSingleton()
 	infostream << "Audio: Global Deinitialized." << std::endl;
 }
 
-/*
- * ISoundDataOpen struct
- */
-
-std::shared_ptr<ISoundDataOpen> ISoundDataOpen::fromOggFile(std::unique_ptr<RAIIOggFile> oggfile,
-		const std::string &filename_for_logging)
-{
-	// Get some information about the OGG file
-	std::optional<OggFileDecodeInfo> decode_info = oggfile->getDecodeInfo(filename_for_logging);
-	if (!decode_info.has_value()) {
-		warningstream << "Audio: Error decoding "
-				<< filename_for_logging << std::endl;
-		return nullptr;
-	}
-
-	// use duration (in seconds) to decide whether to load all at once or to stream
-	if (decode_info->length_seconds <= SOUND_DURATION_MAX_SINGLE) {
-		return std::make_shared<SoundDataOpenBuffer>(std::move(oggfile), *decode_info);
-	} else {
-		return std::make_shared<SoundDataOpenStream>(std::move(oggfile), *decode_info);
-	}
-}
-
 /*
  * SoundDataUnopenBuffer struct
  */
 
-std::shared_ptr<ISoundDataOpen> SoundDataUnopenBuffer::open(const std::string &sound_name) &&
+std::unique_ptr<RAIIOggFile> SoundDataUnopenBuffer::openOggFile(
+		const std::string &sound_name) const
 {
-	// load from m_buffer
+	// load from a copy of m_buffer, which is kept for opening the sound again
 
 	auto oggfile = std::make_unique<RAIIOggFile>();
 
 	auto buffer_source = std::make_unique<OggVorbisBufferSource>();
-	buffer_source->buf = std::move(m_buffer);
+	buffer_source->buf = m_buffer;
 
 	oggfile->m_needs_clear = true;
 	if (ov_open_callbacks(buffer_source.release(), oggfile->get(), nullptr, 0,
@@ -347,14 +342,15 @@ std::shared_ptr<ISoundDataOpen> SoundDataUnopenBuffer::open(const std::string &s
 		return nullptr;
 	}
 
-	return ISoundDataOpen::fromOggFile(std::move(oggfile), sound_name);
+	return oggfile;
 }
 
 /*
  * SoundDataUnopenFile struct
  */
 
-std::shared_ptr<ISoundDataOpen> SoundDataUnopenFile::open(const std::string &sound_name) &&
+std::unique_ptr<RAIIOggFile> SoundDataUnopenFile::openOggFile(
+		const std::string &sound_name) const
 {
 	// load from file at m_path
 
@@ -367,22 +363,17 @@ std::shared_ptr<ISoundDataOpen> SoundDataUnopenFile::open(const std::string &sou
 	}
 	oggfile->m_needs_clear = true;
 
-	return ISoundDataOpen::fromOggFile(std::move(oggfile), sound_name);
+	return oggfile;
 }
 
 /*
  * SoundDataOpenBuffer struct
  */
 
-SoundDataOpenBuffer::SoundDataOpenBuffer(std::unique_ptr<RAIIOggFile> oggfile,
-		const OggFileDecodeInfo &decode_info) : ISoundDataOpen(decode_info)
+SoundDataOpenBuffer::SoundDataOpenBuffer(const OggFileDecodeInfo &decode_info,
+		const std::string &pcm) :
+	ISoundDataOpen(decode_info), m_buffer(upload_pcm(decode_info, pcm))
 {
-	m_buffer = oggfile->loadBuffer(m_decode_info, 0, m_decode_info.length_samples);
-	if (m_buffer.get() == 0) {
-		warningstream << "SoundDataOpenBuffer: Failed to load sound \""
-				<< m_decode_info.name_for_logging << "\"" << std::endl;
-		return;
-	}
 }
 
 /*
@@ -401,6 +392,63 @@ std::tuple<ALuint, ALuint, ALuint> SoundDataOpenStream::getOrLoadBufferAt(ALuint
 	if (offset >= m_decode_info.length_samples)
 		return {0, m_decode_info.length_samples, 0};
 
+	std::vector<ContiguousBuffers>::iterator after_it;
+	if (auto found = findBufferAt(offset, after_it))
+		return *found;
+
+	return loadBufferAt(offset, after_it);
+}
+
+size_t SoundDataOpenStream::getMemoryUsage() const
+{
+	size_t num_samples = 0;
+	for (const ContiguousBuffers &bufs : m_bufferss)
+		num_samples += bufs.m_buffers.back().m_end - bufs.m_start;
+	return num_samples * m_decode_info.bytes_per_sample;
+}
+
+std::optional<std::pair<ALuint, ALuint>> SoundDataOpenStream::getIntervalToLoadAt(
+		ALuint offset)
+{
+	if (offset >= m_decode_info.length_samples)
+		return std::nullopt;
+
+	std::vector<ContiguousBuffers>::iterator after_it;
+	if (findBufferAt(offset, after_it))
+		return std::nullopt;
+
+	return getNewBufferInterval(offset, after_it);
+}
+
+bool SoundDataOpenStream::decodeInterval(ALuint pcm_start, ALuint pcm_end,
+		std::string &pcm)
+{
+	MutexAutoLock lock(m_oggfile_mutex);
+	return m_oggfile->decodePCM(m_decode_info, pcm_start, pcm_end, pcm);
+}
+
+void SoundDataOpenStream::addDecodedBuffer(ALuint pcm_start, ALuint pcm_end,
+		const std::string &pcm)
+{
+	std::vector<ContiguousBuffers>::iterator after_it;
+	if (findBufferAt(pcm_start, after_it))
+		return;
+
+	// The interval must still fit between its neighbours
+	ALuint end_before = after_it != m_bufferss.begin() ?
+			(after_it - 1)->m_buffers.back().m_end : 0;
+	ALuint start_after = after_it != m_bufferss.end() ?
+			after_it->m_start : m_decode_info.length_samples;
+	if (pcm_start < end_before || pcm_end > start_after)
+		return;
+
+	insertBuffer(pcm_start, pcm_start, pcm_end, upload_pcm(m_decode_info, pcm),
+			after_it);
+}
+
+std::optional<std::tuple<ALuint, ALuint, ALuint>> SoundDataOpenStream::findBufferAt(
+		ALuint offset, std::vector<ContiguousBuffers>::iterator &after_it)
+{
 	// find the right-most ContiguousBuffers, such that `m_start <= offset`
 	// equivalent: the first element from the right such that `!(m_start > offset)`
 	// (from the right, `offset` is a lower bound to the `m_start`s)
@@ -422,7 +470,8 @@ std::tuple<ALuint, ALuint, ALuint> SoundDataOpenStream::getOrLoadBufferAt(ALuint
 		if (upper_it != bufs.end()) {
 			ALuint start = upper_it == bufs.begin() ? lower_rit->m_start
 					: (upper_it - 1)->m_end;
-			return {upper_it->m_buffer.get(), upper_it->m_end, offset - start};
+			return std::make_tuple(upper_it->m_buffer.get(), upper_it->m_end,
+					offset - start);
 		}
 	}
 
@@ -430,13 +479,13 @@ std::tuple<ALuint, ALuint, ALuint> SoundDataOpenStream::getOrLoadBufferAt(ALuint
 	// or no loaded buffer (that starts before or at `offset`) ends after `offset`
 
 	// lower_rit, but not reverse and 1 farther
-	auto after_it = m_bufferss.begin() + (m_bufferss.rend() - lower_rit);
+	after_it = m_bufferss.begin() + (m_bufferss.rend() - lower_rit);
 
-	return loadBufferAt(offset, after_it);
+	return std::nullopt;
 }
 
-std::tuple<ALuint, ALuint, ALuint> SoundDataOpenStream::loadBufferAt(ALuint offset,
-		std::vector<ContiguousBuffers>::iterator after_it)
+std::pair<ALuint, ALuint> SoundDataOpenStream::getNewBufferInterval(ALuint offset,
+		std::vector<ContiguousBuffers>::iterator after_it) const
 {
 	bool has_before = after_it != m_bufferss.begin();
 	bool has_after = after_it != m_bufferss.end();
@@ -446,10 +495,6 @@ std::tuple<ALuint, ALuint, ALuint> SoundDataOpenStream::loadBufferAt(ALuint offs
 
 	const ALuint min_buf_len_samples = m_decode_info.freq * MIN_STREAM_BUFFER_LENGTH;
 
-	//
-	// 1) Find the actual start and end of the new buffer
-	//
-
 	ALuint new_buf_start = offset;
 	ALuint new_buf_end = offset + min_buf_len_samples;
 
@@ -472,17 +517,18 @@ std::tuple<ALuint, ALuint, ALuint> SoundDataOpenStream::loadBufferAt(ALuint offs
 	if (start_after - new_buf_end < min_buf_len_samples)
 		new_buf_end = start_after;
 
-	//
-	// 2) Load [new_buf_start, new_buf_end)
-	//
+	return {new_buf_start, new_buf_end};
+}
 
-	// If it fails, we get a 0-buffer. we store it and won't try loading again
-	RAIIALSoundBuffer new_buf = m_oggfile->loadBuffer(m_decode_info, new_buf_start,
-			new_buf_end);
+std::tuple<ALuint, ALuint, ALuint> SoundDataOpenStream::insertBuffer(ALuint offset,
+		ALuint new_buf_start, ALuint new_buf_end, RAIIALSoundBuffer new_buf,
+		std::vector<ContiguousBuffers>::iterator after_it)
+{
+	bool has_before = after_it != m_bufferss.begin();
+	bool has_after = after_it != m_bufferss.end();
 
-	//
-	// 3) Insert before after_it
-	//
+	ALuint end_before = has_before ? (after_it - 1)->m_buffers.back().m_end : 0;
+	ALuint start_after = has_after ? after_it->m_start : m_decode_info.length_samples;
 
 	// Choose ContiguousBuffers to add the new SoundBufferUntil into:
 	// * `after_it - 1` (=before) if existent and if there's no space between its
@@ -507,6 +553,83 @@ std::tuple<ALuint, ALuint, ALuint> SoundDataOpenStream::loadBufferAt(ALuint offs
 	return {it->m_buffers[new_buf_i].m_buffer.get(), new_buf_end, offset - new_buf_start};
 }
 
+std::tuple<ALuint, ALuint, ALuint> SoundDataOpenStream::loadBufferAt(ALuint offset,
+		std::vector<ContiguousBuffers>::iterator after_it)
+{
+	// 1) Find the actual start and end of the new buffer
+	auto [new_buf_start, new_buf_end] = getNewBufferInterval(offset, after_it);
+
+	// 2) Load [new_buf_start, new_buf_end)
+	// If it fails, we get a 0-buffer. we store it and won't try loading again
+	RAIIALSoundBuffer new_buf;
+	{
+		ScopeProfiler sp(g_profiler, "Sound: main thread decode", SPT_ADD);
+		std::string pcm;
+		if (decodeInterval(new_buf_start, new_buf_end, pcm))
+			new_buf = upload_pcm(m_decode_info, pcm);
+	}
+
+	// 3) Insert before after_it
+	return insertBuffer(offset, new_buf_start, new_buf_end, std::move(new_buf),
+			after_it);
+}
+
+/*
+ * SoundDecodeJob struct
+ */
+
+void SoundDecodeJob::run()
+{
+	if (stream) {
+		ok = stream->decodeInterval(pcm_start, pcm_end, pcm);
+		return;
+	}
+
+	std::unique_ptr<RAIIOggFile> file = unopen->openOggFile(sound_name);
+	if (!file)
+		return;
+
+	// Get some information about the OGG file
+	decode_info = file->getDecodeInfo(sound_name);
+	if (!decode_info.has_value()) {
+		warningstream << "Audio: Error decoding "
+				<< sound_name << std::endl;
+		return;
+	}
+
+	// use duration (in seconds) to decide whether to load all at once or to stream
+	if (decode_info->length_seconds <= SOUND_DURATION_MAX_SINGLE) {
+		ok = file->decodePCM(*decode_info, 0, decode_info->length_samples, pcm);
+		if (!ok) {
+			warningstream << "SoundDecodeJob: Failed to load sound \""
+					<< sound_name << "\"" << std::endl;
+		}
+	} else {
+		oggfile = std::move(file);
+		ok = true;
+	}
+}
+
+/*
+ * SoundDecodeThread class
+ */
+
+void *SoundDecodeThread::run()
+{
+	while (!stopRequested()) {
+		std::unique_ptr<SoundDecodeJob> job = m_jobs.pop_frontNoEx(100);
+		if (!job)
+			continue;
+
+		{
+			ScopeProfiler sp(g_profiler, "Sound: decode thread", SPT_ADD);
+			job->run();
+		}
+		m_results.push_back(std::move(job));
+	}
+	return nullptr;
+}
+
 /*
  * PlayingSound class
  */
@@ -747,6 +870,8 @@ void OpenALSoundManager::stepStreams(f32 dtime)
 		if (!snd->stepStream())
 			continue;
 
+		decodeStreamAhead(*snd);
+
 		// sound still lives and needs more stream-stepping => add to next bigstep
 		m_sounds_streaming_next_bigstep.push_back(std::move(wptr));
 	}
@@ -778,26 +903,145 @@ void OpenALSoundManager::doFades(f32 dtime)
 	}
 }
 
-std::shared_ptr<ISoundDataOpen> OpenALSoundManager::openSingleSound(const std::string &sound_name)
+std::shared_ptr<ISoundDataOpen> OpenALSoundManager::requestOpenSound(
+		const std::string &sound_name)
 {
 	// if already open, nothing to do
 	auto it = m_sound_datas_open.find(sound_name);
-	if (it != m_sound_datas_open.end())
-		return it->second;
+	if (it != m_sound_datas_open.end()) {
+		it->second.last_used = ++m_open_sound_clock;
+		return it->second.data;
+	}
+
+	if (m_sounds_opening.count(sound_name) != 0)
+		return nullptr;
 
 	// find unopened data
 	auto it_unopen = m_sound_datas_unopen.find(sound_name);
 	if (it_unopen == m_sound_datas_unopen.end())
 		return nullptr;
-	std::unique_ptr<ISoundDataUnopen> unopn_snd = std::move(it_unopen->second);
-	m_sound_datas_unopen.erase(it_unopen);
 
-	// open
-	std::shared_ptr<ISoundDataOpen> opn_snd = std::move(*unopn_snd).open(sound_name);
-	if (!opn_snd)
-		return nullptr;
-	m_sound_datas_open.emplace(sound_name, opn_snd);
-	return opn_snd;
+	// open on the decode thread
+	auto job = std::make_unique<SoundDecodeJob>();
+	job->sound_name = sound_name;
+	job->unopen = it_unopen->second;
+	m_decode_thread.enqueue(std::move(job));
+	m_sounds_opening.insert(sound_name);
+	return nullptr;
+}
+
+void OpenALSoundManager::processDecodeResults()
+{
+	std::vector<std::pair<sound_handle_t, PendingSound>> ready;
+	bool opened_any = false;
+
+	while (std::unique_ptr<SoundDecodeJob> job = m_decode_thread.getResult()) {
+		if (job->stream) {
+			job->stream->m_decoding_ahead = false;
+			if (job->ok)
+				job->stream->addDecodedBuffer(job->pcm_start, job->pcm_end, job->pcm);
+			continue;
+		}
+
+		m_sounds_opening.erase(job->sound_name);
+		if (job->ok) {
+			std::shared_ptr<ISoundDataOpen> data;
+			if (job->oggfile) {
+				data = std::make_shared<SoundDataOpenStream>(std::move(job->oggfile),
+						*job->decode_info);
+			} else {
+				data = std::make_shared<SoundDataOpenBuffer>(*job->decode_info,
+						job->pcm);
+			}
+			m_sound_datas_open[job->sound_name] = OpenSound{std::move(data),
+					++m_open_sound_clock};
+			opened_any = true;
+		} else {
+			// it can't be opened, getLoadedSoundNameFromGroup removes it
+			// from its groups
+			m_sound_datas_unopen.erase(job->sound_name);
+		}
+
+		for (auto it = m_sounds_pending.begin(); it != m_sounds_pending.end();) {
+			if (it->second.sound_name == job->sound_name) {
+				ready.emplace_back(it->first, std::move(it->second));
+				it = m_sounds_pending.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	for (auto &it : ready) {
+		PendingSound &pending = it.second;
+		if (m_sound_datas_open.count(pending.sound_name) == 0) {
+			// failed, choose another sound from the group
+			pending.sound_name = getLoadedSoundNameFromGroup(pending.group_name);
+			if (pending.sound_name.empty()) {
+				reportRemovedSound(it.first);
+				continue;
+			}
+		}
+		startOrQueueSound(it.first, std::move(pending));
+	}
+
+	if (opened_any)
+		evictOpenSounds();
+}
+
+void OpenALSoundManager::decodeStreamAhead(PlayingSound &sound)
+{
+	auto stream = std::static_pointer_cast<SoundDataOpenStream>(sound.getData());
+	if (stream->m_decoding_ahead)
+		return;
+
+	std::optional<std::pair<ALuint, ALuint>> interval =
+			stream->getIntervalToLoadAt(sound.getNextSamplePos());
+	if (!interval.has_value())
+		return;
+
+	auto job = std::make_unique<SoundDecodeJob>();
+	job->sound_name = stream->m_decode_info.name_for_logging;
+	job->stream = stream;
+	job->pcm_start = interval->first;
+	job->pcm_end = interval->second;
+	stream->m_decoding_ahead = true;
+	m_decode_thread.enqueue(std::move(job));
+}
+
+size_t OpenALSoundManager::evictOpenSounds(size_t max_bytes)
+{
+	size_t total_bytes = 0;
+	std::vector<std::pair<u64, std::string>> evictable;
+	for (const auto &it : m_sound_datas_open) {
+		total_bytes += it.second.data->getMemoryUsage();
+		// only referenced here => not playing and not being decoded
+		if (it.second.data.use_count() == 1)
+			evictable.emplace_back(it.second.last_used, it.first);
+	}
+	if (total_bytes <= max_bytes)
+		return 0;
+
+	// least recently used first
+	std::sort(evictable.begin(), evictable.end());
+
+	size_t num_evicted = 0;
+	size_t freed_bytes = 0;
+	for (const auto &it : evictable) {
+		if (total_bytes <= max_bytes)
+			break;
+		auto it_open = m_sound_datas_open.find(it.second);
+		const size_t bytes = it_open->second.data->getMemoryUsage();
+		total_bytes -= bytes;
+		freed_bytes += bytes;
+		m_sound_datas_open.erase(it_open);
+		++num_evicted;
+	}
+
+	verbosestream << "OpenALSoundManager: Evicted " << num_evicted
+			<< " open sounds, " << total_bytes << " bytes of sound data left"
+			<< std::endl;
+	return freed_bytes;
 }
 
 std::string OpenALSoundManager::getLoadedSoundNameFromGroup(const std::string &group_name)
@@ -815,14 +1059,15 @@ std::string OpenALSoundManager::getLoadedSoundNameFromGroup(const std::string &g
 		chosen_sound_name = group_sounds[j];
 
 		// find chosen one
-		std::shared_ptr<ISoundDataOpen> snd = openSingleSound(chosen_sound_name);
-		if (snd)
+		if (m_sound_datas_open.count(chosen_sound_name) != 0 ||
+				m_sound_datas_unopen.count(chosen_sound_name) != 0)
 			break;
 
 		// it doesn't exist
 		// remove it from the group and try again
 		group_sounds[j] = std::move(group_sounds.back());
 		group_sounds.pop_back();
+		chosen_sound_name.clear();
 	}
 
 	return chosen_sound_name;
@@ -845,21 +1090,14 @@ std::string OpenALSoundManager::getOrLoadLoadedSoundNameFromGroup(const std::str
 }
 
 std::shared_ptr<PlayingSound> OpenALSoundManager::createPlayingSound(
-		const std::string &sound_name, bool loop, f32 volume, f32 pitch,
-		f32 start_time, const std::optional<std::pair<v3f, v3f>> &pos_vel_opt)
+		std::shared_ptr<ISoundDataOpen> lsnd, const std::string &sound_name,
+		bool loop, f32 volume, f32 pitch, f32 start_time,
+		const std::optional<std::pair<v3f, v3f>> &pos_vel_opt)
 {
 	infostream << "OpenALSoundManager: Creating playing sound \"" << sound_name
 			<< "\"" << std::endl;
 	warn_if_al_error("before createPlayingSound");
 
-	std::shared_ptr<ISoundDataOpen> lsnd = openSingleSound(sound_name);
-	if (!lsnd) {
-		// does not happen because of the call to getLoadedSoundNameFromGroup
-		errorstream << "OpenALSoundManager::createPlayingSound: Sound \""
-				<< sound_name << "\" disappeared." << std::endl;
-		return nullptr;
-	}
-
 	if (lsnd->m_decode_info.is_stereo && pos_vel_opt.has_value()) {
 		warningstream << "OpenALSoundManager::createPlayingSound: "
 				<< "Creating positional stereo sound \"" << sound_name << "\"."
@@ -923,22 +1161,61 @@ void OpenALSoundManager::playSoundGeneric(sound_handle_t id, const std::string &
 		start_time = 0.0f;
 	}
 
-	// play it
-	std::shared_ptr<PlayingSound> sound = createPlayingSound(sound_name, loop,
-			volume, pitch, start_time, pos_vel_opt);
+	// play it, or wait for it to be opened
+	PendingSound pending;
+	pending.group_name = group_name;
+	pending.sound_name = sound_name;
+	pending.loop = loop;
+	pending.volume = volume;
+	pending.fade = fade > 0.0f ? fade : 0.0f;
+	pending.target_fade_volume = target_fade_volume;
+	pending.pitch = pitch;
+	pending.start_time = start_time;
+	pending.pos_vel_opt = pos_vel_opt;
+	pending.request_time_ms = porting::getTimeMs();
+	startOrQueueSound(id, std::move(pending));
+
+	// open the other sounds of the group, so that they are ready when chosen
+	for (const std::string &other_name : m_sound_groups[group_name])
+		requestOpenSound(other_name);
+}
+
+void OpenALSoundManager::startOrQueueSound(sound_handle_t id, PendingSound &&pending)
+{
+	std::shared_ptr<ISoundDataOpen> lsnd = requestOpenSound(pending.sound_name);
+	if (!lsnd) {
+		if (m_sounds_opening.count(pending.sound_name) == 0) {
+			// does not happen because of the call to getLoadedSoundNameFromGroup
+			errorstream << "OpenALSoundManager::startOrQueueSound: Sound \""
+					<< pending.sound_name << "\" disappeared." << std::endl;
+			reportRemovedSound(id);
+			return;
+		}
+		m_sounds_pending.insert_or_assign(id, std::move(pending));
+		return;
+	}
+
+	g_profiler->avg("Sound: start latency [ms]",
+			porting::getTimeMs() - pending.request_time_ms);
+
+	std::shared_ptr<PlayingSound> sound = createPlayingSound(std::move(lsnd),
+			pending.sound_name, pending.loop, pending.volume, pending.pitch,
+			pending.start_time, pending.pos_vel_opt);
 	if (!sound) {
 		reportRemovedSound(id);
 		return;
 	}
 
 	// add to streaming sounds if streaming
-	if (sound->isStreaming())
+	if (sound->isStreaming()) {
+		decodeStreamAhead(*sound);
 		m_sounds_streaming_next_bigstep.push_back(sound);
+	}
 
 	m_sounds_playing.emplace(id, std::move(sound));
 
-	if (fade > 0.0f)
-		fadeSound(id, fade, target_fade_volume);
+	if (pending.fade != 0.0f)
+		fadeSound(id, pending.fade, pending.target_fade_volume);
 }
 
 int OpenALSoundManager::removeDeadSounds()
@@ -969,18 +1246,25 @@ OpenALSoundManager::OpenALSoundManager(SoundManagerSingleton *smg,
 {
 	SANITY_CHECK(!!m_fallback_path_provider);
 
+	m_decode_thread.start();
+
 	infostream << "Audio: Initialized: OpenAL " << std::endl;
 }
 
 OpenALSoundManager::~OpenALSoundManager()
 {
 	infostream << "Audio: Deinitializing..." << std::endl;
+
+	m_decode_thread.stop();
+	m_decode_thread.wait();
 }
 
 /* Interface */
 
 void OpenALSoundManager::step(f32 dtime)
 {
+	processDecodeResults();
+
 	m_time_until_dead_removal -= dtime;
 	if (m_time_until_dead_removal <= 0.0f) {
 		if (!m_sounds_playing.empty()) {
@@ -994,9 +1278,11 @@ void OpenALSoundManager::step(f32 dtime)
 
 		int num_deleted_sounds = removeDeadSounds();
 
-		if (num_deleted_sounds != 0)
+		if (num_deleted_sounds != 0) {
 			verbosestream << "OpenALSoundManager::step(): Deleted "
 					<< num_deleted_sounds << " dead playing sounds." << std::endl;
+			evictOpenSounds();
+		}
 
 		m_time_until_dead_removal = REMOVE_DEAD_SOUNDS_INTERVAL;
 	}
@@ -1046,7 +1332,7 @@ void OpenALSoundManager::setListenerGain(f32 gain)
 bool OpenALSoundManager::loadSoundFile(const std::string &name, const std::string &filepath)
 {
 	// do not add twice
-	if (m_sound_datas_open.count(name) != 0 || m_sound_datas_unopen.count(name) != 0)
+	if (m_sound_datas_unopen.count(name) != 0)
 		return false;
 
 	// coarse check
@@ -1054,18 +1340,18 @@ bool OpenALSoundManager::loadSoundFile(const std::string &name, const std::strin
 		return false;
 
 	// remember for lazy loading
-	m_sound_datas_unopen.emplace(name, std::make_unique<SoundDataUnopenFile>(filepath));
+	m_sound_datas_unopen.emplace(name, std::make_shared<SoundDataUnopenFile>(filepath));
 	return true;
 }
 
 bool OpenALSoundManager::loadSoundData(const std::string &name, std::string &&filedata)
 {
 	// do not add twice
-	if (m_sound_datas_open.count(name) != 0 || m_sound_datas_unopen.count(name) != 0)
+	if (m_sound_datas_unopen.count(name) != 0)
 		return false;
 
 	// remember for lazy loading
-	m_sound_datas_unopen.emplace(name, std::make_unique<SoundDataUnopenBuffer>(std::move(filedata)));
+	m_sound_datas_unopen.emplace(name, std::make_shared<SoundDataUnopenBuffer>(std::move(filedata)));
 	return true;
 }
 
@@ -1099,6 +1385,7 @@ void OpenALSoundManager::playSoundAt(sound_handle_t id, const SoundSpec &spec,
 void OpenALSoundManager::stopSound(sound_handle_t sound)
 {
 	m_sounds_playing.erase(sound);
+	m_sounds_pending.erase(sound);
 	reportRemovedSound(sound);
 }
 
@@ -1108,8 +1395,15 @@ void OpenALSoundManager::fadeSound(sound_handle_t soundid, f32 step, f32 target_
 	if (step == 0.0f)
 		return;
 	auto sound_it = m_sounds_playing.find(soundid);
-	if (sound_it == m_sounds_playing.end())
+	if (sound_it == m_sounds_playing.end()) {
+		// Fade once it starts
+		auto pending_it = m_sounds_pending.find(soundid);
+		if (pending_it != m_sounds_pending.end()) {
+			pending_it->second.fade = step;
+			pending_it->second.target_fade_volume = target_gain;
+		}
 		return; // No sound to fade
+	}
 	PlayingSound &sound = *sound_it->second;
 	if (sound.fade(step, target_gain))
 		m_sounds_fading.emplace_back(sound_it->second);
@@ -1122,7 +1416,30 @@ void OpenALSoundManager::updateSoundPosVel(sound_handle_t id, const v3f &pos_,
 	v3f vel = swap_handedness(vel_);
 
 	auto i = m_sounds_playing.find(id);
-	if (i == m_sounds_playing.end())
+	if (i == m_sounds_playing.end()) {
+		auto pending_it = m_sounds_pending.find(id);
+		if (pending_it != m_sounds_pending.end() &&
+				pending_it->second.pos_vel_opt.has_value())
+			pending_it->second.pos_vel_opt = std::make_pair(pos, vel);
 		return;
+	}
 	i->second->updatePosVel(pos, vel);
 }
+
+size_t OpenALSoundManager::getMemoryUsage()
+{
+	size_t total_bytes = 0;
+	for (const auto &it : m_sound_datas_unopen)
+		total_bytes += it.second->getMemoryUsage();
+	for (const auto &it : m_sound_datas_open)
+		total_bytes += it.second.data->getMemoryUsage();
+	return total_bytes;
+}
+
+size_t OpenALSoundManager::freeMemory(size_t bytes)
+{
+	size_t open_bytes = 0;
+	for (const auto &it : m_sound_datas_open)
+		open_bytes += it.second.data->getMemoryUsage();
+	return evictOpenSounds(open_bytes > bytes ? open_bytes - bytes : 0);
+}
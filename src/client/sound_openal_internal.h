@@ -27,7 +27,9 @@ with this program; ifnot, write to the Free Software Foundation, Inc.,
 #include "log.h"
 #include "porting.h"
 #include "sound_openal.h"
+#include "threading/thread.h"
 #include "util/basic_macros.h"
+#include "util/container.h"
 
 #if defined(_WIN32)
 	#include <al.h>
@@ -45,8 +47,11 @@ with this program; ifnot, write to the Free Software Foundation, Inc.,
 #endif
 #include <vorbis/vorbisfile.h>
 
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -85,15 +90,21 @@ with this program; ifnot, write to the Free Software Foundation, Inc.,
  *   * Step 3.2:
  *     We choose one random sound name from the given group.
  *   * Step 3.3:
- *     We open the sound (see `openSingleSound`).
+ *     We open the sound (see `requestOpenSound`).
  *     If the sound is already open (in `m_sound_datas_open`), we take that one.
- *     Otherwise we open it by calling `ISoundDataUnopen::open`. We choose (by
+ *     Otherwise the `SoundDecodeThread` opens it with
+ *     `ISoundDataUnopen::openOggFile`, and the play request waits in
+ *     `m_sounds_pending` until the result is picked up in `step`. We choose (by
  *     sound length), whether it's a single-buffer (`SoundDataOpenBuffer`) or
  *     streamed (`SoundDataOpenStream`) sound.
- *     Single-buffer sounds are always completely loaded. Streamed sounds can be
- *     partially loaded.
- *     The sound is erased from `m_sound_datas_unopen` and added to `m_sound_datas_open`.
- *     Open sounds are kept forever.
+ *     Single-buffer sounds are completely decoded by the thread. Streamed sounds
+ *     can be partially loaded.
+ *     The other sounds of the group are opened as well, so that the next play
+ *     of the group does not have to wait.
+ *     The sound stays in `m_sound_datas_unopen` and is added to `m_sound_datas_open`.
+ *     Open sounds that are not playing are evicted, least recently used first,
+ *     once they take more than SOUND_PCM_CACHE_MAX_BYTES. They are opened
+ *     again when needed.
  *   * Step 3.4:
  *     We create the new `PlayingSound`. It has a `shared_ptr` to its open sound.
  *     If the open sound is streaming, the playing sound needs to be stepped using
@@ -129,6 +140,10 @@ with this program; ifnot, write to the Free Software Foundation, Inc.,
  * other sounds that may have taken long to stepStream(), and sounds being played
  * faster due to Doppler effect.
  *
+ * After a buffer is enqueued, the buffer after it is decoded ahead by the
+ * `SoundDecodeThread` (see `decodeStreamAhead`), so that stepStream() normally
+ * only has to upload already decoded data.
+ *
  */
 
 // constants
@@ -141,6 +156,9 @@ constexpr f32 SOUND_DURATION_MAX_SINGLE = 3.0f;
 constexpr f32 MIN_STREAM_BUFFER_LENGTH = 1.0f;
 // duration in seconds of one bigstep
 constexpr f32 STREAM_BIGSTEP_TIME = 0.3f;
+// size in bytes of decoded data of open sounds above which sounds that are
+// not playing are evicted
+constexpr size_t SOUND_PCM_CACHE_MAX_BYTES = 64 * 1024 * 1024;
 
 static_assert(MIN_STREAM_BUFFER_LENGTH > STREAM_BIGSTEP_TIME * 2.0f,
 		"See [Streaming of sounds].");
@@ -230,6 +248,18 @@ struct RAIIOggFile {
 
 	std::optional<OggFileDecodeInfo> getDecodeInfo(const std::string &filename_for_logging);
 
+	/**
+	 * Decodes exactly the specified interval of PCM-data.
+	 *
+	 * @param decode_info Cached meta information of the file.
+	 * @param pcm_start First sample in the interval.
+	 * @param pcm_end One after last sample of the interval (=> exclusive).
+	 * @param pcm Receives the decoded s16 samples.
+	 * @return Whether decoding succeeded.
+	 */
+	bool decodePCM(const OggFileDecodeInfo &decode_info, ALuint pcm_start,
+			ALuint pcm_end, std::string &pcm);
+
 	/**
 	 * Main function for loading ogg vorbis sounds.
 	 * Loads exactly the specified interval of PCM-data, and creates an OpenAL
@@ -315,8 +345,10 @@ struct ISoundDataOpen
 	 */
 	virtual std::tuple<ALuint, ALuint, ALuint> getOrLoadBufferAt(ALuint offset) = 0;
 
-	static std::shared_ptr<ISoundDataOpen> fromOggFile(std::unique_ptr<RAIIOggFile> oggfile,
-		const std::string &filename_for_logging);
+	/**
+	 * @return Size in bytes of the PCM-data loaded into OpenAL buffers.
+	 */
+	virtual size_t getMemoryUsage() const = 0;
 };
 
 /**
@@ -326,9 +358,12 @@ struct ISoundDataUnopen
 {
 	virtual ~ISoundDataUnopen() = default;
 
-	// Note: The ISoundDataUnopen is moved (see &&). It is not meant to be kept
-	// after opening.
-	virtual std::shared_ptr<ISoundDataOpen> open(const std::string &sound_name) && = 0;
+	// Note: Called from the SoundDecodeThread. The ISoundDataUnopen is kept,
+	// so that the sound can be opened again after it was evicted.
+	virtual std::unique_ptr<RAIIOggFile> openOggFile(const std::string &sound_name) const = 0;
+
+	// Size in bytes of the encoded data held in memory
+	virtual size_t getMemoryUsage() const { return 0; }
 };
 
 /**
@@ -340,7 +375,9 @@ struct SoundDataUnopenBuffer final : ISoundDataUnopen
 
 	explicit SoundDataUnopenBuffer(std::string &&buffer) : m_buffer(std::move(buffer)) {}
 
-	std::shared_ptr<ISoundDataOpen> open(const std::string &sound_name) && override;
+	std::unique_ptr<RAIIOggFile> openOggFile(const std::string &sound_name) const override;
+
+	size_t getMemoryUsage() const override { return m_buffer.size(); }
 };
 
 /**
@@ -352,7 +389,7 @@ struct SoundDataUnopenFile final : ISoundDataUnopen
 
 	explicit SoundDataUnopenFile(const std::string &path) : m_path(path) {}
 
-	std::shared_ptr<ISoundDataOpen> open(const std::string &sound_name) && override;
+	std::unique_ptr<RAIIOggFile> openOggFile(const std::string &sound_name) const override;
 };
 
 /**
@@ -363,8 +400,8 @@ struct SoundDataOpenBuffer final : ISoundDataOpen
 {
 	RAIIALSoundBuffer m_buffer;
 
-	SoundDataOpenBuffer(std::unique_ptr<RAIIOggFile> oggfile,
-			const OggFileDecodeInfo &decode_info);
+	// Uploads the completely decoded PCM-data
+	SoundDataOpenBuffer(const OggFileDecodeInfo &decode_info, const std::string &pcm);
 
 	bool isStreaming() const noexcept override { return false; }
 
@@ -374,6 +411,11 @@ struct SoundDataOpenBuffer final : ISoundDataOpen
 			return {0, m_decode_info.length_samples, 0};
 		return {m_buffer.get(), m_decode_info.length_samples, offset};
 	}
+
+	size_t getMemoryUsage() const override
+	{
+		return m_decode_info.length_samples * m_decode_info.bytes_per_sample;
+	}
 };
 
 /**
@@ -404,9 +446,13 @@ struct SoundDataOpenStream final : ISoundDataOpen
 		std::vector<SoundBufferUntil> m_buffers;
 	};
 
+	// Decoding happens on the main thread and on the SoundDecodeThread
+	std::mutex m_oggfile_mutex;
 	std::unique_ptr<RAIIOggFile> m_oggfile;
 	// A sorted vector of non-overlapping, non-contiguous `ContiguousBuffers`s.
 	std::vector<ContiguousBuffers> m_bufferss;
+	// Whether the SoundDecodeThread is decoding a buffer of this sound
+	bool m_decoding_ahead = false;
 
 	SoundDataOpenStream(std::unique_ptr<RAIIOggFile> oggfile,
 			const OggFileDecodeInfo &decode_info);
@@ -415,7 +461,44 @@ struct SoundDataOpenStream final : ISoundDataOpen
 
 	std::tuple<ALuint, ALuint, ALuint> getOrLoadBufferAt(ALuint offset) override;
 
+	size_t getMemoryUsage() const override;
+
+	/**
+	 * Gives the interval that getOrLoadBufferAt would load for `offset`.
+	 *
+	 * @return `{pcm_start, pcm_end}`, or nullopt if that buffer is already
+	 *         loaded or `offset` is invalid.
+	 */
+	std::optional<std::pair<ALuint, ALuint>> getIntervalToLoadAt(ALuint offset);
+
+	/**
+	 * Decodes an interval from getIntervalToLoadAt. Thread-safe.
+	 */
+	bool decodeInterval(ALuint pcm_start, ALuint pcm_end, std::string &pcm);
+
+	/**
+	 * Adds a buffer for an interval decoded with decodeInterval. Nothing
+	 * happens if the interval was loaded otherwise in the meantime.
+	 */
+	void addDecodedBuffer(ALuint pcm_start, ALuint pcm_end, const std::string &pcm);
+
 private:
+	// Finds the loaded buffer containing offset (same as getOrLoadBufferAt).
+	// If there is none, returns nullopt and sets after_it to the
+	// ContiguousBuffers before which a buffer for offset is to be inserted.
+	std::optional<std::tuple<ALuint, ALuint, ALuint>> findBufferAt(ALuint offset,
+			std::vector<ContiguousBuffers>::iterator &after_it);
+
+	// Interval of the buffer to load for offset, see loadBufferAt
+	std::pair<ALuint, ALuint> getNewBufferInterval(ALuint offset,
+			std::vector<ContiguousBuffers>::iterator after_it) const;
+
+	// Inserts a buffer for [new_buf_start, new_buf_end) before after_it
+	// returns same as getOrLoadBufferAt
+	std::tuple<ALuint, ALuint, ALuint> insertBuffer(ALuint offset,
+			ALuint new_buf_start, ALuint new_buf_end, RAIIALSoundBuffer new_buf,
+			std::vector<ContiguousBuffers>::iterator after_it);
+
 	// offset must be before after_it's m_start and after (after_it-1)'s last m_end
 	// new buffer will be inserted into m_bufferss before after_it
 	// returns same as getOrLoadBufferAt
@@ -424,6 +507,60 @@ struct SoundDataOpenStream final : ISoundDataOpen
 };
 
 
+/**
+ * Work item of the SoundDecodeThread. Either opens a sound (and decodes it
+ * completely if it is not streamed), or decodes the next buffer of a stream.
+ */
+struct SoundDecodeJob
+{
+	std::string sound_name;
+
+	// To open a sound
+	std::shared_ptr<ISoundDataUnopen> unopen;
+
+	// To decode [pcm_start, pcm_end) of a stream
+	std::shared_ptr<SoundDataOpenStream> stream;
+	ALuint pcm_start = 0;
+	ALuint pcm_end = 0;
+
+	// Results
+	bool ok = false;
+	std::optional<OggFileDecodeInfo> decode_info;
+	std::unique_ptr<RAIIOggFile> oggfile; // if the opened sound is streamed
+	std::string pcm;
+
+	void run();
+};
+
+/**
+ * Runs SoundDecodeJobs, so that vorbis decoding does not stall the main thread.
+ * No OpenAL calls happen here, buffers are uploaded by the main thread.
+ */
+class SoundDecodeThread final : public Thread
+{
+public:
+	SoundDecodeThread() : Thread("SoundDecode") {}
+
+	void enqueue(std::unique_ptr<SoundDecodeJob> job)
+	{
+		m_jobs.push_back(std::move(job));
+	}
+
+	// Returns a finished job or nullptr
+	std::unique_ptr<SoundDecodeJob> getResult()
+	{
+		return m_results.pop_frontNoEx(0);
+	}
+
+protected:
+	void *run() override;
+
+private:
+	MutexedQueue<std::unique_ptr<SoundDecodeJob>> m_jobs;
+	MutexedQueue<std::unique_ptr<SoundDecodeJob>> m_results;
+};
+
+
 /**
  * A sound that is currently played.
  * Can be streaming.
@@ -459,6 +596,16 @@ class PlayingSound final
 	// return false means streaming finished
 	bool stepStream();
 
+	const std::shared_ptr<ISoundDataOpen> &getData() const noexcept { return m_data; }
+
+	// Position of the next buffer to enqueue, for decoding it ahead
+	ALuint getNextSamplePos() const noexcept
+	{
+		if (m_looping && m_next_sample_pos == m_data->m_decode_info.length_samples)
+			return 0;
+		return m_next_sample_pos;
+	}
+
 	// retruns true if it wasn't fading already
 	bool fade(f32 step, f32 target_gain) noexcept;
 
@@ -520,14 +667,41 @@ class OpenALSoundManager final : public ISoundManager
 	// time in seconds until which removeDeadSounds will be called again
 	f32 m_time_until_dead_removal = REMOVE_DEAD_SOUNDS_INTERVAL;
 
+	struct OpenSound {
+		std::shared_ptr<ISoundDataOpen> data;
+		// value of m_open_sound_clock at the last use, for eviction
+		u64 last_used;
+	};
+
+	/**
+	 * A play request that waits for its sound to be opened.
+	 */
+	struct PendingSound {
+		std::string group_name;
+		std::string sound_name;
+		bool loop;
+		f32 volume;
+		f32 fade;
+		f32 target_fade_volume;
+		f32 pitch;
+		f32 start_time;
+		std::optional<std::pair<v3f, v3f>> pos_vel_opt;
+		u64 request_time_ms;
+	};
+
 	// loaded sounds
-	std::unordered_map<std::string, std::unique_ptr<ISoundDataUnopen>> m_sound_datas_unopen;
-	std::unordered_map<std::string, std::shared_ptr<ISoundDataOpen>> m_sound_datas_open;
+	std::unordered_map<std::string, std::shared_ptr<ISoundDataUnopen>> m_sound_datas_unopen;
+	std::unordered_map<std::string, OpenSound> m_sound_datas_open;
+	u64 m_open_sound_clock = 0;
+	// names of sounds that are being opened by m_decode_thread
+	std::unordered_set<std::string> m_sounds_opening;
 	// sound groups
 	std::unordered_map<std::string, std::vector<std::string>> m_sound_groups;
 
 	// currently playing sounds
 	std::unordered_map<sound_handle_t, std::shared_ptr<PlayingSound>> m_sounds_playing;
+	// sounds waiting for their data to be opened
+	std::unordered_map<sound_handle_t, PendingSound> m_sounds_pending;
 
 	// streamed sounds
 	std::vector<std::weak_ptr<PlayingSound>> m_sounds_streaming_current_bigstep;
@@ -540,25 +714,41 @@ class OpenALSoundManager final : public ISoundManager
 	// if true, all sounds will be directly paused after creation
 	bool m_is_paused = false;
 
+	// declared last, so that it is stopped before anything else is destroyed
+	SoundDecodeThread m_decode_thread;
+
 private:
 	void stepStreams(f32 dtime);
 	void doFades(f32 dtime);
 
 	/**
 	 * Gives the open sound for a loaded sound.
-	 * Opens the sound if currently unopened.
+	 * If it is currently unopened, it is opened on the SoundDecodeThread.
 	 *
 	 * @param sound_name Name of the sound.
-	 * @return The open sound.
+	 * @return The open sound, or nullptr if it is not open yet.
 	 */
-	std::shared_ptr<ISoundDataOpen> openSingleSound(const std::string &sound_name);
+	std::shared_ptr<ISoundDataOpen> requestOpenSound(const std::string &sound_name);
+
+	/**
+	 * Handles the results of the SoundDecodeThread, and starts pending
+	 * sounds whose data is now open.
+	 */
+	void processDecodeResults();
+
+	// Decodes the buffer after the ones enqueued in a streamed sound ahead
+	void decodeStreamAhead(PlayingSound &sound);
+
+	// Evicts open sounds that are not playing until they take at most
+	// max_bytes, see SOUND_PCM_CACHE_MAX_BYTES. Returns the bytes freed.
+	size_t evictOpenSounds(size_t max_bytes = SOUND_PCM_CACHE_MAX_BYTES);
 
 	/**
 	 * Gets a random sound name from a group.
 	 *
 	 * @param group_name The name of the sound group.
-	 * @return The name of a sound in the group, or "" on failure. Getting the
-	 *         sound with `openSingleSound` directly afterwards will not fail.
+	 * @return The name of a sound in the group, or "" on failure. Sounds that
+	 *         failed to open are removed from the group.
 	 */
 	std::string getLoadedSoundNameFromGroup(const std::string &group_name);
 
@@ -568,14 +758,17 @@ class OpenALSoundManager final : public ISoundManager
 	 */
 	std::string getOrLoadLoadedSoundNameFromGroup(const std::string &group_name);
 
-	std::shared_ptr<PlayingSound> createPlayingSound(const std::string &sound_name,
-			bool loop, f32 volume, f32 pitch, f32 start_time,
-			const std::optional<std::pair<v3f, v3f>> &pos_vel_opt);
+	std::shared_ptr<PlayingSound> createPlayingSound(std::shared_ptr<ISoundDataOpen> lsnd,
+			const std::string &sound_name, bool loop, f32 volume, f32 pitch,
+			f32 start_time, const std::optional<std::pair<v3f, v3f>> &pos_vel_opt);
 
 	void playSoundGeneric(sound_handle_t id, const std::string &group_name, bool loop,
 			f32 volume, f32 fade, f32 pitch, bool use_local_fallback, f32 start_time,
 			const std::optional<std::pair<v3f, v3f>> &pos_vel_opt);
 
+	// Starts the sound if it is open, otherwise adds it to m_sounds_pending
+	void startOrQueueSound(sound_handle_t id, PendingSound &&pending);
+
 	/**
 	 * Deletes sounds that are dead (=finished).
 	 *
@@ -610,4 +803,7 @@ class OpenALSoundManager final : public ISoundManager
 	void stopSound(sound_handle_t sound) override;
 	void fadeSound(sound_handle_t soundid, f32 step, f32 target_gain) override;
 	void updateSoundPosVel(sound_handle_t sound, const v3f &pos_, const v3f &vel_) override;
+
+	size_t getMemoryUsage() override;
+	size_t freeMemory(size_t bytes) override;
 };
@@ -0,0 +1,247 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "spritebatch.h"
+#include "guiscalingfilter.h"
+#include <IGUIFont.h>
+#include <algorithm>
+
+// Quads per draw call, limited by 16-bit indices
+#define SPRITEBATCH_MAX_QUADS (0x10000 / 4)
+
+static const video::SColor white_colors[4] = {
+	video::SColor(255, 255, 255, 255), video::SColor(255, 255, 255, 255),
+	video::SColor(255, 255, 255, 255), video::SColor(255, 255, 255, 255),
+};
+
+/*
+	Appends a quad covering destrect clipped against cliprect. The texture
+	coordinates are cut down by the same fraction. Corner colors follow the
+	order used by IVideoDriver::draw2DImage(): upper left, lower left,
+	lower right, upper right.
+*/
+static bool append_quad(std::vector<video::S3DVertex> &vertices,
+		const core::rect<s32> &destrect, const core::rect<f32> &uvrect,
+		const core::rect<s32> *cliprect, const video::SColor *colors)
+{
+	core::rect<s32> dest = destrect;
+	if (cliprect)
+		dest.clipAgainst(*cliprect);
+	if (dest.getWidth() <= 0 || dest.getHeight() <= 0)
+		return false;
+
+	const f32 dw = destrect.getWidth();
+	const f32 dh = destrect.getHeight();
+	const f32 uw = uvrect.getWidth();
+	const f32 vh = uvrect.getHeight();
+
+	const f32 u0 = uvrect.UpperLeftCorner.X +
+		uw * (dest.UpperLeftCorner.X - destrect.UpperLeftCorner.X) / dw;
+	const f32 u1 = uvrect.UpperLeftCorner.X +
+		uw * (dest.LowerRightCorner.X - destrect.UpperLeftCorner.X) / dw;
+	const f32 v0 = uvrect.UpperLeftCorner.Y +
+		vh * (dest.UpperLeftCorner.Y - destrect.UpperLeftCorner.Y) / dh;
+	const f32 v1 = uvrect.UpperLeftCorner.Y +
+		vh * (dest.LowerRightCorner.Y - destrect.UpperLeftCorner.Y) / dh;
+
+	const f32 x0 = dest.UpperLeftCorner.X;
+	const f32 y0 = dest.UpperLeftCorner.Y;
+	const f32 x1 = dest.LowerRightCorner.X;
+	const f32 y1 = dest.LowerRightCorner.Y;
+
+	vertices.emplace_back(x0, y0, 0, 0, 0, 1, colors[0], u0, v0);
+	vertices.emplace_back(x1, y0, 0, 0, 0, 1, colors[3], u1, v0);
+	vertices.emplace_back(x1, y1, 0, 0, 0, 1, colors[2], u1, v1);
+	vertices.emplace_back(x0, y1, 0, 0, 0, 1, colors[1], u0, v1);
+	return true;
+}
+
+SpriteBatch2D::Group &SpriteBatch2D::getGroup(SpriteLayer layer,
+		video::ITexture *texture, bool usealpha)
+{
+	std::vector<Group> &groups = m_layers[layer].groups;
+	for (Group &group : groups) {
+		if (group.texture == texture && group.usealpha == usealpha)
+			return group;
+	}
+	groups.push_back(Group{texture, usealpha, {}});
+	return groups.back();
+}
+
+void SpriteBatch2D::drawImage(SpriteLayer layer, video::ITexture *texture,
+		const core::rect<s32> &destrect, const core::rect<s32> &srcrect,
+		const core::rect<s32> *cliprect, const video::SColor *const colors,
+		bool usealpha)
+{
+	if (destrect.getWidth() <= 0 || destrect.getHeight() <= 0)
+		return;
+
+	// Use the same pre-scaled texture as draw2DImageFilterScaled()
+	video::ITexture *scaled = guiScalingResizeCached(m_driver, texture,
+			srcrect, destrect);
+	if (!scaled)
+		return;
+
+	const core::rect<s32> mysrcrect = (scaled != texture)
+		? core::rect<s32>(0, 0, destrect.getWidth(), destrect.getHeight())
+		: srcrect;
+
+	const video::SColor *mycolors = colors ? colors : white_colors;
+
+	// Vertex alpha combined with the texture alpha channel needs the render
+	// state of draw2DImage(), which a plain material cannot express.
+	bool vertex_alpha = false;
+	for (int i = 0; i < 4; i++)
+		vertex_alpha |= mycolors[i].getAlpha() < 255;
+
+	if (vertex_alpha) {
+		Single single;
+		single.texture = scaled;
+		single.destrect = destrect;
+		single.srcrect = mysrcrect;
+		single.usealpha = usealpha;
+		single.has_clip = cliprect != nullptr;
+		if (cliprect)
+			single.cliprect = *cliprect;
+		for (int i = 0; i < 4; i++)
+			single.colors[i] = mycolors[i];
+		m_layers[layer].singles.push_back(single);
+		m_layers[layer].sprite_count++;
+		return;
+	}
+
+	const core::dimension2d<u32> &ss = scaled->getOriginalSize();
+	const f32 inv_w = 1.0f / ss.Width;
+	const f32 inv_h = 1.0f / ss.Height;
+	const core::rect<f32> uvrect(
+			mysrcrect.UpperLeftCorner.X * inv_w,
+			mysrcrect.UpperLeftCorner.Y * inv_h,
+			mysrcrect.LowerRightCorner.X * inv_w,
+			mysrcrect.LowerRightCorner.Y * inv_h);
+
+	Group &group = getGroup(layer, scaled, usealpha);
+	if (append_quad(group.vertices, destrect, uvrect, cliprect, mycolors))
+		m_layers[layer].sprite_count++;
+}
+
+void SpriteBatch2D::drawRectangle(SpriteLayer layer, video::SColor color,
+		const core::rect<s32> &rect, const core::rect<s32> *cliprect)
+{
+	const video::SColor colors[4] = {color, color, color, color};
+	Group &group = getGroup(layer, nullptr, false);
+	if (append_quad(group.vertices, rect, core::rect<f32>(0, 0, 0, 0),
+			cliprect, colors))
+		m_layers[layer].sprite_count++;
+}
+
+void SpriteBatch2D::drawText(gui::IGUIFont *font, const std::wstring &text,
+		const core::rect<s32> &rect, video::SColor color,
+		const core::rect<s32> *cliprect)
+{
+	Text t;
+	t.font = font;
+	t.text = text;
+	t.rect = rect;
+	t.color = color;
+	t.has_clip = cliprect != nullptr;
+	if (cliprect)
+		t.cliprect = *cliprect;
+	m_texts.push_back(std::move(t));
+}
+
+void SpriteBatch2D::drawGroup(Group &group)
+{
+	const u32 quad_count = group.vertices.size() / 4;
+	if (quad_count == 0)
+		return;
+
+	video::SMaterial material;
+	material.Lighting = false;
+	material.ZBuffer = video::ECFN_DISABLED;
+	material.ZWriteEnable = video::EZW_OFF;
+	material.BackfaceCulling = false;
+	material.TextureLayer[0].BilinearFilter = false;
+	if (group.texture) {
+		material.setTexture(0, group.texture);
+		material.MaterialType = group.usealpha ?
+			video::EMT_TRANSPARENT_ALPHA_CHANNEL : video::EMT_SOLID;
+	} else {
+		material.MaterialType = video::EMT_TRANSPARENT_VERTEX_ALPHA;
+	}
+	m_driver->setMaterial(material);
+
+	const u32 needed = std::min<u32>(quad_count, SPRITEBATCH_MAX_QUADS) * 6;
+	for (u32 i = m_indices.size() / 6; i * 6 < needed; i++) {
+		const u16 base = i * 4;
+		m_indices.push_back(base);
+		m_indices.push_back(base + 1);
+		m_indices.push_back(base + 2);
+		m_indices.push_back(base);
+		m_indices.push_back(base + 2);
+		m_indices.push_back(base + 3);
+	}
+
+	for (u32 first = 0; first < quad_count; first += SPRITEBATCH_MAX_QUADS) {
+		const u32 count = std::min<u32>(quad_count - first, SPRITEBATCH_MAX_QUADS);
+		m_driver->draw2DVertexPrimitiveList(&group.vertices[first * 4], count * 4,
+				m_indices.data(), count * 2);
+		m_stat_drawcalls++;
+	}
+}
+
+void SpriteBatch2D::flush(SpriteLayer last)
+{
+	for (u8 i = 0; i <= last; i++) {
+		Layer &layer = m_layers[i];
+		if (layer.sprite_count == 0)
+			continue;
+
+		for (Group &group : layer.groups)
+			drawGroup(group);
+		layer.groups.clear();
+
+		for (const Single &s : layer.singles) {
+			m_driver->draw2DImage(s.texture, s.destrect, s.srcrect,
+					s.has_clip ? &s.cliprect : nullptr, s.colors, s.usealpha);
+			m_stat_drawcalls++;
+		}
+		layer.singles.clear();
+
+		m_stat_sprites += layer.sprite_count;
+		layer.sprite_count = 0;
+	}
+
+	if (last != SPRITE_LAYER_TOP)
+		return;
+
+	for (const Text &t : m_texts) {
+		t.font->draw(t.text.c_str(), t.rect, t.color, false, false,
+				t.has_clip ? &t.cliprect : nullptr);
+	}
+	m_texts.clear();
+}
+
+bool SpriteBatch2D::empty() const
+{
+	for (const Layer &layer : m_layers) {
+		if (layer.sprite_count > 0)
+			return false;
+	}
+	return m_texts.empty();
+}
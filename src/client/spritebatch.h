@@ -0,0 +1,128 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes_extrabloated.h"
+#include <string>
+#include <vector>
+
+/*
+	Layers are drawn in ascending order when the batch is flushed.
+	Sprites within one layer must not overlap, since they are regrouped
+	by texture and their submission order is not kept.
+*/
+enum SpriteLayer : u8
+{
+	SPRITE_LAYER_BACKGROUND, // Bar backgrounds and selection highlights
+	SPRITE_LAYER_SLOT,       // Slot backgrounds and borders
+	SPRITE_LAYER_IMAGE,      // Item images
+	SPRITE_LAYER_OVERLAY,    // Item overlays
+	SPRITE_LAYER_FOREGROUND, // Wear bars
+	SPRITE_LAYER_COUNT,
+	SPRITE_LAYER_TOP = SPRITE_LAYER_COUNT - 1,
+};
+
+/*
+	Collects 2D images and rectangles and draws all sprites that share a
+	texture with a single draw call. Text is queued as well and drawn on top
+	of everything else.
+
+	Used by the HUD and inventory lists, which otherwise issue several
+	draw2DImage/draw2DRectangle calls per slot.
+*/
+class SpriteBatch2D
+{
+public:
+	SpriteBatch2D(video::IVideoDriver *driver) : m_driver(driver) {}
+
+	// Same semantics as draw2DImageFilterScaled()
+	void drawImage(SpriteLayer layer, video::ITexture *texture,
+			const core::rect<s32> &destrect, const core::rect<s32> &srcrect,
+			const core::rect<s32> *cliprect = nullptr,
+			const video::SColor *const colors = nullptr, bool usealpha = true);
+
+	// Same semantics as IVideoDriver::draw2DRectangle()
+	void drawRectangle(SpriteLayer layer, video::SColor color,
+			const core::rect<s32> &rect, const core::rect<s32> *cliprect = nullptr);
+
+	// Same semantics as IGUIFont::draw()
+	void drawText(gui::IGUIFont *font, const std::wstring &text,
+			const core::rect<s32> &rect, video::SColor color,
+			const core::rect<s32> *cliprect = nullptr);
+
+	// Draws and discards everything queued so far
+	void flush() { flush(SPRITE_LAYER_TOP); }
+
+	// Draws and discards the layers up to and including `last`, so that
+	// something drawn directly afterwards ends up on top of them.
+	// Text is only drawn together with the topmost layer.
+	void flush(SpriteLayer last);
+
+	bool empty() const;
+
+	// Statistics since the last call to resetStats()
+	u32 getDrawCallCount() const { return m_stat_drawcalls; }
+	u32 getSpriteCount() const { return m_stat_sprites; }
+	void resetStats() { m_stat_drawcalls = m_stat_sprites = 0; }
+
+private:
+	struct Group {
+		video::ITexture *texture; // nullptr for untextured rectangles
+		bool usealpha;
+		std::vector<video::S3DVertex> vertices;
+	};
+
+	// A sprite that cannot share a draw call, e.g. uses vertex alpha
+	struct Single {
+		video::ITexture *texture;
+		core::rect<s32> destrect;
+		core::rect<s32> srcrect;
+		core::rect<s32> cliprect;
+		bool has_clip;
+		bool usealpha;
+		video::SColor colors[4];
+	};
+
+	struct Text {
+		gui::IGUIFont *font;
+		std::wstring text;
+		core::rect<s32> rect;
+		video::SColor color;
+		core::rect<s32> cliprect;
+		bool has_clip;
+	};
+
+	struct Layer {
+		std::vector<Group> groups;
+		std::vector<Single> singles;
+		u32 sprite_count = 0;
+	};
+
+	Group &getGroup(SpriteLayer layer, video::ITexture *texture, bool usealpha);
+	void drawGroup(Group &group);
+
+	video::IVideoDriver *m_driver;
+	Layer m_layers[SPRITE_LAYER_COUNT];
+	std::vector<Text> m_texts;
+	std::vector<u16> m_indices;
+
+	u32 m_stat_drawcalls = 0;
+	u32 m_stat_sprites = 0;
+};
@@ -31,6 +31,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "gamedef.h"
 #include "util/strfnd.h"
 #include "imagefilters.h"
+#include "profiler.h"
 #include "guiscalingfilter.h"
 #include "renderingengine.h"
 #include "util/base64.h"
@@ -198,12 +199,26 @@ struct TextureInfo
 	SourceImageCache: A cache used for storing source images.
 */
 
+static u64 image_memory_usage(video::IImage *img)
+{
+	const core::dimension2du dim = img->getDimension();
+	return video::IImage::getDataSizeFromFormat(img->getColorFormat(),
+			dim.Width, dim.Height);
+}
+
+static u64 texture_memory_usage(video::ITexture *tex)
+{
+	const core::dimension2du dim = tex->getSize();
+	return video::IImage::getDataSizeFromFormat(tex->getColorFormat(),
+			dim.Width, dim.Height);
+}
+
 class SourceImageCache
 {
 public:
 	~SourceImageCache() {
 		for (auto &m_image : m_images) {
-			m_image.second->drop();
+			m_image.second.image->drop();
 		}
 		m_images.clear();
 	}
@@ -211,12 +226,9 @@ class SourceImageCache
 	{
 		assert(img); // Pre-condition
 		// Remove old image
-		std::map<std::string, video::IImage*>::iterator n;
-		n = m_images.find(name);
-		if (n != m_images.end()){
-			if (n->second)
-				n->second->drop();
-		}
+		auto n = m_images.find(name);
+		if (n != m_images.end())
+			remove(n);
 
 		video::IImage* toadd = img;
 		bool need_to_grab = true;
@@ -238,24 +250,17 @@ class SourceImageCache
 
 		if (need_to_grab)
 			toadd->grab();
-		m_images[name] = toadd;
-	}
-	video::IImage* get(const std::string &name)
-	{
-		std::map<std::string, video::IImage*>::iterator n;
-		n = m_images.find(name);
-		if (n != m_images.end())
-			return n->second;
-		return NULL;
+		// Images from memory can't be loaded again after evicting them
+		add(name, toadd, !need_to_grab);
 	}
 	// Primarily fetches from cache, secondarily tries to read from filesystem
 	video::IImage *getOrLoad(const std::string &name)
 	{
-		std::map<std::string, video::IImage*>::iterator n;
-		n = m_images.find(name);
+		auto n = m_images.find(name);
 		if (n != m_images.end()){
-			n->second->grab(); // Grab for caller
-			return n->second;
+			n->second.last_used = ++m_clock;
+			n->second.image->grab(); // Grab for caller
+			return n->second.image;
 		}
 		video::IVideoDriver *driver = RenderingEngine::get_video_driver();
 		std::string path = getTexturePath(name);
@@ -269,13 +274,60 @@ class SourceImageCache
 		video::IImage *img = driver->createImageFromFile(path.c_str());
 
 		if (img){
-			m_images[name] = img;
+			add(name, img, true);
 			img->grab(); // Grab for caller
 		}
 		return img;
 	}
+	// Drops images loaded from files that are not used elsewhere, least
+	// recently used first, until `bytes` are freed. Returns the bytes freed.
+	u64 evict(u64 bytes)
+	{
+		std::vector<std::pair<u64, std::string>> evictable;
+		for (const auto &it : m_images) {
+			if (it.second.reloadable && it.second.image->getReferenceCount() == 1)
+				evictable.emplace_back(it.second.last_used, it.first);
+		}
+		std::sort(evictable.begin(), evictable.end());
+
+		u64 freed = 0;
+		for (const auto &it : evictable) {
+			if (freed >= bytes)
+				break;
+			auto n = m_images.find(it.second);
+			freed += image_memory_usage(n->second.image);
+			remove(n);
+		}
+		return freed;
+	}
+	u64 getMemoryUsage() const
+	{
+		return m_bytes;
+	}
 private:
-	std::map<std::string, video::IImage*> m_images;
+	struct CachedImage {
+		video::IImage *image;
+		// Loaded from a file, so it can be loaded again
+		bool reloadable;
+		// Value of m_clock at the last use
+		u64 last_used;
+	};
+
+	void add(const std::string &name, video::IImage *img, bool reloadable)
+	{
+		m_images[name] = CachedImage{img, reloadable, ++m_clock};
+		m_bytes += image_memory_usage(img);
+	}
+	void remove(std::map<std::string, CachedImage>::iterator n)
+	{
+		m_bytes -= image_memory_usage(n->second.image);
+		n->second.image->drop();
+		m_images.erase(n);
+	}
+
+	std::map<std::string, CachedImage> m_images;
+	u64 m_clock = 0;
+	u64 m_bytes = 0;
 };
 
 /*
@@ -378,10 +430,33 @@ class TextureSource : public IWritableTextureSource
 	// Shall be called from the main thread.
 	void rebuildImagesAndTextures();
 
+	video::IImage *generateImage(const std::string &name)
+	{
+		std::set<std::string> source_image_names;
+		return generateImage(name, source_image_names);
+	}
+
 	video::ITexture* getNormalTexture(const std::string &name);
 	video::SColor getTextureAverageColor(const std::string &name);
 	video::ITexture *getShaderFlagsTexture(bool normamap_present);
 
+	u64 getTextureMemoryUsage()
+	{
+		MutexAutoLock lock(m_textureinfo_cache_mutex);
+		return m_texture_bytes;
+	}
+
+	u64 getSourceImageMemoryUsage()
+	{
+		return m_sourcecache.getMemoryUsage();
+	}
+
+	u64 evictSourceImages(u64 bytes)
+	{
+		sanity_check(std::this_thread::get_id() == m_main_thread);
+		return m_sourcecache.evict(bytes);
+	}
+
 private:
 
 	// The id of the thread that is allowed to use irrlicht directly
@@ -430,6 +505,9 @@ class TextureSource : public IWritableTextureSource
 	// but can't be deleted because the ITexture* might still be used
 	std::vector<video::ITexture*> m_texture_trash;
 
+	// Size of all textures created, including the trash
+	u64 m_texture_bytes = 0;
+
 	// Maps image file names to loaded palettes.
 	std::unordered_map<std::string, Palette> m_palettes;
 
@@ -594,6 +672,9 @@ u32 TextureSource::generateTexture(const std::string &name)
 		return 0;
 	}
 
+	ScopeProfiler sp(g_profiler, "TextureSource::generateTexture()", SPT_ADD);
+	g_profiler->graphAdd("num_generated_textures", 1);
+
 	video::IVideoDriver *driver = RenderingEngine::get_video_driver();
 	sanity_check(driver);
 
@@ -617,6 +698,9 @@ u32 TextureSource::generateTexture(const std::string &name)
 
 	MutexAutoLock lock(m_textureinfo_cache_mutex);
 
+	if (tex)
+		m_texture_bytes += texture_memory_usage(tex);
+
 	u32 id = m_textureinfo_cache.size();
 	TextureInfo ti(name, tex, source_image_names);
 	m_textureinfo_cache.push_back(ti);
@@ -809,6 +893,8 @@ void TextureSource::rebuildTexture(video::IVideoDriver *driver, TextureInfo &ti)
 		guiScalingCache(io::path(ti.name.c_str()), driver, img);
 		img->drop();
 	}
+	if (t)
+		m_texture_bytes += texture_memory_usage(t);
 	video::ITexture *t_old = ti.texture;
 	// Replace texture
 	ti.texture = t;
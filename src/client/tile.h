@@ -124,9 +124,19 @@ class IWritableTextureSource : public ITextureSource
 	virtual void processQueue()=0;
 	virtual void insertSourceImage(const std::string &name, video::IImage *img)=0;
 	virtual void rebuildImagesAndTextures()=0;
+	// Generates the image for a texture name without caching anything.
+	// The returned image should be dropped. Main thread only.
+	virtual video::IImage *generateImage(const std::string &name)=0;
 	virtual video::ITexture* getNormalTexture(const std::string &name)=0;
 	virtual video::SColor getTextureAverageColor(const std::string &name)=0;
 	virtual video::ITexture *getShaderFlagsTexture(bool normalmap_present)=0;
+
+	// Approximate sizes in bytes of the textures and the source images
+	virtual u64 getTextureMemoryUsage()=0;
+	virtual u64 getSourceImageMemoryUsage()=0;
+	// Drops source images that can be loaded from files again, least
+	// recently used first. Returns the bytes freed. Main thread only.
+	virtual u64 evictSourceImages(u64 bytes)=0;
 };
 
 IWritableTextureSource *createTextureSource();
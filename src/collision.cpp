@@ -289,30 +289,22 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 	v3s16 max = floatToInt(maxpos_f + box_0.MaxEdge, BS) + v3s16(1, 1, 1);
 
 	bool any_position_valid = false;
+	const NodeDefManager *nodedef = gamedef->getNodeDefManager();
 
-	v3s16 p;
-	for (p.X = min.X; p.X <= max.X; p.X++)
-	for (p.Y = min.Y; p.Y <= max.Y; p.Y++)
-	for (p.Z = min.Z; p.Z <= max.Z; p.Z++) {
-		bool is_position_valid;
-		MapNode n = map->getNode(p, &is_position_valid);
-
-		if (is_position_valid && n.getContent() != CONTENT_IGNORE) {
+	// Walks the area block by block, so that every block is looked up once
+	map->forEachNodeInArea(min, max, [&](v3s16 p, MapNode n) -> bool {
+		if (n.getContent() != CONTENT_IGNORE) {
 			// Object collides into walkable nodes
 
 			any_position_valid = true;
-			const NodeDefManager *nodedef = gamedef->getNodeDefManager();
-			const ContentFeatures &f = nodedef->get(n);
-
-			if (!f.walkable)
-				continue;
+			const NodeCollisionInfo &info =
+				nodedef->getCollisionInfo(n.getContent());
 
-			// Negative bouncy may have a meaning, but we need +value here.
-			int n_bouncy_value = abs(itemgroup_get(f.groups, "bouncy"));
+			if (!info.walkable)
+				return true;
 
 			int neighbors = 0;
-			if (f.drawtype == NDT_NODEBOX &&
-				f.node_box.type == NODEBOX_CONNECTED) {
+			if (info.connected) {
 				v3s16 p2 = p;
 
 				p2.Y++;
@@ -338,15 +330,15 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 				p2.X++;
 				getNeighborConnectingFace(p2, nodedef, map, n, 32, &neighbors);
 			}
-			std::vector<aabb3f> nodeboxes;
-			n.getCollisionBoxes(gamedef->ndef(), &nodeboxes, neighbors);
+			const std::vector<aabb3f> &nodeboxes =
+				info.getBoxes(n.getParam2(), neighbors);
 
 			// Calculate float position only once
 			v3f posf = intToFloat(p, BS);
 			for (auto box : nodeboxes) {
 				box.MinEdge += posf;
 				box.MaxEdge += posf;
-				cinfo.emplace_back(false, n_bouncy_value, p, box);
+				cinfo.emplace_back(false, info.bouncy, p, box);
 			}
 		} else {
 			// Collide with unloaded nodes (position invalid) and loaded
@@ -354,7 +346,8 @@ collisionMoveResult collisionMoveSimple(Environment *env, IGameDef *gamedef,
 			aabb3f box = getNodeBox(p, BS);
 			cinfo.emplace_back(true, 0, p, box);
 		}
-	}
+		return true;
+	});
 
 	// Do not move if world has not loaded yet, since custom node boxes
 	// are not available for collision detection.
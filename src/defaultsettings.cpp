@@ -46,6 +46,23 @@ void set_default_settings()
 	settings->setDefault("noclip", "false");
 	settings->setDefault("client_unload_unused_data_timeout", "600");
 	settings->setDefault("client_mapblock_limit", "7500");
+	settings->setDefault("client_mapblock_compact", "true");
+	settings->setDefault("client_mapblock_memory_limit", "0");
+	settings->setDefault("client_memory_budget", "0");
+	settings->setDefault("hitch_threshold", "50");
+	settings->setDefault("csm_profiler", "false");
+	settings->setDefault("csm_callback_budget", "50");
+	settings->setDefault("network_capture_file", "");
+	settings->setDefault("network_replay_file", "");
+	settings->setDefault("network_replay_fast", "false");
+	settings->setDefault("synthetic_server", "false");
+	settings->setDefault("synthetic_server_block_rate", "200");
+	settings->setDefault("synthetic_server_range", "6");
+	settings->setDefault("synthetic_server_objects", "50");
+	settings->setDefault("synthetic_server_object_update_rate", "10");
+	settings->setDefault("synthetic_server_particle_spawners", "8");
+	settings->setDefault("synthetic_server_particle_rate", "50");
+	settings->setDefault("synthetic_server_textures", "16");
 	settings->setDefault("enable_build_where_you_stand", "false");
 	settings->setDefault("max_out_chat_queue_size", "20");
 	settings->setDefault("pause_on_lost_focus", "false");
@@ -187,6 +204,7 @@ void set_default_settings()
 	settings->setDefault("enable_particles", "true");
 	settings->setDefault("show_nametag_backgrounds", "true");
 	settings->setDefault("transparency_sorting_distance", "16");
+	settings->setDefault("entity_animation_sharing_distance", "24");
 
 	settings->setDefault("enable_minimap", "true");
 	settings->setDefault("minimap_shape_round", "true");
@@ -268,6 +286,10 @@ void set_default_settings()
 
 	// Network
 	settings->setDefault("enable_ipv6", "true");
+	settings->setDefault("enable_remote_media_server", "true");
+	settings->setDefault("curl_timeout", "20000");
+	settings->setDefault("curl_parallel_limit", "8");
+	settings->setDefault("curl_file_download_timeout", "300000");
 	settings->setDefault("max_packets_per_iteration","1024");
 	settings->setDefault("port", "30000");
 
@@ -276,6 +298,9 @@ void set_default_settings()
 	settings->setDefault("profiler_print_interval", "0");
 	settings->setDefault("debug_log_level", "action");
 	settings->setDefault("debug_log_size_max", "50");
+	settings->setDefault("debug_log_async", "false");
+	settings->setDefault("debug_log_async_queue_size", "1024");
+	settings->setDefault("debug_log_async_overflow", "block");
 	settings->setDefault("chat_log_level", "error");
 	settings->setDefault("secure.enable_security", "true");
 	settings->setDefault("secure.trusted_mods", "");
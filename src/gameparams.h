@@ -52,6 +52,9 @@ struct GameStartData : GameParams
 
 	ELoginRegister allow_login_or_register = ELoginRegister::Any;
 
+	// Camera path script of the --benchmark mode, empty if not benchmarking
+	std::string benchmark_script;
+
 	// "world_path" must be kept in sync!
 	WorldSpec world_spec;
 };
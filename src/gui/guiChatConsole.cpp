@@ -32,6 +32,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irrlicht_changes/CGUITTFont.h"
 #include "util/string.h"
 #include <string>
+#include <algorithm>
 
 inline u32 clamp_u8(s32 value)
 {
@@ -347,7 +348,7 @@ void GUIChatConsole::drawPrompt()
 	u32 font_width  = m_fontsize.X;
 	u32 font_height = m_fontsize.Y;
 
-	core::dimension2d<u32> size = m_font->getDimension(prompt_text.c_str());
+	core::dimension2d<u32> size = getTextDimension(prompt_text, prompt_text.size());
 	u32 text_width = size.Width;
 	if (size.Height > font_height)
 		font_height = size.Height;
@@ -373,7 +374,7 @@ void GUIChatConsole::drawPrompt()
 		if (cursor_pos >= 0)
 		{
 
-			u32 text_to_cursor_pos_width = m_font->getDimension(prompt_text.substr(0, cursor_pos).c_str()).Width;
+			u32 text_to_cursor_pos_width = getTextDimension(prompt_text, cursor_pos).Width;
 
 			s32 cursor_len = prompt.getCursorLength();
 			video::IVideoDriver* driver = Environment->getVideoDriver();
@@ -394,6 +395,25 @@ void GUIChatConsole::drawPrompt()
 
 }
 
+core::dimension2d<u32> GUIChatConsole::getTextDimension(const std::wstring &text,
+		size_t len)
+{
+	// The console uses a monospace font, so kerning can be ignored and
+	// the text size is the sum of its glyph sizes
+	core::dimension2d<u32> size(0, 0);
+	len = std::min(len, text.size());
+	for (size_t i = 0; i < len; i++) {
+		auto it = m_glyph_sizes.find(text[i]);
+		if (it == m_glyph_sizes.end()) {
+			const wchar_t glyph[2] = {text[i], L'\0'};
+			it = m_glyph_sizes.emplace(text[i], m_font->getDimension(glyph)).first;
+		}
+		size.Width += it->second.Width;
+		size.Height = std::max(size.Height, it->second.Height);
+	}
+	return size;
+}
+
 bool GUIChatConsole::OnEvent(const SEvent& event)
 {
 
@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "modalMenu.h"
 #include "chat.h"
 #include "config.h"
+#include <unordered_map>
 
 class Client;
 
@@ -84,6 +85,9 @@ class GUIChatConsole : public gui::IGUIElement
 	void drawText();
 	void drawPrompt();
 
+	// Measure text using cached per-glyph sizes of m_font
+	core::dimension2d<u32> getTextDimension(const std::wstring &text, size_t len);
+
 	// If clicked fragment has a web url, send it to the system default web browser.
 	// Returns true if, and only if a web url was pressed.
 	bool weblinkClick(s32 col, s32 row);
@@ -133,6 +137,8 @@ class GUIChatConsole : public gui::IGUIElement
 	// font
 	gui::IGUIFont *m_font = nullptr;
 	v2u32 m_fontsize;
+	// Glyph sizes of m_font, the console font never changes
+	std::unordered_map<wchar_t, core::dimension2d<u32>> m_glyph_sizes;
 
 	// Track if a ctrl key is currently held down
 	bool m_is_ctrl_down;
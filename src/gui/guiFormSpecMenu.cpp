@@ -46,6 +46,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "scripting_server.h"
 #include "mainmenumanager.h"
 #include "porting.h"
+#include "profiler.h"
 #include "settings.h"
 #include "client/client.h"
 #include "client/fontengine.h"
@@ -96,6 +97,42 @@ static unsigned int font_line_height(gui::IGUIFont *font)
 	return font->getDimension(L"Ay").Height + font->getKerningHeight();
 }
 
+std::vector<std::string> split_formspec_elements(const std::string &formspec)
+{
+	std::vector<std::string> elements;
+	elements.reserve(std::count(formspec.begin(), formspec.end(), ']') + 1);
+
+	size_t start = 0;
+	size_t end = formspec.size();
+	for (size_t i = 0; i < formspec.size(); i++) {
+		if (formspec[i] == '\\') {
+			// split() drops a dangling escape character at the very end
+			if (++i == formspec.size())
+				end = i - 1;
+		} else if (formspec[i] == ']') {
+			elements.emplace_back(formspec, start, i - start);
+			start = i + 1;
+		}
+	}
+	elements.emplace_back(formspec, start, end - start);
+
+	return elements;
+}
+
+// Element types that patchElement() can update without rebuilding the GUI
+static bool is_patchable_element_type(const std::string &type)
+{
+	return type == "label" || type == "image" || type == "item_image";
+}
+
+static std::string get_element_type(const std::string &element)
+{
+	size_t pos = element.find('[');
+	if (pos == std::string::npos)
+		return "";
+	return trim(element.substr(0, pos));
+}
+
 inline u32 clamp_u8(s32 value)
 {
 	return (u32) MYMIN(MYMAX(value, 0), 255);
@@ -2734,6 +2771,131 @@ void GUIFormSpecMenu::removeAll()
 		clickthrough_it->drop();
 	for (auto &scroll_container_it : m_scroll_containers)
 		scroll_container_it.second->drop();
+
+	m_patchable_elements.clear();
+}
+
+void GUIFormSpecMenu::updateFormSpec(const std::string &formspec_string)
+{
+	std::vector<std::string> elements = split_formspec_elements(formspec_string);
+	m_formspec_string = formspec_string;
+
+	if (patchFormSpec(elements)) {
+		m_formspec_elements = std::move(elements);
+		return;
+	}
+
+	m_formspec_elements = std::move(elements);
+	m_formspec_elements_dirty = false;
+	m_is_form_regenerated = false;
+	regenerateGui(m_screensize_old);
+}
+
+bool GUIFormSpecMenu::patchFormSpec(const std::vector<std::string> &elements)
+{
+	// Only the same form with an otherwise unchanged layout can be patched
+	if (m_formspec_elements_dirty || !m_is_form_regenerated)
+		return false;
+	if (m_text_dst->m_formname != m_last_formname)
+		return false;
+	if (m_formspec_prepend != m_formspec_prepend_built)
+		return false;
+	if (elements.size() != m_formspec_elements.size())
+		return false;
+
+	std::vector<size_t> changed;
+	for (size_t i = 0; i < elements.size(); i++) {
+		if (elements[i] == m_formspec_elements[i])
+			continue;
+		if (!patchElement(i, elements[i], false))
+			return false;
+		changed.push_back(i);
+	}
+
+	// Everything was checked above, applying cannot fail anymore
+	for (size_t i : changed)
+		patchElement(i, elements[i], true);
+
+	return true;
+}
+
+bool GUIFormSpecMenu::patchElement(size_t index, const std::string &element,
+		bool apply)
+{
+	auto it = m_patchable_elements.find(index);
+	if (it == m_patchable_elements.end())
+		return false;
+
+	const std::string &old_element = m_formspec_elements[index];
+	const std::string type = get_element_type(element);
+	if (type != get_element_type(old_element) || !is_patchable_element_type(type))
+		return false;
+
+	std::vector<std::string> old_parts =
+		split(old_element.substr(old_element.find('[') + 1), ';');
+	std::vector<std::string> parts = split(element.substr(element.find('[') + 1), ';');
+	if (parts.size() != old_parts.size())
+		return false;
+
+	// Everything but the content must stay the same, so position and size do
+	size_t content_index = type == "label" ? 1 : 2;
+	if (type == "image" && parts.size() < 3)
+		return false; // Size depends on the texture
+	for (size_t i = 0; i < parts.size(); i++) {
+		if (i != content_index && parts[i] != old_parts[i])
+			return false;
+	}
+	const std::string &content = parts[content_index];
+
+	gui::IGUIElement *e = it->second;
+
+	if (type == "label") {
+		EnrichedString text(unescape_string(utf8_to_wide(content)));
+		// A label is split into one element per line
+		if (text.size() == 0 || text.getString().find(L'\n') != std::wstring::npos)
+			return false;
+		if (!apply)
+			return true;
+
+		gui::IGUIStaticText *label = static_cast<gui::IGUIStaticText *>(e);
+		text.setDefaultColor(label->getOverrideColor());
+		setStaticText(label, text);
+
+		core::rect<s32> rect = label->getRelativePosition();
+		rect.LowerRightCorner.X = rect.UpperLeftCorner.X +
+			label->getOverrideFont()->getDimension(text.c_str()).Width;
+		label->setRelativePosition(rect);
+		return true;
+	}
+
+	if (type == "image") {
+		// The image name is also its style name
+		const std::string old_name = unescape_string(old_parts[content_index]);
+		const std::string name = unescape_string(content);
+		if (theme_by_name.count(old_name) || theme_by_name.count(name))
+			return false;
+		if (!apply)
+			return true;
+
+		video::ITexture *texture = m_tsrc->getTexture(name);
+		if (e->getType() == gui::EGUIET_IMAGE)
+			static_cast<gui::IGUIImage *>(e)->setImage(texture);
+		else
+			static_cast<GUIAnimatedImage *>(e)->setTexture(texture);
+
+		for (FieldSpec &field : m_fields) {
+			if (field.fid == e->getID()) {
+				field.fname = name;
+				break;
+			}
+		}
+		return true;
+	}
+
+	// item_image
+	if (apply)
+		static_cast<GUIItemImage *>(e)->setItemName(content);
+	return true;
 }
 
 void GUIFormSpecMenu::parseElement(parserData* data, const std::string &element)
@@ -3031,7 +3193,11 @@ void GUIFormSpecMenu::regenerateGui(v2u32 screensize)
 		m_tooltip_element->grab();
 	}
 
-	std::vector<std::string> elements = split(m_formspec_string,']');
+	if (m_formspec_elements_dirty) {
+		m_formspec_elements = split_formspec_elements(m_formspec_string);
+		m_formspec_elements_dirty = false;
+	}
+	const std::vector<std::string> &elements = m_formspec_elements;
 	unsigned int i = 0;
 
 	/* try to read version from first element only */
@@ -3244,7 +3410,8 @@ void GUIFormSpecMenu::regenerateGui(v2u32 screensize)
 		u16 version_backup = m_formspec_version;
 		mydata.real_coordinates = false; // Old coordinates by default.
 
-		std::vector<std::string> prepend_elements = split(m_formspec_prepend, ']');
+		std::vector<std::string> prepend_elements =
+			split_formspec_elements(m_formspec_prepend);
 		for (const auto &element : prepend_elements)
 			parseElement(&mydata, element);
 
@@ -3260,8 +3427,20 @@ void GUIFormSpecMenu::regenerateGui(v2u32 screensize)
 		mydata.real_coordinates = rc_backup; // Restore coordinates
 	}
 
+	m_formspec_prepend_built = m_formspec_prepend;
+
 	for (; i< elements.size(); i++) {
+		const size_t fields_before = m_fields.size();
+		const size_t clickthrough_before = m_clickthrough_elements.size();
+
 		parseElement(&mydata, elements[i]);
+
+		// Remember elements that created exactly one widget, so later
+		// changes to their content can be applied without a full rebuild
+		if (m_fields.size() == fields_before + 1 &&
+				m_clickthrough_elements.size() == clickthrough_before + 1 &&
+				is_patchable_element_type(get_element_type(elements[i])))
+			m_patchable_elements[i] = m_clickthrough_elements.back();
 	}
 
 	if (mydata.current_parent != this) {
@@ -3439,11 +3618,8 @@ void GUIFormSpecMenu::drawMenu()
 {
 	if (m_form_src) {
 		const std::string &newform = m_form_src->getForm();
-		if (newform != m_formspec_string) {
-			m_formspec_string = newform;
-			m_is_form_regenerated = false;
-			regenerateGui(m_screensize_old);
-		}
+		if (newform != m_formspec_string)
+			updateFormSpec(newform);
 	}
 
 	gui::IGUISkin* skin = Environment->getSkin();
@@ -3488,6 +3664,9 @@ void GUIFormSpecMenu::drawMenu()
 	for (gui::IGUIElement *e : m_clickthrough_elements)
 		e->setVisible(true);
 
+	for (GUIInventoryList *e : m_inventorylists)
+		e->resetStats();
+
 	/*
 		This is where all the drawing happens.
 	*/
@@ -3497,6 +3676,14 @@ void GUIFormSpecMenu::drawMenu()
 						child->getAbsolutePosition()))
 			child->draw();
 
+	u32 list_sprites = 0, list_drawcalls = 0;
+	for (const GUIInventoryList *e : m_inventorylists) {
+		list_sprites += e->getSpriteCount();
+		list_drawcalls += e->getDrawCallCount();
+	}
+	g_profiler->avg("Formspec: inventory sprites [#]", list_sprites);
+	g_profiler->avg("Formspec: inventory drawcalls [#]", list_drawcalls);
+
 	for (gui::IGUIElement *e : m_clickthrough_elements)
 		e->setVisible(false);
 
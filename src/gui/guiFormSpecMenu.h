@@ -97,6 +97,12 @@ class IFormSource
 	virtual std::string resolveText(const std::string &str) { return str; }
 };
 
+/*
+	Splits a formspec into its elements. Gives the same result as
+	split(formspec, ']') but copies whole elements instead of single characters.
+*/
+std::vector<std::string> split_formspec_elements(const std::string &formspec);
+
 class GUIFormSpecMenu : public GUIModalMenu
 {
 	struct ListRingSpec
@@ -186,10 +192,8 @@ class GUIFormSpecMenu : public GUIModalMenu
 	void setFormSpec(const std::string &formspec_string,
 			const InventoryLocation &current_inventory_location)
 	{
-		m_formspec_string = formspec_string;
 		m_current_inventory_location = current_inventory_location;
-		m_is_form_regenerated = false;
-		regenerateGui(m_screensize_old);
+		updateFormSpec(formspec_string);
 	}
 
 	const InventoryLocation &getFormspecLocation()
@@ -323,6 +327,13 @@ class GUIFormSpecMenu : public GUIModalMenu
 
 	std::string m_formspec_string;
 	std::string m_formspec_prepend;
+	// m_formspec_string split into its elements, as used for the current GUI
+	std::vector<std::string> m_formspec_elements;
+	bool m_formspec_elements_dirty = true;
+	// Prepend the current GUI was built with
+	std::string m_formspec_prepend_built;
+	// Elements that can be updated in place, by index into m_formspec_elements
+	std::unordered_map<size_t, gui::IGUIElement *> m_patchable_elements;
 	InventoryLocation m_current_inventory_location;
 
 	// Default true because we can't control regeneration on resizing, but
@@ -426,6 +437,11 @@ class GUIFormSpecMenu : public GUIModalMenu
 
 	void removeAll();
 
+	// Applies a new formspec string, patching the existing GUI if possible
+	void updateFormSpec(const std::string &formspec_string);
+	bool patchFormSpec(const std::vector<std::string> &elements);
+	bool patchElement(size_t index, const std::string &element, bool apply);
+
 	void parseElement(parserData* data, const std::string &element);
 
 	void parseSize(parserData* data, const std::string &element);
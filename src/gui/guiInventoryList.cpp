@@ -85,34 +85,33 @@ void GUIInventoryList::draw()
 	Client *client = m_fs_menu->getClient();
 	const ItemSpec *selected_item = m_fs_menu->getSelectedItem();
 
+	SpriteBatch2D batch(driver);
+
 	core::rect<s32> imgrect(0, 0, m_slot_size.X, m_slot_size.Y);
 	v2s32 base_pos = AbsoluteRect.UpperLeftCorner;
 
 	const s32 list_size = (s32)ilist->getSize();
+	const s32 slot_count = std::min(m_geom.X * m_geom.Y, list_size - m_start_item_i);
 
-	for (s32 i = 0; i < m_geom.X * m_geom.Y; i++) {
-		s32 item_i = i + m_start_item_i;
-		if (item_i >= list_size)
-			break;
-
+	auto slot_rect = [&] (s32 i) {
 		v2s32 p((i % m_geom.X) * m_slot_spacing.X,
 				(i / m_geom.X) * m_slot_spacing.Y);
-		core::rect<s32> rect = imgrect + base_pos + p;
-		ItemStack item = ilist->getItem(item_i);
+		return imgrect + base_pos + p;
+	};
 
-		bool selected = selected_item
-			&& m_invmgr->getInventory(selected_item->inventoryloc) == inv
-			&& selected_item->listname == m_listname
-			&& selected_item->i == item_i;
+	// layer 0: all slot backgrounds, flushed before the first item so that
+	// item meshes do not split them into several draw calls
+	for (s32 i = 0; i < slot_count; i++) {
+		s32 item_i = i + m_start_item_i;
+		core::rect<s32> rect = slot_rect(i);
 		bool hovering = m_hovered_i == item_i;
-		ItemRotationKind rotation_kind = selected ? IT_ROT_SELECTED :
-			(hovering ? IT_ROT_HOVERED : IT_ROT_NONE);
 
-		// layer 0
 		if (hovering) {
-			driver->draw2DRectangle(m_options.slotbg_h, rect, &AbsoluteClippingRect);
+			batch.drawRectangle(SPRITE_LAYER_SLOT, m_options.slotbg_h, rect,
+					&AbsoluteClippingRect);
 		} else {
-			driver->draw2DRectangle(m_options.slotbg_n, rect, &AbsoluteClippingRect);
+			batch.drawRectangle(SPRITE_LAYER_SLOT, m_options.slotbg_n, rect,
+					&AbsoluteClippingRect);
 		}
 
 		// Draw inv slot borders
@@ -125,28 +124,43 @@ void GUIInventoryList::draw()
 			core::rect<s32> clipping_rect = Parent ? Parent->getAbsoluteClippingRect()
 					: core::rect<s32>();
 			core::rect<s32> *clipping_rect_ptr = Parent ? &clipping_rect : nullptr;
-			driver->draw2DRectangle(m_options.slotbordercolor,
+			batch.drawRectangle(SPRITE_LAYER_SLOT, m_options.slotbordercolor,
 				core::rect<s32>(v2s32(x1 - border, y1 - border),
 								v2s32(x2 + border, y1)), clipping_rect_ptr);
-			driver->draw2DRectangle(m_options.slotbordercolor,
+			batch.drawRectangle(SPRITE_LAYER_SLOT, m_options.slotbordercolor,
 				core::rect<s32>(v2s32(x1 - border, y2),
 								v2s32(x2 + border, y2 + border)), clipping_rect_ptr);
-			driver->draw2DRectangle(m_options.slotbordercolor,
+			batch.drawRectangle(SPRITE_LAYER_SLOT, m_options.slotbordercolor,
 				core::rect<s32>(v2s32(x1 - border, y1),
 								v2s32(x1, y2)), clipping_rect_ptr);
-			driver->draw2DRectangle(m_options.slotbordercolor,
+			batch.drawRectangle(SPRITE_LAYER_SLOT, m_options.slotbordercolor,
 				core::rect<s32>(v2s32(x2, y1),
 								v2s32(x2 + border, y2)), clipping_rect_ptr);
 		}
+	}
+	batch.flush(SPRITE_LAYER_SLOT);
+
+	// layer 1: the items
+	for (s32 i = 0; i < slot_count; i++) {
+		s32 item_i = i + m_start_item_i;
+		core::rect<s32> rect = slot_rect(i);
+		ItemStack item = ilist->getItem(item_i);
+
+		bool selected = selected_item
+			&& m_invmgr->getInventory(selected_item->inventoryloc) == inv
+			&& selected_item->listname == m_listname
+			&& selected_item->i == item_i;
+		bool hovering = m_hovered_i == item_i;
+		ItemRotationKind rotation_kind = selected ? IT_ROT_SELECTED :
+			(hovering ? IT_ROT_HOVERED : IT_ROT_NONE);
 
-		// layer 1
 		if (selected)
 			item.takeItem(m_fs_menu->getSelectedAmount());
 
 		if (!item.empty()) {
 			// Draw item stack
 			drawItemStack(driver, m_font, item, rect, &AbsoluteClippingRect,
-					client, rotation_kind);
+					client, rotation_kind, &batch);
 			// Add hovering tooltip
 			if (hovering && !selected_item) {
 				std::string tooltip = item.getDescription(client->idef());
@@ -157,6 +171,10 @@ void GUIInventoryList::draw()
 		}
 	}
 
+	batch.flush();
+	m_stat_drawcalls += batch.getDrawCallCount();
+	m_stat_sprites += batch.getSpriteCount();
+
 	IGUIElement::draw();
 }
 
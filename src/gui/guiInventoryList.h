@@ -116,6 +116,11 @@ class GUIInventoryList : public gui::IGUIElement
 	// returns -1 if not item is at pos p
 	s32 getItemIndexAtPos(v2s32 p) const;
 
+	// Statistics of the sprite batch since the last call to resetStats()
+	u32 getDrawCallCount() const { return m_stat_drawcalls; }
+	u32 getSpriteCount() const { return m_stat_sprites; }
+	void resetStats() { m_stat_drawcalls = m_stat_sprites = 0; }
+
 private:
 	InventoryManager *m_invmgr;
 	const InventoryLocation m_inventoryloc;
@@ -144,4 +149,7 @@ class GUIInventoryList : public gui::IGUIElement
 
 	// we do not want to write a warning on every draw
 	bool m_already_warned;
+
+	u32 m_stat_drawcalls = 0;
+	u32 m_stat_sprites = 0;
 };
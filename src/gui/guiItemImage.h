@@ -38,6 +38,13 @@ class GUIItemImage : public gui::IGUIElement
 		m_label = text;
 	}
 
+	void setItemName(const std::string &item_name)
+	{
+		m_item_name = item_name;
+	}
+
+	const std::string &getItemName() const { return m_item_name; }
+
 private:
 	std::string m_item_name;
 	gui::IGUIFont *m_font;
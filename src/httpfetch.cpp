@@ -22,9 +22,25 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <iostream>
 #include <sstream>
 #include <list>
+#include <deque>
+#include <vector>
 #include <unordered_map>
 #include <cerrno>
+#include <cstring>
+#include <cstdlib>
 #include <mutex>
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <netinet/tcp.h>
+	#include <netdb.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
 #include "network/socket.h" // for select()
 #include "threading/event.h"
 #include "config.h"
@@ -42,19 +58,19 @@ static std::unordered_map<u64, std::queue<HTTPFetchResult>>
 	g_httpfetch_results;
 
 HTTPFetchRequest::HTTPFetchRequest() :
-	timeout(20),
+	timeout(g_settings->getS32("curl_timeout")),
 	connect_timeout(10 * 1000),
 	useragent(std::string(PROJECT_NAME_C "/") + g_version_hash)
 {
 }
 
 
-static void httpfetch_deliver_result(const HTTPFetchResult &fetch_result)
+static void httpfetch_deliver_result(HTTPFetchResult &&fetch_result)
 {
 	u64 caller = fetch_result.caller;
 	if (caller != HTTPFETCH_DISCARD) {
 		MutexAutoLock lock(g_httpfetch_mutex);
-		g_httpfetch_results[caller].emplace(fetch_result);
+		g_httpfetch_results[caller].emplace(std::move(fetch_result));
 	}
 }
 
@@ -111,38 +127,1144 @@ bool httpfetch_async_get(u64 caller, HTTPFetchResult &fetch_result)
 	return true;
 }
 
+
 /*
-	USE_CURL is off:
+	Built-in HTTP/1.1 client. Plain http:// only, no TLS.
+
+	Requests are handled by HTTPFetchThread, which keeps up to
+	parallel_limit keep-alive connections open. A connection that has
+	already returned a persistent response also gets further GET requests
+	pipelined onto it, so many small files (e.g. remote media) don't wait
+	for a round trip each.
+*/
+
+#ifdef _WIN32
+	typedef SOCKET http_socket_t;
+	#define HTTP_INVALID_SOCKET INVALID_SOCKET
+	#define LAST_SOCKET_ERR() WSAGetLastError()
+	#define SOCKET_WOULD_BLOCK(e) ((e) == WSAEWOULDBLOCK)
+	#define SOCKET_IN_PROGRESS(e) ((e) == WSAEWOULDBLOCK)
+	#define close_socket(fd) closesocket(fd)
+	#define HTTP_SEND_FLAGS 0
+#else
+	typedef int http_socket_t;
+	#define HTTP_INVALID_SOCKET (-1)
+	#define LAST_SOCKET_ERR() (errno)
+	#define SOCKET_WOULD_BLOCK(e) ((e) == EAGAIN || (e) == EWOULDBLOCK)
+	#define SOCKET_IN_PROGRESS(e) ((e) == EINPROGRESS)
+	#define close_socket(fd) ::close(fd)
+	#ifdef MSG_NOSIGNAL
+		#define HTTP_SEND_FLAGS MSG_NOSIGNAL
+	#else
+		#define HTTP_SEND_FLAGS 0
+	#endif
+#endif
+
+// Number of requests that may be outstanding on one connection
+#define HTTP_PIPELINE_DEPTH 6
+// Keep-alive connections without requests are closed after this time
+#define HTTP_IDLE_TIMEOUT_MS 30000
+// How often a request is restarted after its connection broke
+#define HTTP_MAX_RETRIES 2
+#define HTTP_MAX_REDIRECTS 3
+// Size limit of a response header block
+#define HTTP_MAX_HEADER_SIZE (64 * 1024)
+
+static std::string http_urlencode(const std::string &str)
+{
+	static const char hex_chars[] = "0123456789ABCDEF";
+	std::string out;
+	out.reserve(str.size());
+	for (unsigned char c : str) {
+		if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+			out += c;
+		} else {
+			out += '%';
+			out += hex_chars[c >> 4];
+			out += hex_chars[c & 0xf];
+		}
+	}
+	return out;
+}
+
+// Splits an http:// URL. Returns false for anything else.
+static bool http_split_url(const std::string &url, std::string &host,
+		std::string &port, std::string &path)
+{
+	const std::string scheme = "http://";
+	if (!str_starts_with(url, scheme, true))
+		return false;
+
+	size_t host_start = scheme.size();
+	size_t path_start = url.find_first_of("/?#", host_start);
+	if (path_start == std::string::npos)
+		path_start = url.size();
+	std::string authority = url.substr(host_start, path_start - host_start);
+
+	// Strip user info, it is not supported
+	size_t at = authority.rfind('@');
+	if (at != std::string::npos)
+		authority = authority.substr(at + 1);
 
-	Dummy httpfetch implementation that always returns an error.
+	port = "80";
+	if (!authority.empty() && authority[0] == '[') {
+		// IPv6 address literal
+		size_t end = authority.find(']');
+		if (end == std::string::npos)
+			return false;
+		host = authority.substr(1, end - 1);
+		if (end + 1 < authority.size()) {
+			if (authority[end + 1] != ':')
+				return false;
+			port = authority.substr(end + 2);
+		}
+	} else {
+		size_t colon = authority.find(':');
+		host = authority.substr(0, colon);
+		if (colon != std::string::npos)
+			port = authority.substr(colon + 1);
+	}
+
+	path = url.substr(path_start);
+	size_t fragment = path.find('#');
+	if (fragment != std::string::npos)
+		path.erase(fragment);
+	if (path.empty() || path[0] != '/')
+		path = "/" + path;
+
+	return !host.empty() && !port.empty() &&
+		port.find_first_not_of("0123456789") == std::string::npos;
+}
+
+/*
+	A request and its (partial) result
 */
+struct HTTPFetchOngoing
+{
+	HTTPFetchRequest request;
+	HTTPFetchResult result;
+
+	std::string url; // may change when following redirects
+	std::string host;
+	std::string port;
+	std::string wire; // serialized request
+
+	u64 deadline = 0;
+	u8 retries = 0;
+	u8 redirects = 0;
+	bool redirect = false;
+	bool discard = false;
+
+	HTTPFetchOngoing(const HTTPFetchRequest &fetch_request) :
+		request(fetch_request),
+		result(fetch_request),
+		url(fetch_request.url)
+	{}
+
+	bool isIdempotent() const { return request.method == HTTP_GET; }
+
+	// Parses the URL and serializes the request. Returns false on error.
+	bool prepare();
+};
+
+bool HTTPFetchOngoing::prepare()
+{
+	std::string path;
+	if (!http_split_url(url, host, port, path))
+		return false;
+
+	static const char *method_names[] = {"GET", "POST", "PUT", "DELETE"};
+
+	std::string body, content_type;
+	if (!request.raw_data.empty()) {
+		body = request.raw_data;
+	} else if (!request.fields.empty()) {
+		if (request.method == HTTP_POST && request.multipart) {
+			const std::string boundary = "----" PROJECT_NAME_C "FormBoundary";
+			for (const auto &field : request.fields) {
+				body += "--" + boundary + "\r\n"
+					"Content-Disposition: form-data; name=\"" +
+					field.first + "\"\r\n\r\n" + field.second + "\r\n";
+			}
+			body += "--" + boundary + "--\r\n";
+			content_type = "multipart/form-data; boundary=" + boundary;
+		} else {
+			std::string query;
+			for (const auto &field : request.fields) {
+				if (!query.empty())
+					query += '&';
+				query += http_urlencode(field.first) + '=' +
+					http_urlencode(field.second);
+			}
+			if (request.method == HTTP_GET) {
+				path += (path.find('?') == std::string::npos ? '?' : '&') + query;
+			} else {
+				body = query;
+				content_type = "application/x-www-form-urlencoded";
+			}
+		}
+	}
+
+	std::ostringstream os;
+	os << method_names[request.method] << " " << path << " HTTP/1.1\r\n";
+	if (host.find(':') != std::string::npos)
+		os << "Host: [" << host << "]";
+	else
+		os << "Host: " << host;
+	if (port != "80")
+		os << ":" << port;
+	os << "\r\n";
+	os << "User-Agent: " << request.useragent << "\r\n";
+	os << "Accept-Encoding: identity\r\n";
+	bool has_content_type = false;
+	for (const std::string &header : request.extra_headers) {
+		os << header << "\r\n";
+		has_content_type |= str_starts_with(header, "Content-Type:", true);
+	}
+	if (!content_type.empty() && !has_content_type)
+		os << "Content-Type: " << content_type << "\r\n";
+	if (request.method != HTTP_GET || !body.empty())
+		os << "Content-Length: " << body.size() << "\r\n";
+	os << "\r\n";
+	os << body;
+
+	wire = os.str();
+	return true;
+}
+
+static void httpfetch_log_result(const HTTPFetchOngoing &ongoing, const char *error)
+{
+	const HTTPFetchResult &result = ongoing.result;
+	if (error) {
+		errorstream << "HTTPFetch for " << ongoing.url << " failed: "
+			<< error << std::endl;
+	} else if (result.response_code >= 400) {
+		errorstream << "HTTPFetch for " << ongoing.url
+			<< " returned response code " << result.response_code
+			<< std::endl;
+		if (result.caller == HTTPFETCH_PRINT_ERR && !result.data.empty()) {
+			errorstream << "Response body:" << std::endl;
+			safe_print_string(errorstream, result.data);
+			errorstream << std::endl;
+		}
+	}
+}
+
+/*
+	One keep-alive connection to a host. Requests are answered in the order
+	they were added, the front one is the one being received.
+*/
+class HTTPConnection
+{
+public:
+	HTTPConnection(const std::string &host, const std::string &port,
+			long connect_timeout);
+	~HTTPConnection();
+	DISABLE_CLASS_COPY(HTTPConnection)
+
+	bool matches(const HTTPFetchOngoing *ongoing) const
+	{
+		return ongoing->host == m_host && ongoing->port == m_port;
+	}
+
+	bool isClosed() const { return m_state == STATE_CLOSED; }
+	bool isIdle() const { return m_state != STATE_CLOSED && m_queue.empty(); }
+	size_t getQueueSize() const { return m_queue.size(); }
+	u64 getIdleSince() const { return m_idle_since; }
+
+	// Whether another request can be sent before the current ones finished
+	bool canPipeline() const;
+
+	void add(HTTPFetchOngoing *ongoing, u64 now);
+
+	// Marks all requests of this caller as discarded
+	void discardCaller(u64 caller);
+
+	void fillSets(fd_set *rd, fd_set *wr, int *maxfd) const;
+
+	// Does socket I/O and parses responses. Finished requests are appended
+	// to done, requests that need to be started again to retry.
+	void step(const fd_set *rd, const fd_set *wr, u64 now,
+			std::vector<HTTPFetchOngoing *> &done,
+			std::vector<HTTPFetchOngoing *> &retry);
+
+	// Closes the connection, failing or retrying all requests
+	void close(const char *error, bool timeout,
+			std::vector<HTTPFetchOngoing *> &done,
+			std::vector<HTTPFetchOngoing *> &retry);
+
+private:
+	enum State {
+		STATE_CONNECTING,
+		STATE_OPEN,
+		STATE_CLOSED,
+	};
+
+	enum BodyMode {
+		BODY_LENGTH,
+		BODY_CHUNKED,
+		BODY_UNTIL_CLOSE,
+	};
+
+	enum ChunkState {
+		CHUNK_SIZE,
+		CHUNK_DATA,
+		CHUNK_DATA_END,
+		CHUNK_TRAILER,
+	};
+
+	bool connectNext();
+	bool parseHeaders();
+	// Returns true if the front response is complete
+	bool parseBody();
+	void completeFront(std::vector<HTTPFetchOngoing *> &done,
+			std::vector<HTTPFetchOngoing *> &retry);
+	void resetResponse();
+
+	std::string m_host;
+	std::string m_port;
+	State m_state = STATE_CLOSED;
+	http_socket_t m_fd = HTTP_INVALID_SOCKET;
+
+	std::vector<struct sockaddr_storage> m_addrs;
+	std::vector<socklen_t> m_addr_lens;
+	size_t m_next_addr = 0;
+	u64 m_connect_deadline = 0;
+
+	std::deque<HTTPFetchOngoing *> m_queue;
+	std::string m_send_buf;
+	size_t m_send_pos = 0;
+	std::string m_recv_buf;
+	size_t m_recv_pos = 0;
+	u64 m_idle_since = 0;
+
+	// Set once the server kept the connection open after a response
+	bool m_persistent = false;
+
+	// State of the response to m_queue.front()
+	bool m_headers_done = false;
+	bool m_close_after = false;
+	BodyMode m_body_mode = BODY_LENGTH;
+	size_t m_content_length = 0;
+	ChunkState m_chunk_state = CHUNK_SIZE;
+	size_t m_chunk_remaining = 0;
+	long m_response_code = 0;
+	std::string m_location;
+	std::string m_body;
+	bool m_got_response_data = false;
+};
+
+HTTPConnection::HTTPConnection(const std::string &host, const std::string &port,
+		long connect_timeout) :
+	m_host(host),
+	m_port(port)
+{
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo *res = nullptr;
+	int e = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+	if (e != 0) {
+		infostream << "HTTPFetch: cannot resolve " << host << ": "
+			<< gai_strerror(e) << std::endl;
+		return;
+	}
+	for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+		struct sockaddr_storage addr;
+		memcpy(&addr, ai->ai_addr, ai->ai_addrlen);
+		m_addrs.push_back(addr);
+		m_addr_lens.push_back(ai->ai_addrlen);
+	}
+	freeaddrinfo(res);
+
+	m_connect_deadline = porting::getTimeMs() + connect_timeout;
+	connectNext();
+}
+
+HTTPConnection::~HTTPConnection()
+{
+	if (m_fd != HTTP_INVALID_SOCKET)
+		close_socket(m_fd);
+	for (HTTPFetchOngoing *ongoing : m_queue)
+		delete ongoing;
+}
+
+bool HTTPConnection::connectNext()
+{
+	while (m_next_addr < m_addrs.size()) {
+		const struct sockaddr_storage &addr = m_addrs[m_next_addr];
+		socklen_t addr_len = m_addr_lens[m_next_addr];
+		m_next_addr++;
+
+		if (m_fd != HTTP_INVALID_SOCKET)
+			close_socket(m_fd);
+		m_fd = socket(addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+		if (m_fd == HTTP_INVALID_SOCKET)
+			continue;
+
+#ifdef _WIN32
+		u_long nonblocking = 1;
+		ioctlsocket(m_fd, FIONBIO, &nonblocking);
+#else
+		fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+#endif
+		int nodelay = 1;
+		setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY,
+				(const char *)&nodelay, sizeof(nodelay));
+#ifdef SO_NOSIGPIPE
+		int nosigpipe = 1;
+		setsockopt(m_fd, SOL_SOCKET, SO_NOSIGPIPE, &nosigpipe, sizeof(nosigpipe));
+#endif
+
+		if (connect(m_fd, (const struct sockaddr *)&addr, addr_len) == 0) {
+			m_state = STATE_OPEN;
+			return true;
+		}
+		if (SOCKET_IN_PROGRESS(LAST_SOCKET_ERR())) {
+			m_state = STATE_CONNECTING;
+			return true;
+		}
+	}
+
+	if (m_fd != HTTP_INVALID_SOCKET) {
+		close_socket(m_fd);
+		m_fd = HTTP_INVALID_SOCKET;
+	}
+	m_state = STATE_CLOSED;
+	return false;
+}
+
+bool HTTPConnection::canPipeline() const
+{
+	if (m_state != STATE_OPEN || !m_persistent || m_close_after)
+		return false;
+	if (m_queue.size() >= HTTP_PIPELINE_DEPTH)
+		return false;
+	for (const HTTPFetchOngoing *ongoing : m_queue) {
+		if (!ongoing->isIdempotent())
+			return false;
+	}
+	return true;
+}
+
+void HTTPConnection::add(HTTPFetchOngoing *ongoing, u64 now)
+{
+	if (m_queue.empty())
+		resetResponse();
+	ongoing->deadline = now + ongoing->request.timeout;
+	m_queue.push_back(ongoing);
+	m_send_buf.append(ongoing->wire);
+}
+
+void HTTPConnection::discardCaller(u64 caller)
+{
+	for (HTTPFetchOngoing *ongoing : m_queue) {
+		if (ongoing->result.caller == caller)
+			ongoing->discard = true;
+	}
+}
+
+void HTTPConnection::fillSets(fd_set *rd, fd_set *wr, int *maxfd) const
+{
+	if (m_fd == HTTP_INVALID_SOCKET)
+		return;
+
+	FD_SET(m_fd, rd);
+	if (m_state == STATE_CONNECTING || m_send_pos < m_send_buf.size())
+		FD_SET(m_fd, wr);
+#ifdef _WIN32
+	// select() ignores it, it only tells that there is a socket
+	*maxfd = MYMAX(*maxfd, 0);
+#else
+	*maxfd = MYMAX(*maxfd, m_fd);
+#endif
+}
+
+void HTTPConnection::resetResponse()
+{
+	m_headers_done = false;
+	m_body_mode = BODY_LENGTH;
+	m_content_length = 0;
+	m_chunk_state = CHUNK_SIZE;
+	m_chunk_remaining = 0;
+	m_response_code = 0;
+	m_location.clear();
+	m_body.clear();
+	m_got_response_data = false;
+}
+
+void HTTPConnection::close(const char *error, bool timeout,
+		std::vector<HTTPFetchOngoing *> &done,
+		std::vector<HTTPFetchOngoing *> &retry)
+{
+	if (m_fd != HTTP_INVALID_SOCKET) {
+		close_socket(m_fd);
+		m_fd = HTTP_INVALID_SOCKET;
+	}
+	m_state = STATE_CLOSED;
+
+	// The front request failed if it already got some of its response
+	// (or timed out). All others were never answered and can be retried.
+	bool front = true;
+	for (HTTPFetchOngoing *ongoing : m_queue) {
+		bool failed = (front && (m_got_response_data || timeout)) ||
+				ongoing->retries >= HTTP_MAX_RETRIES ||
+				!ongoing->isIdempotent();
+		if (failed) {
+			ongoing->result.succeeded = false;
+			ongoing->result.timeout = front && timeout;
+			if (!ongoing->discard)
+				httpfetch_log_result(*ongoing, error);
+			done.push_back(ongoing);
+		} else {
+			ongoing->retries++;
+			retry.push_back(ongoing);
+		}
+		front = false;
+	}
+	m_queue.clear();
+	m_send_buf.clear();
+	m_send_pos = 0;
+	m_recv_buf.clear();
+	m_recv_pos = 0;
+	resetResponse();
+}
+
+bool HTTPConnection::parseHeaders()
+{
+	for (;;) {
+		size_t end = m_recv_buf.find("\r\n\r\n", m_recv_pos);
+		if (end == std::string::npos) {
+			if (m_recv_buf.size() - m_recv_pos > HTTP_MAX_HEADER_SIZE)
+				throw SerializationError("response header too large");
+			return false;
+		}
+
+		std::istringstream is(m_recv_buf.substr(m_recv_pos, end - m_recv_pos));
+		m_recv_pos = end + 4;
+
+		std::string line;
+		std::getline(is, line);
+		// "HTTP/1.1 200 OK"
+		if (!str_starts_with(line, "HTTP/1.") || line.size() < 12)
+			throw SerializationError("invalid status line");
+		bool http10 = line[7] == '0';
+		m_response_code = mystoi(line.substr(9, 3));
+		if (m_response_code < 100 || m_response_code > 599)
+			throw SerializationError("invalid status code");
+
+		bool has_length = false;
+		bool chunked = false;
+		bool keep_alive = !http10;
+		m_location.clear();
+		while (std::getline(is, line)) {
+			size_t colon = line.find(':');
+			if (colon == std::string::npos)
+				continue;
+			std::string name = lowercase(trim(line.substr(0, colon)));
+			std::string value = trim(line.substr(colon + 1));
+			if (name == "content-length") {
+				has_length = true;
+				m_content_length = std::strtoull(value.c_str(), nullptr, 10);
+			} else if (name == "transfer-encoding") {
+				chunked = lowercase(value).find("chunked") != std::string::npos;
+			} else if (name == "connection") {
+				std::string v = lowercase(value);
+				if (v.find("close") != std::string::npos)
+					keep_alive = false;
+				else if (v.find("keep-alive") != std::string::npos)
+					keep_alive = true;
+			} else if (name == "location") {
+				m_location = value;
+			}
+		}
+
+		// Informational responses (e.g. 100 Continue) precede the real one
+		if (m_response_code >= 100 && m_response_code < 200)
+			continue;
+
+		m_close_after = !keep_alive;
+		if (m_response_code == 204 || m_response_code == 304) {
+			m_body_mode = BODY_LENGTH;
+			m_content_length = 0;
+		} else if (chunked) {
+			m_body_mode = BODY_CHUNKED;
+		} else if (has_length) {
+			m_body_mode = BODY_LENGTH;
+		} else {
+			m_body_mode = BODY_UNTIL_CLOSE;
+			m_close_after = true;
+		}
+		if (m_body_mode == BODY_LENGTH)
+			m_body.reserve(m_content_length);
+		m_headers_done = true;
+		return true;
+	}
+}
+
+bool HTTPConnection::parseBody()
+{
+	if (m_body_mode == BODY_LENGTH) {
+		size_t n = MYMIN(m_content_length - m_body.size(),
+				m_recv_buf.size() - m_recv_pos);
+		m_body.append(m_recv_buf, m_recv_pos, n);
+		m_recv_pos += n;
+		return m_body.size() == m_content_length;
+	}
+
+	if (m_body_mode == BODY_UNTIL_CLOSE) {
+		m_body.append(m_recv_buf, m_recv_pos, std::string::npos);
+		m_recv_pos = m_recv_buf.size();
+		return false;
+	}
+
+	for (;;) {
+		switch (m_chunk_state) {
+		case CHUNK_SIZE: {
+			size_t end = m_recv_buf.find("\r\n", m_recv_pos);
+			if (end == std::string::npos)
+				return false;
+			std::string size_str = m_recv_buf.substr(m_recv_pos, end - m_recv_pos);
+			m_recv_pos = end + 2;
+			if (size_str.empty() || !isxdigit((unsigned char)size_str[0]))
+				throw SerializationError("invalid chunk size");
+			// Chunk extensions after ';' are ignored by strtoull
+			m_chunk_remaining = std::strtoull(size_str.c_str(), nullptr, 16);
+			m_chunk_state = m_chunk_remaining ? CHUNK_DATA : CHUNK_TRAILER;
+			break;
+		}
+		case CHUNK_DATA: {
+			size_t n = MYMIN(m_chunk_remaining, m_recv_buf.size() - m_recv_pos);
+			if (n == 0)
+				return false;
+			m_body.append(m_recv_buf, m_recv_pos, n);
+			m_recv_pos += n;
+			m_chunk_remaining -= n;
+			if (m_chunk_remaining == 0)
+				m_chunk_state = CHUNK_DATA_END;
+			break;
+		}
+		case CHUNK_DATA_END:
+			if (m_recv_buf.size() - m_recv_pos < 2)
+				return false;
+			if (m_recv_buf.compare(m_recv_pos, 2, "\r\n") != 0)
+				throw SerializationError("invalid chunk terminator");
+			m_recv_pos += 2;
+			m_chunk_state = CHUNK_SIZE;
+			break;
+		case CHUNK_TRAILER: {
+			// Trailer fields are skipped, an empty line ends the body
+			size_t end = m_recv_buf.find("\r\n", m_recv_pos);
+			if (end == std::string::npos)
+				return false;
+			bool last = end == m_recv_pos;
+			m_recv_pos = end + 2;
+			if (last)
+				return true;
+			break;
+		}
+		}
+	}
+}
+
+void HTTPConnection::completeFront(std::vector<HTTPFetchOngoing *> &done,
+		std::vector<HTTPFetchOngoing *> &retry)
+{
+	HTTPFetchOngoing *ongoing = m_queue.front();
+	m_queue.pop_front();
+
+	ongoing->result.succeeded = true;
+	ongoing->result.response_code = m_response_code;
+	ongoing->result.data = std::move(m_body);
+
+	bool is_redirect = m_response_code == 301 || m_response_code == 302 ||
+		m_response_code == 303 || m_response_code == 307 ||
+		m_response_code == 308;
+	if (is_redirect && !m_location.empty() && ongoing->isIdempotent() &&
+			ongoing->redirects < HTTP_MAX_REDIRECTS) {
+		// Relative locations refer to the same server
+		if (m_location[0] == '/') {
+			std::string url = "http://";
+			url += m_host.find(':') != std::string::npos ?
+				"[" + m_host + "]" : m_host;
+			m_location = url + ":" + m_port + m_location;
+		}
+		ongoing->url = m_location;
+		ongoing->redirects++;
+		ongoing->redirect = true;
+		ongoing->result.data.clear();
+		retry.push_back(ongoing);
+	} else {
+		if (!ongoing->discard)
+			httpfetch_log_result(*ongoing, nullptr);
+		done.push_back(ongoing);
+	}
+
+	resetResponse();
+	if (!m_close_after)
+		m_persistent = true;
+}
+
+void HTTPConnection::step(const fd_set *rd, const fd_set *wr, u64 now,
+		std::vector<HTTPFetchOngoing *> &done,
+		std::vector<HTTPFetchOngoing *> &retry)
+{
+	if (m_state == STATE_CLOSED) {
+		if (!m_queue.empty())
+			close("could not connect", false, done, retry);
+		return;
+	}
+
+	if (m_state == STATE_CONNECTING) {
+		if (FD_ISSET(m_fd, wr) || FD_ISSET(m_fd, rd)) {
+			int err = 0;
+			socklen_t len = sizeof(err);
+			getsockopt(m_fd, SOL_SOCKET, SO_ERROR, (char *)&err, &len);
+			if (err == 0) {
+				m_state = STATE_OPEN;
+			} else if (!connectNext()) {
+				close("could not connect", false, done, retry);
+				return;
+			}
+		} else if (now > m_connect_deadline) {
+			close("connection timed out", true, done, retry);
+			return;
+		}
+		if (m_state != STATE_OPEN)
+			return;
+	}
+
+	// Send pending requests
+	while (m_send_pos < m_send_buf.size()) {
+		int n = send(m_fd, m_send_buf.data() + m_send_pos,
+				m_send_buf.size() - m_send_pos, HTTP_SEND_FLAGS);
+		if (n < 0) {
+			if (SOCKET_WOULD_BLOCK(LAST_SOCKET_ERR()))
+				break;
+			close("send failed", false, done, retry);
+			return;
+		}
+		m_send_pos += n;
+	}
+	if (m_send_pos == m_send_buf.size()) {
+		m_send_buf.clear();
+		m_send_pos = 0;
+	}
+
+	// Receive what is there
+	bool eof = false;
+	if (FD_ISSET(m_fd, rd)) {
+		char buf[64 * 1024];
+		for (int i = 0; i < 16; i++) {
+			int n = recv(m_fd, buf, sizeof(buf), 0);
+			if (n > 0) {
+				m_recv_buf.append(buf, n);
+				continue;
+			}
+			if (n < 0 && SOCKET_WOULD_BLOCK(LAST_SOCKET_ERR()))
+				break;
+			eof = true;
+			break;
+		}
+	}
+
+	// Parse responses
+	try {
+		while (!m_queue.empty() && m_recv_pos < m_recv_buf.size()) {
+			m_got_response_data = true;
+			if (!m_headers_done && !parseHeaders())
+				break;
+			if (!parseBody())
+				break;
+			completeFront(done, retry);
+			if (m_close_after) {
+				eof = true;
+				break;
+			}
+		}
+		// A body without length ends with the connection
+		if (eof && !m_queue.empty() && m_headers_done &&
+				m_body_mode == BODY_UNTIL_CLOSE)
+			completeFront(done, retry);
+	} catch (SerializationError &e) {
+		close(e.what(), false, done, retry);
+		return;
+	}
+
+	if (m_recv_pos == m_recv_buf.size()) {
+		m_recv_buf.clear();
+		m_recv_pos = 0;
+	} else if (m_recv_pos > m_recv_buf.size() / 2) {
+		m_recv_buf.erase(0, m_recv_pos);
+		m_recv_pos = 0;
+	}
+
+	if (eof) {
+		close("connection closed by server", false, done, retry);
+		return;
+	}
+
+	if (m_queue.empty()) {
+		if (m_idle_since == 0)
+			m_idle_since = now;
+	} else {
+		m_idle_since = 0;
+		if (now > m_queue.front()->deadline)
+			close("operation timed out", true, done, retry);
+	}
+}
+
+/*
+	The fetch thread
+*/
+
+class HTTPFetchThread : public Thread
+{
+protected:
+	enum RequestType {
+		RT_FETCH,
+		RT_CLEAR,
+		RT_WAKEUP,
+	};
+
+	struct Request {
+		RequestType type = RT_WAKEUP;
+		HTTPFetchRequest fetch_request;
+		Event *event = nullptr;
+	};
+
+	MutexedQueue<Request> m_requests;
+	size_t m_parallel_limit;
+
+	// Requests waiting for a connection
+	std::deque<HTTPFetchOngoing *> m_queued;
+	std::vector<HTTPConnection *> m_connections;
+
+public:
+	HTTPFetchThread(int parallel_limit) :
+		Thread("HTTPFetch")
+	{
+		m_parallel_limit = MYMAX(parallel_limit, 1);
+	}
+
+	void requestFetch(const HTTPFetchRequest &fetch_request)
+	{
+		Request req;
+		req.type = RT_FETCH;
+		req.fetch_request = fetch_request;
+		m_requests.push_back(std::move(req));
+	}
+
+	void requestClear(u64 caller, Event *event)
+	{
+		Request req;
+		req.type = RT_CLEAR;
+		req.fetch_request.caller = caller;
+		req.event = event;
+		m_requests.push_back(std::move(req));
+	}
+
+	void requestWakeUp()
+	{
+		Request req;
+		req.type = RT_WAKEUP;
+		m_requests.push_back(std::move(req));
+	}
+
+protected:
+	void processRequest(const Request &req)
+	{
+		if (req.type == RT_FETCH) {
+			HTTPFetchOngoing *ongoing = new HTTPFetchOngoing(req.fetch_request);
+			if (!ongoing->prepare()) {
+				httpfetch_log_result(*ongoing, str_starts_with(ongoing->url, "https://", true) ?
+					"https is not supported without cURL" : "invalid URL");
+				finish(ongoing);
+				return;
+			}
+			m_queued.push_back(ongoing);
+		} else if (req.type == RT_CLEAR) {
+			u64 caller = req.fetch_request.caller;
+			for (auto it = m_queued.begin(); it != m_queued.end();) {
+				if ((*it)->result.caller == caller) {
+					delete *it;
+					it = m_queued.erase(it);
+				} else {
+					++it;
+				}
+			}
+			for (HTTPConnection *conn : m_connections)
+				conn->discardCaller(caller);
+			if (req.event)
+				req.event->signal();
+		}
+		// RT_WAKEUP: nothing to do
+	}
+
+	void finish(HTTPFetchOngoing *ongoing)
+	{
+		if (!ongoing->discard)
+			httpfetch_deliver_result(std::move(ongoing->result));
+		delete ongoing;
+	}
+
+	bool hasActiveTransfers() const
+	{
+		if (!m_queued.empty())
+			return true;
+		for (const HTTPConnection *conn : m_connections) {
+			if (!conn->isIdle())
+				return true;
+		}
+		return false;
+	}
+
+	// Assigns waiting requests to connections
+	void dispatch(u64 now)
+	{
+		for (auto it = m_queued.begin(); it != m_queued.end();) {
+			HTTPFetchOngoing *ongoing = *it;
+
+			HTTPConnection *idle = nullptr, *pipelined = nullptr;
+			for (HTTPConnection *conn : m_connections) {
+				if (!conn->matches(ongoing) || conn->isClosed())
+					continue;
+				if (conn->isIdle()) {
+					idle = conn;
+					break;
+				}
+				if (ongoing->isIdempotent() && conn->canPipeline() &&
+						(!pipelined || conn->getQueueSize() < pipelined->getQueueSize()))
+					pipelined = conn;
+			}
+
+			HTTPConnection *conn = idle;
+			if (!conn && m_connections.size() >= m_parallel_limit && !pipelined) {
+				// Make room by dropping a connection to another server
+				for (auto c = m_connections.begin(); c != m_connections.end(); ++c) {
+					if ((*c)->isIdle() || (*c)->isClosed()) {
+						delete *c;
+						m_connections.erase(c);
+						break;
+					}
+				}
+			}
+			if (!conn && m_connections.size() < m_parallel_limit) {
+				conn = new HTTPConnection(ongoing->host, ongoing->port,
+						ongoing->request.connect_timeout);
+				m_connections.push_back(conn);
+			}
+			if (!conn)
+				conn = pipelined;
+			if (!conn) {
+				++it;
+				continue;
+			}
+
+			conn->add(ongoing, now);
+			it = m_queued.erase(it);
+		}
+	}
+
+	void processResults(std::vector<HTTPFetchOngoing *> &done,
+			std::vector<HTTPFetchOngoing *> &retry)
+	{
+		for (HTTPFetchOngoing *ongoing : done)
+			finish(ongoing);
+		done.clear();
+
+		// Retried requests go first to keep the order of results
+		for (auto it = retry.rbegin(); it != retry.rend(); ++it) {
+			HTTPFetchOngoing *ongoing = *it;
+			if (ongoing->redirect) {
+				ongoing->redirect = false;
+				verbosestream << "HTTPFetch: following redirect to "
+					<< ongoing->url << std::endl;
+				if (!ongoing->prepare()) {
+					httpfetch_log_result(*ongoing, "unsupported redirect");
+					ongoing->result.succeeded = false;
+					finish(ongoing);
+					continue;
+				}
+			}
+			m_queued.push_front(ongoing);
+		}
+		retry.clear();
+	}
+
+	void *run()
+	{
+		std::vector<HTTPFetchOngoing *> done, retry;
+
+		while (!stopRequested()) {
+			// Block on the request queue when there is nothing to transfer
+			u32 wait_ms = 0;
+			if (!hasActiveTransfers())
+				wait_ms = m_connections.empty() ? 100000000 : 1000;
+			try {
+				for (;;) {
+					processRequest(m_requests.pop_front(wait_ms));
+					wait_ms = 0;
+				}
+			} catch (ItemNotFoundException &e) {
+			}
+
+			if (stopRequested())
+				break;
+
+			u64 now = porting::getTimeMs();
+			dispatch(now);
+
+			if (m_connections.empty())
+				continue;
+
+			fd_set rd, wr;
+			FD_ZERO(&rd);
+			FD_ZERO(&wr);
+			int maxfd = -1;
+			for (const HTTPConnection *conn : m_connections)
+				conn->fillSets(&rd, &wr, &maxfd);
+
+			if (maxfd != -1) {
+				// Short timeout so new requests are picked up quickly
+				struct timeval tv;
+				tv.tv_sec = 0;
+				tv.tv_usec = hasActiveTransfers() ? 10000 : 0;
+				if (select(maxfd + 1, &rd, &wr, nullptr, &tv) < 0) {
+					FD_ZERO(&rd);
+					FD_ZERO(&wr);
+				}
+			}
+
+			now = porting::getTimeMs();
+			for (auto it = m_connections.begin(); it != m_connections.end();) {
+				HTTPConnection *conn = *it;
+				conn->step(&rd, &wr, now, done, retry);
+				if (conn->isIdle() && now - conn->getIdleSince() > HTTP_IDLE_TIMEOUT_MS)
+					conn->close(nullptr, false, done, retry);
+				if (conn->isClosed()) {
+					delete conn;
+					it = m_connections.erase(it);
+				} else {
+					++it;
+				}
+			}
+
+			processResults(done, retry);
+		}
+
+		// Drop whatever is left
+		for (HTTPFetchOngoing *ongoing : m_queued)
+			delete ongoing;
+		m_queued.clear();
+		for (HTTPConnection *conn : m_connections)
+			delete conn;
+		m_connections.clear();
+
+		return NULL;
+	}
+};
+
+static HTTPFetchThread *g_httpfetch_thread = NULL;
 
 void httpfetch_init(int parallel_limit)
 {
+	FATAL_ERROR_IF(g_httpfetch_thread, "httpfetch_init called twice");
+
+	verbosestream << "httpfetch_init: parallel_limit=" << parallel_limit
+			<< std::endl;
+
+	g_httpfetch_thread = new HTTPFetchThread(parallel_limit);
+	g_httpfetch_thread->start();
 }
 
 void httpfetch_cleanup()
 {
+	verbosestream << "httpfetch_cleanup: cleaning up" << std::endl;
+
+	if (g_httpfetch_thread) {
+		g_httpfetch_thread->stop();
+		g_httpfetch_thread->requestWakeUp();
+		g_httpfetch_thread->wait();
+		delete g_httpfetch_thread;
+		g_httpfetch_thread = NULL;
+	}
 }
 
 void httpfetch_async(const HTTPFetchRequest &fetch_request)
 {
-	errorstream << "httpfetch_async: unable to fetch " << fetch_request.url
-			<< " because USE_CURL=0" << std::endl;
+	if (!g_httpfetch_thread) {
+		errorstream << "httpfetch_async: unable to fetch " << fetch_request.url
+				<< " because httpfetch is not initialized" << std::endl;
+		httpfetch_deliver_result(HTTPFetchResult(fetch_request));
+		return;
+	}
 
-	HTTPFetchResult fetch_result(fetch_request); // sets succeeded = false etc.
-	httpfetch_deliver_result(fetch_result);
+	g_httpfetch_thread->requestFetch(fetch_request);
 }
 
 static void httpfetch_request_clear(u64 caller)
 {
+	if (!g_httpfetch_thread)
+		return;
+
+	if (g_httpfetch_thread->isRunning()) {
+		Event event;
+		g_httpfetch_thread->requestClear(caller, &event);
+		event.wait();
+	} else {
+		g_httpfetch_thread->requestClear(caller, NULL);
+	}
 }
 
 void httpfetch_sync(const HTTPFetchRequest &fetch_request,
 		HTTPFetchResult &fetch_result)
 {
-	errorstream << "httpfetch_sync: unable to fetch " << fetch_request.url
-			<< " because USE_CURL=0" << std::endl;
+	// Run the request on this thread, with its own connection
+	HTTPFetchOngoing *ongoing = new HTTPFetchOngoing(fetch_request);
+	std::vector<HTTPFetchOngoing *> done, retry;
+	HTTPConnection *conn = nullptr;
+
+	for (;;) {
+		if (!ongoing->prepare()) {
+			httpfetch_log_result(*ongoing, "invalid or unsupported URL");
+			ongoing->result.succeeded = false;
+			break;
+		}
+
+		u64 now = porting::getTimeMs();
+		conn = new HTTPConnection(ongoing->host, ongoing->port,
+				ongoing->request.connect_timeout);
+		conn->add(ongoing, now);
+
+		while (done.empty() && retry.empty()) {
+			fd_set rd, wr;
+			FD_ZERO(&rd);
+			FD_ZERO(&wr);
+			int maxfd = -1;
+			conn->fillSets(&rd, &wr, &maxfd);
+			if (maxfd != -1) {
+				struct timeval tv;
+				tv.tv_sec = 0;
+				tv.tv_usec = 100000;
+				if (select(maxfd + 1, &rd, &wr, nullptr, &tv) < 0) {
+					FD_ZERO(&rd);
+					FD_ZERO(&wr);
+				}
+			}
+			conn->step(&rd, &wr, porting::getTimeMs(), done, retry);
+		}
+		delete conn;
+
+		if (!done.empty())
+			break;
+
+		// Redirected or retried
+		retry.clear();
+		ongoing->redirect = false;
+	}
 
-	fetch_result = HTTPFetchResult(fetch_request); // sets succeeded = false etc.
+	fetch_result = std::move(ongoing->result);
+	delete ongoing;
 }
@@ -20,6 +20,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "log.h"
 
 #include "threading/mutex_auto_lock.h"
+#include "threading/semaphore.h"
+#include "threading/thread.h"
 #include "debug.h"
 #include "gettime.h"
 #include "porting.h"
@@ -255,10 +257,31 @@ void Logger::log(LogLevel lev, const std::string &text)
 	const std::string thread_name = getThreadName();
 	const std::string label = getLevelLabel(lev);
 	const std::string timestamp = getTimestamp();
-	std::ostringstream os(std::ios_base::binary);
-	os << timestamp << ": " << label << "[" << thread_name << "]: " << text;
+	std::string combined;
+	combined.reserve(timestamp.size() + label.size() + thread_name.size() +
+		text.size() + 6);
+	combined.append(timestamp).append(": ").append(label).append("[");
+	const size_t thread_name_pos = combined.size();
+	combined.append(thread_name).append("]: ");
+	const size_t payload_pos = combined.size();
+	combined.append(text);
+
+	if (isAsync()) {
+		// The other parts are cut out of the combined line by the writer
+		LogRecord record;
+		record.level = lev;
+		record.time_len = timestamp.size();
+		record.thread_name_pos = thread_name_pos;
+		record.thread_name_len = thread_name.size();
+		record.payload_pos = payload_pos;
+		record.combined = std::move(combined);
+		if (enqueueAsync(std::move(record)))
+			return;
+		// Async mode was turned off in the meantime
+		combined = std::move(record.combined);
+	}
 
-	logToOutputs(lev, os.str(), timestamp, thread_name, text);
+	logToOutputs(lev, combined, timestamp, thread_name, text);
 }
 
 void Logger::logRaw(LogLevel lev, const std::string &text)
@@ -266,14 +289,25 @@ void Logger::logRaw(LogLevel lev, const std::string &text)
 	if (m_silenced_levels[lev])
 		return;
 
+	if (isAsync()) {
+		LogRecord record;
+		record.level = lev;
+		record.raw = true;
+		record.combined = text;
+		if (enqueueAsync(std::move(record)))
+			return;
+	}
+
 	logToOutputsRaw(lev, text);
 }
 
 void Logger::logToOutputsRaw(LogLevel lev, const std::string &line)
 {
 	MutexAutoLock lock(m_mutex);
-	for (size_t i = 0; i != m_outputs[lev].size(); i++)
+	for (size_t i = 0; i != m_outputs[lev].size(); i++) {
 		m_outputs[lev][i]->logRaw(lev, line);
+		m_outputs[lev][i]->flush();
+	}
 }
 
 void Logger::logToOutputs(LogLevel lev, const std::string &combined,
@@ -281,8 +315,234 @@ void Logger::logToOutputs(LogLevel lev, const std::string &combined,
 	const std::string &payload_text)
 {
 	MutexAutoLock lock(m_mutex);
-	for (size_t i = 0; i != m_outputs[lev].size(); i++)
+	for (size_t i = 0; i != m_outputs[lev].size(); i++) {
 		m_outputs[lev][i]->log(lev, combined, time, thread_name, payload_text);
+		m_outputs[lev][i]->flush();
+	}
+}
+
+////
+//// Asynchronous logging
+////
+
+static thread_local bool t_is_log_writer = false;
+
+class LogWriterThread : public Thread {
+public:
+	LogWriterThread(Logger &logger) :
+		Thread("LogWriter"),
+		m_logger(logger)
+	{}
+
+	void wakeup()
+	{
+		m_wakeup.post();
+	}
+
+protected:
+	void *run()
+	{
+		t_is_log_writer = true;
+		while (!stopRequested()) {
+			// Batch up writes; producers wake us early when the queue
+			// fills up or when they wait for a flush
+			m_wakeup.wait(WRITE_INTERVAL_MS);
+			m_logger.drainAsync();
+		}
+		m_logger.drainAsync();
+		return nullptr;
+	}
+
+private:
+	static const u32 WRITE_INTERVAL_MS = 50;
+
+	Logger &m_logger;
+	Semaphore m_wakeup;
+};
+
+static LogRecord makeDroppedRecord(u32 dropped)
+{
+	LogRecord record;
+	record.level = LL_WARNING;
+	const std::string time = getTimestamp();
+	const std::string thread_name = "LogWriter";
+	record.combined = time + ": " + Logger::getLevelLabel(LL_WARNING) + "[";
+	record.time_len = time.size();
+	record.thread_name_pos = record.combined.size();
+	record.thread_name_len = thread_name.size();
+	record.combined += thread_name + "]: ";
+	record.payload_pos = record.combined.size();
+	record.combined += "Log queue overflow, " + std::to_string(dropped) +
+		" message(s) were dropped";
+	return record;
+}
+
+void Logger::startAsync(u32 queue_size, bool block_when_full)
+{
+	if (isAsync())
+		return;
+
+	m_async_queue_size = std::max<u32>(queue_size, 16);
+	m_async_block = block_when_full;
+	m_async_queue.reserve(m_async_queue_size);
+	m_async_batch.reserve(m_async_queue_size);
+	// The writer is kept around after stopAsync() since late log calls
+	// from other threads may still try to wake it up
+	if (!m_async_writer)
+		m_async_writer = new LogWriterThread(*this);
+	m_async.store(true, std::memory_order_release);
+	m_async_writer->start();
+}
+
+void Logger::stopAsync()
+{
+	if (!isAsync())
+		return;
+
+	m_async_writer->stop();
+	m_async_writer->wakeup();
+	m_async_writer->wait();
+
+	{
+		// Write what was queued while the writer shut down. Log calls
+		// check the mode under this lock too, so they either made it into
+		// the queue or are written directly after it.
+		MutexAutoLock lock(m_async_mutex);
+		m_async.store(false, std::memory_order_release);
+		m_async_batch.clear();
+		m_async_batch.swap(m_async_queue);
+		if (m_async_dropped > 0) {
+			m_async_batch.push_back(makeDroppedRecord(m_async_dropped));
+			m_async_dropped = 0;
+		}
+		writeRecords(m_async_batch);
+		m_async_batch.clear();
+	}
+	// Producers waiting for space now log directly
+	m_async_space_cv.notify_all();
+
+	// Release anyone still waiting in flushAsync()
+	MutexAutoLock lock(m_async_flush_mutex);
+	m_async_flush_done = m_async_flush_requested;
+	m_async_flush_cv.notify_all();
+}
+
+void Logger::flushAsync()
+{
+	if (!isAsync() || t_is_log_writer)
+		return;
+
+	std::unique_lock<std::mutex> lock(m_async_flush_mutex);
+	const u64 ticket = ++m_async_flush_requested;
+	m_async_writer->wakeup();
+	m_async_flush_cv.wait(lock, [&] {
+		return m_async_flush_done >= ticket || !isAsync();
+	});
+}
+
+bool Logger::enqueueAsync(LogRecord &&record)
+{
+	const LogLevel lev = record.level;
+	// Errors must never be lost, everything else follows the configured policy
+	const bool must_block = (m_async_block || lev <= LL_ERROR) && !t_is_log_writer;
+	bool wake_writer;
+	{
+		std::unique_lock<std::mutex> lock(m_async_mutex);
+		while (m_async_queue.size() >= m_async_queue_size && isAsync()) {
+			if (!must_block) {
+				m_async_dropped++;
+				return true;
+			}
+			m_async_writer->wakeup();
+			m_async_space_cv.wait(lock);
+		}
+		if (!isAsync())
+			return false;
+
+		m_async_queue.push_back(std::move(record));
+		wake_writer = m_async_queue.size() > m_async_queue_size / 2;
+	}
+
+	if (lev <= LL_ERROR)
+		flushAsync();
+	else if (wake_writer)
+		m_async_writer->wakeup();
+	return true;
+}
+
+size_t Logger::drainAsync()
+{
+	u64 flush_ticket;
+	{
+		MutexAutoLock lock(m_async_flush_mutex);
+		flush_ticket = m_async_flush_requested;
+	}
+
+	// Take the whole queue, producers continue with the empty batch buffer
+	{
+		MutexAutoLock lock(m_async_mutex);
+		m_async_batch.swap(m_async_queue);
+		if (m_async_dropped > 0) {
+			m_async_batch.push_back(makeDroppedRecord(m_async_dropped));
+			m_async_dropped = 0;
+		}
+	}
+	m_async_space_cv.notify_all();
+
+	writeRecords(m_async_batch);
+	const size_t count = m_async_batch.size();
+	m_async_batch.clear();
+
+	{
+		MutexAutoLock lock(m_async_flush_mutex);
+		if (flush_ticket > m_async_flush_done) {
+			m_async_flush_done = flush_ticket;
+			m_async_flush_cv.notify_all();
+		}
+	}
+
+	return count;
+}
+
+void Logger::writeRecords(const std::vector<LogRecord> &records)
+{
+	if (records.empty())
+		return;
+
+	MutexAutoLock lock(m_mutex);
+	bool touched[LL_MAX] = {};
+	for (const LogRecord &record : records) {
+		const LogLevel lev = record.level;
+		if (m_outputs[lev].empty())
+			continue;
+		touched[lev] = true;
+		if (record.raw) {
+			for (ILogOutput *out : m_outputs[lev])
+				out->logRaw(lev, record.combined);
+			continue;
+		}
+
+		const std::string &c = record.combined;
+		const std::string time = c.substr(0, record.time_len);
+		const std::string thread_name = c.substr(record.thread_name_pos,
+			record.thread_name_len);
+		const std::string payload = c.substr(record.payload_pos);
+		for (ILogOutput *out : m_outputs[lev])
+			out->log(lev, c, time, thread_name, payload);
+	}
+
+	// One flush per output and batch
+	std::vector<ILogOutput *> flushed;
+	for (size_t lev = 0; lev < LL_MAX; lev++) {
+		if (!touched[lev])
+			continue;
+		for (ILogOutput *out : m_outputs[lev]) {
+			if (std::find(flushed.begin(), flushed.end(), out) != flushed.end())
+				continue;
+			out->flush();
+			flushed.push_back(out);
+		}
+	}
 }
 
 ////
@@ -20,9 +20,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
 #include <map>
 #include <queue>
 #include <string>
+#include <vector>
 #include <fstream>
 #include <thread>
 #include <mutex>
@@ -35,6 +37,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irrlichttypes.h"
 
 class ILogOutput;
+class LogWriterThread;
 
 enum LogLevel {
 	LL_NONE, // Special level that is always printed
@@ -56,6 +59,18 @@ enum LogColor {
 typedef u8 LogLevelMask;
 #define LOGLEVEL_TO_MASKLEVEL(x) (1 << x)
 
+// A preformatted log line, as handed from a logging thread to the writer thread.
+// The time, thread name and payload are only kept as positions in `combined`.
+struct LogRecord {
+	LogLevel level = LL_NONE;
+	bool raw = false;
+	std::string combined;
+	u32 time_len = 0;
+	u32 thread_name_pos = 0;
+	u32 thread_name_len = 0;
+	u32 payload_pos = 0;
+};
+
 class Logger {
 public:
 	void addOutput(ILogOutput *out);
@@ -79,14 +94,40 @@ class Logger {
 		return m_has_outputs[level].load(std::memory_order_relaxed);
 	}
 
+	/*
+	 * Asynchronous mode: log calls only append the preformatted line to a
+	 * queue, a writer thread takes the whole queue at once and writes it to
+	 * the outputs in a batch, in the order the lines were logged. When the
+	 * queue is full the message is either dropped or the calling thread
+	 * waits for the writer.
+	 * Errors are always waited for, so they reach the outputs before a
+	 * possible abort().
+	 */
+	void startAsync(u32 queue_size, bool block_when_full);
+	void stopAsync();
+	// Wait until everything logged so far has been written
+	void flushAsync();
+	bool isAsync() const {
+		return m_async.load(std::memory_order_acquire);
+	}
+
 	static LogColor color_mode;
 
 private:
+	friend class LogWriterThread;
+
 	void logToOutputsRaw(LogLevel, const std::string &line);
 	void logToOutputs(LogLevel, const std::string &combined,
 		const std::string &time, const std::string &thread_name,
 		const std::string &payload_text);
 
+	// Returns false without taking the record if async mode is off,
+	// it is then to be written directly
+	bool enqueueAsync(LogRecord &&record);
+	// Returns the number of records written
+	size_t drainAsync();
+	void writeRecords(const std::vector<LogRecord> &records);
+
 	const std::string getThreadName();
 
 	std::vector<ILogOutput *> m_outputs[LL_MAX];
@@ -98,6 +139,23 @@ class Logger {
 	volatile bool m_silenced_levels[LL_MAX];
 	std::map<std::thread::id, std::string> m_thread_names;
 	mutable std::mutex m_mutex;
+
+	// Async mode state
+	std::atomic<bool> m_async{false};
+	bool m_async_block = true;
+	size_t m_async_queue_size = 0;
+	LogWriterThread *m_async_writer = nullptr;
+	u32 m_async_dropped = 0;
+	// Protects m_async_queue, m_async_dropped and turning async mode off
+	std::mutex m_async_mutex;
+	std::condition_variable m_async_space_cv;
+	std::vector<LogRecord> m_async_queue;
+	// Only used by the writer, swapped with m_async_queue to keep both allocated
+	std::vector<LogRecord> m_async_batch;
+	std::mutex m_async_flush_mutex;
+	std::condition_variable m_async_flush_cv;
+	u64 m_async_flush_requested = 0;
+	u64 m_async_flush_done = 0;
 };
 
 class ILogOutput {
@@ -106,6 +164,8 @@ class ILogOutput {
 	virtual void log(LogLevel, const std::string &combined,
 		const std::string &time, const std::string &thread_name,
 		const std::string &payload_text) = 0;
+	// Called after a line (or a batch of lines in async mode) was written
+	virtual void flush() {}
 };
 
 class ICombinedLogOutput : public ILogOutput {
@@ -144,7 +204,12 @@ class FileLogOutput : public ICombinedLogOutput {
 
 	void logRaw(LogLevel lev, const std::string &line)
 	{
-		m_stream << line << std::endl;
+		m_stream << line << '\n';
+	}
+
+	void flush()
+	{
+		m_stream.flush();
 	}
 
 private:
@@ -354,7 +419,7 @@ extern Logger g_logger;
  *
  * The finished lines are sent to a LogTarget which is a global (not thread-local)
  * object, and from there relayed to g_logger. The final writes are serialized
- * by the mutex in g_logger.
+ * by the mutex in g_logger, or done by its writer thread in async mode.
 */
 
 extern thread_local LogStream dstream;
@@ -246,6 +246,8 @@ static void set_allowed_options(OptionList *allowed_options)
 			_("Set password from contents of file"))));
 	allowed_options->insert(std::make_pair("go", ValueSpec(VALUETYPE_FLAG,
 			_("Disable main menu"))));
+	allowed_options->insert(std::make_pair("benchmark", ValueSpec(VALUETYPE_STRING,
+			_("Fly along the camera path in the given script, write frame timings and quit (implies --go)"))));
 
 }
 
@@ -380,7 +382,7 @@ static bool init_common(const Settings &cmd_args, int argc, char *argv[])
 	mysrand(time(0));
 
 	// Initialize HTTP fetcher
-	httpfetch_init(10);
+	httpfetch_init(g_settings->getS32("curl_parallel_limit"));
 
 	init_gettext(porting::path_locale.c_str(),
 		g_settings->get("language"), argc, argv);
@@ -392,6 +394,9 @@ static void uninit_common()
 {
 	httpfetch_cleanup();
 
+	// Write out everything that is still queued
+	g_logger.stopAsync();
+
 	sockets_cleanup();
 
 	// It'd actually be okay to leak these but we want to please valgrind...
@@ -465,6 +470,16 @@ static void init_log_streams(const Settings &cmd_args)
 	file_log_output.setFile(log_filename,
 		g_settings->getU64("debug_log_size_max") * 1000000);
 	g_logger.addOutputMaxLevel(&file_log_output, log_level);
+
+	if (g_settings->getBool("debug_log_async")) {
+		const std::string &overflow = g_settings->get("debug_log_async_overflow");
+		if (overflow != "block" && overflow != "drop") {
+			warningstream << "Supplied unrecognized debug_log_async_overflow; "
+				"using \"block\"." << std::endl;
+		}
+		g_logger.startAsync(g_settings->getU32("debug_log_async_queue_size"),
+			overflow != "drop");
+	}
 }
 
 static bool game_configure(GameParams *game_params, const Settings &cmd_args)
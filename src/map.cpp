@@ -35,7 +35,6 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "script/scripting_server.h"
 #include "irrlicht_changes/printing.h"
 #include <deque>
-#include <queue>
 
 /*
 	Map
@@ -262,26 +261,57 @@ bool Map::removeNodeWithEvent(v3s16 p)
 	return succeeded;
 }
 
-struct TimeOrderedMapBlock {
-	MapSector *sect;
-	MapBlock *block;
+void Map::linkBlock(MapBlock *block)
+{
+	assert(!block->m_lru_linked);
+	block->m_lru_prev = m_lru_back;
+	block->m_lru_next = nullptr;
+	if (m_lru_back)
+		m_lru_back->m_lru_next = block;
+	else
+		m_lru_front = block;
+	m_lru_back = block;
+	block->m_lru_linked = true;
+	block->m_last_used = m_block_usage_time;
 
-	TimeOrderedMapBlock(MapSector *sect, MapBlock *block) :
-		sect(sect),
-		block(block)
-	{}
+	m_loaded_block_count++;
+	m_loaded_block_bytes += block->getMemoryUsage();
+}
 
-	bool operator<(const TimeOrderedMapBlock &b) const
-	{
-		return block->getUsageTimer() < b.block->getUsageTimer();
-	};
-};
+void Map::unlinkBlock(MapBlock *block)
+{
+	if (!block->m_lru_linked)
+		return;
+	if (block->m_lru_prev)
+		block->m_lru_prev->m_lru_next = block->m_lru_next;
+	else
+		m_lru_front = block->m_lru_next;
+	if (block->m_lru_next)
+		block->m_lru_next->m_lru_prev = block->m_lru_prev;
+	else
+		m_lru_back = block->m_lru_prev;
+	block->m_lru_prev = block->m_lru_next = nullptr;
+	block->m_lru_linked = false;
+
+	m_loaded_block_count--;
+	m_loaded_block_bytes -= block->getMemoryUsage();
+}
+
+void Map::touchBlock(MapBlock *block)
+{
+	block->m_last_used = m_block_usage_time;
+	if (block == m_lru_back)
+		return;
+	unlinkBlock(block);
+	linkBlock(block);
+}
 
 /*
 	Updates usage timers
 */
 void Map::timerUpdate(float dtime, float unload_timeout, s32 max_loaded_blocks,
-		std::vector<v3s16> *unloaded_blocks)
+		std::vector<v3s16> *unloaded_blocks, u64 max_loaded_bytes,
+		u64 time_budget_us)
 {
 	bool save_before_unloading = maySaveBlocks();
 
@@ -291,129 +321,87 @@ void Map::timerUpdate(float dtime, float unload_timeout, s32 max_loaded_blocks,
 	std::vector<v2s16> sector_deletion_queue;
 	u32 deleted_blocks_count = 0;
 	u32 saved_blocks_count = 0;
-	u32 block_count_all = 0;
 	u32 locked_blocks = 0;
 
+	m_block_usage_time += dtime;
+
 	const auto start_time = porting::getTimeUs();
 	beginSave();
 
-	// If there is no practical limit, we spare creation of mapblock_queue
-	if (max_loaded_blocks < 0) {
-		for (auto &sector_it : m_sectors) {
-			MapSector *sector = sector_it.second;
-
-			bool all_blocks_deleted = true;
-
-			MapBlockVect blocks;
-			sector->getBlocks(blocks);
-
-			for (MapBlock *block : blocks) {
-				block->incrementUsageTimer(dtime);
-
-				if (block->refGet() == 0
-						&& block->getUsageTimer() > unload_timeout) {
-					v3s16 p = block->getPos();
-
-					// Save if modified
-					if (block->getModified() != MOD_STATE_CLEAN
-							&& save_before_unloading) {
-						modprofiler.add(block->getModifiedReasonString(), 1);
-						if (!saveBlock(block))
-							continue;
-						saved_blocks_count++;
-					}
-
-					// Delete from memory
-					sector->deleteBlock(block);
-
-					if (unloaded_blocks)
-						unloaded_blocks->push_back(p);
-
-					deleted_blocks_count++;
-				} else {
-					all_blocks_deleted = false;
-					block_count_all++;
-				}
-			}
-
-			// Delete sector if we emptied it
-			if (all_blocks_deleted) {
-				sector_deletion_queue.push_back(sector_it.first);
-			}
-		}
-	} else {
-		std::priority_queue<TimeOrderedMapBlock> mapblock_queue;
-		for (auto &sector_it : m_sectors) {
-			MapSector *sector = sector_it.second;
-
-			MapBlockVect blocks;
-			sector->getBlocks(blocks);
-
-			for (MapBlock *block : blocks) {
-				block->incrementUsageTimer(dtime);
-				mapblock_queue.push(TimeOrderedMapBlock(sector, block));
-			}
+	// Blocks that are kept are moved to the back, visit each at most once
+	u32 to_visit = m_loaded_block_count;
+	while (m_lru_front && to_visit-- > 0) {
+		MapBlock *block = m_lru_front;
+
+		const bool over_limit =
+				(max_loaded_blocks >= 0 && m_loaded_block_count > (u32)max_loaded_blocks) ||
+				(max_loaded_bytes > 0 && m_loaded_block_bytes > max_loaded_bytes);
+		// Everything behind the front was used more recently
+		if (!over_limit && block->getUsageTimer() <= unload_timeout)
+			break;
+
+		if (time_budget_us > 0 && porting::getTimeUs() - start_time > time_budget_us)
+			break;
+
+		if (block->refGet() != 0) {
+			// Drawn or being meshed, so it is in use
+			touchBlock(block);
+			locked_blocks++;
+			continue;
 		}
-		block_count_all = mapblock_queue.size();
-
-		// Delete old blocks, and blocks over the limit from the memory
-		while (!mapblock_queue.empty() && ((s32)mapblock_queue.size() > max_loaded_blocks
-				|| mapblock_queue.top().block->getUsageTimer() > unload_timeout)) {
-			TimeOrderedMapBlock b = mapblock_queue.top();
-			mapblock_queue.pop();
 
-			MapBlock *block = b.block;
+		v3s16 p = block->getPos();
 
-			if (block->refGet() != 0) {
-				locked_blocks++;
+		// Save if modified
+		if (block->getModified() != MOD_STATE_CLEAN && save_before_unloading) {
+			modprofiler.add(block->getModifiedReasonString(), 1);
+			if (!saveBlock(block)) {
+				touchBlock(block);
 				continue;
 			}
+			saved_blocks_count++;
+		}
 
-			v3s16 p = block->getPos();
-
-			// Save if modified
-			if (block->getModified() != MOD_STATE_CLEAN && save_before_unloading) {
-				modprofiler.add(block->getModifiedReasonString(), 1);
-				if (!saveBlock(block))
-					continue;
-				saved_blocks_count++;
-			}
-
-			// Delete from memory
-			b.sect->deleteBlock(block);
+		// Delete from memory
+		MapSector *sector = getSectorNoGenerate(v2s16(p.X, p.Z));
+		sector->deleteBlock(block);
 
-			if (unloaded_blocks)
-				unloaded_blocks->push_back(p);
+		// Delete sector if we emptied it
+		if (sector->empty())
+			sector_deletion_queue.push_back(sector->getPos());
 
-			deleted_blocks_count++;
-			block_count_all--;
-		}
+		if (unloaded_blocks)
+			unloaded_blocks->push_back(p);
 
-		// Delete empty sectors
-		for (auto &sector_it : m_sectors) {
-			if (sector_it.second->empty()) {
-				sector_deletion_queue.push_back(sector_it.first);
-			}
-		}
+		deleted_blocks_count++;
 	}
 
 	endSave();
 	const auto end_time = porting::getTimeUs();
 
-	reportMetrics(end_time - start_time, saved_blocks_count, block_count_all);
+	reportMetrics(end_time - start_time, saved_blocks_count, m_loaded_block_count);
 
 	// Finally delete the empty sectors
 	deleteSectors(sector_deletion_queue);
 
-	if(deleted_blocks_count != 0)
+	// The client unloads a few blocks every frame, so unloads without
+	// saving are summed up and logged at most every few seconds
+	m_unload_log_blocks += deleted_blocks_count;
+	m_unload_log_saved += saved_blocks_count;
+	const u64 now_ms = porting::getTimeMs();
+	if (m_unload_log_blocks != 0 && (saved_blocks_count != 0 ||
+			now_ms - m_unload_log_time_ms >= UNLOAD_LOG_INTERVAL_MS))
 	{
 		PrintInfo(infostream); // ServerMap/ClientMap:
-		infostream<<"Unloaded "<<deleted_blocks_count
+		infostream<<"Unloaded "<<m_unload_log_blocks
 				<<" blocks from memory";
 		if(save_before_unloading)
-			infostream<<", of which "<<saved_blocks_count<<" were written";
-		infostream<<", "<<block_count_all<<" blocks in memory, " << locked_blocks << " locked";
+			infostream<<", of which "<<m_unload_log_saved<<" were written";
+		infostream<<", "<<m_loaded_block_count<<" blocks in memory, " << locked_blocks << " locked";
 		infostream<<"."<<std::endl;
+		m_unload_log_blocks = 0;
+		m_unload_log_saved = 0;
+		m_unload_log_time_ms = now_ms;
 		if(saved_blocks_count != 0){
 			PrintInfo(infostream); // ServerMap/ClientMap:
 			infostream<<"Blocks modified by: "<<std::endl;
@@ -206,11 +206,17 @@ class Map /*: public NodeContainer*/
 	virtual bool deleteBlock(v3s16 blockpos) { return false; }
 
 	/*
-		Updates usage timers and unloads unused blocks and sectors.
+		Advances the usage timers and unloads blocks unused for longer than
+		unload_timeout, then the least recently used ones while more than
+		max_loaded_blocks (-1 for no limit) or max_loaded_bytes (0 for no
+		limit) are loaded. Only the front of the list of blocks by last use
+		is visited, and it stops after time_budget_us (0 for no limit) so
+		that it can be called every frame.
 		Saves modified blocks before unloading if possible.
 	*/
 	void timerUpdate(float dtime, float unload_timeout, s32 max_loaded_blocks,
-			std::vector<v3s16> *unloaded_blocks=NULL);
+			std::vector<v3s16> *unloaded_blocks=NULL, u64 max_loaded_bytes=0,
+			u64 time_budget_us=0);
 
 	/*
 		Unloads all blocks with a zero refCount().
@@ -226,6 +232,19 @@ class Map /*: public NodeContainer*/
 	// For debug printing. Prints "Map: ", "ServerMap: " or "ClientMap: "
 	virtual void PrintInfo(std::ostream &out);
 
+	/*
+		Loaded blocks, kept in a list by last use for timerUpdate().
+		MapSector links and unlinks blocks as they are added and removed,
+		MapBlock::resetUsageTimer() moves a block to the back.
+	*/
+	void linkBlock(MapBlock *block);
+	void unlinkBlock(MapBlock *block);
+	void touchBlock(MapBlock *block);
+
+	u32 getLoadedBlockCount() const { return m_loaded_block_count; }
+	// Sum of MapBlock::getMemoryUsage()
+	u64 getLoadedBlockBytes() const { return m_loaded_block_bytes; }
+
 	/*
 		Node metadata
 		These are basically coordinate wrappers to MapBlock
@@ -304,6 +323,21 @@ class Map /*: public NodeContainer*/
 	// This stores the properties of the nodes on the map.
 	const NodeDefManager *m_nodedef;
 
+	// Blocks by last use, least recently used first
+	MapBlock *m_lru_front = nullptr;
+	MapBlock *m_lru_back = nullptr;
+	u32 m_loaded_block_count = 0;
+	u64 m_loaded_block_bytes = 0;
+	// Sum of timerUpdate() dtimes, see MapBlock::m_last_used
+	double m_block_usage_time = 0;
+	// Unloads not logged yet, see timerUpdate()
+	u32 m_unload_log_blocks = 0;
+	u32 m_unload_log_saved = 0;
+	u64 m_unload_log_time_ms = 0;
+	static const u64 UNLOAD_LOG_INTERVAL_MS = 10000;
+
+	friend class MapBlock;
+
 	// Can be implemented by child class
 	virtual void reportMetrics(u64 save_time_us, u32 saved_blocks, u32 all_blocks) {}
 
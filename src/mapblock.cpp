@@ -19,6 +19,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "mapblock.h"
 
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <sstream>
 #include "map.h"
 #include "light.h"
@@ -36,6 +40,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/string.h"
 #include "util/serialize.h"
 #include "util/basic_macros.h"
+#include "util/stream.h"
 
 static const char *modified_reason_strings[] = {
 	"initial",
@@ -60,6 +65,13 @@ static const char *modified_reason_strings[] = {
 	"unknown",
 };
 
+/*
+	The mesh threads read blocks in MapBlock::copyTo() while the main thread
+	may change them. Writing single nodes races harmlessly, but replacing the
+	storage frees the old one, so that is done under the exclusive lock.
+*/
+static std::shared_mutex s_storage_mutex;
+
 /*
 	MapBlock
 */
@@ -81,6 +93,148 @@ MapBlock::~MapBlock()
 		mesh = nullptr;
 	}
 #endif
+	delete[] data;
+}
+
+void MapBlock::reallocate()
+{
+	{
+		std::unique_lock<std::shared_mutex> lock(s_storage_mutex);
+		delete[] data;
+		data = nullptr;
+		m_palette.assign(1, MapNode(CONTENT_IGNORE));
+		std::vector<u8>().swap(m_palette_indices);
+		m_palette_index_bits = 0;
+	}
+	updateMemoryUsage();
+	raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_REALLOCATE);
+}
+
+bool MapBlock::compact()
+{
+	if (!data)
+		return true;
+
+	// Open addressing table from node to palette index + 1
+	const u32 table_bits = 9;
+	const u32 table_size = 1 << table_bits;
+	u32 table_keys[table_size];
+	u16 table_values[table_size] = {};
+
+	std::vector<MapNode> palette;
+	u8 indices[nodecount];
+	MapNode previous_n(CONTENT_IGNORE);
+	u8 previous_index = 0;
+	for (u32 i = 0; i < nodecount; i++) {
+		const MapNode n = data[i];
+		// Neighbouring nodes are mostly the same
+		if (i > 0 && n == previous_n) {
+			indices[i] = previous_index;
+			continue;
+		}
+
+		const u32 key = (u32)n.param0 << 16 | (u32)n.param1 << 8 | n.param2;
+		u32 slot = (key * 2654435761U) >> (32 - table_bits);
+		while (table_values[slot] != 0 && table_keys[slot] != key)
+			slot = (slot + 1) & (table_size - 1);
+		if (table_values[slot] == 0) {
+			if (palette.size() == 256)
+				return false;
+			palette.push_back(n);
+			table_keys[slot] = key;
+			table_values[slot] = palette.size();
+		}
+		previous_n = n;
+		previous_index = table_values[slot] - 1;
+		indices[i] = previous_index;
+	}
+
+	u8 bits = 0;
+	std::vector<u8> packed;
+	if (palette.size() > 1) {
+		bits = palette.size() <= 2 ? 1 : palette.size() <= 4 ? 2 :
+				palette.size() <= 16 ? 4 : 8;
+		packed.resize(nodecount * bits / 8);
+		for (u32 i = 0; i < nodecount; i++) {
+			const u32 bit = i * bits;
+			packed[bit >> 3] |= indices[i] << (bit & 7);
+		}
+	}
+	palette.shrink_to_fit();
+
+	std::unique_lock<std::shared_mutex> lock(s_storage_mutex);
+	delete[] data;
+	data = nullptr;
+	m_palette = std::move(palette);
+	m_palette_indices = std::move(packed);
+	m_palette_index_bits = bits;
+	lock.unlock();
+
+	updateMemoryUsage();
+	return true;
+}
+
+void MapBlock::expand(bool keep_contents)
+{
+	if (data)
+		return;
+
+	MapNode *nodes = new MapNode[nodecount];
+	if (keep_contents)
+		decompressTo(nodes);
+
+	std::unique_lock<std::shared_mutex> lock(s_storage_mutex);
+	data = nodes;
+	std::vector<MapNode>().swap(m_palette);
+	std::vector<u8>().swap(m_palette_indices);
+	m_palette_index_bits = 0;
+	lock.unlock();
+
+	updateMemoryUsage();
+}
+
+void MapBlock::updateMemoryUsage()
+{
+	u32 usage = sizeof(MapBlock);
+	if (data)
+		usage += nodecount * sizeof(MapNode);
+	usage += m_palette.capacity() * sizeof(MapNode) + m_palette_indices.capacity();
+
+	if (m_lru_linked)
+		m_parent->m_loaded_block_bytes += (s64)usage - m_memory_usage;
+	m_memory_usage = usage;
+}
+
+void MapBlock::resetUsageTimer()
+{
+	if (m_lru_linked)
+		m_parent->touchBlock(this);
+}
+
+float MapBlock::getUsageTimer()
+{
+	if (!m_lru_linked)
+		return 0;
+	return m_parent->m_block_usage_time - m_last_used;
+}
+
+void MapBlock::decompressTo(MapNode *dst) const
+{
+	if (m_palette_indices.empty()) {
+		std::fill(dst, dst + nodecount, m_palette[0]);
+		return;
+	}
+
+	const u8 bits = m_palette_index_bits;
+	const u8 mask = (1 << bits) - 1;
+	const u32 per_byte = 8 / bits;
+	for (u32 byte = 0; byte < m_palette_indices.size(); byte++) {
+		u8 packed = m_palette_indices[byte];
+		for (u32 j = 0; j < per_byte; j++) {
+			*dst++ = m_palette[packed & mask];
+			packed >>= bits;
+		}
+	}
 }
 
 
@@ -106,7 +260,7 @@ MapNode MapBlock::getNodeParent(v3s16 p, bool *is_valid_position)
 
 	if (is_valid_position)
 		*is_valid_position = true;
-	return data[p.Z * zstride + p.Y * ystride + p.X];
+	return getNodeNoCheck(p);
 }
 
 std::string MapBlock::getModifiedReasonString()
@@ -136,8 +290,18 @@ void MapBlock::copyTo(VoxelManipulator &dst)
 	v3s16 data_size(MAP_BLOCKSIZE, MAP_BLOCKSIZE, MAP_BLOCKSIZE);
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
-	// Copy from data to VoxelManipulator
-	dst.copyFrom(data, data_area, v3s16(0,0,0),
+	std::shared_lock<std::shared_mutex> lock(s_storage_mutex);
+	if (data) {
+		// Copy from data to VoxelManipulator
+		dst.copyFrom(data, data_area, v3s16(0,0,0),
+				getPosRelative(), data_size);
+		return;
+	}
+
+	// Decompress without changing the block, this runs on the mesh threads
+	std::unique_ptr<MapNode[]> nodes(new MapNode[nodecount]);
+	decompressTo(nodes.get());
+	dst.copyFrom(nodes.get(), data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
 }
 
@@ -147,6 +311,8 @@ void MapBlock::copyFrom(VoxelManipulator &dst)
 	VoxelArea data_area(v3s16(0,0,0), data_size - v3s16(1,1,1));
 
 	// Copy from VoxelManipulator to data
+	if (!data)
+		expand();
 	dst.copyTo(data, data_area, v3s16(0,0,0),
 			getPosRelative(), data_size);
 }
@@ -160,13 +326,17 @@ void MapBlock::actuallyUpdateDayNightDiff()
 
 	bool differs = false;
 
+	// A compact block has every distinct node in its palette
+	const MapNode *nodes = data ? data : m_palette.data();
+	const u32 count = data ? nodecount : m_palette.size();
+
 	/*
 		Check if any lighting value differs
 	*/
 
 	MapNode previous_n(CONTENT_IGNORE);
-	for (u32 i = 0; i < nodecount; i++) {
-		MapNode n = data[i];
+	for (u32 i = 0; i < count; i++) {
+		MapNode n = nodes[i];
 
 		// If node is identical to previous node, don't verify if it differs
 		if (n == previous_n)
@@ -184,8 +354,8 @@ void MapBlock::actuallyUpdateDayNightDiff()
 	*/
 	if (differs) {
 		bool only_air = true;
-		for (u32 i = 0; i < nodecount; i++) {
-			MapNode &n = data[i];
+		for (u32 i = 0; i < count; i++) {
+			const MapNode &n = nodes[i];
 			if (n.getContent() != CONTENT_AIR) {
 				only_air = false;
 				break;
@@ -238,8 +408,15 @@ void MapBlock::serialize(std::ostream &os_compressed, u8 version, bool disk, int
 	const u8 content_width = 2;
 	const u8 params_width = 2;
 
-	buf = MapNode::serializeBulk(version, data, nodecount,
-			content_width, params_width);
+	if (data) {
+		buf = MapNode::serializeBulk(version, data, nodecount,
+				content_width, params_width);
+	} else {
+		std::unique_ptr<MapNode[]> nodes(new MapNode[nodecount]);
+		decompressTo(nodes.get());
+		buf = MapNode::serializeBulk(version, nodes.get(), nodecount,
+				content_width, params_width);
+	}
 
 	writeU8(os, content_width);
 	writeU8(os, params_width);
@@ -310,6 +487,8 @@ void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 	/*
 		Bulk node data
 	*/
+	if (!data)
+		expand(false);
 	if (version >= 29) {
 		MapNode::deSerializeBulk(is, version, data, nodecount,
 			content_width, params_width);
@@ -346,6 +525,80 @@ void MapBlock::deSerialize(std::istream &in_compressed, u8 version, bool disk)
 			<<": Done."<<std::endl);
 }
 
+size_t MapBlock::deSerialize(const u8 *src, size_t size, u8 version,
+		std::vector<u8> &decode_buffer)
+{
+	if (version < 29) {
+		// Parts of the block are compressed separately
+		MemoryStreamBuffer buf(reinterpret_cast<const char *>(src), size);
+		std::istream is(&buf);
+		deSerialize(is, version, false);
+		return buf.getPosition();
+	}
+
+	if(!ser_ver_supported(version))
+		throw VersionMismatchException("ERROR: MapBlock format not supported");
+
+	TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()<<std::endl);
+
+	m_day_night_differs_expired = false;
+
+	// Flags, lighting and widths, the node data and the metadata version.
+	// Only blocks with node metadata are bigger than this.
+	const size_t header_size = 5;
+	const size_t expected_size = header_size + nodecount * 4 + 1;
+	if (decode_buffer.size() < expected_size)
+		decode_buffer.resize(expected_size);
+
+	size_t raw_size;
+	const size_t consumed = decompressZstd(src, size, decode_buffer, raw_size);
+	const u8 *raw = decode_buffer.data();
+	if (raw_size < header_size)
+		throw SerializationError("MapBlock::deSerialize(): truncated data");
+
+	u8 flags = raw[0];
+	is_underground = (flags & 0x01) != 0;
+	m_day_night_differs = (flags & 0x02) != 0;
+	m_lighting_complete = readU16(raw + 1);
+	m_generated = (flags & 0x08) == 0;
+
+	TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()
+			<<": Bulk node data"<<std::endl);
+	u8 content_width = raw[3];
+	u8 params_width = raw[4];
+	if(content_width != 1 && content_width != 2)
+		throw SerializationError("MapBlock::deSerialize(): invalid content_width");
+	if(params_width != 2)
+		throw SerializationError("MapBlock::deSerialize(): invalid params_width");
+
+	const size_t bulk_size = nodecount * (content_width + params_width);
+	if (raw_size < header_size + bulk_size)
+		throw SerializationError("MapBlock::deSerialize(): truncated data");
+	// Every node is overwritten, the palette doesn't need to be decoded
+	if (!data)
+		expand(false);
+	MapNode::deSerializeBulk(raw + header_size, version, data, nodecount,
+		content_width, params_width);
+
+	TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()
+			<<": Node metadata"<<std::endl);
+	const u8 *metadata = raw + header_size + bulk_size;
+	const size_t metadata_size = raw_size - header_size - bulk_size;
+	if (metadata_size > 0 && metadata[0] == 0) {
+		// Version 0 means no metadata
+		m_node_metadata.clear();
+	} else {
+		MemoryStreamBuffer buf(reinterpret_cast<const char *>(metadata),
+				metadata_size);
+		std::istream is(&buf);
+		m_node_metadata.deSerialize(is, m_gamedef->idef());
+	}
+
+	TRACESTREAM(<<"MapBlock::deSerialize "<<getPos()
+			<<": Done."<<std::endl);
+	return consumed;
+}
+
 void MapBlock::deSerializeNetworkSpecific(std::istream &is)
 {
 	try {
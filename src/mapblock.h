@@ -20,12 +20,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #pragma once
 
 #include <set>
+#include <vector>
 #include "irr_v3d.h"
 #include "mapnode.h"
 #include "exceptions.h"
 #include "constants.h"
 #include "nodemetadata.h"
 #include "modifiedstate.h"
+#include "util/basic_macros.h"
 #include "util/numeric.h" // getContainerPos
 #include "settings.h"
 
@@ -73,6 +75,8 @@ class MapBlock
 	MapBlock(Map *parent, v3s16 pos, IGameDef *gamedef);
 	~MapBlock();
 
+	DISABLE_CLASS_COPY(MapBlock);
+
 	/*virtual u16 nodeContainerId() const
 	{
 		return NODECONTAINER_ID_MAPBLOCK;
@@ -96,18 +100,40 @@ class MapBlock
 		m_parent = nullptr;
 	}
 
-	void reallocate()
-	{
-		for (u32 i = 0; i < nodecount; i++)
-			data[i] = MapNode(CONTENT_IGNORE);
-		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_REALLOCATE);
-	}
+	// Fills the block with CONTENT_IGNORE, stored compactly
+	void reallocate();
 
+	// Returns the full node array for writing, expanding compact storage.
+	// Use getNodeNoCheck() or copyTo() for reading.
 	MapNode* getData()
 	{
+		if (!data)
+			expand();
 		return data;
 	}
 
+	////
+	//// Compact node storage
+	////
+
+	/*
+		A block holds either a full node array or a palette of the distinct
+		nodes in it with bit-packed indices into it; a single palette entry
+		means the block is uniform. Writes expand the block to a full array.
+	*/
+
+	// Converts the full array to a palette if the block has at most
+	// 256 distinct nodes. Returns true if the block is compact afterwards.
+	bool compact();
+	// Converts palette storage back to a full array. Without keep_contents
+	// the array is left uninitialized, for callers that overwrite every node.
+	void expand(bool keep_contents = true);
+
+	inline bool isCompact() const
+	{
+		return !data;
+	}
+
 	////
 	//// Modification tracking methods
 	////
@@ -255,7 +281,7 @@ class MapBlock
 		if (!*valid_position)
 			return {CONTENT_IGNORE};
 
-		return data[z * zstride + y * ystride + x];
+		return getNodeNoCheck(x, y, z);
 	}
 
 	inline MapNode getNode(v3s16 p, bool *valid_position)
@@ -274,6 +300,8 @@ class MapBlock
 		if (!isValidPosition(x, y, z))
 			throw InvalidPositionException();
 
+		if (!data)
+			expand();
 		data[z * zstride + y * ystride + x] = n;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE);
 	}
@@ -289,7 +317,10 @@ class MapBlock
 
 	inline MapNode getNodeNoCheck(s16 x, s16 y, s16 z)
 	{
-		return data[z * zstride + y * ystride + x];
+		const u32 i = z * zstride + y * ystride + x;
+		if (data)
+			return data[i];
+		return getCompactNode(i);
 	}
 
 	inline MapNode getNodeNoCheck(v3s16 p)
@@ -299,6 +330,8 @@ class MapBlock
 
 	inline void setNodeNoCheck(s16 x, s16 y, s16 z, MapNode n)
 	{
+		if (!data)
+			expand();
 		data[z * zstride + y * ystride + x] = n;
 		raiseModified(MOD_STATE_WRITE_NEEDED, MOD_REASON_SET_NODE_NO_CHECK);
 	}
@@ -314,6 +347,7 @@ class MapBlock
 	MapNode getNodeParent(v3s16 p, bool *is_valid_position = NULL);
 
 	// Copies data to VoxelManipulator to getPosRelative()
+	// Safe to call from the mesh threads, it does not expand the block.
 	void copyTo(VoxelManipulator &dst);
 
 	// Copies data from VoxelManipulator getPosRelative()
@@ -360,22 +394,20 @@ class MapBlock
 	}
 
 	////
-	//// Usage timer (see m_usage_timer)
+	//// Usage timer (see m_last_used)
 	////
 
-	inline void resetUsageTimer()
-	{
-		m_usage_timer = 0;
-	}
+	// Marks the block as used, moving it to the back of the parent's
+	// unload order
+	void resetUsageTimer();
 
-	inline void incrementUsageTimer(float dtime)
-	{
-		m_usage_timer += dtime;
-	}
+	// Seconds since the block was last used
+	float getUsageTimer();
 
-	inline float getUsageTimer()
+	// Approximate heap and object size in bytes
+	inline u32 getMemoryUsage() const
 	{
-		return m_usage_timer;
+		return m_memory_usage;
 	}
 
 	////
@@ -408,6 +440,11 @@ class MapBlock
 	// If disk == true: In addition to doing other things, will add
 	// unknown blocks from id-name mapping to wndef
 	void deSerialize(std::istream &is, u8 version, bool disk);
+	// Network format from memory, decompressing into decode_buffer which
+	// is kept by the caller for the next block.
+	// Returns the number of bytes read from data.
+	size_t deSerialize(const u8 *src, size_t size, u8 version,
+			std::vector<u8> &decode_buffer);
 
 	void serializeNetworkSpecific(std::ostream &os);
 	void deSerializeNetworkSpecific(std::istream &is);
@@ -419,6 +456,8 @@ class MapBlock
 
 #ifndef SERVER // Only on client
 	MapBlockMesh *mesh = nullptr;
+	// The mesh was dropped to save memory, it is made again once in range
+	bool mesh_evicted = false;
 #endif
 
 	NodeMetadataList m_node_metadata;
@@ -439,6 +478,25 @@ class MapBlock
 	u8 solid_sides {0};
 
 private:
+	inline MapNode getCompactNode(u32 i) const
+	{
+		if (m_palette_indices.empty())
+			return m_palette[0];
+		const u32 bit = i * m_palette_index_bits;
+		const u8 index = (m_palette_indices[bit >> 3] >> (bit & 7)) &
+				((1 << m_palette_index_bits) - 1);
+		return m_palette[index];
+	}
+
+	// Writes all nodes of a compact block to dst
+	void decompressTo(MapNode *dst) const;
+
+	// Recomputes m_memory_usage after the node storage changed
+	void updateMemoryUsage();
+
+	// Map keeps its loaded blocks in a list by last use
+	friend class Map;
+
 	/*
 		Private member variables
 	*/
@@ -501,10 +559,17 @@ class MapBlock
 	u32 m_disk_timestamp = BLOCK_TIMESTAMP_UNDEFINED;
 
 	/*
-		When the block is accessed, this is set to 0.
-		Map will unload the block when this reaches a timeout.
+		Map time when the block was last accessed.
+		Map will unload the block when it is unused for a timeout.
 	*/
-	float m_usage_timer = 0;
+	double m_last_used = 0;
+	// Neighbours in the parent's list of blocks by last use
+	MapBlock *m_lru_prev = nullptr;
+	MapBlock *m_lru_next = nullptr;
+	bool m_lru_linked = false;
+
+	// See getMemoryUsage()
+	u32 m_memory_usage = 0;
 
 	/*
 		Reference count; currently used for determining if this block is in
@@ -512,7 +577,15 @@ class MapBlock
 	*/
 	int m_refcount = 0;
 
-	MapNode data[nodecount];
+	// Full node array, nullptr while the block is compact
+	MapNode *data = nullptr;
+
+	// Compact storage, see compact()
+	std::vector<MapNode> m_palette;
+	// Empty for uniform blocks
+	std::vector<u8> m_palette_indices;
+	// 1, 2, 4 or 8
+	u8 m_palette_index_bits = 0;
 };
 
 typedef std::vector<MapBlock*> MapBlockVect;
@@ -29,6 +29,15 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "util/numeric.h"
 #include <string>
 #include <sstream>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define MAPNODE_BULK_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+#define MAPNODE_BULK_NEON 1
+#include <arm_neon.h>
+#endif
 
 static const Rotation wallmounted_to_rot[] = {
 	ROTATE_0, ROTATE_180, ROTATE_90, ROTATE_270
@@ -652,6 +661,118 @@ void MapNode::deSerialize(u8 *source, u8 version)
 	}
 }
 
+/*
+	Conversion between the bulk format (big-endian param0 of all nodes,
+	then param1 of all nodes, then param2 of all nodes) and MapNode arrays.
+	The vector versions handle 16 nodes per iteration and rely on MapNode
+	being laid out as a little-endian u16 followed by two bytes.
+*/
+#if defined(MAPNODE_BULK_SSE2) || defined(MAPNODE_BULK_NEON)
+static_assert(sizeof(MapNode) == 4, "unexpected MapNode size");
+static_assert(offsetof(MapNode, param1) == 2 && offsetof(MapNode, param2) == 3,
+		"unexpected MapNode layout");
+#endif
+
+#if defined(MAPNODE_BULK_SSE2)
+static inline __m128i bswap16_sse2(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+// Low 16 bits of each u32 in a and b, packed into eight u16
+static inline __m128i pack_low16_sse2(__m128i a, __m128i b)
+{
+	// Sign-extend first so that the saturating pack keeps the value
+	a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+	b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+	return _mm_packs_epi32(a, b);
+}
+
+static inline __m128i pack_high16_sse2(__m128i a, __m128i b)
+{
+	return _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+}
+#endif
+
+static u32 bulk_to_nodes_vector(const u8 *src, MapNode *nodes, u32 nodecount)
+{
+	u32 i = 0;
+#if defined(MAPNODE_BULK_SSE2)
+	const u8 *p1 = src + 2 * nodecount;
+	const u8 *p2 = src + 3 * nodecount;
+	u8 *dst = reinterpret_cast<u8 *>(nodes);
+	for (; i + 16 <= nodecount; i += 16) {
+		__m128i c0 = bswap16_sse2(_mm_loadu_si128((const __m128i *)(src + 2 * i)));
+		__m128i c1 = bswap16_sse2(_mm_loadu_si128((const __m128i *)(src + 2 * i + 16)));
+		__m128i a = _mm_loadu_si128((const __m128i *)(p1 + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(p2 + i));
+		__m128i params_lo = _mm_unpacklo_epi8(a, b);
+		__m128i params_hi = _mm_unpackhi_epi8(a, b);
+		_mm_storeu_si128((__m128i *)(dst + 4 * i),      _mm_unpacklo_epi16(c0, params_lo));
+		_mm_storeu_si128((__m128i *)(dst + 4 * i + 16), _mm_unpackhi_epi16(c0, params_lo));
+		_mm_storeu_si128((__m128i *)(dst + 4 * i + 32), _mm_unpacklo_epi16(c1, params_hi));
+		_mm_storeu_si128((__m128i *)(dst + 4 * i + 48), _mm_unpackhi_epi16(c1, params_hi));
+	}
+#elif defined(MAPNODE_BULK_NEON)
+	const u8 *p1 = src + 2 * nodecount;
+	const u8 *p2 = src + 3 * nodecount;
+	u8 *dst = reinterpret_cast<u8 *>(nodes);
+	for (; i + 16 <= nodecount; i += 16) {
+		// val[0] holds the high bytes of param0, val[1] the low bytes
+		uint8x16x2_t content = vld2q_u8(src + 2 * i);
+		uint8x16x4_t out;
+		out.val[0] = content.val[1];
+		out.val[1] = content.val[0];
+		out.val[2] = vld1q_u8(p1 + i);
+		out.val[3] = vld1q_u8(p2 + i);
+		vst4q_u8(dst + 4 * i, out);
+	}
+#endif
+	return i;
+}
+
+static u32 nodes_to_bulk_vector(const MapNode *nodes, u8 *dst, u32 nodecount)
+{
+	u32 i = 0;
+#if defined(MAPNODE_BULK_SSE2)
+	u8 *p1 = dst + 2 * nodecount;
+	u8 *p2 = dst + 3 * nodecount;
+	const u8 *src = reinterpret_cast<const u8 *>(nodes);
+	const __m128i low_bytes = _mm_set1_epi16(0xFF);
+	for (; i + 16 <= nodecount; i += 16) {
+		__m128i n0 = _mm_loadu_si128((const __m128i *)(src + 4 * i));
+		__m128i n1 = _mm_loadu_si128((const __m128i *)(src + 4 * i + 16));
+		__m128i n2 = _mm_loadu_si128((const __m128i *)(src + 4 * i + 32));
+		__m128i n3 = _mm_loadu_si128((const __m128i *)(src + 4 * i + 48));
+		_mm_storeu_si128((__m128i *)(dst + 2 * i),
+				bswap16_sse2(pack_low16_sse2(n0, n1)));
+		_mm_storeu_si128((__m128i *)(dst + 2 * i + 16),
+				bswap16_sse2(pack_low16_sse2(n2, n3)));
+		// param1 | param2 << 8 of each node
+		__m128i params0 = pack_high16_sse2(n0, n1);
+		__m128i params1 = pack_high16_sse2(n2, n3);
+		_mm_storeu_si128((__m128i *)(p1 + i), _mm_packus_epi16(
+				_mm_and_si128(params0, low_bytes), _mm_and_si128(params1, low_bytes)));
+		_mm_storeu_si128((__m128i *)(p2 + i), _mm_packus_epi16(
+				_mm_srli_epi16(params0, 8), _mm_srli_epi16(params1, 8)));
+	}
+#elif defined(MAPNODE_BULK_NEON)
+	u8 *p1 = dst + 2 * nodecount;
+	u8 *p2 = dst + 3 * nodecount;
+	const u8 *src = reinterpret_cast<const u8 *>(nodes);
+	for (; i + 16 <= nodecount; i += 16) {
+		uint8x16x4_t in = vld4q_u8(src + 4 * i);
+		uint8x16x2_t content;
+		content.val[0] = in.val[1];
+		content.val[1] = in.val[0];
+		vst2q_u8(dst + 2 * i, content);
+		vst1q_u8(p1 + i, in.val[2]);
+		vst1q_u8(p2 + i, in.val[3]);
+	}
+#endif
+	return i;
+}
+
 SharedBuffer<u8> MapNode::serializeBulk(int version,
 		const MapNode *nodes, u32 nodecount,
 		u8 content_width, u8 params_width)
@@ -674,7 +795,8 @@ SharedBuffer<u8> MapNode::serializeBulk(int version,
 	u32 start2 = (content_width + 1) * nodecount;
 
 	// Serialize content
-	for (u32 i = 0; i < nodecount; i++) {
+	for (u32 i = nodes_to_bulk_vector(nodes, &databuf[0], nodecount);
+			i < nodecount; i++) {
 		writeU16(&databuf[i * 2], nodes[i].param0);
 		writeU8(&databuf[start1 + i], nodes[i].param1);
 		writeU8(&databuf[start2 + i], nodes[i].param2);
@@ -686,6 +808,19 @@ SharedBuffer<u8> MapNode::serializeBulk(int version,
 void MapNode::deSerializeBulk(std::istream &is, int version,
 		MapNode *nodes, u32 nodecount,
 		u8 content_width, u8 params_width)
+{
+	// read data
+	const u32 len = nodecount * (content_width + params_width);
+	Buffer<u8> databuf(len);
+	is.read(reinterpret_cast<char*>(*databuf), len);
+
+	deSerializeBulk(*databuf, version, nodes, nodecount,
+			content_width, params_width);
+}
+
+void MapNode::deSerializeBulk(const u8 *databuf, int version,
+		MapNode *nodes, u32 nodecount,
+		u8 content_width, u8 params_width)
 {
 	if(!ser_ver_supported(version))
 		throw VersionMismatchException("ERROR: MapNode format not supported");
@@ -695,23 +830,22 @@ void MapNode::deSerializeBulk(std::istream &is, int version,
 			|| params_width != 2)
 		FATAL_ERROR("Deserialize bulk node data error");
 
-	// read data
-	const u32 len = nodecount * (content_width + params_width);
-	Buffer<u8> databuf(len);
-	is.read(reinterpret_cast<char*>(*databuf), len);
-
 	// Deserialize content
-	if(content_width == 1)
-	{
-		for(u32 i=0; i<nodecount; i++)
-			nodes[i].param0 = readU8(&databuf[i]);
-	}
-	else if(content_width == 2)
-	{
-		for(u32 i=0; i<nodecount; i++)
-			nodes[i].param0 = readU16(&databuf[i*2]);
+	if (content_width == 2) {
+		const u32 start1 = 2 * nodecount;
+		const u32 start2 = 3 * nodecount;
+		for (u32 i = bulk_to_nodes_vector(databuf, nodes, nodecount);
+				i < nodecount; i++) {
+			nodes[i].param0 = readU16(&databuf[i * 2]);
+			nodes[i].param1 = databuf[start1 + i];
+			nodes[i].param2 = databuf[start2 + i];
+		}
+		return;
 	}
 
+	for (u32 i = 0; i < nodecount; i++)
+		nodes[i].param0 = readU8(&databuf[i]);
+
 	// Deserialize param1
 	u32 start1 = content_width * nodecount;
 	for(u32 i=0; i<nodecount; i++)
@@ -719,20 +853,12 @@ void MapNode::deSerializeBulk(std::istream &is, int version,
 
 	// Deserialize param2
 	u32 start2 = (content_width + 1) * nodecount;
-	if(content_width == 1)
-	{
-		for(u32 i=0; i<nodecount; i++) {
-			nodes[i].param2 = readU8(&databuf[start2 + i]);
-			if(nodes[i].param0 > 0x7F){
-				nodes[i].param0 <<= 4;
-				nodes[i].param0 |= (nodes[i].param2&0xF0)>>4;
-				nodes[i].param2 &= 0x0F;
-			}
+	for(u32 i=0; i<nodecount; i++) {
+		nodes[i].param2 = readU8(&databuf[start2 + i]);
+		if(nodes[i].param0 > 0x7F){
+			nodes[i].param0 <<= 4;
+			nodes[i].param0 |= (nodes[i].param2&0xF0)>>4;
+			nodes[i].param2 &= 0x0F;
 		}
 	}
-	else if(content_width == 2)
-	{
-		for(u32 i=0; i<nodecount; i++)
-			nodes[i].param2 = readU8(&databuf[start2 + i]);
-	}
 }
@@ -322,4 +322,9 @@ struct alignas(u32) MapNode
 	static void deSerializeBulk(std::istream &is, int version,
 			MapNode *nodes, u32 nodecount,
 			u8 content_width, u8 params_width);
+	// Same as above, reading nodecount * (content_width + params_width)
+	// bytes from src
+	static void deSerializeBulk(const u8 *src, int version,
+			MapNode *nodes, u32 nodecount,
+			u8 content_width, u8 params_width);
 };
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "mapsector.h"
 #include "exceptions.h"
 #include "mapblock.h"
+#include "map.h"
 #include "serialization.h"
 
 MapSector::MapSector(Map *parent, v2s16 pos, IGameDef *gamedef):
@@ -40,6 +41,8 @@ void MapSector::deleteBlocks()
 	m_block_cache = nullptr;
 
 	// Delete all blocks
+	for (auto &block : m_blocks)
+		m_parent->unlinkBlock(block.second.get());
 	m_blocks.clear();
 }
 
@@ -82,6 +85,7 @@ MapBlock *MapSector::createBlankBlock(s16 y)
 	MapBlock *block = block_u.get();
 
 	m_blocks[y] = std::move(block_u);
+	m_parent->linkBlock(block);
 
 	return block;
 }
@@ -99,7 +103,9 @@ void MapSector::insertBlock(std::unique_ptr<MapBlock> block)
 	assert(p2d == m_pos);
 
 	// Insert into container
+	MapBlock *block_p = block.get();
 	m_blocks[block_y] = std::move(block);
+	m_parent->linkBlock(block_p);
 }
 
 void MapSector::deleteBlock(MapBlock *block)
@@ -121,6 +127,7 @@ std::unique_ptr<MapBlock> MapSector::detachBlock(MapBlock *block)
 	std::unique_ptr<MapBlock> ret = std::move(it->second);
 	assert(ret.get() == block);
 	m_blocks.erase(it);
+	m_parent->unlinkBlock(block);
 
 	// Mark as removed
 	block->makeOrphan();
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "client/mesh_generator_thread.h"
 #include "chatmessage.h"
 #include "client/clientmedia.h"
+#include "client/defsnapshot.h"
 #include "log.h"
 #include "map.h"
 #include "mapsector.h"
@@ -41,11 +42,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "script/scripting_client.h"
 #include "util/serialize.h"
 #include "util/srp.h"
+#include "util/stream.h"
 #include "util/sha1.h"
 #include "tileanimation.h"
 #include "gettext.h"
 #include "skyparams.h"
 #include "particles.h"
+#include "profiler.h"
 #include <memory>
 
 void Client::handleCommand_Deprecated(NetworkPacket* pkt)
@@ -302,8 +305,10 @@ void Client::handleCommand_BlockData(NetworkPacket* pkt)
 	v3s16 p;
 	*pkt >> p;
 
-	std::string datastring(pkt->getString(6), pkt->getSize() - 6);
-	std::istringstream istr(datastring, std::ios_base::binary);
+	// Read straight from the packet, the block is decompressed into
+	// m_block_decode_buffer
+	const u8 *blockdata = reinterpret_cast<const u8 *>(pkt->getString(6));
+	const size_t blockdata_size = pkt->getSize() - 6;
 
 	MapSector *sector;
 	MapBlock *block;
@@ -314,22 +319,29 @@ void Client::handleCommand_BlockData(NetworkPacket* pkt)
 	assert(sector->getPos() == p2d);
 
 	block = sector->getBlockNoCreateNoEx(p.Y);
-	if (block) {
-		/*
-			Update an existing block
-		*/
-		block->deSerialize(istr, m_server_ser_ver, false);
-		block->deSerializeNetworkSpecific(istr);
-	}
-	else {
+	if (!block) {
 		/*
 			Create a new block
 		*/
 		block = sector->createBlankBlock(p.Y);
-		block->deSerialize(istr, m_server_ser_ver, false);
-		block->deSerializeNetworkSpecific(istr);
 	}
 
+	TimeTaker tt_decode("", nullptr, PRECISION_MICRO);
+	const size_t capacity = m_block_decode_buffer.capacity();
+
+	size_t consumed = block->deSerialize(blockdata, blockdata_size,
+			m_server_ser_ver, m_block_decode_buffer);
+	MemoryStreamBuffer rest(reinterpret_cast<const char *>(blockdata) + consumed,
+			blockdata_size - consumed);
+	std::istream rest_is(&rest);
+	block->deSerializeNetworkSpecific(rest_is);
+	if (m_compact_mapblocks)
+		block->compact();
+
+	g_profiler->avg("Client: block decode [us]", tt_decode.stop(true));
+	g_profiler->avg("Client: block decode allocations",
+			m_block_decode_buffer.capacity() != capacity ? 1 : 0);
+
 	/*
 		Add it to mesh update queue and set it to be acknowledged after update.
 	*/
@@ -770,13 +782,23 @@ void Client::handleCommand_NodeDef(NetworkPacket* pkt)
 	// updating content definitions
 	sanity_check(!m_mesh_update_manager->isRunning());
 
+	const std::string compressed = pkt->readLongString();
+	if (DefinitionSnapshot::restoreNodeDefs(compressed, m_proto_ver, m_nodedef)) {
+		infostream << "Client: Node definitions unchanged, reusing them"
+				<< std::endl;
+		m_nodedef_received = true;
+		return;
+	}
+
 	// Decompress node definitions
-	std::istringstream tmp_is(pkt->readLongString(), std::ios::binary);
+	std::istringstream tmp_is(compressed, std::ios::binary);
 	std::stringstream tmp_os(std::ios::binary | std::ios::in | std::ios::out);
 	decompressZlib(tmp_is, tmp_os);
 
 	// Deserialize node definitions
 	m_nodedef->deSerialize(tmp_os, m_proto_ver);
+	DefinitionSnapshot::storeNodeDefs(compressed, m_proto_ver, m_nodedef,
+			tmp_os.str().size());
 	m_nodedef_received = true;
 }
 
@@ -789,13 +811,23 @@ void Client::handleCommand_ItemDef(NetworkPacket* pkt)
 	// updating content definitions
 	sanity_check(!m_mesh_update_manager->isRunning());
 
+	const std::string compressed = pkt->readLongString();
+	if (DefinitionSnapshot::restoreItemDefs(compressed, m_proto_ver, m_itemdef)) {
+		infostream << "Client: Item definitions unchanged, reusing them"
+				<< std::endl;
+		m_itemdef_received = true;
+		return;
+	}
+
 	// Decompress item definitions
-	std::istringstream tmp_is(pkt->readLongString(), std::ios::binary);
+	std::istringstream tmp_is(compressed, std::ios::binary);
 	std::stringstream tmp_os(std::ios::binary | std::ios::in | std::ios::out);
 	decompressZlib(tmp_is, tmp_os);
 
 	// Deserialize node definitions
 	m_itemdef->deSerialize(tmp_os, m_proto_ver);
+	DefinitionSnapshot::storeItemDefs(compressed, m_proto_ver, m_itemdef,
+			tmp_os.str().size());
 	m_itemdef_received = true;
 }
 
@@ -341,6 +341,7 @@ void ContentFeatures::reset()
 	has_on_construct = false;
 	has_on_destruct = false;
 	has_after_destruct = false;
+	floats = false;
 	/*
 		Actual data
 
@@ -981,6 +982,7 @@ void NodeDefManager::clear()
 	m_next_id = 0;
 	m_selection_box_union.reset(0,0,0);
 	m_selection_box_int_union.reset(0,0,0);
+	m_collision_info.clear();
 
 	resetNodeResolveState();
 
@@ -1002,6 +1004,7 @@ void NodeDefManager::clear()
 		for (u32 ci = 0; ci <= CONTENT_MAX; ci++)
 			m_content_lighting_flag_cache[ci] = f.getLightingFlags();
 		addNameIdMapping(c, f.name);
+		updateCollisionInfo(c);
 	}
 
 	// Set CONTENT_AIR
@@ -1023,6 +1026,7 @@ void NodeDefManager::clear()
 		m_content_features[c] = f;
 		m_content_lighting_flag_cache[c] = f.getLightingFlags();
 		addNameIdMapping(c, f.name);
+		updateCollisionInfo(c);
 	}
 
 	// Set CONTENT_IGNORE
@@ -1043,6 +1047,7 @@ void NodeDefManager::clear()
 		m_content_features[c] = f;
 		m_content_lighting_flag_cache[c] = f.getLightingFlags();
 		addNameIdMapping(c, f.name);
+		updateCollisionInfo(c);
 	}
 }
 
@@ -1296,6 +1301,7 @@ content_t NodeDefManager::set(const std::string &name, const ContentFeatures &de
 	m_content_features[id] = def;
 	m_content_features[id].floats = itemgroup_get(def.groups, "float") != 0;
 	m_content_lighting_flag_cache[id] = def.getLightingFlags();
+	updateCollisionInfo(id);
 	verbosestream << "NodeDefManager: registering content id \"" << id
 		<< "\": name=\"" << def.name << "\""<<std::endl;
 
@@ -1312,6 +1318,63 @@ content_t NodeDefManager::set(const std::string &name, const ContentFeatures &de
 }
 
 
+void NodeDefManager::updateCollisionInfo(content_t c)
+{
+	if (m_collision_info.size() < m_content_features.size())
+		m_collision_info.resize(m_content_features.size());
+
+	const ContentFeatures &f = m_content_features[c];
+	NodeCollisionInfo &info = m_collision_info[c];
+	info = NodeCollisionInfo();
+	info.walkable = f.walkable;
+	// Negative bouncy may have a meaning, but collisions need +value
+	info.bouncy = abs(itemgroup_get(f.groups, "bouncy"));
+	if (!f.walkable)
+		return;
+
+	// Which parts of param2 transformNodeBox() reads, see
+	// MapNode::getFaceDir(), getWallMounted() and getLevel()
+	const NodeBox &box = f.collision_box.fixed.empty() ?
+			f.node_box : f.collision_box;
+	const bool wallmounted = f.param_type_2 == CPT2_WALLMOUNTED ||
+			f.param_type_2 == CPT2_COLORED_WALLMOUNTED;
+	if (box.type == NODEBOX_FIXED || box.type == NODEBOX_LEVELED) {
+		if (f.param_type_2 == CPT2_FACEDIR ||
+				f.param_type_2 == CPT2_COLORED_FACEDIR)
+			info.param2_mask |= 0x1F;
+		else if (f.param_type_2 == CPT2_4DIR ||
+				f.param_type_2 == CPT2_COLORED_4DIR)
+			info.param2_mask |= 0x03;
+		else if (wallmounted)
+			info.param2_mask |= 0x07;
+	}
+	if (box.type == NODEBOX_LEVELED && f.liquid_type != LIQUID_SOURCE) {
+		if (f.param_type_2 == CPT2_FLOWINGLIQUID ||
+				f.liquid_type == LIQUID_FLOWING)
+			info.param2_mask |= LIQUID_LEVEL_MASK;
+		else if (f.param_type_2 == CPT2_LEVELED)
+			info.param2_mask |= LEVELED_MASK;
+	}
+	if (box.type == NODEBOX_WALLMOUNTED && wallmounted)
+		info.param2_mask |= 0x07;
+
+	// collisionMoveSimple() only looks for neighbors in this case
+	info.connected = f.drawtype == NDT_NODEBOX &&
+			f.node_box.type == NODEBOX_CONNECTED;
+
+	// Neighbors are bits 1 to 32
+	const u32 neighbor_variants = info.connected ? 64 : 1;
+	const u32 param2_variants = info.param2_mask + 1;
+	info.boxes.resize(neighbor_variants * param2_variants);
+	for (u32 neighbors = 0; neighbors < neighbor_variants; neighbors++)
+	for (u32 param2 = 0; param2 < param2_variants; param2++) {
+		MapNode n(c, 0, param2);
+		n.getCollisionBoxes(this,
+				&info.boxes[neighbors * param2_variants + param2], neighbors);
+	}
+}
+
+
 content_t NodeDefManager::allocateDummy(const std::string &name)
 {
 	assert(!name.empty());	// Pre-condition
@@ -1511,6 +1574,7 @@ void NodeDefManager::deSerialize(std::istream &is, u16 protocol_version)
 		m_content_features[i].floats = itemgroup_get(f.groups, "float") != 0;
 		m_content_lighting_flag_cache[i] = f.getLightingFlags();
 		addNameIdMapping(i, f.name);
+		updateCollisionInfo(i);
 		TRACESTREAM(<< "NodeDef: deserialized " << f.name << std::endl);
 
 		getNodeBoxUnion(f.selection_box, f, &m_selection_box_union);
@@ -1523,6 +1587,24 @@ void NodeDefManager::deSerialize(std::istream &is, u16 protocol_version)
 }
 
 
+void NodeDefManager::copyDefinitionsFrom(const NodeDefManager &other)
+{
+	clear();
+
+	// The cross-references are already resolved in `other`
+	m_content_features = other.m_content_features;
+	m_name_id_mapping = other.m_name_id_mapping;
+	m_name_id_mapping_with_aliases = other.m_name_id_mapping_with_aliases;
+	m_group_to_items = other.m_group_to_items;
+	m_next_id = other.m_next_id;
+	m_selection_box_union = other.m_selection_box_union;
+	m_selection_box_int_union = other.m_selection_box_int_union;
+	memcpy(m_content_lighting_flag_cache, other.m_content_lighting_flag_cache,
+			sizeof(m_content_lighting_flag_cache));
+	m_collision_info = other.m_collision_info;
+}
+
+
 void NodeDefManager::addNameIdMapping(content_t i, const std::string &name)
 {
 	m_name_id_mapping.set(i, name);
@@ -526,6 +526,30 @@ struct ContentFeatures
 	u8 getAlphaForLegacy() const;
 };
 
+/*!
+ * Collision properties of a node type, built from its ContentFeatures.
+ */
+struct NodeCollisionInfo
+{
+	bool walkable = false;
+	// Absolute value of the "bouncy" group
+	int bouncy = 0;
+	// Whether the boxes depend on the connected neighbors, see
+	// MapNode::getNeighbors()
+	bool connected = false;
+	// Bits of param2 the boxes depend on, one less than a power of two
+	u8 param2_mask = 0;
+	// Boxes relative to the node position, by neighbors and param2.
+	// Empty if the node is not walkable.
+	std::vector<std::vector<aabb3f>> boxes;
+
+	const std::vector<aabb3f> &getBoxes(u8 param2, u8 neighbors) const
+	{
+		return boxes[(connected ? neighbors * (param2_mask + 1) : 0) +
+				(param2 & param2_mask)];
+	}
+};
+
 /*!
  * @brief This class is for getting the actual properties of nodes from their
  * content ID.
@@ -646,6 +670,18 @@ class NodeDefManager {
 	 */
 	bool cancelNodeResolveCallback(NodeResolver *nr) const;
 
+	/*!
+	 * Returns the collision properties of a node type, with its boxes
+	 * for every param2 and connected neighbors. Built whenever a
+	 * definition changes, so it is as cheap to get as \ref get().
+	 * @param c a content ID
+	 */
+	inline const NodeCollisionInfo &getCollisionInfo(content_t c) const {
+		return
+			(c < m_content_features.size() && !m_content_features[c].name.empty()) ?
+				m_collision_info[c] : m_collision_info[CONTENT_UNKNOWN];
+	}
+
 	/*!
 	 * Registers a new node type with the given name and allocates a new
 	 * content ID.
@@ -711,6 +747,14 @@ class NodeDefManager {
 	 */
 	void deSerialize(std::istream &is, u16 protocol_version);
 
+	/*!
+	 * Replaces the content of this manager with a copy of the definitions
+	 * in `other`, as if the same data had been deserialized again.
+	 * Neither manager may have textures loaded yet.
+	 * @param other the manager to copy from
+	 */
+	void copyDefinitionsFrom(const NodeDefManager &other);
+
 	/*!
 	 * Used to indicate that node registration has finished.
 	 * @param completed tells whether registration is complete
@@ -775,6 +819,12 @@ class NodeDefManager {
 	 */
 	void fixSelectionBoxIntUnion();
 
+	/*!
+	 * Builds the entry of \ref m_collision_info for a content ID from its
+	 * ContentFeatures.
+	 */
+	void updateCollisionInfo(content_t c);
+
 	//! Features indexed by ID.
 	std::vector<ContentFeatures> m_content_features;
 
@@ -829,6 +879,11 @@ class NodeDefManager {
 	 * Fast cache of content lighting flags.
 	 */
 	ContentLightingFlags m_content_lighting_flag_cache[CONTENT_MAX + 1L];
+
+	/*!
+	 * Collision properties by content ID, same size as m_content_features.
+	 */
+	std::vector<NodeCollisionInfo> m_collision_info;
 };
 
 NodeDefManager *createNodeDefManager();
@@ -70,5 +70,6 @@ struct ObjectProperties
 	ObjectProperties();
 	// check limits of some important properties (strings) that'd cause exceptions later on
 	bool validate();
+	void serialize(std::ostream &os) const;
 	void deSerialize(std::istream &is);
 };
@@ -54,12 +54,14 @@ ScopeProfiler::~ScopeProfiler()
 			m_profiler->max(m_name, duration);
 			break;
 		}
+		m_profiler->frameAdd(m_name, duration);
 	}
 	delete m_timer;
 }
 
 Profiler::Profiler()
 {
+	m_frame_thread = std::this_thread::get_id();
 	m_start_time = porting::getTimeMs();
 }
 
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <string>
 #include <map>
 #include <ostream>
+#include <thread>
 
 #include "threading/mutex_auto_lock.h"
 #include "util/timetaker.h"
@@ -82,11 +83,37 @@ class Profiler
 		m_data.erase(name);
 	}
 
+	/*
+		Time spent in ScopeProfilers by the thread that created the profiler
+		(the main thread), summed per name since the last call of frameGet().
+		Used to attribute slow frames.
+	*/
+	void frameAdd(const std::string &name, float value)
+	{
+		if (std::this_thread::get_id() != m_frame_thread)
+			return;
+		MutexAutoLock lock(m_mutex);
+		m_frametimes[name] += value;
+	}
+	void frameGet(GraphValues &result)
+	{
+		MutexAutoLock lock(m_mutex);
+		result.clear();
+		for (auto &it : m_frametimes) {
+			if (it.second == 0)
+				continue;
+			result.emplace(it.first, it.second);
+			it.second = 0;
+		}
+	}
+
 private:
 	std::mutex m_mutex;
 	std::map<std::string, float> m_data;
 	std::map<std::string, int> m_avgcounts;
 	std::map<std::string, float> m_graphvalues;
+	std::map<std::string, float> m_frametimes;
+	std::thread::id m_frame_thread;
 	u64 m_start_time;
 };
 
@@ -25,6 +25,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "filesys.h"
 #include "content/mods.h"
 #include "porting.h"
+#include "profiler.h"
+#include "settings.h"
+#include "log.h"
 #include "util/string.h"
 #include "server.h"
 #ifndef SERVER
@@ -45,6 +48,9 @@ extern "C" {
 #include <cstdarg>
 #include "script/common/c_content.h"
 #include <sstream>
+#include <optional>
+#include <algorithm>
+#include <map>
 
 
 class ModNameStorer
@@ -140,6 +146,10 @@ ScriptApiBase::ScriptApiBase(ScriptingType type):
 		return 0;
 	});
 	lua_setfield(m_luastack, -2, "set_push_node");
+#ifndef SERVER
+	if (m_type == ScriptingType::Client)
+		initCallbackProfiler();
+#endif
 	// Finally, put the table into the global environment:
 	lua_setglobal(m_luastack, "core");
 
@@ -307,6 +317,13 @@ void ScriptApiBase::runCallbacksRaw(int nargs,
 	// Only run callbacks when the scripting enviroment is loaded
 	FATAL_ERROR_IF(m_type == ScriptingType::Client &&
 			!getClient()->modsLoaded(), fxn);
+
+	// Client-side mods run on the main thread, time them for frame stats
+	std::optional<ScopeProfiler> sp;
+	if (m_type == ScriptingType::Client)
+		sp.emplace(g_profiler, "Client: CSM callbacks", SPT_ADD);
+	// Calls left unfinished by an error are dropped
+	const size_t profiled_calls = m_profiled_calls.size();
 #endif
 
 #ifdef SCRIPTAPI_LOCK_DEBUG
@@ -334,6 +351,9 @@ void ScriptApiBase::runCallbacksRaw(int nargs,
 	// ... <error handler> <run_callbacks> <table> <mode> <arg#1> <arg#2> ... <arg#n>
 
 	int result = lua_pcall(L, nargs + 2, 1, error_handler);
+#ifndef SERVER
+	m_profiled_calls.resize(profiled_calls);
+#endif
 	if (result != 0)
 		scriptError(result, fxn);
 
@@ -410,3 +430,255 @@ Client* ScriptApiBase::getClient()
 	return dynamic_cast<Client *>(m_gamedef);
 }
 #endif
+
+#ifndef SERVER
+
+// Per-callback profiler of client-side mods, see builtin/client/register.lua
+
+// Seconds between budget warnings for the same callback
+#define CALLBACK_BUDGET_WARNING_INTERVAL 10
+
+static size_t lua_memory_usage(lua_State *L)
+{
+	return (size_t)lua_gc(L, LUA_GCCOUNT, 0) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
+// Folded stack lines use ';' between frames and ' ' before the value
+static std::string folded_frame(std::string name)
+{
+	for (char &c : name) {
+		if (c == ';' || c == ' ')
+			c = '_';
+	}
+	return name;
+}
+
+void ScriptApiBase::initCallbackProfiler()
+{
+	lua_State *L = getStack();
+
+	m_profiler_enabled = g_settings->getBool("csm_profiler");
+	m_callback_budget_us = g_settings->getU32("csm_callback_budget") * 1000;
+
+	// Taken out of the core table by builtin
+	if (m_profiler_enabled || m_callback_budget_us > 0) {
+		lua_pushcfunction(L, l_profiler_enter);
+		lua_setfield(L, -2, "profiler_enter");
+		lua_pushcfunction(L, l_profiler_leave);
+		lua_setfield(L, -2, "profiler_leave");
+	}
+	lua_pushcfunction(L, l_profiler_report);
+	lua_setfield(L, -2, "profiler_report");
+	lua_pushcfunction(L, l_profiler_save);
+	lua_setfield(L, -2, "profiler_save");
+	lua_pushcfunction(L, l_profiler_reset);
+	lua_setfield(L, -2, "profiler_reset");
+}
+
+ScriptApiBase::CallbackProfile *ScriptApiBase::getCallbackProfile(lua_State *L, int func)
+{
+	auto it = m_callback_profiles.find(lua_topointer(L, func));
+	if (it != m_callback_profiles.end())
+		return &it->second;
+
+	CallbackProfile &profile = m_callback_profiles[lua_topointer(L, func)];
+	// Keeps the function alive, so that no other function can take over
+	// its address and with it this profile
+	lua_pushvalue(L, func);
+	profile.func_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+	// Registered by core.register_*, see make_registration()
+	lua_getglobal(L, "core");
+	lua_getfield(L, -1, "callback_origins");
+	if (lua_istable(L, -1)) {
+		lua_pushvalue(L, func);
+		lua_gettable(L, -2);
+	} else {
+		lua_pushnil(L);
+	}
+	if (lua_istable(L, -1)) {
+		lua_getfield(L, -1, "mod");
+		lua_getfield(L, -2, "name");
+		profile.mod = readParam<std::string>(L, -2, "??");
+		profile.event = readParam<std::string>(L, -1, "??");
+		lua_pop(L, 2);
+	} else {
+		profile.mod = profile.event = "??";
+	}
+	lua_pop(L, 3);
+	// Registered while no mod was loading
+	if (profile.mod == "??")
+		profile.mod = "*builtin*";
+
+	lua_Debug ar;
+	lua_pushvalue(L, func);
+	if (lua_getinfo(L, ">S", &ar))
+		profile.function = std::string(ar.short_src) + ":" + itos(ar.linedefined);
+	else
+		profile.function = "??";
+
+	return &profile;
+}
+
+// profiler_enter(func)
+int ScriptApiBase::l_profiler_enter(lua_State *L)
+{
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	ScriptApiBase *script = ModApiBase::getScriptApiBase(L);
+
+	// With only the budget enabled, just the time is taken
+	ProfiledCall call;
+	call.profile = nullptr;
+	call.start_mem = 0;
+	if (script->m_profiler_enabled) {
+		call.profile = script->getCallbackProfile(L, 1);
+		call.start_mem = lua_memory_usage(L);
+	}
+	call.child_us = 0;
+	call.child_mem = 0;
+	call.start_us = porting::getTimeUs();
+	script->m_profiled_calls.push_back(call);
+	return 0;
+}
+
+// profiler_leave(func)
+int ScriptApiBase::l_profiler_leave(lua_State *L)
+{
+	const u64 now_us = porting::getTimeUs();
+	luaL_checktype(L, 1, LUA_TFUNCTION);
+	ScriptApiBase *script = ModApiBase::getScriptApiBase(L);
+	if (script->m_profiled_calls.empty())
+		return 0;
+
+	const ProfiledCall call = script->m_profiled_calls.back();
+	script->m_profiled_calls.pop_back();
+
+	const u64 time_us = now_us - call.start_us;
+
+	if (script->m_profiler_enabled) {
+		const size_t mem = lua_memory_usage(L);
+		// Less memory after a garbage collection step, which we can't tell apart
+		const size_t alloc = mem > call.start_mem ? mem - call.start_mem : 0;
+		const u64 self_us = time_us - std::min(call.child_us, time_us);
+		const size_t self_alloc = alloc - std::min(call.child_mem, alloc);
+
+		if (!script->m_profiled_calls.empty()) {
+			script->m_profiled_calls.back().child_us += time_us;
+			script->m_profiled_calls.back().child_mem += alloc;
+		}
+
+		CallbackProfile &profile = *call.profile;
+		profile.calls++;
+		profile.time_us += self_us;
+		profile.max_us = std::max(profile.max_us, time_us);
+		profile.alloc_bytes += self_alloc;
+
+		g_profiler->add("CSM: " + profile.mod + " [ms]", self_us / 1000.0f);
+		g_profiler->add("CSM: " + profile.mod + " alloc [KiB]", self_alloc / 1024.0f);
+	}
+
+	if (script->m_callback_budget_us == 0 || time_us <= script->m_callback_budget_us)
+		return 0;
+
+	// Without the profiler the callback is only looked up when it is slow
+	CallbackProfile &profile = call.profile ? *call.profile :
+			*script->getCallbackProfile(L, 1);
+	if (profile.last_warning_us == 0 || now_us - profile.last_warning_us >
+			CALLBACK_BUDGET_WARNING_INTERVAL * 1000000ULL) {
+		profile.last_warning_us = now_us;
+		warningstream << "Client-side mod \"" << profile.mod << "\" took "
+				<< (time_us / 1000) << " ms in " << profile.event << " ("
+				<< profile.function << "), over csm_callback_budget" << std::endl;
+	}
+	return 0;
+}
+
+// profiler_report() -> string
+int ScriptApiBase::l_profiler_report(lua_State *L)
+{
+	ScriptApiBase *script = ModApiBase::getScriptApiBase(L);
+	if (!script->m_profiler_enabled) {
+		lua_pushstring(L, "The profiler is disabled, enable csm_profiler.");
+		return 1;
+	}
+
+	struct ModTotal {
+		u64 calls = 0, time_us = 0, max_us = 0, alloc_bytes = 0;
+	};
+	std::map<std::string, ModTotal> mods;
+	std::vector<const CallbackProfile *> functions;
+	for (const auto &it : script->m_callback_profiles) {
+		const CallbackProfile &profile = it.second;
+		if (profile.calls == 0)
+			continue;
+		ModTotal &total = mods[profile.mod];
+		total.calls += profile.calls;
+		total.time_us += profile.time_us;
+		total.max_us = std::max(total.max_us, profile.max_us);
+		total.alloc_bytes += profile.alloc_bytes;
+		functions.push_back(&profile);
+	}
+
+	std::vector<std::pair<std::string, ModTotal>> sorted(mods.begin(), mods.end());
+	std::sort(sorted.begin(), sorted.end(),
+		[] (const std::pair<std::string, ModTotal> &a, const std::pair<std::string, ModTotal> &b) {
+			return a.second.time_us > b.second.time_us;
+		});
+	std::sort(functions.begin(), functions.end(),
+		[] (const CallbackProfile *a, const CallbackProfile *b) {
+			return a->time_us > b->time_us;
+		});
+
+	std::ostringstream os(std::ios_base::binary);
+	os << "Time in client-side mod callbacks:";
+	for (const auto &it : sorted) {
+		os << "\n" << it.first << ": " << (it.second.time_us / 1000) << " ms in "
+			<< it.second.calls << " calls, max " << (it.second.max_us / 1000)
+			<< " ms, " << (it.second.alloc_bytes / 1024) << " KiB allocated";
+	}
+	os << "\nSlowest callbacks:";
+	for (size_t i = 0; i < std::min<size_t>(functions.size(), 5); i++) {
+		const CallbackProfile &profile = *functions[i];
+		os << "\n" << profile.mod << " " << profile.event << " " << profile.function
+			<< ": " << (profile.time_us / 1000) << " ms in " << profile.calls << " calls";
+	}
+	lua_pushstring(L, os.str().c_str());
+	return 1;
+}
+
+// profiler_save() -> path or nil
+int ScriptApiBase::l_profiler_save(lua_State *L)
+{
+	ScriptApiBase *script = ModApiBase::getScriptApiBase(L);
+
+	// One "mod;event;function microseconds" line each, as flamegraph.pl reads
+	std::ostringstream os(std::ios_base::binary);
+	for (const auto &it : script->m_callback_profiles) {
+		const CallbackProfile &profile = it.second;
+		if (profile.time_us == 0)
+			continue;
+		os << folded_frame(profile.mod) << ";" << folded_frame(profile.event) << ";"
+			<< folded_frame(profile.function) << " " << profile.time_us << "\n";
+	}
+
+	const std::string path = porting::path_user + DIR_DELIM + "csm_profile.folded";
+	if (!fs::safeWriteToFile(path, os.str())) {
+		lua_pushnil(L);
+		return 1;
+	}
+	lua_pushstring(L, path.c_str());
+	return 1;
+}
+
+// profiler_reset()
+int ScriptApiBase::l_profiler_reset(lua_State *L)
+{
+	ScriptApiBase *script = ModApiBase::getScriptApiBase(L);
+	for (auto &it : script->m_callback_profiles) {
+		CallbackProfile &profile = it.second;
+		profile.calls = profile.time_us = profile.max_us = profile.alloc_bytes = 0;
+	}
+	return 0;
+}
+
+#endif
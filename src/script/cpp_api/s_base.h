@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <thread>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 #include "common/helper.h"
 #include "util/basic_macros.h"
 
@@ -158,6 +159,49 @@ class ScriptApiBase : protected LuaHelper {
 private:
 	static int luaPanic(lua_State *L);
 
+#ifndef SERVER
+	/*
+		Profiler of the callbacks of client-side mods, which run on the main
+		thread. builtin/client/register.lua reports each callback it runs.
+		Time and allocations are attributed to the function without the
+		callbacks run from inside it. With only csm_callback_budget set,
+		just the time of each call is taken.
+	*/
+	struct CallbackProfile {
+		// Registry reference to the function
+		int func_ref = LUA_NOREF;
+		std::string mod, event, function;
+		u64 calls = 0;
+		u64 time_us = 0;
+		u64 max_us = 0;
+		u64 alloc_bytes = 0;
+		u64 last_warning_us = 0;
+	};
+	struct ProfiledCall {
+		CallbackProfile *profile;
+		u64 start_us;
+		size_t start_mem;
+		u64 child_us;
+		size_t child_mem;
+	};
+
+	void initCallbackProfiler();
+	CallbackProfile *getCallbackProfile(lua_State *L, int func);
+	static int l_profiler_enter(lua_State *L);
+	static int l_profiler_leave(lua_State *L);
+	static int l_profiler_report(lua_State *L);
+	static int l_profiler_save(lua_State *L);
+	static int l_profiler_reset(lua_State *L);
+
+	// Keyed by the callback function
+	std::unordered_map<const void *, CallbackProfile> m_callback_profiles;
+	std::vector<ProfiledCall> m_profiled_calls;
+	// csm_profiler: report the time per mod to the profiler
+	bool m_profiler_enabled = false;
+	// csm_callback_budget, 0 for none
+	u64 m_callback_budget_us = 0;
+#endif
+
 	lua_State      *m_luastack = nullptr;
 
 	IGameDef       *m_gamedef = nullptr;
@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <zlib.h>
 #include <zstd.h>
+#include <algorithm>
 
 /* report a zlib or i/o error */
 static void zerr(int ret)
@@ -286,15 +287,55 @@ void decompressZstd(std::istream &is, std::ostream &os)
 		}
 	} while (ret != 0);
 
-	// Unget all the data that ZSTD_decompressStream didn't take
+	// Give back all the data that ZSTD_decompressStream didn't take
 	is.clear(); // Just in case EOF is set
-	for (u32 i = 0; i < input.size - input.pos; i++) {
+	const size_t unused = input.size - input.pos;
+	if (unused == 0)
+		return;
+	is.seekg(-(std::streamoff)unused, std::ios_base::cur);
+	if (!is.fail())
+		return;
+	// Not seekable, unget it byte by byte
+	is.clear();
+	for (size_t i = 0; i < unused; i++) {
 		is.unget();
 		if (is.fail() || is.bad())
 			throw SerializationError("decompressZstd: unget failed");
 	}
 }
 
+size_t decompressZstd(const u8 *data, size_t data_size,
+		std::vector<u8> &out, size_t &out_size)
+{
+	// reusing the context is recommended for performance
+	// it will be destroyed when the thread ends
+	thread_local std::unique_ptr<ZSTD_DStream, ZSTD_Deleter> stream(ZSTD_createDStream());
+
+	ZSTD_initDStream(stream.get());
+
+	ZSTD_inBuffer input = { data, data_size, 0 };
+	out_size = 0;
+	size_t ret;
+	do {
+		if (out_size == out.size())
+			out.resize(std::max<size_t>(out.size() * 2, 16384));
+
+		ZSTD_outBuffer output = { out.data(), out.size(), out_size };
+		ret = ZSTD_decompressStream(stream.get(), &output, &input);
+		if (ZSTD_isError(ret)) {
+			dstream << ZSTD_getErrorName(ret) << std::endl;
+			throw SerializationError("decompressZstd: failed");
+		}
+		out_size = output.pos;
+
+		// Everything was read, yet the frame is incomplete
+		if (ret != 0 && input.pos == input.size && output.pos < output.size)
+			throw SerializationError("decompressZstd: truncated input");
+	} while (ret != 0);
+
+	return input.pos;
+}
+
 void compress(u8 *data, u32 size, std::ostream &os, u8 version, int level)
 {
 	if(version >= 29)
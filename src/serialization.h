@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "irrlichttypes.h"
 #include "exceptions.h"
 #include <iostream>
+#include <vector>
 #include "util/pointer.h"
 
 /*
@@ -93,6 +94,11 @@ void decompressZlib(std::istream &is, std::ostream &os, size_t limit = 0);
 void compressZstd(const u8 *data, size_t data_size, std::ostream &os, int level = 0);
 void compressZstd(const std::string &data, std::ostream &os, int level = 0);
 void decompressZstd(std::istream &is, std::ostream &os);
+// Decompresses the zstd frame at the start of data into out, which is grown
+// as needed but never shrunk so that it can be reused. out_size receives the
+// decompressed size. Returns the number of bytes read from data.
+size_t decompressZstd(const u8 *data, size_t data_size,
+		std::vector<u8> &out, size_t &out_size);
 
 // These choose between zlib and a self-made one according to version
 void compress(const SharedBuffer<u8> &data, std::ostream &os, u8 version, int level = -1);
@@ -0,0 +1,723 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#include "syntheticserver.h"
+#include "activeobject.h"
+#include "constants.h"
+#include "face_position_cache.h"
+#include "itemdef.h"
+#include "log.h"
+#include "mapblock.h"
+#include "nodedef.h"
+#include "noise.h"
+#include "object_properties.h"
+#include "particles.h"
+#include "porting.h"
+#include "serialization.h"
+#include "settings.h"
+#include "network/connection.h"
+#include "network/networkpacket.h"
+#include "threading/thread.h"
+#include "util/base64.h"
+#include "util/numeric.h"
+#include "util/serialize.h"
+#include "util/sha1.h"
+#include "util/string.h"
+#include <cmath>
+#include <sstream>
+
+// Channels as used by the real server
+#define CHANNEL_DEFAULT 0
+#define CHANNEL_MAP 2
+
+// Split media into packets of at most this size
+#define MEDIA_BUNCH_SIZE (512 * 1024)
+
+class SyntheticServerThread : public Thread
+{
+public:
+	SyntheticServerThread(SyntheticServer *server) :
+		Thread("SyntheticServer"),
+		m_server(server)
+	{}
+
+	void *run()
+	{
+		u64 last_time = porting::getTimeMs();
+		while (!stopRequested()) {
+			try {
+				m_server->receive();
+				u64 time = porting::getTimeMs();
+				m_server->step((time - last_time) / 1000.0f);
+				last_time = time;
+			} catch (con::ConnectionBindFailed &e) {
+				m_server->m_error.set(std::string("SyntheticServer: ") + e.what());
+				errorstream << m_server->m_error.get() << std::endl;
+				break;
+			}
+		}
+		return nullptr;
+	}
+
+private:
+	SyntheticServer *m_server;
+};
+
+/*
+	16x16 uncompressed true-color TGA with some noise on top of a color
+	picked from the index, so that the textures differ from each other.
+*/
+static std::string make_texture(u32 index, s32 seed)
+{
+	const u16 size = 16;
+	std::string data(18 + size * size * 4, '\0');
+	u8 *header = reinterpret_cast<u8 *>(&data[0]);
+	header[2] = 2; // Uncompressed true-color
+	header[12] = size & 0xFF; // Little endian width
+	header[14] = size & 0xFF; // Little endian height
+	header[16] = 32; // Bits per pixel
+	header[17] = 0x28; // 8 alpha bits, origin at the top left
+
+	const u8 r = 64 + (index * 97) % 160;
+	const u8 g = 64 + (index * 57) % 160;
+	const u8 b = 64 + (index * 31) % 160;
+	u8 *pixel = header + 18;
+	for (u16 y = 0; y < size; y++)
+	for (u16 x = 0; x < size; x++) {
+		s32 shade = noise2d(x, y, seed + index) * 24;
+		pixel[0] = rangelim(b + shade, 0, 255);
+		pixel[1] = rangelim(g + shade, 0, 255);
+		pixel[2] = rangelim(r + shade, 0, 255);
+		pixel[3] = 255;
+		pixel += 4;
+	}
+	return data;
+}
+
+SyntheticServer::SyntheticServer(Address bind_addr) :
+	m_bind_addr(bind_addr),
+	m_error("")
+{
+	m_block_rate = MYMAX(g_settings->getU32("synthetic_server_block_rate"), 1);
+	m_range = rangelim(g_settings->getS16("synthetic_server_range"), 1, 32);
+	m_object_count = g_settings->getU16("synthetic_server_objects");
+	m_object_interval = 1.0f /
+		MYMAX(g_settings->getFloat("synthetic_server_object_update_rate"), 0.1f);
+	m_spawner_count = g_settings->getU16("synthetic_server_particle_spawners");
+	m_particle_rate = g_settings->getU16("synthetic_server_particle_rate");
+
+	generateContent();
+
+	m_con = std::make_unique<con::Connection>(PROTOCOL_ID, 512,
+			CONNECTION_TIMEOUT, m_bind_addr.isIPv6(), this);
+	m_thread = std::make_unique<SyntheticServerThread>(this);
+}
+
+SyntheticServer::~SyntheticServer()
+{
+	stop();
+	// Destroy the connection before the definitions, it calls back into us
+	m_con.reset();
+	delete m_itemdef;
+	delete m_nodedef;
+}
+
+void SyntheticServer::start()
+{
+	infostream << "SyntheticServer: Serving on "
+		<< m_bind_addr.serializeString() << ":" << m_bind_addr.getPort()
+		<< std::endl;
+
+	m_con->SetTimeoutMs(30);
+	m_con->Serve(m_bind_addr);
+	m_thread->start();
+}
+
+void SyntheticServer::stop()
+{
+	m_thread->stop();
+	m_thread->wait();
+}
+
+void SyntheticServer::peerAdded(con::Peer *peer)
+{
+	verbosestream << "SyntheticServer: Peer " << peer->id << " added" << std::endl;
+	m_peers[peer->id].peer_id = peer->id;
+}
+
+void SyntheticServer::deletingPeer(con::Peer *peer, bool timeout)
+{
+	verbosestream << "SyntheticServer: Peer " << peer->id << " removed"
+		<< (timeout ? " (timed out)" : "") << std::endl;
+	m_peers.erase(peer->id);
+}
+
+void SyntheticServer::generateContent()
+{
+	m_itemdef = createItemDefManager();
+	m_nodedef = createNodeDefManager();
+
+	// Each texture gets a node. The first node is used below the surface,
+	// the others make up the surface.
+	const u16 texture_count =
+		rangelim(g_settings->getU16("synthetic_server_textures"), 2, 1024);
+	for (u16 i = 0; i < texture_count; i++) {
+		const std::string texture = "synthetic_" + itos(i) + ".tga";
+		m_media[texture] = make_texture(i, m_seed);
+		m_textures.push_back(texture);
+
+		ContentFeatures f;
+		f.name = "synthetic:node_" + itos(i);
+		f.drawtype = NDT_NORMAL;
+		for (TileDef &tiledef : f.tiledef)
+			tiledef.name = texture;
+		f.groups["cracky"] = 3;
+		m_node_ids.push_back(m_nodedef->set(f.name, f));
+
+		ItemDefinition def;
+		def.type = ITEM_NODE;
+		def.name = f.name;
+		def.description = "Synthetic node " + itos(i);
+		m_itemdef->registerItem(def);
+	}
+
+	std::ostringstream os(std::ios::binary);
+	std::ostringstream os_compressed(std::ios::binary);
+	m_itemdef->serialize(os, LATEST_PROTOCOL_VERSION);
+	compressZlib(os.str(), os_compressed);
+	m_itemdef_data = os_compressed.str();
+
+	os.str("");
+	os_compressed.str("");
+	m_nodedef->serialize(os, LATEST_PROTOCOL_VERSION);
+	compressZlib(os.str(), os_compressed);
+	m_nodedef_data = os_compressed.str();
+
+	m_spawn_pos = v3f(0, getGroundLevel(0, 0) + 1, 0);
+}
+
+s16 SyntheticServer::getGroundLevel(s16 x, s16 z) const
+{
+	return 4 + noise2d_perlin(x / 128.0f, z / 128.0f, m_seed, 4, 0.5f) * 24;
+}
+
+void SyntheticServer::generateBlock(v3s16 blockpos, MapNode *nodes) const
+{
+	const v3s16 origin = blockpos * MAP_BLOCKSIZE;
+	const u16 surface_count = m_node_ids.size() - 1;
+
+	for (s16 z = 0; z < MAP_BLOCKSIZE; z++)
+	for (s16 x = 0; x < MAP_BLOCKSIZE; x++) {
+		const s16 ground = getGroundLevel(origin.X + x, origin.Z + z);
+		const float biome = noise2d_perlin((origin.X + x) / 256.0f,
+				(origin.Z + z) / 256.0f, m_seed + 1, 2, 0.5f);
+		const content_t surface = m_node_ids[1 +
+			rangelim((s32)((biome + 1.0f) * 0.5f * surface_count), 0,
+				surface_count - 1)];
+
+		for (s16 y = 0; y < MAP_BLOCKSIZE; y++) {
+			MapNode &n = nodes[z * MAP_BLOCKSIZE * MAP_BLOCKSIZE +
+				y * MAP_BLOCKSIZE + x];
+			const s16 node_y = origin.Y + y;
+			if (node_y > ground)
+				n = MapNode(CONTENT_AIR, LIGHT_SUN, 0);
+			else if (node_y > ground - 3)
+				n = MapNode(surface);
+			else
+				n = MapNode(m_node_ids[0]);
+		}
+	}
+}
+
+void SyntheticServer::receive()
+{
+	try {
+		// Wait for the first packet, then take whatever else has arrived
+		NetworkPacket pkt;
+		m_con->Receive(&pkt);
+		handlePacket(&pkt);
+		for (;;) {
+			NetworkPacket next;
+			if (!m_con->TryReceive(&next))
+				break;
+			handlePacket(&next);
+		}
+	} catch (con::NoIncomingDataException &e) {
+	}
+}
+
+void SyntheticServer::step(float dtime)
+{
+	m_time += dtime;
+
+	// Don't let credit pile up while there is nothing to send
+	m_block_credit = MYMIN(m_block_credit + dtime * m_block_rate,
+			(f32)m_block_rate);
+	u32 budget = m_block_credit;
+
+	for (auto &it : m_peers) {
+		RemotePeer &peer = it.second;
+		if (!peer.ready)
+			continue;
+
+		if (budget > 0) {
+			u32 sent = sendBlocks(peer, budget);
+			budget -= sent;
+			m_block_credit -= sent;
+		}
+
+		peer.object_timer -= dtime;
+		if (peer.object_timer <= 0.0f) {
+			sendObjectPositions(peer, m_object_interval);
+			peer.object_timer = MYMAX(peer.object_timer + m_object_interval, 0.0f);
+		}
+	}
+}
+
+void SyntheticServer::handlePacket(NetworkPacket *pkt)
+{
+	auto it = m_peers.find(pkt->getPeerId());
+	if (it == m_peers.end())
+		return;
+	RemotePeer &peer = it->second;
+
+	try {
+		switch (pkt->getCommand()) {
+		case TOSERVER_INIT:
+			handleInit(peer, pkt);
+			break;
+		case TOSERVER_FIRST_SRP:
+		case TOSERVER_SRP_BYTES_A:
+			handleAuth(peer, pkt);
+			break;
+		case TOSERVER_INIT2:
+			handleInit2(peer, pkt);
+			break;
+		case TOSERVER_REQUEST_MEDIA:
+			handleRequestMedia(peer, pkt);
+			break;
+		case TOSERVER_CLIENT_READY:
+			handleClientReady(peer, pkt);
+			break;
+		case TOSERVER_PLAYERPOS:
+			handlePlayerPos(peer, pkt);
+			break;
+		case TOSERVER_DELETEDBLOCKS:
+			handleDeletedBlocks(peer, pkt);
+			break;
+		default:
+			// Chat, interaction and the like are not simulated
+			break;
+		}
+	} catch (PacketError &e) {
+		warningstream << "SyntheticServer: Ignoring malformed packet "
+			<< pkt->getCommand() << " from peer " << pkt->getPeerId()
+			<< ": " << e.what() << std::endl;
+	}
+}
+
+void SyntheticServer::handleInit(RemotePeer &peer, NetworkPacket *pkt)
+{
+	u8 max_ser_ver;
+	u16 compression_modes, min_proto_ver, max_proto_ver;
+	*pkt >> max_ser_ver >> compression_modes >> min_proto_ver
+		>> max_proto_ver >> peer.name;
+
+	// Definitions are serialized once, for the latest protocol version only
+	if (max_ser_ver < SER_FMT_VER_HIGHEST_WRITE ||
+			min_proto_ver > LATEST_PROTOCOL_VERSION ||
+			max_proto_ver < LATEST_PROTOCOL_VERSION) {
+		sendAccessDenied(peer, SERVER_ACCESSDENIED_WRONG_VERSION);
+		return;
+	}
+	peer.protocol_version = LATEST_PROTOCOL_VERSION;
+
+	infostream << "SyntheticServer: \"" << peer.name << "\" joining" << std::endl;
+
+	// Any password is fine, registering is the shortest exchange
+	NetworkPacket resp_pkt(TOCLIENT_HELLO, 0, peer.peer_id);
+	resp_pkt << (u8)SER_FMT_VER_HIGHEST_WRITE << (u16)NETPROTO_COMPRESSION_NONE
+		<< peer.protocol_version << (u32)AUTH_MECHANISM_FIRST_SRP << peer.name;
+	m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &resp_pkt, true);
+}
+
+void SyntheticServer::handleAuth(RemotePeer &peer, NetworkPacket *pkt)
+{
+	if (peer.protocol_version == 0)
+		return;
+
+	NetworkPacket resp_pkt(TOCLIENT_AUTH_ACCEPT, 0, peer.peer_id);
+	resp_pkt << (m_spawn_pos + v3f(0, 0.5f, 0)) * BS << (u64)m_seed
+		<< 0.09f << (u32)AUTH_MECHANISM_FIRST_SRP;
+	m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &resp_pkt, true);
+}
+
+void SyntheticServer::handleInit2(RemotePeer &peer, NetworkPacket *pkt)
+{
+	if (peer.protocol_version == 0)
+		return;
+
+	{
+		NetworkPacket resp_pkt(TOCLIENT_MOVEMENT, 12 * 4, peer.peer_id);
+		resp_pkt << 3.0f << 2.0f << 10.0f // acceleration: default, air, fast
+			<< 4.0f << 1.35f << 20.0f << 3.0f << 6.5f // speed: walk, crouch, fast, climb, jump
+			<< 1.0f << 0.5f << 10.0f // liquid: fluidity, smooth, sink
+			<< 9.81f; // gravity
+		m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &resp_pkt, true);
+	}
+	{
+		NetworkPacket resp_pkt(TOCLIENT_ITEMDEF, 0, peer.peer_id);
+		resp_pkt.putLongString(m_itemdef_data);
+		m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &resp_pkt, true);
+	}
+	{
+		NetworkPacket resp_pkt(TOCLIENT_NODEDEF, 0, peer.peer_id);
+		resp_pkt.putLongString(m_nodedef_data);
+		m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &resp_pkt, true);
+	}
+	{
+		NetworkPacket resp_pkt(TOCLIENT_ANNOUNCE_MEDIA, 0, peer.peer_id);
+		resp_pkt << (u16)m_media.size();
+		for (const auto &it : m_media) {
+			SHA1 sha1;
+			sha1.addBytes(it.second.c_str(), it.second.size());
+			unsigned char *digest = sha1.getDigest();
+			resp_pkt << it.first << base64_encode(digest, 20);
+			free(digest);
+		}
+		// No remote media servers
+		resp_pkt << std::string();
+		m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &resp_pkt, true);
+	}
+	{
+		NetworkPacket resp_pkt(TOCLIENT_CSM_RESTRICTION_FLAGS, 8 + 4, peer.peer_id);
+		resp_pkt << (u64)CSM_RF_NONE << (u32)0;
+		m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &resp_pkt, true);
+	}
+	{
+		// Noon, standing still
+		NetworkPacket resp_pkt(TOCLIENT_TIME_OF_DAY, 2 + 4, peer.peer_id);
+		resp_pkt << (u16)12000 << 0.0f;
+		m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &resp_pkt, true);
+	}
+}
+
+void SyntheticServer::handleRequestMedia(RemotePeer &peer, NetworkPacket *pkt)
+{
+	u16 count;
+	*pkt >> count;
+
+	std::vector<std::vector<const std::string *>> bunches(1);
+	size_t bunch_size = 0;
+	for (u16 i = 0; i < count; i++) {
+		std::string name;
+		*pkt >> name;
+		auto it = m_media.find(name);
+		if (it == m_media.end())
+			continue;
+
+		if (bunch_size > MEDIA_BUNCH_SIZE) {
+			bunches.emplace_back();
+			bunch_size = 0;
+		}
+		bunches.back().push_back(&it->first);
+		bunch_size += it->second.size();
+	}
+
+	for (size_t i = 0; i < bunches.size(); i++) {
+		NetworkPacket resp_pkt(TOCLIENT_MEDIA, 0, peer.peer_id);
+		resp_pkt << (u16)bunches.size() << (u16)i << (u32)bunches[i].size();
+		for (const std::string *name : bunches[i]) {
+			resp_pkt << *name;
+			resp_pkt.putLongString(m_media[*name]);
+		}
+		m_con->Send(peer.peer_id, CHANNEL_MAP, &resp_pkt, true);
+	}
+}
+
+void SyntheticServer::handleClientReady(RemotePeer &peer, NetworkPacket *pkt)
+{
+	if (peer.protocol_version == 0 || peer.ready)
+		return;
+
+	{
+		const char *privs[] = {"interact", "fly", "fast", "noclip"};
+		NetworkPacket resp_pkt(TOCLIENT_PRIVILEGES, 0, peer.peer_id);
+		resp_pkt << (u16)ARRLEN(privs);
+		for (const char *priv : privs)
+			resp_pkt << std::string(priv);
+		m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &resp_pkt, true);
+	}
+
+	peer.ready = true;
+	peer.position = m_spawn_pos;
+	sendObjects(peer);
+	sendParticleSpawners(peer);
+
+	actionstream << "SyntheticServer: \"" << peer.name << "\" joined, streaming "
+		<< m_block_rate << " blocks/s, " << m_object_count << " objects, "
+		<< m_spawner_count << " particle spawners" << std::endl;
+}
+
+void SyntheticServer::handlePlayerPos(RemotePeer &peer, NetworkPacket *pkt)
+{
+	if (pkt->getRemainingBytes() < 12 + 12 + 4 + 4 + 4 + 1 + 1)
+		return;
+
+	v3s32 position, speed;
+	s32 pitch, yaw;
+	u32 keys_pressed;
+	u8 fov, wanted_range;
+	*pkt >> position >> speed >> pitch >> yaw >> keys_pressed
+		>> fov >> wanted_range;
+
+	peer.position = v3f(position.X, position.Y, position.Z) / 100.0f / BS;
+	peer.wanted_range = wanted_range;
+}
+
+void SyntheticServer::handleDeletedBlocks(RemotePeer &peer, NetworkPacket *pkt)
+{
+	u8 count;
+	*pkt >> count;
+	for (u8 i = 0; i < count; i++) {
+		v3s16 p;
+		*pkt >> p;
+		peer.sent_blocks.erase(p);
+	}
+	// Deleted blocks may be in range again
+	peer.nearest_unsent_d = 0;
+}
+
+void SyntheticServer::sendAccessDenied(const RemotePeer &peer, AccessDeniedCode reason)
+{
+	NetworkPacket pkt(TOCLIENT_ACCESS_DENIED, 1 + 2 + 1, peer.peer_id);
+	pkt << (u8)reason << std::string() << (u8)0;
+	m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &pkt, true);
+}
+
+u32 SyntheticServer::sendBlocks(RemotePeer &peer, u32 budget)
+{
+	const v3s16 center = getNodeBlockPos(floatToInt(peer.position * BS, BS));
+	if (center != peer.center_block) {
+		peer.center_block = center;
+		peer.nearest_unsent_d = 0;
+	}
+
+	// The client asks for nothing until it knows its view range
+	const s16 range = peer.wanted_range > 0 ?
+		MYMIN(m_range, peer.wanted_range) : m_range;
+
+	// Nearest blocks first, as the real server does
+	u32 sent = 0;
+	for (s16 d = peer.nearest_unsent_d; d <= range; d++) {
+		bool all_sent = true;
+		for (const v3s16 &offset : FacePositionCache::getFacePositions(d)) {
+			const v3s16 p = center + offset;
+			if (peer.sent_blocks.count(p) != 0)
+				continue;
+			if (sent >= budget) {
+				all_sent = false;
+				break;
+			}
+			sendBlock(peer, p);
+			sent++;
+		}
+		if (!all_sent)
+			break;
+		peer.nearest_unsent_d = d + 1;
+	}
+	return sent;
+}
+
+void SyntheticServer::sendBlock(RemotePeer &peer, v3s16 blockpos)
+{
+	const u32 nodecount = MAP_BLOCKSIZE * MAP_BLOCKSIZE * MAP_BLOCKSIZE;
+	MapNode nodes[nodecount];
+	generateBlock(blockpos, nodes);
+
+	bool has_air = false, has_ground = false;
+	for (const MapNode &n : nodes) {
+		if (n.getContent() == CONTENT_AIR)
+			has_air = true;
+		else
+			has_ground = true;
+	}
+
+	// Same layout as MapBlock::serialize() for the network
+	const u8 version = SER_FMT_VER_HIGHEST_WRITE;
+	std::ostringstream os_raw(std::ios_base::binary);
+	u8 flags = 0;
+	if (!has_air)
+		flags |= 0x01; // underground
+	if (has_air && has_ground)
+		flags |= 0x02; // day-night differs
+	writeU8(os_raw, flags);
+	writeU16(os_raw, 0xFFFF); // lighting complete
+	writeU8(os_raw, 2); // content width
+	writeU8(os_raw, 2); // params width
+	SharedBuffer<u8> buf = MapNode::serializeBulk(version, nodes, nodecount, 2, 2);
+	os_raw.write(reinterpret_cast<char *>(*buf), buf.getSize());
+	writeU8(os_raw, 0); // no node metadata
+
+	std::ostringstream os(std::ios_base::binary);
+	compress(os_raw.str(), os, version);
+	writeU8(os, 2); // network specific data version
+
+	const std::string data = os.str();
+	NetworkPacket pkt(TOCLIENT_BLOCKDATA, 6 + data.size(), peer.peer_id);
+	pkt << blockpos;
+	pkt.putRawString(data);
+	m_con->Send(peer.peer_id, CHANNEL_MAP, &pkt, true);
+	peer.sent_blocks.insert(blockpos);
+}
+
+v3f SyntheticServer::getObjectPosition(u16 i, const v3f &center) const
+{
+	// Rings of objects circling the player at different distances,
+	// heights and speeds
+	const f32 radius = 3.0f + (i % 8) * 2.0f;
+	const f32 speed = 1.0f / radius;
+	const f32 angle = m_time * speed + i * (2.0f * M_PI / MYMAX(m_object_count, 1));
+	return center + v3f(radius * std::cos(angle), 1.0f + (i % 3),
+			radius * std::sin(angle));
+}
+
+void SyntheticServer::sendObjects(RemotePeer &peer)
+{
+	if (m_object_count == 0)
+		return;
+
+	ObjectProperties prop;
+	prop.visual = "cube";
+	prop.textures.clear();
+	for (u32 i = 0; i < 6; i++)
+		prop.textures.push_back(m_textures[i % m_textures.size()]);
+	prop.visual_size = v3f(0.5f, 0.5f, 0.5f);
+	prop.collisionbox = aabb3f(-0.25f, -0.25f, -0.25f, 0.25f, 0.25f, 0.25f);
+	prop.selectionbox = prop.collisionbox;
+	prop.pointable = false;
+	prop.static_save = false;
+
+	std::ostringstream prop_os(std::ios::binary);
+	writeU8(prop_os, AO_CMD_SET_PROPERTIES);
+	prop.serialize(prop_os);
+	const std::string prop_message = serializeString32(prop_os.str());
+
+	NetworkPacket pkt(TOCLIENT_ACTIVE_OBJECT_REMOVE_ADD, 0, peer.peer_id);
+	pkt << (u16)0 << m_object_count;
+	for (u16 i = 0; i < m_object_count; i++) {
+		// Same layout as GenericCAO::processInitData() expects
+		std::ostringstream os(std::ios::binary);
+		writeU8(os, 1); // version
+		os << serializeString16(""); // name
+		writeU8(os, 0); // is_player
+		writeU16(os, i + 1); // id
+		writeV3F32(os, getObjectPosition(i, peer.position) * BS);
+		writeV3F32(os, v3f()); // rotation
+		writeU16(os, prop.hp_max);
+		writeU8(os, 1); // number of messages
+		os << prop_message;
+
+		pkt << (u16)(i + 1) << (u8)ACTIVEOBJECT_TYPE_GENERIC;
+		pkt.putLongString(os.str());
+	}
+	m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &pkt, true);
+}
+
+void SyntheticServer::sendObjectPositions(RemotePeer &peer, f32 interval)
+{
+	if (m_object_count == 0)
+		return;
+
+	NetworkPacket pkt(TOCLIENT_ACTIVE_OBJECT_MESSAGES, 0, peer.peer_id);
+	for (u16 i = 0; i < m_object_count; i++) {
+		const v3f pos = getObjectPosition(i, peer.position);
+
+		std::ostringstream os(std::ios::binary);
+		writeU8(os, AO_CMD_UPDATE_POSITION);
+		writeV3F32(os, pos * BS);
+		writeV3F32(os, v3f()); // velocity
+		writeV3F32(os, v3f()); // acceleration
+		writeV3F32(os, v3f(0, m_time * 90.0f, 0)); // rotation
+		writeU8(os, 1); // do_interpolate
+		writeU8(os, 0); // is_end_position
+		writeF32(os, interval);
+
+		pkt << (u16)(i + 1);
+		pkt << os.str();
+	}
+	// Like the real server, position updates may get lost
+	m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &pkt, false);
+}
+
+void SyntheticServer::sendParticleSpawners(RemotePeer &peer)
+{
+	using namespace ParticleParamTypes;
+
+	for (u16 i = 0; i < m_spawner_count; i++) {
+		// Spread the spawners around the player
+		const f32 angle = i * (2.0f * M_PI / m_spawner_count);
+		const v3f center = peer.position +
+			v3f(8.0f * std::cos(angle), 2.0f, 8.0f * std::sin(angle));
+
+		ParticleSpawnerParameters p;
+		p.amount = m_particle_rate;
+		p.time = 0.0f; // Spawn forever, amount is per second
+		p.pos = v3fRange(center - v3f(2.0f), center + v3f(2.0f));
+		p.vel = v3fRange(v3f(-0.5f, 0.5f, -0.5f), v3f(0.5f, 2.0f, 0.5f));
+		p.acc = v3fRange(v3f(0.0f, -1.0f, 0.0f), v3f(0.0f, -1.0f, 0.0f));
+		p.exptime = f32Range(2.0f, 4.0f);
+		p.size = f32Range(0.5f, 1.5f);
+		p.collisiondetection = true;
+		p.texture.string = m_textures[i % m_textures.size()];
+
+		// Same layout as the real server
+		std::ostringstream os(std::ios_base::binary);
+		writeU16(os, p.amount);
+		writeF32(os, p.time);
+		p.pos.serialize(os);
+		p.vel.serialize(os);
+		p.acc.serialize(os);
+		p.exptime.serialize(os);
+		p.size.serialize(os);
+		writeU8(os, p.collisiondetection);
+		os << serializeString32(p.texture.string);
+		writeU32(os, i + 1); // id
+		writeU8(os, p.vertical);
+		writeU8(os, p.collision_removal);
+		writeU16(os, 0); // attached object id
+		p.animation.serialize(os, peer.protocol_version);
+		writeU8(os, p.glow);
+		writeU8(os, p.object_collision);
+		writeU16(os, p.node.param0);
+		writeU8(os, p.node.param2);
+		writeU8(os, p.node_tile);
+		p.texture.serialize(os, peer.protocol_version, true);
+		p.drag.serialize(os);
+		p.jitter.serialize(os);
+		p.bounce.serialize(os);
+		serializeParameterValue(os, AttractorKind::none);
+		p.radius.serialize(os);
+		writeU16(os, 0); // texture pool size
+
+		NetworkPacket pkt(TOCLIENT_ADD_PARTICLESPAWNER, 0, peer.peer_id);
+		pkt.putRawString(os.str());
+		m_con->Send(peer.peer_id, CHANNEL_DEFAULT, &pkt, true);
+	}
+}
@@ -0,0 +1,149 @@
+/*
+Minetest
+Copyright (C) 2023 Minetest contributors
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation; either version 2.1 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#pragma once
+
+#include "irrlichttypes_bloated.h"
+#include "constants.h"
+#include "mapnode.h"
+#include "network/address.h"
+#include "network/networkprotocol.h"
+#include "network/peerhandler.h"
+#include "util/basic_macros.h"
+#include "util/thread.h"
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+class IWritableItemDefManager;
+class NetworkPacket;
+class NodeDefManager;
+class SyntheticServerThread;
+namespace con { class Connection; }
+
+/*
+	A stand-in server for load testing the client on loopback.
+
+	It speaks just enough of the protocol for a client to join: any name
+	and password are accepted, generated node and item definitions and
+	textures are sent, and afterwards procedurally generated map blocks
+	around the player are streamed together with moving objects and
+	particle spawners, at the rates given by the synthetic_server_*
+	settings. Apart from the player position, whatever the client sends
+	is ignored.
+
+	Runs on its own thread; the public methods are thread-safe.
+*/
+class SyntheticServer : public con::PeerHandler
+{
+public:
+	SyntheticServer(Address bind_addr);
+	~SyntheticServer();
+	DISABLE_CLASS_COPY(SyntheticServer)
+
+	void start();
+	void stop();
+
+	// Set if the server thread stopped because of an error
+	std::string getError() { return m_error.get(); }
+
+	// con::PeerHandler
+	void peerAdded(con::Peer *peer);
+	void deletingPeer(con::Peer *peer, bool timeout);
+
+private:
+	friend class SyntheticServerThread;
+
+	struct RemotePeer {
+		session_t peer_id = PEER_ID_INEXISTENT;
+		u16 protocol_version = 0;
+		std::string name;
+		// Set on TOSERVER_CLIENT_READY, no map data is sent before that
+		bool ready = false;
+		// Last reported player position, in nodes
+		v3f position;
+		// Map blocks to send in each direction, capped by the settings
+		s16 wanted_range = 0;
+		// Block around which the blocks were last sent
+		v3s16 center_block;
+		// All blocks closer to center_block than this have been sent
+		s16 nearest_unsent_d = 0;
+		std::set<v3s16> sent_blocks;
+		// Time until the next object position update
+		f32 object_timer = 0.0f;
+	};
+
+	void generateContent();
+	void generateBlock(v3s16 blockpos, MapNode *nodes) const;
+	s16 getGroundLevel(s16 x, s16 z) const;
+
+	// Runs on the server thread
+	void receive();
+	void step(float dtime);
+	void handlePacket(NetworkPacket *pkt);
+
+	void handleInit(RemotePeer &peer, NetworkPacket *pkt);
+	void handleAuth(RemotePeer &peer, NetworkPacket *pkt);
+	void handleInit2(RemotePeer &peer, NetworkPacket *pkt);
+	void handleRequestMedia(RemotePeer &peer, NetworkPacket *pkt);
+	void handleClientReady(RemotePeer &peer, NetworkPacket *pkt);
+	void handlePlayerPos(RemotePeer &peer, NetworkPacket *pkt);
+	void handleDeletedBlocks(RemotePeer &peer, NetworkPacket *pkt);
+
+	void sendAccessDenied(const RemotePeer &peer, AccessDeniedCode reason);
+	// Sends up to `budget` blocks, returns how many were sent
+	u32 sendBlocks(RemotePeer &peer, u32 budget);
+	void sendBlock(RemotePeer &peer, v3s16 blockpos);
+	void sendObjects(RemotePeer &peer);
+	void sendObjectPositions(RemotePeer &peer, f32 interval);
+	void sendParticleSpawners(RemotePeer &peer);
+	v3f getObjectPosition(u16 i, const v3f &center) const;
+
+	std::unique_ptr<con::Connection> m_con;
+	Address m_bind_addr;
+	std::unique_ptr<SyntheticServerThread> m_thread;
+	MutexedVariable<std::string> m_error;
+
+	// Everything below is only used on the server thread
+	std::map<session_t, RemotePeer> m_peers;
+	f32 m_time = 0.0f;
+	f32 m_block_credit = 0.0f;
+
+	IWritableItemDefManager *m_itemdef = nullptr;
+	NodeDefManager *m_nodedef = nullptr;
+	// Compressed definitions, the same for every client
+	std::string m_itemdef_data;
+	std::string m_nodedef_data;
+	// Texture file name -> contents
+	std::map<std::string, std::string> m_media;
+	std::vector<std::string> m_textures;
+	std::vector<content_t> m_node_ids;
+	s32 m_seed = 1337;
+	v3f m_spawn_pos;
+
+	// Values of the synthetic_server_* settings
+	u32 m_block_rate;
+	s16 m_range;
+	u16 m_object_count;
+	f32 m_object_interval;
+	u16 m_spawner_count;
+	u16 m_particle_rate;
+};
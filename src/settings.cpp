@@ -1006,3 +1006,87 @@ void Settings::doCallbacks(const std::string &name) const
 			(it->first)(name, it->second);
 	}
 }
+
+
+/* Setting handles */
+
+template <typename T>
+static T readSettingValue(const Settings *settings, const std::string &name);
+
+template <>
+bool readSettingValue(const Settings *settings, const std::string &name)
+{
+	return settings->getBool(name);
+}
+
+template <>
+u16 readSettingValue(const Settings *settings, const std::string &name)
+{
+	return settings->getU16(name);
+}
+
+template <>
+s16 readSettingValue(const Settings *settings, const std::string &name)
+{
+	return settings->getS16(name);
+}
+
+template <>
+u32 readSettingValue(const Settings *settings, const std::string &name)
+{
+	return settings->getU32(name);
+}
+
+template <>
+s32 readSettingValue(const Settings *settings, const std::string &name)
+{
+	return settings->getS32(name);
+}
+
+template <>
+float readSettingValue(const Settings *settings, const std::string &name)
+{
+	return settings->getFloat(name);
+}
+
+template <typename T>
+SettingHandle<T>::SettingHandle(const std::string &name, Settings *settings) :
+	m_name(name),
+	m_settings(settings),
+	m_value(T())
+{
+	assert(m_settings);
+	m_settings->registerChangedCallback(m_name, settingChangedCallback, this);
+	reload();
+}
+
+template <typename T>
+SettingHandle<T>::~SettingHandle()
+{
+	m_settings->deregisterChangedCallback(m_name, settingChangedCallback, this);
+}
+
+template <typename T>
+void SettingHandle<T>::settingChangedCallback(const std::string &name, void *data)
+{
+	reinterpret_cast<SettingHandle<T> *>(data)->reload();
+}
+
+template <typename T>
+void SettingHandle<T>::reload()
+{
+	// Keep the previous value if the setting was removed or is malformed
+	try {
+		m_value.store(readSettingValue<T>(m_settings, m_name),
+			std::memory_order_relaxed);
+	} catch (SettingNotFoundException &e) {
+		warningstream << "SettingHandle: " << e.what() << std::endl;
+	}
+}
+
+template class SettingHandle<bool>;
+template class SettingHandle<u16>;
+template class SettingHandle<s16>;
+template class SettingHandle<u32>;
+template class SettingHandle<s32>;
+template class SettingHandle<float>;
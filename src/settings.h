@@ -26,6 +26,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <list>
 #include <set>
 #include <mutex>
+#include <atomic>
 
 class Settings;
 
@@ -291,3 +292,40 @@ class Settings {
 
 	static std::unordered_map<std::string, const FlagDesc *> s_flags;
 };
+
+/*
+ * Typed, cached view of a single setting.
+ *
+ * The value is parsed once on construction and refreshed through the regular
+ * changed-callback mechanism, so reading it is a single atomic load instead of
+ * a locked hash lookup and a string parse. Meant for code that runs every
+ * frame or every object step. Only scalar types are supported.
+ */
+template <typename T>
+class SettingHandle {
+public:
+	SettingHandle(const std::string &name, Settings *settings = g_settings);
+	~SettingHandle();
+
+	DISABLE_CLASS_COPY(SettingHandle)
+
+	inline T get() const { return m_value.load(std::memory_order_relaxed); }
+	inline operator T() const { return get(); }
+
+	const std::string &getName() const { return m_name; }
+
+private:
+	static void settingChangedCallback(const std::string &name, void *data);
+	void reload();
+
+	const std::string m_name;
+	Settings *m_settings;
+	std::atomic<T> m_value;
+};
+
+extern template class SettingHandle<bool>;
+extern template class SettingHandle<u16>;
+extern template class SettingHandle<s16>;
+extern template class SettingHandle<u32>;
+extern template class SettingHandle<s32>;
+extern template class SettingHandle<float>;
@@ -51,6 +51,12 @@ const std::wstring &Translations::getTranslation(
 	}
 }
 
+void Translations::merge(const Translations &other)
+{
+	for (const auto &it : other.m_translations)
+		m_translations[it.first] = it.second;
+}
+
 void Translations::loadTranslation(const std::string &data)
 {
 	std::istringstream is(data);
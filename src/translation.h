@@ -31,6 +31,8 @@ class Translations
 {
 public:
 	void loadTranslation(const std::string &data);
+	// Add all translations of other, replacing existing ones
+	void merge(const Translations &other);
 	void clear();
 	const std::wstring &getTranslation(
 			const std::wstring &textdomain, const std::wstring &s);
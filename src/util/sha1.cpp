@@ -72,63 +72,196 @@ SHA1::SHA1()
 SHA1::~SHA1()
 {
 	// erase data
-	H0 = H1 = H2 = H3 = H4 = 0;
+	H[0] = H[1] = H[2] = H[3] = H[4] = 0;
 	for( int c = 0; c < 64; c++ ) bytes[c] = 0;
 	unprocessedBytes = size = 0;
 }
 
+/*
+	Block functions
+
+	Both take the five state words and hash `count` complete 64-byte blocks.
+	The SHA extension version is only used when the CPU supports it.
+*/
+
+static inline Uint32 load_be32(const unsigned char *p)
+{
+	return ((Uint32)p[0] << 24) | ((Uint32)p[1] << 16) |
+		((Uint32)p[2] << 8) | (Uint32)p[3];
+}
+
+#define SHA1_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+// Message schedule kept in a 16 word ring instead of the full 80 words
+#define SHA1_W(t) (W[(t) & 15] = SHA1_ROTL(W[((t) - 3) & 15] ^ \
+		W[((t) - 8) & 15] ^ W[((t) - 14) & 15] ^ W[(t) & 15], 1))
+
+#define SHA1_STEP(f, k, w) do { \
+		Uint32 temp = SHA1_ROTL(a, 5) + (f) + e + (k) + (w); \
+		e = d; d = c; c = SHA1_ROTL(b, 30); b = a; a = temp; \
+	} while (0)
+
+static void sha1_blocks_scalar(Uint32 *H, const unsigned char *data, size_t count)
+{
+	Uint32 W[16];
+
+	for (; count > 0; count--, data += 64) {
+		Uint32 a = H[0], b = H[1], c = H[2], d = H[3], e = H[4];
+		int t;
+
+		for (t = 0; t < 16; t++) {
+			W[t] = load_be32(data + t * 4);
+			SHA1_STEP(d ^ (b & (c ^ d)), 0x5a827999, W[t]);
+		}
+		for (; t < 20; t++)
+			SHA1_STEP(d ^ (b & (c ^ d)), 0x5a827999, SHA1_W(t));
+		for (; t < 40; t++)
+			SHA1_STEP(b ^ c ^ d, 0x6ed9eba1, SHA1_W(t));
+		for (; t < 60; t++)
+			SHA1_STEP((b & c) | (d & (b | c)), 0x8f1bbcdc, SHA1_W(t));
+		for (; t < 80; t++)
+			SHA1_STEP(b ^ c ^ d, 0xca62c1d6, SHA1_W(t));
+
+		H[0] += a;
+		H[1] += b;
+		H[2] += c;
+		H[3] += d;
+		H[4] += e;
+	}
+}
+
+#undef SHA1_STEP
+#undef SHA1_W
+#undef SHA1_ROTL
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHA1_HAVE_SHANI 1
+#include <cpuid.h>
+#include <immintrin.h>
+
+static bool cpu_has_shani()
+{
+	unsigned int eax, ebx, ecx, edx;
+	// SSSE3 and SSE4.1 are needed for the byte shuffle and extract
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	if (!(ecx & (1 << 9)) || !(ecx & (1 << 19)))
+		return false;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+	return (ebx & (1 << 29)) != 0;
+}
+
+/*
+	Four rounds using the SHA extensions. The message registers rotate:
+	m0 holds the current words, m1..m3 the following ones. e_cur carries E
+	into these rounds, e_next receives the state for the next four.
+*/
+#define SHA1_ROUNDS4(e_cur, e_next, m0, m1, m2, m3, func) do { \
+		e_cur = _mm_sha1nexte_epu32(e_cur, m0); \
+		e_next = abcd; \
+		m1 = _mm_sha1msg2_epu32(m1, m0); \
+		abcd = _mm_sha1rnds4_epu32(abcd, e_cur, func); \
+		m3 = _mm_sha1msg1_epu32(m3, m0); \
+		m2 = _mm_xor_si128(m2, m0); \
+	} while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void sha1_blocks_shani(Uint32 *H, const unsigned char *data, size_t count)
+{
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+	__m128i abcd = _mm_loadu_si128((const __m128i *)H);
+	abcd = _mm_shuffle_epi32(abcd, 0x1B);
+	__m128i e0 = _mm_set_epi32(H[4], 0, 0, 0);
+	__m128i e1;
+
+	for (; count > 0; count--, data += 64) {
+		const __m128i abcd_save = abcd;
+		const __m128i e0_save = e0;
+
+		__m128i msg0 = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)(data + 0)), mask);
+		__m128i msg1 = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)(data + 16)), mask);
+		__m128i msg2 = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)(data + 32)), mask);
+		__m128i msg3 = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)(data + 48)), mask);
+
+		// Rounds 0-11: the schedule is still being filled
+		e0 = _mm_add_epi32(e0, msg0);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+		e1 = _mm_sha1nexte_epu32(e1, msg1);
+		e0 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+		msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+		e0 = _mm_sha1nexte_epu32(e0, msg2);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+		msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+		msg0 = _mm_xor_si128(msg0, msg2);
+
+		// Rounds 12-79
+		SHA1_ROUNDS4(e1, e0, msg3, msg0, msg1, msg2, 0);
+		SHA1_ROUNDS4(e0, e1, msg0, msg1, msg2, msg3, 0);
+		SHA1_ROUNDS4(e1, e0, msg1, msg2, msg3, msg0, 1);
+		SHA1_ROUNDS4(e0, e1, msg2, msg3, msg0, msg1, 1);
+		SHA1_ROUNDS4(e1, e0, msg3, msg0, msg1, msg2, 1);
+		SHA1_ROUNDS4(e0, e1, msg0, msg1, msg2, msg3, 1);
+		SHA1_ROUNDS4(e1, e0, msg1, msg2, msg3, msg0, 1);
+		SHA1_ROUNDS4(e0, e1, msg2, msg3, msg0, msg1, 2);
+		SHA1_ROUNDS4(e1, e0, msg3, msg0, msg1, msg2, 2);
+		SHA1_ROUNDS4(e0, e1, msg0, msg1, msg2, msg3, 2);
+		SHA1_ROUNDS4(e1, e0, msg1, msg2, msg3, msg0, 2);
+		SHA1_ROUNDS4(e0, e1, msg2, msg3, msg0, msg1, 2);
+		SHA1_ROUNDS4(e1, e0, msg3, msg0, msg1, msg2, 3);
+		SHA1_ROUNDS4(e0, e1, msg0, msg1, msg2, msg3, 3);
+		SHA1_ROUNDS4(e1, e0, msg1, msg2, msg3, msg0, 3);
+		SHA1_ROUNDS4(e0, e1, msg2, msg3, msg0, msg1, 3);
+		SHA1_ROUNDS4(e1, e0, msg3, msg0, msg1, msg2, 3);
+
+		e0 = _mm_sha1nexte_epu32(e0, e0_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	abcd = _mm_shuffle_epi32(abcd, 0x1B);
+	_mm_storeu_si128((__m128i *)H, abcd);
+	H[4] = _mm_extract_epi32(e0, 3);
+}
+
+#undef SHA1_ROUNDS4
+#endif
+
+bool SHA1::hasSHANI()
+{
+#ifdef SHA1_HAVE_SHANI
+	static const bool have_shani = cpu_has_shani();
+	return have_shani;
+#else
+	return false;
+#endif
+}
+
+void SHA1::processBlocks(const unsigned char *data, size_t count)
+{
+#ifdef SHA1_HAVE_SHANI
+	if (useSHANI) {
+		sha1_blocks_shani(H, data, count);
+		return;
+	}
+#endif
+	sha1_blocks_scalar(H, data, count);
+}
+
 // process ***********************************************************
 void SHA1::process()
 {
 	assert( unprocessedBytes == 64 );
-	//printf( "process: " ); hexPrinter( bytes, 64 ); printf( "\n" );
-	int t;
-	Uint32 a, b, c, d, e, K, f, W[80];
-	// starting values
-	a = H0;
-	b = H1;
-	c = H2;
-	d = H3;
-	e = H4;
-	// copy and expand the message block
-	for( t = 0; t < 16; t++ ) W[t] = (bytes[t*4] << 24)
-									+(bytes[t*4 + 1] << 16)
-									+(bytes[t*4 + 2] << 8)
-									+ bytes[t*4 + 3];
-	for(; t< 80; t++ ) W[t] = lrot( W[t-3]^W[t-8]^W[t-14]^W[t-16], 1 );
-
-	/* main loop */
-	Uint32 temp;
-	for( t = 0; t < 80; t++ )
-	{
-		if( t < 20 ) {
-			K = 0x5a827999;
-			f = (b & c) | ((~b) & d);
-		} else if( t < 40 ) {
-			K = 0x6ed9eba1;
-			f = b ^ c ^ d;
-		} else if( t < 60 ) {
-			K = 0x8f1bbcdc;
-			f = (b & c) | (b & d) | (c & d);
-		} else {
-			K = 0xca62c1d6;
-			f = b ^ c ^ d;
-		}
-		temp = lrot(a,5) + f + e + W[t] + K;
-		e = d;
-		d = c;
-		c = lrot(b,30);
-		b = a;
-		a = temp;
-		//printf( "t=%d %08x %08x %08x %08x %08x\n",t,a,b,c,d,e );
-	}
-	/* add variables */
-	H0 += a;
-	H1 += b;
-	H2 += c;
-	H3 += d;
-	H4 += e;
-	//printf( "Current: %08x %08x %08x %08x %08x\n",H0,H1,H2,H3,H4 );
+	processBlocks( bytes, 1 );
 	/* all bytes have been processed */
 	unprocessedBytes = 0;
 }
@@ -140,24 +273,31 @@ void SHA1::addBytes( const char* data, int num )
 	assert( num >= 0 );
 	// add these bytes to the running total
 	size += num;
-	// repeat until all data is processed
-	while( num > 0 )
+	// complete a partially filled block first
+	if( unprocessedBytes > 0 )
 	{
-		// number of bytes required to complete block
 		int needed = 64 - unprocessedBytes;
-		assert( needed > 0 );
-		// number of bytes to copy (use smaller of two)
 		int toCopy = (num < needed) ? num : needed;
-		// Copy the bytes
 		memcpy( bytes + unprocessedBytes, data, toCopy );
-		// Bytes have been copied
 		num -= toCopy;
 		data += toCopy;
 		unprocessedBytes += toCopy;
-
-		// there is a full block
 		if( unprocessedBytes == 64 ) process();
 	}
+	// hash whole blocks without copying them
+	if( num >= 64 )
+	{
+		int blocks = num / 64;
+		processBlocks( (const unsigned char*)data, blocks );
+		num -= blocks * 64;
+		data += blocks * 64;
+	}
+	// keep the rest for later
+	if( num > 0 )
+	{
+		memcpy( bytes, data, num );
+		unprocessedBytes = num;
+	}
 }
 
 // digest ************************************************************
@@ -188,11 +328,11 @@ unsigned char* SHA1::getDigest()
 	// allocate memory for the digest bytes
 	unsigned char* digest = (unsigned char*)malloc( 20 );
 	// copy the digest bytes
-	storeBigEndianUint32( digest, H0 );
-	storeBigEndianUint32( digest + 4, H1 );
-	storeBigEndianUint32( digest + 8, H2 );
-	storeBigEndianUint32( digest + 12, H3 );
-	storeBigEndianUint32( digest + 16, H4 );
+	storeBigEndianUint32( digest, H[0] );
+	storeBigEndianUint32( digest + 4, H[1] );
+	storeBigEndianUint32( digest + 8, H[2] );
+	storeBigEndianUint32( digest + 12, H[3] );
+	storeBigEndianUint32( digest + 16, H[4] );
 	// return the digest
 	return digest;
 }
@@ -26,27 +26,32 @@ SOFTWARE.
 
 #pragma once
 
+#include <cstddef>
+
 typedef unsigned int Uint32;
 
 class SHA1
 {
 private:
 	// fields
-	Uint32 H0 = 0x67452301;
-	Uint32 H1 = 0xefcdab89;
-	Uint32 H2 = 0x98badcfe;
-	Uint32 H3 = 0x10325476;
-	Uint32 H4 = 0xc3d2e1f0;
+	Uint32 H[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
 	unsigned char bytes[64];
 	int unprocessedBytes = 0;
 	Uint32 size = 0;
+	bool useSHANI = hasSHANI();
 	void process();
+	// Hashes `count` complete 64-byte blocks straight from `data`
+	void processBlocks(const unsigned char *data, size_t count);
 
 public:
 	SHA1();
 	~SHA1();
 	void addBytes(const char *data, int num);
 	unsigned char *getDigest();
+	// Whether the CPU supports the SHA extensions, which are then used
+	static bool hasSHANI();
+	// Falls back to the portable code, e.g. to test it on such CPUs
+	void disableSHANI() { useSHANI = false; }
 	// utility methods
 	static Uint32 lrot(Uint32 x, int bits);
 	static void storeBigEndianUint32(unsigned char *byte, Uint32 num);
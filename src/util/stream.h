@@ -68,3 +68,16 @@ class DummyStreamBuffer : public std::streambuf {
 		return n;
 	}
 };
+
+// Read-only stream buffer over memory owned by the caller, avoids copying it
+// into a std::istringstream
+class MemoryStreamBuffer : public std::streambuf {
+public:
+	MemoryStreamBuffer(const char *data, size_t size) {
+		char *begin = const_cast<char *>(data);
+		setg(begin, begin, begin + size);
+	}
+
+	// Number of bytes read so far
+	size_t getPosition() const { return gptr() - eback(); }
+};